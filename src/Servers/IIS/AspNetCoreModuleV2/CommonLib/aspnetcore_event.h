@@ -1072,5 +1072,113 @@ public:
                                  3 ); //Verbosity
         };
     };
+    //
+    // Event: mof class name ANCMForwardPhases,
+    // Description: Durations of the phases of a forwarded request
+    // EventTypeName: ANCM_REQUEST_FORWARD_PHASES
+    // EventType: 16
+    // EventLevel: 4
+    //
+    
+    class ANCM_REQUEST_FORWARD_PHASES
+    {
+    public:
+        static
+        HRESULT
+        RaiseEvent(
+            IHttpTraceContext * pHttpTraceContext,
+            LPCGUID    pContextId,
+            ULONG      ProcessAcquire,
+            ULONG      Connect,
+            ULONG      SendHeaders,
+            ULONG      SendBody,
+            ULONG      FirstByte,
+            ULONG      HeadersSet,
+            ULONG      LastByte,
+            ULONG      ClientFlush
+        )
+        //
+        // Raise ANCM_REQUEST_FORWARD_PHASES Event
+        //
+        {
+            HTTP_TRACE_EVENT Event;
+            Event.pProviderGuid = WWWServerTraceProvider::GetProviderGuid();
+            Event.dwArea =  WWWServerTraceProvider::ANCM;
+            Event.pAreaGuid = ANCMEvents::GetAreaGuid();
+            Event.dwEvent = 16;
+            Event.pszEventName = L"ANCM_REQUEST_FORWARD_PHASES";
+            Event.dwEventVersion = 1;
+            Event.dwVerbosity = 4;
+            Event.cEventItems = 9;
+            Event.pActivityGuid = nullptr;
+            Event.pRelatedActivityGuid = nullptr;
+            Event.dwTimeStamp = 0;
+            Event.dwFlags = HTTP_TRACE_EVENT_FLAG_STATIC_DESCRIPTIVE_FIELDS;
+    
+            // pActivityGuid, pRelatedActivityGuid, Timestamp to be filled in by IIS
+    
+            HTTP_TRACE_EVENT_ITEM Items[ 9 ];
+            Items[ 0 ].pszName = L"ContextId";
+            Items[ 0 ].dwDataType = HTTP_TRACE_TYPE_LPCGUID; // mof type (object)
+            Items[ 0 ].pbData = (PBYTE) pContextId;
+            Items[ 0 ].cbData = 16;
+            Items[ 0 ].pszDataDescription = nullptr;
+            Items[ 1 ].pszName = L"ProcessAcquire";
+            Items[ 1 ].dwDataType = HTTP_TRACE_TYPE_ULONG; // mof type (uint32)
+            Items[ 1 ].pbData = (PBYTE) &ProcessAcquire;
+            Items[ 1 ].cbData = 4;
+            Items[ 1 ].pszDataDescription = nullptr;
+            Items[ 2 ].pszName = L"Connect";
+            Items[ 2 ].dwDataType = HTTP_TRACE_TYPE_ULONG; // mof type (uint32)
+            Items[ 2 ].pbData = (PBYTE) &Connect;
+            Items[ 2 ].cbData = 4;
+            Items[ 2 ].pszDataDescription = nullptr;
+            Items[ 3 ].pszName = L"SendHeaders";
+            Items[ 3 ].dwDataType = HTTP_TRACE_TYPE_ULONG; // mof type (uint32)
+            Items[ 3 ].pbData = (PBYTE) &SendHeaders;
+            Items[ 3 ].cbData = 4;
+            Items[ 3 ].pszDataDescription = nullptr;
+            Items[ 4 ].pszName = L"SendBody";
+            Items[ 4 ].dwDataType = HTTP_TRACE_TYPE_ULONG; // mof type (uint32)
+            Items[ 4 ].pbData = (PBYTE) &SendBody;
+            Items[ 4 ].cbData = 4;
+            Items[ 4 ].pszDataDescription = nullptr;
+            Items[ 5 ].pszName = L"FirstByte";
+            Items[ 5 ].dwDataType = HTTP_TRACE_TYPE_ULONG; // mof type (uint32)
+            Items[ 5 ].pbData = (PBYTE) &FirstByte;
+            Items[ 5 ].cbData = 4;
+            Items[ 5 ].pszDataDescription = nullptr;
+            Items[ 6 ].pszName = L"HeadersSet";
+            Items[ 6 ].dwDataType = HTTP_TRACE_TYPE_ULONG; // mof type (uint32)
+            Items[ 6 ].pbData = (PBYTE) &HeadersSet;
+            Items[ 6 ].cbData = 4;
+            Items[ 6 ].pszDataDescription = nullptr;
+            Items[ 7 ].pszName = L"LastByte";
+            Items[ 7 ].dwDataType = HTTP_TRACE_TYPE_ULONG; // mof type (uint32)
+            Items[ 7 ].pbData = (PBYTE) &LastByte;
+            Items[ 7 ].cbData = 4;
+            Items[ 7 ].pszDataDescription = nullptr;
+            Items[ 8 ].pszName = L"ClientFlush";
+            Items[ 8 ].dwDataType = HTTP_TRACE_TYPE_ULONG; // mof type (uint32)
+            Items[ 8 ].pbData = (PBYTE) &ClientFlush;
+            Items[ 8 ].cbData = 4;
+            Items[ 8 ].pszDataDescription = nullptr;
+            Event.pEventItems = Items;
+            pHttpTraceContext->RaiseTraceEvent( &Event );
+            return S_OK;
+        };
+    
+        static
+        BOOL
+        IsEnabled( 
+            IHttpTraceContext *  pHttpTraceContext )
+        // Check if tracing for this event is enabled
+        {
+            return WWWServerTraceProvider::CheckTracingEnabled( 
+                                 pHttpTraceContext,
+                                 WWWServerTraceProvider::ANCM,
+                                 4 ); //Verbosity
+        };
+    };
 };
 #endif
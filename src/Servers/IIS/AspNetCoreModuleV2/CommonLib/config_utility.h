@@ -16,6 +16,16 @@ class ConfigUtility
     #define CS_ASPNETCORE_DEBUG_FILE                         L"debugFile"
     #define CS_ASPNETCORE_ENABLE_OUT_OF_PROCESS_CONSOLE_REDIRECTION L"enableOutOfProcessConsoleRedirection"
     #define CS_ASPNETCORE_FORWARD_RESPONSE_CONNECTION_HEADER L"forwardResponseConnectionHeader"
+    #define CS_ASPNETCORE_LOAD_BALANCING_POLICY              L"loadBalancingPolicy"
+    #define CS_ASPNETCORE_ENABLE_SPARE_PROCESS               L"enableSpareProcess"
+    #define CS_ASPNETCORE_STARTUP_QUEUE_LENGTH               L"startupQueueLength"
+    #define CS_ASPNETCORE_STARTUP_QUEUE_TIME_LIMIT           L"startupQueueTimeLimit"
+    #define CS_ASPNETCORE_RESPONSE_CACHE_SIZE                L"responseCacheSize"
+    #define CS_ASPNETCORE_ENABLE_REQUEST_COLLAPSING          L"enableRequestCollapsing"
+    #define CS_ASPNETCORE_SEND_FILE_ROOT                     L"sendFileRoot"
+    #define CS_ASPNETCORE_SERVER_TIMING_SAMPLE_RATE          L"serverTimingSampleRate"
+    #define CS_ASPNETCORE_WEBSOCKET_IDLE_TIMEOUT             L"webSocketIdleTimeout"
+    #define CS_ASPNETCORE_ENABLE_WEBSOCKET_COALESCING        L"enableWebSocketCoalescing"
     #define CS_ASPNETCORE_DEBUG_LEVEL                        L"debugLevel"
     #define CS_ASPNETCORE_HANDLER_SETTINGS_NAME              L"name"
     #define CS_ASPNETCORE_HANDLER_SETTINGS_VALUE             L"value"
@@ -56,6 +66,76 @@ public:
         return FindKeyValuePair(pElement, CS_ASPNETCORE_FORWARD_RESPONSE_CONNECTION_HEADER, strForwardResponseConnectionHeader);
     }
 
+    static
+    HRESULT
+    FindLoadBalancingPolicy(IAppHostElement* pElement, STRU& strLoadBalancingPolicy)
+    {
+        return FindKeyValuePair(pElement, CS_ASPNETCORE_LOAD_BALANCING_POLICY, strLoadBalancingPolicy);
+    }
+
+    static
+    HRESULT
+    FindEnableSpareProcess(IAppHostElement* pElement, STRU& strEnableSpareProcess)
+    {
+        return FindKeyValuePair(pElement, CS_ASPNETCORE_ENABLE_SPARE_PROCESS, strEnableSpareProcess);
+    }
+
+    static
+    HRESULT
+    FindStartupQueueLength(IAppHostElement* pElement, STRU& strStartupQueueLength)
+    {
+        return FindKeyValuePair(pElement, CS_ASPNETCORE_STARTUP_QUEUE_LENGTH, strStartupQueueLength);
+    }
+
+    static
+    HRESULT
+    FindStartupQueueTimeLimit(IAppHostElement* pElement, STRU& strStartupQueueTimeLimit)
+    {
+        return FindKeyValuePair(pElement, CS_ASPNETCORE_STARTUP_QUEUE_TIME_LIMIT, strStartupQueueTimeLimit);
+    }
+
+    static
+    HRESULT
+    FindResponseCacheSize(IAppHostElement* pElement, STRU& strResponseCacheSize)
+    {
+        return FindKeyValuePair(pElement, CS_ASPNETCORE_RESPONSE_CACHE_SIZE, strResponseCacheSize);
+    }
+
+    static
+    HRESULT
+    FindEnableRequestCollapsing(IAppHostElement* pElement, STRU& strEnableRequestCollapsing)
+    {
+        return FindKeyValuePair(pElement, CS_ASPNETCORE_ENABLE_REQUEST_COLLAPSING, strEnableRequestCollapsing);
+    }
+
+    static
+    HRESULT
+    FindSendFileRoot(IAppHostElement* pElement, STRU& strSendFileRoot)
+    {
+        return FindKeyValuePair(pElement, CS_ASPNETCORE_SEND_FILE_ROOT, strSendFileRoot);
+    }
+
+    static
+    HRESULT
+    FindServerTimingSampleRate(IAppHostElement* pElement, STRU& strServerTimingSampleRate)
+    {
+        return FindKeyValuePair(pElement, CS_ASPNETCORE_SERVER_TIMING_SAMPLE_RATE, strServerTimingSampleRate);
+    }
+
+    static
+    HRESULT
+    FindWebSocketIdleTimeout(IAppHostElement* pElement, STRU& strWebSocketIdleTimeout)
+    {
+        return FindKeyValuePair(pElement, CS_ASPNETCORE_WEBSOCKET_IDLE_TIMEOUT, strWebSocketIdleTimeout);
+    }
+
+    static
+    HRESULT
+    FindEnableWebSocketCoalescing(IAppHostElement* pElement, STRU& strEnableWebSocketCoalescing)
+    {
+        return FindKeyValuePair(pElement, CS_ASPNETCORE_ENABLE_WEBSOCKET_COALESCING, strEnableWebSocketCoalescing);
+    }
+
 private:
     static
     HRESULT
@@ -149,6 +149,38 @@ FILE_UTILITY::EnsureDirectoryPathExists(
     }
 }
 
+HRESULT
+FILE_UTILITY::GetFinalPath(
+    _In_  HANDLE    hFile,
+    _Out_ STRU*     pStruFinalPath
+)
+{
+    DWORD cchFinalPath = GetFinalPathNameByHandle(hFile,
+        pStruFinalPath->QueryStr(),
+        pStruFinalPath->QuerySizeCCH(),
+        FILE_NAME_NORMALIZED);
+
+    if (cchFinalPath >= pStruFinalPath->QuerySizeCCH())
+    {
+        //
+        // The buffer was too small, the size needed includes the terminator.
+        //
+        RETURN_IF_FAILED(pStruFinalPath->Resize(cchFinalPath));
+        cchFinalPath = GetFinalPathNameByHandle(hFile,
+            pStruFinalPath->QueryStr(),
+            pStruFinalPath->QuerySizeCCH(),
+            FILE_NAME_NORMALIZED);
+    }
+
+    RETURN_LAST_ERROR_IF(cchFinalPath == 0);
+    if (cchFinalPath >= pStruFinalPath->QuerySizeCCH())
+    {
+        RETURN_HR(HRESULT_FROM_WIN32(ERROR_INSUFFICIENT_BUFFER));
+    }
+
+    return pStruFinalPath->SyncWithBuffer();
+}
+
 std::string FILE_UTILITY::GetHtml(HMODULE module, int page, USHORT statusCode, USHORT subStatusCode, const std::string& specificReasonPhrase, const std::string& solution)
 {
     return GetHtml(module, page, statusCode, subStatusCode, specificReasonPhrase, solution, std::string());
@@ -26,6 +26,17 @@ public:
         _In_  LPCWSTR pszPath
     );
 
+    //
+    // Path of an open file or directory as resolved by the file system,
+    // with links and junctions followed.
+    //
+    static
+    HRESULT
+    GetFinalPath(
+        _In_  HANDLE    hFile,
+        _Out_ STRU*     pStruFinalPath
+    );
+
     static
     std::string
     GetHtml(HMODULE module, int page, USHORT statusCode, USHORT subStatusCode, const std::string& specificReasonPhrase, const std::string& solution);
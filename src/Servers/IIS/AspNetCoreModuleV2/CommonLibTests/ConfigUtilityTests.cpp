@@ -75,6 +75,86 @@ namespace ConfigUtilityTests
         TestHandlerVersion(L"debugLEVEL", L"value", L"value", func);
     }
 
+    TEST_F(ConfigUtilityTest, CheckLoadBalancingPolicy)
+    {
+        auto func = ConfigUtility::FindLoadBalancingPolicy;
+
+        TestHandlerVersion(L"loadBalancingPolicy", L"leastRequests", L"leastRequests", func);
+        TestHandlerVersion(L"LOADBALANCINGPOLICY", L"ewmaLatency", L"ewmaLatency", func);
+        TestHandlerVersion(L"debugLevel", L"leastRequests", L"", func);
+    }
+
+    TEST_F(ConfigUtilityTest, CheckEnableSpareProcess)
+    {
+        auto func = ConfigUtility::FindEnableSpareProcess;
+
+        TestHandlerVersion(L"enableSpareProcess", L"true", L"true", func);
+        TestHandlerVersion(L"ENABLESPAREPROCESS", L"false", L"false", func);
+        TestHandlerVersion(L"debugLevel", L"true", L"", func);
+    }
+
+    TEST_F(ConfigUtilityTest, CheckStartupQueue)
+    {
+        TestHandlerVersion(L"startupQueueLength", L"100", L"100", ConfigUtility::FindStartupQueueLength);
+        TestHandlerVersion(L"STARTUPQUEUELENGTH", L"5", L"5", ConfigUtility::FindStartupQueueLength);
+        TestHandlerVersion(L"startupQueueTimeLimit", L"30", L"30", ConfigUtility::FindStartupQueueTimeLimit);
+        TestHandlerVersion(L"startupQueueLength", L"30", L"", ConfigUtility::FindStartupQueueTimeLimit);
+    }
+
+    TEST_F(ConfigUtilityTest, CheckResponseCacheSize)
+    {
+        auto func = ConfigUtility::FindResponseCacheSize;
+
+        TestHandlerVersion(L"responseCacheSize", L"1048576", L"1048576", func);
+        TestHandlerVersion(L"RESPONSECACHESIZE", L"0", L"0", func);
+        TestHandlerVersion(L"startupQueueLength", L"100", L"", func);
+    }
+
+    TEST_F(ConfigUtilityTest, CheckEnableRequestCollapsing)
+    {
+        auto func = ConfigUtility::FindEnableRequestCollapsing;
+
+        TestHandlerVersion(L"enableRequestCollapsing", L"true", L"true", func);
+        TestHandlerVersion(L"ENABLEREQUESTCOLLAPSING", L"false", L"false", func);
+        TestHandlerVersion(L"responseCacheSize", L"true", L"", func);
+    }
+
+    TEST_F(ConfigUtilityTest, CheckSendFileRoot)
+    {
+        auto func = ConfigUtility::FindSendFileRoot;
+
+        TestHandlerVersion(L"sendFileRoot", L"wwwroot\\files", L"wwwroot\\files", func);
+        TestHandlerVersion(L"SENDFILEROOT", L"C:\\files", L"C:\\files", func);
+        TestHandlerVersion(L"enableRequestCollapsing", L"true", L"", func);
+    }
+
+    TEST_F(ConfigUtilityTest, CheckServerTimingSampleRate)
+    {
+        auto func = ConfigUtility::FindServerTimingSampleRate;
+
+        TestHandlerVersion(L"serverTimingSampleRate", L"100", L"100", func);
+        TestHandlerVersion(L"SERVERTIMINGSAMPLERATE", L"1", L"1", func);
+        TestHandlerVersion(L"sendFileRoot", L"100", L"", func);
+    }
+
+    TEST_F(ConfigUtilityTest, CheckWebSocketIdleTimeout)
+    {
+        auto func = ConfigUtility::FindWebSocketIdleTimeout;
+
+        TestHandlerVersion(L"webSocketIdleTimeout", L"300", L"300", func);
+        TestHandlerVersion(L"WEBSOCKETIDLETIMEOUT", L"60", L"60", func);
+        TestHandlerVersion(L"serverTimingSampleRate", L"300", L"", func);
+    }
+
+    TEST_F(ConfigUtilityTest, CheckEnableWebSocketCoalescing)
+    {
+        auto func = ConfigUtility::FindEnableWebSocketCoalescing;
+
+        TestHandlerVersion(L"enableWebSocketCoalescing", L"true", L"true", func);
+        TestHandlerVersion(L"ENABLEWEBSOCKETCOALESCING", L"false", L"false", func);
+        TestHandlerVersion(L"webSocketIdleTimeout", L"true", L"", func);
+    }
+
     TEST(ConfigUtilityTestSingle, MultipleElements)
     {
         IAppHostElement* retElement = NULL;
@@ -0,0 +1,216 @@
+// Copyright (c) .NET Foundation. All rights reserved.
+// Licensed under the MIT License. See License.txt in the project root for license information.
+
+#include "stdafx.h"
+#include "admissionqueue.h"
+#include <atomic>
+#include <thread>
+#include <vector>
+
+namespace AdmissionQueueTests
+{
+    const HRESULT HR_TIMEOUT = HRESULT_FROM_WIN32(ERROR_TIMEOUT);
+
+    //
+    // Records completions instead of posting them to IIS.
+    //
+    class FAKE_WAITER : public ADMISSION_WAITER
+    {
+    public:
+        void
+        OnAdmissionComplete(
+            HRESULT     hr
+        ) noexcept override
+        {
+            m_cCompletions++;
+            m_hr = hr;
+            if (m_pOrder != nullptr)
+            {
+                m_pOrder->push_back(this);
+            }
+        }
+
+        int                         m_cCompletions = 0;
+        HRESULT                     m_hr = 1;
+        std::vector<FAKE_WAITER*>  *m_pOrder = nullptr;
+    };
+
+    TEST(AdmissionQueue, DisabledQueueRejects)
+    {
+        ADMISSION_QUEUE queue;
+        FAKE_WAITER waiter;
+
+        EXPECT_FALSE(queue.IsEnabled());
+        EXPECT_FALSE(queue.Enqueue(&waiter, 0));
+        EXPECT_EQ(0, waiter.m_cCompletions);
+    }
+
+    TEST(AdmissionQueue, RejectsWhenFull)
+    {
+        ADMISSION_QUEUE queue;
+        FAKE_WAITER waiters[3];
+        queue.Initialize(2, 1000);
+
+        EXPECT_TRUE(queue.Enqueue(&waiters[0], 0));
+        EXPECT_TRUE(queue.Enqueue(&waiters[1], 0));
+        EXPECT_FALSE(queue.Enqueue(&waiters[2], 0));
+        EXPECT_EQ(2u, queue.QueryCount());
+
+        queue.CompleteAll(S_OK);
+        EXPECT_TRUE(queue.Enqueue(&waiters[2], 0));
+    }
+
+    TEST(AdmissionQueue, CompleteAllAdmitsInArrivalOrder)
+    {
+        ADMISSION_QUEUE queue;
+        FAKE_WAITER waiters[3];
+        std::vector<FAKE_WAITER*> order;
+        queue.Initialize(10, 1000);
+
+        for (FAKE_WAITER& waiter : waiters)
+        {
+            waiter.m_pOrder = &order;
+            EXPECT_TRUE(queue.Enqueue(&waiter, 0));
+        }
+
+        queue.CompleteAll(S_OK);
+
+        ASSERT_EQ(3u, order.size());
+        for (int i = 0; i < 3; i++)
+        {
+            EXPECT_EQ(&waiters[i], order[i]);
+            EXPECT_EQ(1, waiters[i].m_cCompletions);
+            EXPECT_EQ(S_OK, waiters[i].m_hr);
+        }
+        EXPECT_EQ(0u, queue.QueryCount());
+    }
+
+    TEST(AdmissionQueue, ExpiresOnlyTimedOutWaiters)
+    {
+        ADMISSION_QUEUE queue;
+        FAKE_WAITER early;
+        FAKE_WAITER late;
+        queue.Initialize(10, 1000);
+
+        EXPECT_TRUE(queue.Enqueue(&early, 0));
+        EXPECT_TRUE(queue.Enqueue(&late, 500));
+
+        queue.ExpireWaiters(999, HR_TIMEOUT);
+        EXPECT_EQ(0, early.m_cCompletions);
+
+        queue.ExpireWaiters(1000, HR_TIMEOUT);
+        EXPECT_EQ(1, early.m_cCompletions);
+        EXPECT_EQ(HR_TIMEOUT, early.m_hr);
+        EXPECT_EQ(0, late.m_cCompletions);
+        EXPECT_EQ(1u, queue.QueryCount());
+
+        queue.CompleteAll(S_OK);
+        EXPECT_EQ(S_OK, late.m_hr);
+        EXPECT_EQ(1, early.m_cCompletions);
+    }
+
+    TEST(AdmissionQueue, RemovedWaiterIsNotCompleted)
+    {
+        ADMISSION_QUEUE queue;
+        FAKE_WAITER waiters[3];
+        queue.Initialize(10, 1000);
+
+        for (FAKE_WAITER& waiter : waiters)
+        {
+            EXPECT_TRUE(queue.Enqueue(&waiter, 0));
+        }
+
+        EXPECT_TRUE(queue.Remove(&waiters[1]));
+        EXPECT_FALSE(queue.Remove(&waiters[1]));
+        queue.CompleteAll(S_OK);
+
+        EXPECT_EQ(1, waiters[0].m_cCompletions);
+        EXPECT_EQ(0, waiters[1].m_cCompletions);
+        EXPECT_EQ(1, waiters[2].m_cCompletions);
+        EXPECT_FALSE(queue.Remove(&waiters[0]));
+    }
+
+    TEST(AdmissionQueue, CloseCompletesAndRejects)
+    {
+        ADMISSION_QUEUE queue;
+        FAKE_WAITER waiter;
+        FAKE_WAITER rejected;
+        queue.Initialize(10, 1000);
+
+        EXPECT_TRUE(queue.Enqueue(&waiter, 0));
+        queue.Close(E_ABORT);
+
+        EXPECT_EQ(E_ABORT, waiter.m_hr);
+        EXPECT_FALSE(queue.Enqueue(&rejected, 0));
+    }
+
+    TEST(AdmissionQueue, WaiterCanBeDeletedOnCompletion)
+    {
+        class SELF_DELETING_WAITER : public ADMISSION_WAITER
+        {
+        public:
+            explicit SELF_DELETING_WAITER(int* pcCompleted) : m_pcCompleted(pcCompleted) {}
+
+            void
+            OnAdmissionComplete(
+                HRESULT
+            ) noexcept override
+            {
+                (*m_pcCompleted)++;
+                delete this;
+            }
+
+            int *m_pcCompleted;
+        };
+
+        ADMISSION_QUEUE queue;
+        int cCompleted = 0;
+        queue.Initialize(10, 1000);
+
+        for (int i = 0; i < 5; i++)
+        {
+            EXPECT_TRUE(queue.Enqueue(new SELF_DELETING_WAITER(&cCompleted), 0));
+        }
+        queue.ExpireWaiters(0, HR_TIMEOUT);
+        EXPECT_EQ(0, cCompleted);
+        queue.CompleteAll(S_OK);
+        EXPECT_EQ(5, cCompleted);
+    }
+
+    TEST(AdmissionQueue, ConcurrentCompletionCompletesEachWaiterOnce)
+    {
+        ADMISSION_QUEUE queue;
+        std::vector<FAKE_WAITER> waiters(4000);
+        std::atomic<bool> fDone(false);
+        queue.Initialize(static_cast<uint32_t>(waiters.size()), 50);
+
+        std::thread completer([&]()
+        {
+            uint64_t ullNow = 0;
+            while (!fDone)
+            {
+                queue.ExpireWaiters(ullNow++, HR_TIMEOUT);
+                queue.CompleteAll(S_OK);
+            }
+        });
+
+        for (size_t i = 0; i < waiters.size(); i++)
+        {
+            EXPECT_TRUE(queue.Enqueue(&waiters[i], i));
+            if (i % 3 == 0)
+            {
+                queue.Remove(&waiters[i]);
+            }
+        }
+
+        fDone = true;
+        completer.join();
+        queue.CompleteAll(S_OK);
+
+        for (const FAKE_WAITER& waiter : waiters)
+        {
+            EXPECT_LE(waiter.m_cCompletions, 1);
+        }
+        EXPECT_EQ(0u, queue.QueryCount());
+    }
+}
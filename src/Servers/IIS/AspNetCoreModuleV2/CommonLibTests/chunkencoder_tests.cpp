@@ -0,0 +1,146 @@
+// Copyright (c) .NET Foundation. All rights reserved.
+// Licensed under the MIT License. See License.txt in the project root for license information.
+
+#include "stdafx.h"
+#include "chunkencoder.h"
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+namespace ChunkEncoderTests
+{
+    std::string
+    Append(const CHUNK_ENCODER::SEGMENT& segment, std::string wire)
+    {
+        wire.append(reinterpret_cast<const char*>(segment.pbData), segment.cbData);
+        return wire;
+    }
+
+    //
+    // Frames every payload and returns what goes on the wire.
+    //
+    std::string
+    Encode(CHUNK_ENCODER& encoder, const std::vector<std::string>& payloads)
+    {
+        std::string wire;
+        CHUNK_ENCODER::SEGMENT rgSegments[CHUNK_ENCODER::SEGMENTS_PER_CHUNK];
+
+        for (const std::string& payload : payloads)
+        {
+            const uint32_t cSegments = encoder.EncodeChunk(
+                reinterpret_cast<const uint8_t*>(payload.data()),
+                static_cast<uint32_t>(payload.size()),
+                rgSegments);
+
+            EXPECT_EQ(CHUNK_ENCODER::SEGMENTS_PER_CHUNK, cSegments);
+            EXPECT_LE(rgSegments[0].cbData, CHUNK_ENCODER::MAX_SIZE_LINE);
+            EXPECT_EQ(reinterpret_cast<const uint8_t*>(payload.data()), rgSegments[1].pbData);
+
+            for (uint32_t i = 0; i < cSegments; i++)
+            {
+                wire = Append(rgSegments[i], wire);
+            }
+        }
+
+        return Append(encoder.EncodeLastChunk(), wire);
+    }
+
+    //
+    // Minimal chunked decoder, fails the test on malformed framing.
+    //
+    std::string
+    Decode(const std::string& wire)
+    {
+        std::string entity;
+        size_t i = 0;
+
+        for (;;)
+        {
+            const size_t iEol = wire.find("\r\n", i);
+            if (iEol == std::string::npos)
+            {
+                ADD_FAILURE() << "missing size line";
+                return entity;
+            }
+
+            const size_t cbChunk = std::strtoul(wire.substr(i, iEol - i).c_str(), nullptr, 16);
+            i = iEol + 2;
+            if (cbChunk == 0)
+            {
+                EXPECT_EQ("\r\n", wire.substr(i));
+                return entity;
+            }
+
+            entity += wire.substr(i, cbChunk);
+            i += cbChunk;
+            EXPECT_EQ("\r\n", wire.substr(i, 2));
+            i += 2;
+        }
+    }
+
+    TEST(ChunkEncoder, EmptyEntityIsOnlyLastChunk)
+    {
+        CHUNK_ENCODER encoder;
+
+        EXPECT_EQ("0\r\n\r\n", Encode(encoder, {}));
+    }
+
+    TEST(ChunkEncoder, FramesSingleChunk)
+    {
+        CHUNK_ENCODER encoder;
+
+        EXPECT_EQ("5\r\nhello\r\n0\r\n\r\n", Encode(encoder, { "hello" }));
+    }
+
+    TEST(ChunkEncoder, CarriesChunkEndIntoNextSizeLine)
+    {
+        CHUNK_ENCODER encoder;
+        CHUNK_ENCODER::SEGMENT rgSegments[CHUNK_ENCODER::SEGMENTS_PER_CHUNK];
+        const uint8_t payload[16] = {};
+
+        encoder.EncodeChunk(payload, 1, rgSegments);
+        EXPECT_EQ("1\r\n", Append(rgSegments[0], ""));
+
+        encoder.EncodeChunk(payload, 16, rgSegments);
+        EXPECT_EQ("\r\n10\r\n", Append(rgSegments[0], ""));
+    }
+
+    TEST(ChunkEncoder, FormatsSizesBeyond64K)
+    {
+        CHUNK_ENCODER encoder;
+        CHUNK_ENCODER::SEGMENT rgSegments[CHUNK_ENCODER::SEGMENTS_PER_CHUNK];
+        const uint8_t payload[1] = {};
+
+        encoder.EncodeChunk(payload, 0x10000, rgSegments);
+        EXPECT_EQ("10000\r\n", Append(rgSegments[0], ""));
+
+        encoder.EncodeChunk(payload, 0xfedcba98, rgSegments);
+        EXPECT_EQ("\r\nfedcba98\r\n", Append(rgSegments[0], ""));
+        EXPECT_EQ(CHUNK_ENCODER::MAX_SIZE_LINE, rgSegments[0].cbData);
+    }
+
+    TEST(ChunkEncoder, RoundTripsPayloadsOfEverySize)
+    {
+        CHUNK_ENCODER encoder;
+        std::vector<std::string> payloads;
+        std::string entity;
+
+        for (size_t cb : { 1, 15, 16, 255, 256, 4095, 4096, 8192, 65535, 65536, 300000 })
+        {
+            payloads.emplace_back(cb, static_cast<char>('a' + cb % 26));
+            entity += payloads.back();
+        }
+
+        EXPECT_EQ(entity, Decode(Encode(encoder, payloads)));
+    }
+
+    TEST(ChunkEncoder, ResetStartsNewEntity)
+    {
+        CHUNK_ENCODER encoder;
+
+        Encode(encoder, { "abc" });
+        encoder.Reset();
+
+        EXPECT_EQ("2\r\nxy\r\n0\r\n\r\n", Encode(encoder, { "xy" }));
+    }
+}
@@ -0,0 +1,357 @@
+// Copyright (c) .NET Foundation. All rights reserved.
+// Licensed under the MIT License. See License.txt in the project root for license information.
+
+#include "stdafx.h"
+#include "collapsedrequests.h"
+#include "responsecache.h"
+#include <atomic>
+#include <future>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace CollapsedRequestsTests
+{
+    class FAKE_WAITER : public COLLAPSED_REQUEST_WAITER
+    {
+    public:
+        void
+        OnCollapsedRequestComplete() noexcept override
+        {
+            m_cCompletions++;
+        }
+
+        uint32_t    m_cCompletions = 0;
+    };
+
+    //
+    // Plays the backend and the requests of a forwarder with a response
+    // cache: a request is served from the cache, else follows the request
+    // already fetching its URL, else fetches the URL from the backend.
+    //
+    class FAKE_FORWARDER
+    {
+    public:
+        FAKE_FORWARDER()
+        {
+            m_cache.Initialize(1024 * 1024, 64 * 1024);
+        }
+
+        class REQUEST : public COLLAPSED_REQUEST_WAITER
+        {
+        public:
+            REQUEST(FAKE_FORWARDER& forwarder, const std::string& strUrl)
+                : m_forwarder(forwarder),
+                  m_strUrl(strUrl)
+            {
+            }
+
+            //
+            // Returns true if the request waits for a leader.
+            //
+            bool
+            Execute()
+            {
+                m_pResponse = m_forwarder.m_cache.Lookup(m_strUrl, NoHeaders, 0);
+                if (m_pResponse != nullptr)
+                {
+                    return false;
+                }
+
+                if (!m_fFollowed && !m_forwarder.m_registry.Join(m_strUrl, this, 0))
+                {
+                    m_fFollowed = true;
+                    return true;
+                }
+
+                m_fLeader = !m_fFollowed;
+                return false;
+            }
+
+            //
+            // Completes a leader, or a follower that missed the cache,
+            // with the backend response.
+            //
+            void
+            Fetch()
+            {
+                m_forwarder.m_cBackendRequests++;
+
+                std::unique_ptr<CACHED_RESPONSE> pResponse(new CACHED_RESPONSE());
+                pResponse->strHeaders = "HTTP/1.1 200 OK\r\nCache-Control: public, max-age=60\r\n\r\n";
+                pResponse->strEntity = "entity of " + m_strUrl;
+                m_forwarder.m_cache.Insert(m_strUrl, NoHeaders, std::move(pResponse), 0);
+                m_pResponse = m_forwarder.m_cache.Lookup(m_strUrl, NoHeaders, 0);
+
+                if (m_fLeader)
+                {
+                    m_forwarder.m_registry.Release(m_strUrl);
+                }
+            }
+
+            void
+            OnCollapsedRequestComplete() noexcept override
+            {
+                m_completed.set_value();
+            }
+
+            static
+            std::string_view
+            NoHeaders(const std::string&)
+            {
+                return std::string_view();
+            }
+
+            FAKE_FORWARDER&                         m_forwarder;
+            std::string                             m_strUrl;
+            std::shared_ptr<const CACHED_RESPONSE>  m_pResponse;
+            std::promise<void>                      m_completed;
+            bool                                    m_fFollowed = false;
+            bool                                    m_fLeader = false;
+        };
+
+        //
+        // Runs a request to completion on the calling thread.
+        //
+        std::shared_ptr<const CACHED_RESPONSE>
+        Run(const std::string& strUrl)
+        {
+            REQUEST request(*this, strUrl);
+            if (request.Execute())
+            {
+                request.m_completed.get_future().wait();
+                request.Execute();
+            }
+
+            if (request.m_pResponse == nullptr)
+            {
+                request.Fetch();
+            }
+            return request.m_pResponse;
+        }
+
+        RESPONSE_CACHE                  m_cache;
+        COLLAPSED_REQUEST_REGISTRY      m_registry;
+        std::atomic<uint32_t>           m_cBackendRequests{ 0 };
+    };
+
+    TEST(CollapsedRequests, FirstRequestLeads)
+    {
+        COLLAPSED_REQUEST_REGISTRY registry;
+        FAKE_WAITER leader;
+        FAKE_WAITER follower;
+
+        EXPECT_TRUE(registry.Join("a", &leader, 0));
+        EXPECT_FALSE(registry.Join("a", &follower, 0));
+        EXPECT_TRUE(registry.Join("b", &follower, 0));
+        EXPECT_EQ(2u, registry.QueryCount());
+    }
+
+    TEST(CollapsedRequests, ReleaseCompletesEveryFollowerOnce)
+    {
+        COLLAPSED_REQUEST_REGISTRY registry;
+        FAKE_WAITER leader;
+        FAKE_WAITER followers[5];
+
+        registry.Join("a", &leader, 0);
+        for (FAKE_WAITER& follower : followers)
+        {
+            registry.Join("a", &follower, 0);
+        }
+
+        EXPECT_EQ(5u, registry.Release("a"));
+        EXPECT_EQ(0u, registry.Release("a"));
+        EXPECT_EQ(0u, registry.QueryCount());
+        EXPECT_EQ(0u, leader.m_cCompletions);
+        for (const FAKE_WAITER& follower : followers)
+        {
+            EXPECT_EQ(1u, follower.m_cCompletions);
+        }
+    }
+
+    TEST(CollapsedRequests, NextRequestLeadsAfterRelease)
+    {
+        COLLAPSED_REQUEST_REGISTRY registry;
+        FAKE_WAITER first;
+        FAKE_WAITER second;
+
+        registry.Join("a", &first, 0);
+        registry.Release("a");
+
+        EXPECT_TRUE(registry.Join("a", &second, 0));
+    }
+
+    TEST(CollapsedRequests, ExpireCompletesOnlyLateFollowers)
+    {
+        COLLAPSED_REQUEST_REGISTRY registry;
+        FAKE_WAITER leader;
+        FAKE_WAITER early[2];
+        FAKE_WAITER late;
+
+        registry.Initialize(100);
+        registry.Join("a", &leader, 0);
+        registry.Join("a", &early[0], 0);
+        registry.Join("a", &late, 50);
+        registry.Join("a", &early[1], 10);
+
+        EXPECT_EQ(0u, registry.ExpireFollowers(99));
+        EXPECT_EQ(1u, registry.ExpireFollowers(100));
+        EXPECT_EQ(1u, registry.ExpireFollowers(110));
+        EXPECT_EQ(1u, early[0].m_cCompletions);
+        EXPECT_EQ(1u, early[1].m_cCompletions);
+        EXPECT_EQ(0u, late.m_cCompletions);
+
+        //
+        // The leader keeps its key, its Release completes the rest.
+        //
+        EXPECT_EQ(1u, registry.QueryCount());
+        EXPECT_EQ(1u, registry.Release("a"));
+        EXPECT_EQ(1u, late.m_cCompletions);
+        EXPECT_EQ(1u, early[0].m_cCompletions);
+        EXPECT_EQ(0u, leader.m_cCompletions);
+    }
+
+    TEST(CollapsedRequests, FollowersWaitWithoutLimitByDefault)
+    {
+        COLLAPSED_REQUEST_REGISTRY registry;
+        FAKE_WAITER leader;
+        FAKE_WAITER follower;
+
+        registry.Join("a", &leader, 1000);
+        registry.Join("a", &follower, 1000);
+
+        EXPECT_EQ(0u, registry.ExpireFollowers(UINT64_MAX - 1));
+        EXPECT_EQ(1u, registry.Release("a"));
+    }
+
+    TEST(CollapsedRequests, ExpiredFollowerFetchesItself)
+    {
+        FAKE_FORWARDER forwarder;
+        FAKE_FORWARDER::REQUEST leader(forwarder, "host/a");
+        FAKE_FORWARDER::REQUEST follower(forwarder, "host/a");
+
+        forwarder.m_registry.Initialize(100);
+        leader.Execute();
+        EXPECT_TRUE(follower.Execute());
+
+        //
+        // The leader is slow, the follower stops waiting for it.
+        //
+        EXPECT_EQ(1u, forwarder.m_registry.ExpireFollowers(100));
+        EXPECT_FALSE(follower.Execute());
+        EXPECT_EQ(nullptr, follower.m_pResponse);
+        follower.Fetch();
+        ASSERT_TRUE(follower.m_pResponse != nullptr);
+        EXPECT_EQ(1u, forwarder.m_cBackendRequests.load());
+
+        leader.Fetch();
+        EXPECT_EQ(2u, forwarder.m_cBackendRequests.load());
+        EXPECT_EQ(0u, forwarder.m_registry.QueryCount());
+    }
+
+    TEST(CollapsedRequests, ExpireRacingReleaseCompletesFollowersOnce)
+    {
+        COLLAPSED_REQUEST_REGISTRY registry;
+        registry.Initialize(0);
+
+        for (int iRound = 0; iRound < 200; iRound++)
+        {
+            FAKE_WAITER leader;
+            std::vector<FAKE_WAITER> followers(32);
+
+            registry.Join("a", &leader, 0);
+            for (FAKE_WAITER& follower : followers)
+            {
+                registry.Join("a", &follower, 0);
+            }
+
+            std::atomic<uint32_t> cCompleted(0);
+            std::thread expire([&]() { cCompleted += registry.ExpireFollowers(0); });
+            cCompleted += registry.Release("a");
+            expire.join();
+
+            EXPECT_EQ(32u, cCompleted.load());
+            for (const FAKE_WAITER& follower : followers)
+            {
+                EXPECT_EQ(1u, follower.m_cCompletions);
+            }
+        }
+    }
+
+    TEST(CollapsedRequests, ColdStartHerdMakesOneBackendRequest)
+    {
+        FAKE_FORWARDER forwarder;
+        std::vector<std::unique_ptr<FAKE_FORWARDER::REQUEST>> requests;
+
+        for (int i = 0; i < 100; i++)
+        {
+            requests.emplace_back(new FAKE_FORWARDER::REQUEST(forwarder, "host/a"));
+            EXPECT_EQ(i != 0, requests.back()->Execute());
+        }
+
+        requests[0]->Fetch();
+
+        for (auto& pRequest : requests)
+        {
+            EXPECT_FALSE(pRequest->Execute());
+            ASSERT_TRUE(pRequest->m_pResponse != nullptr);
+            EXPECT_EQ("entity of host/a", pRequest->m_pResponse->strEntity);
+            EXPECT_EQ(requests[0]->m_pResponse.get(), pRequest->m_pResponse.get());
+        }
+
+        EXPECT_EQ(1u, forwarder.m_cBackendRequests.load());
+    }
+
+    TEST(CollapsedRequests, FollowersOfFailedLeaderFetchThemselves)
+    {
+        FAKE_FORWARDER forwarder;
+        FAKE_FORWARDER::REQUEST leader(forwarder, "host/a");
+        FAKE_FORWARDER::REQUEST follower(forwarder, "host/a");
+
+        leader.Execute();
+        EXPECT_TRUE(follower.Execute());
+
+        //
+        // The leader gives up without caching a response.
+        //
+        forwarder.m_registry.Release("host/a");
+
+        EXPECT_FALSE(follower.Execute());
+        EXPECT_EQ(nullptr, follower.m_pResponse);
+        EXPECT_FALSE(follower.m_fLeader);
+        EXPECT_EQ(0u, forwarder.m_registry.QueryCount());
+    }
+
+    TEST(CollapsedRequests, ConcurrentRequestsAllGetTheResponse)
+    {
+        FAKE_FORWARDER forwarder;
+        std::atomic<uint32_t> cServed(0);
+        std::vector<std::thread> threads;
+
+        for (int iThread = 0; iThread < 8; iThread++)
+        {
+            threads.emplace_back([&, iThread]()
+            {
+                for (int i = 0; i < 200; i++)
+                {
+                    const std::string strUrl = "host/" + std::to_string((i + iThread) % 10);
+                    const auto pResponse = forwarder.Run(strUrl);
+                    if (pResponse != nullptr && pResponse->strEntity == "entity of " + strUrl)
+                    {
+                        cServed++;
+                    }
+                }
+            });
+        }
+
+        for (std::thread& thread : threads)
+        {
+            thread.join();
+        }
+
+        EXPECT_EQ(1600u, cServed.load());
+        EXPECT_GE(forwarder.m_cBackendRequests.load(), 10u);
+        EXPECT_EQ(0u, forwarder.m_registry.QueryCount());
+    }
+}
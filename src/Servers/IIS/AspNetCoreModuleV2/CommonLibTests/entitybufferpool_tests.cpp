@@ -0,0 +1,129 @@
+// Copyright (c) .NET Foundation. All rights reserved.
+// Licensed under the MIT License. See License.txt in the project root for license information.
+
+#include "stdafx.h"
+#include "entitybufferpool.h"
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+namespace EntityBufferPoolTests
+{
+    class EntityBufferPoolTest : public testing::Test
+    {
+    protected:
+        void
+        SetUp() override
+        {
+            ASSERT_EQ(S_OK, ALLOC_CACHE_HANDLER::StaticInitialize());
+            ASSERT_EQ(S_OK, ENTITY_BUFFER_POOL::StaticInitialize());
+        }
+
+        void
+        TearDown() override
+        {
+            ENTITY_BUFFER_POOL::StaticTerminate();
+            ALLOC_CACHE_HANDLER::StaticTerminate();
+        }
+
+        //
+        // Returns the usable size of a buffer allocated for cbBuffer bytes.
+        //
+        static
+        DWORD
+        QueryUsableSize(DWORD cbBuffer)
+        {
+            DWORD cbUsable = 0;
+            BYTE *pBuffer = ENTITY_BUFFER_POOL::Alloc(cbBuffer, &cbUsable);
+            EXPECT_NE(nullptr, pBuffer);
+            if (pBuffer != nullptr)
+            {
+                memset(pBuffer, 0xAB, cbUsable);
+                ENTITY_BUFFER_POOL::Free(pBuffer);
+            }
+            return cbUsable;
+        }
+    };
+
+    TEST_F(EntityBufferPoolTest, RoundsUpToSmallestClass)
+    {
+        EXPECT_EQ(ENTITY_BUFFER_POOL::MIN_BUFFER_SIZE, QueryUsableSize(0));
+        EXPECT_EQ(ENTITY_BUFFER_POOL::MIN_BUFFER_SIZE, QueryUsableSize(1));
+        EXPECT_EQ(ENTITY_BUFFER_POOL::MIN_BUFFER_SIZE, QueryUsableSize(ENTITY_BUFFER_POOL::MIN_BUFFER_SIZE));
+        EXPECT_EQ(ENTITY_BUFFER_POOL::MIN_BUFFER_SIZE * 2, QueryUsableSize(ENTITY_BUFFER_POOL::MIN_BUFFER_SIZE + 1));
+    }
+
+    TEST_F(EntityBufferPoolTest, RoundsUpToPowerOfTwoClasses)
+    {
+        for (DWORD cbClass = ENTITY_BUFFER_POOL::MIN_BUFFER_SIZE * 2; cbClass <= ENTITY_BUFFER_POOL::MAX_BUFFER_SIZE; cbClass <<= 1)
+        {
+            EXPECT_EQ(cbClass, QueryUsableSize(cbClass / 2 + 1));
+            EXPECT_EQ(cbClass, QueryUsableSize(cbClass));
+        }
+    }
+
+    TEST_F(EntityBufferPoolTest, LargestClassIsExact)
+    {
+        EXPECT_EQ(ENTITY_BUFFER_POOL::MAX_BUFFER_SIZE, QueryUsableSize(ENTITY_BUFFER_POOL::MAX_BUFFER_SIZE - 1));
+        EXPECT_EQ(ENTITY_BUFFER_POOL::MAX_BUFFER_SIZE, QueryUsableSize(ENTITY_BUFFER_POOL::MAX_BUFFER_SIZE));
+    }
+
+    TEST_F(EntityBufferPoolTest, LargerRequestsComeFromTheHeapAtTheirSize)
+    {
+        EXPECT_EQ(ENTITY_BUFFER_POOL::MAX_BUFFER_SIZE + 1, QueryUsableSize(ENTITY_BUFFER_POOL::MAX_BUFFER_SIZE + 1));
+        EXPECT_EQ(3 * ENTITY_BUFFER_POOL::MAX_BUFFER_SIZE, QueryUsableSize(3 * ENTITY_BUFFER_POOL::MAX_BUFFER_SIZE));
+    }
+
+    TEST_F(EntityBufferPoolTest, RejectsSizesThatOverflowTheHeader)
+    {
+        EXPECT_EQ(nullptr, ENTITY_BUFFER_POOL::Alloc(MAXDWORD));
+    }
+
+    TEST_F(EntityBufferPoolTest, ReusesReleasedBuffersOfTheSameClass)
+    {
+        //
+        // Released buffers go to the lookaside list of the current CPU, stay
+        // on one CPU so the next allocations find them there.
+        //
+        const DWORD_PTR affinity = SetThreadAffinityMask(GetCurrentThread(), 1);
+        ASSERT_NE(0u, affinity);
+
+        std::vector<BYTE*> rgBuffers;
+        for (int i = 0; i < 4; i++)
+        {
+            rgBuffers.push_back(ENTITY_BUFFER_POOL::Alloc(4096));
+            ASSERT_NE(nullptr, rgBuffers.back());
+        }
+        for (BYTE *pBuffer : rgBuffers)
+        {
+            ENTITY_BUFFER_POOL::Free(pBuffer);
+        }
+
+        //
+        // Any size of the class gets a released buffer back, another class
+        // does not.
+        //
+        BYTE *pOtherClass = ENTITY_BUFFER_POOL::Alloc(8192);
+        BYTE *pSameClass = ENTITY_BUFFER_POOL::Alloc(3000);
+
+        EXPECT_EQ(rgBuffers.end(), std::find(rgBuffers.begin(), rgBuffers.end(), pOtherClass));
+        EXPECT_NE(rgBuffers.end(), std::find(rgBuffers.begin(), rgBuffers.end(), pSameClass));
+
+        ENTITY_BUFFER_POOL::Free(pSameClass);
+        ENTITY_BUFFER_POOL::Free(pOtherClass);
+        SetThreadAffinityMask(GetCurrentThread(), affinity);
+    }
+
+    TEST_F(EntityBufferPoolTest, OversizedBuffersAreNotPooled)
+    {
+        BYTE *pLarge = ENTITY_BUFFER_POOL::Alloc(ENTITY_BUFFER_POOL::MAX_BUFFER_SIZE + 1);
+        ASSERT_NE(nullptr, pLarge);
+        pLarge[ENTITY_BUFFER_POOL::MAX_BUFFER_SIZE] = 1;
+        ENTITY_BUFFER_POOL::Free(pLarge);
+
+        //
+        // The biggest class still works after a heap buffer went back.
+        //
+        EXPECT_EQ(ENTITY_BUFFER_POOL::MAX_BUFFER_SIZE, QueryUsableSize(ENTITY_BUFFER_POOL::MAX_BUFFER_SIZE));
+    }
+}
@@ -0,0 +1,186 @@
+// Copyright (c) .NET Foundation. All rights reserved.
+// Licensed under the MIT License. See License.txt in the project root for license information.
+
+#include "stdafx.h"
+#include "fragmentcoalescer.h"
+#include <algorithm>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace FragmentCoalescerTests
+{
+    constexpr uint32_t BUFFER_SIZE = 1024;
+    constexpr uint32_t MIN_RECEIVE = 256;
+
+    struct RELAY_RESULT
+    {
+        std::vector<std::string> messages;
+        size_t cSends = 0;
+    };
+
+    //
+    // Relays messages that arrive in the given parts through one direction
+    // of the WebSocket relay: receives fill the buffer behind what is held,
+    // every send writes one frame and the peer reassembles the messages
+    // from the frames.
+    //
+    RELAY_RESULT
+    Relay(
+        FRAGMENT_COALESCER& coalescer,
+        const std::vector<std::vector<std::string>>& messages)
+    {
+        RELAY_RESULT result;
+        std::string buffer(BUFFER_SIZE, '\0');
+        std::string current;
+
+        for (const auto& parts : messages)
+        {
+            for (size_t iPart = 0; iPart < parts.size(); iPart++)
+            {
+                size_t ibPart = 0;
+                do
+                {
+                    const uint32_t cbSpace = BUFFER_SIZE - coalescer.QueryBuffered();
+                    const uint32_t cbReceived = static_cast<uint32_t>(
+                        std::min<size_t>(cbSpace, parts[iPart].size() - ibPart));
+                    buffer.replace(coalescer.QueryBuffered(), cbReceived, parts[iPart], ibPart, cbReceived);
+                    ibPart += cbReceived;
+
+                    const bool fFinal = iPart + 1 == parts.size() && ibPart == parts[iPart].size();
+                    if (coalescer.OnReceive(cbReceived, fFinal, BUFFER_SIZE))
+                    {
+                        current.append(buffer, 0, coalescer.QueryBuffered());
+                        result.cSends++;
+                        coalescer.OnSent();
+                        if (fFinal)
+                        {
+                            result.messages.push_back(current);
+                            current.clear();
+                        }
+                    }
+                } while (ibPart < parts[iPart].size());
+            }
+        }
+
+        EXPECT_TRUE(current.empty());
+        return result;
+    }
+
+    //
+    // Splits messages of cbMessage bytes into cParts parts, the way they
+    // arrive when their frames cross TCP segments.
+    //
+    std::vector<std::vector<std::string>>
+    SplitMessages(size_t cMessages, size_t cbMessage, size_t cParts)
+    {
+        std::vector<std::vector<std::string>> messages(cMessages);
+        for (size_t i = 0; i < cMessages; i++)
+        {
+            const std::string message(cbMessage, static_cast<char>('a' + i % 26));
+            const size_t cbPart = (cbMessage + cParts - 1) / cParts;
+            for (size_t ib = 0; ib < cbMessage; ib += cbPart)
+            {
+                messages[i].push_back(message.substr(ib, cbPart));
+            }
+        }
+        return messages;
+    }
+
+    TEST(FragmentCoalescer, DisabledSendsEveryReceive)
+    {
+        FRAGMENT_COALESCER coalescer;
+        coalescer.Initialize(false, MIN_RECEIVE);
+
+        EXPECT_TRUE(coalescer.OnReceive(10, false, BUFFER_SIZE));
+        EXPECT_EQ(10u, coalescer.QueryBuffered());
+        coalescer.OnSent();
+        EXPECT_EQ(0u, coalescer.QueryBuffered());
+    }
+
+    TEST(FragmentCoalescer, HoldsPartsUntilFinalFragment)
+    {
+        FRAGMENT_COALESCER coalescer;
+        coalescer.Initialize(true, MIN_RECEIVE);
+
+        EXPECT_FALSE(coalescer.OnReceive(16, false, BUFFER_SIZE));
+        EXPECT_FALSE(coalescer.OnReceive(16, false, BUFFER_SIZE));
+        EXPECT_EQ(32u, coalescer.QueryBuffered());
+        EXPECT_TRUE(coalescer.OnReceive(16, true, BUFFER_SIZE));
+        EXPECT_EQ(48u, coalescer.QueryBuffered());
+    }
+
+    TEST(FragmentCoalescer, SendsWhenBufferRunsLow)
+    {
+        FRAGMENT_COALESCER coalescer;
+        coalescer.Initialize(true, MIN_RECEIVE);
+
+        EXPECT_FALSE(coalescer.OnReceive(BUFFER_SIZE - MIN_RECEIVE, false, BUFFER_SIZE));
+        EXPECT_TRUE(coalescer.OnReceive(1, false, BUFFER_SIZE));
+    }
+
+    TEST(FragmentCoalescer, PreservesMessageBoundariesAndOrder)
+    {
+        std::mt19937 random(7);
+        std::vector<std::vector<std::string>> messages;
+        std::vector<std::string> expected;
+
+        for (int i = 0; i < 500; i++)
+        {
+            const size_t cbMessage = random() % 3000;
+            std::string message;
+            for (size_t ib = 0; ib < cbMessage; ib++)
+            {
+                message.push_back(static_cast<char>(random()));
+            }
+            expected.push_back(message);
+
+            std::vector<std::string> parts;
+            size_t ib = 0;
+            do
+            {
+                const size_t cbPart = std::min<size_t>(cbMessage - ib, 1 + random() % 700);
+                parts.push_back(message.substr(ib, cbPart));
+                ib += cbPart;
+            } while (ib < cbMessage);
+            messages.push_back(parts);
+        }
+
+        for (const bool fEnabled : { false, true })
+        {
+            FRAGMENT_COALESCER coalescer;
+            coalescer.Initialize(fEnabled, MIN_RECEIVE);
+            EXPECT_EQ(expected, Relay(coalescer, messages).messages);
+        }
+    }
+
+    TEST(FragmentCoalescer, SmallMessagesTakeOneSendEach)
+    {
+        //
+        // 64 byte messages arriving in four parts: every relayed part costs
+        // a send and its completion, so coalescing relays four times as many
+        // messages per completion.
+        //
+        const auto messages = SplitMessages(10000, 64, 4);
+        FRAGMENT_COALESCER coalescer;
+
+        coalescer.Initialize(false, MIN_RECEIVE);
+        const RELAY_RESULT uncoalesced = Relay(coalescer, messages);
+
+        coalescer.Initialize(true, MIN_RECEIVE);
+        const RELAY_RESULT coalesced = Relay(coalescer, messages);
+
+        EXPECT_EQ(40000u, uncoalesced.cSends);
+        EXPECT_EQ(10000u, coalesced.cSends);
+        EXPECT_EQ(uncoalesced.messages, coalesced.messages);
+    }
+
+    TEST(FragmentCoalescer, WholeMessagesAreNotDelayed)
+    {
+        const auto messages = SplitMessages(1000, 64, 1);
+        FRAGMENT_COALESCER coalescer;
+        coalescer.Initialize(true, MIN_RECEIVE);
+
+        EXPECT_EQ(1000u, Relay(coalescer, messages).cSends);
+    }
+}
@@ -0,0 +1,273 @@
+// Copyright (c) .NET Foundation. All rights reserved.
+// Licensed under the MIT License. See License.txt in the project root for license information.
+
+#include "stdafx.h"
+#include "headertokenizer.h"
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace HeaderTokenizerTests
+{
+    using HEADERS = std::vector<std::pair<std::string, std::string>>;
+
+    bool Tokenize(std::string_view block, uint16_t& status, std::string& reason, HEADERS& headers)
+    {
+        HEADER_TOKENIZER tokenizer(block);
+        std::string_view reasonSpan;
+        if (!tokenizer.ParseStatusLine(status, reasonSpan))
+        {
+            return false;
+        }
+        reason = reasonSpan;
+
+        std::string_view name;
+        std::string_view value;
+        while (tokenizer.Next(name, value))
+        {
+            headers.emplace_back(name, value);
+        }
+        return !tokenizer.HasError();
+    }
+
+    TEST(HeaderTokenizer, ParsesStatusLineAndHeaders)
+    {
+        uint16_t status = 0;
+        std::string reason;
+        HEADERS headers;
+
+        ASSERT_TRUE(Tokenize(
+            "HTTP/1.1 404 Not Found\r\n"
+            "Content-Type: text/plain\r\n"
+            "Content-Length:12\r\n"
+            "X-Custom  :   spaced value   \r\n"
+            "\r\n",
+            status, reason, headers));
+
+        EXPECT_EQ(404, status);
+        EXPECT_EQ("Not Found", reason);
+        ASSERT_EQ(3u, headers.size());
+        EXPECT_EQ("Content-Type", headers[0].first);
+        EXPECT_EQ("text/plain", headers[0].second);
+        EXPECT_EQ("Content-Length", headers[1].first);
+        EXPECT_EQ("12", headers[1].second);
+        EXPECT_EQ("X-Custom", headers[2].first);
+        EXPECT_EQ("spaced value", headers[2].second);
+    }
+
+    TEST(HeaderTokenizer, SpansPointIntoOriginalBlock)
+    {
+        const std::string block = "HTTP/1.1 200 OK\r\nServer: Kestrel\r\n\r\n";
+        HEADER_TOKENIZER tokenizer(block);
+        uint16_t status = 0;
+        std::string_view reason;
+        std::string_view name;
+        std::string_view value;
+
+        ASSERT_TRUE(tokenizer.ParseStatusLine(status, reason));
+        ASSERT_TRUE(tokenizer.Next(name, value));
+        EXPECT_EQ(block.data() + 17, name.data());
+        EXPECT_EQ(block.data() + 25, value.data());
+        EXPECT_FALSE(tokenizer.Next(name, value));
+        EXPECT_FALSE(tokenizer.HasError());
+    }
+
+    TEST(HeaderTokenizer, KeepsObsFoldInValue)
+    {
+        uint16_t status = 0;
+        std::string reason;
+        HEADERS headers;
+
+        ASSERT_TRUE(Tokenize(
+            "HTTP/1.1 200 OK\r\n"
+            "X-Folded: first\r\n"
+            "\tsecond\r\n"
+            "  third\r\n"
+            "X-Next: value\r\n"
+            "\r\n",
+            status, reason, headers));
+
+        ASSERT_EQ(2u, headers.size());
+        EXPECT_EQ("X-Folded", headers[0].first);
+        EXPECT_EQ("first\r\n\tsecond\r\n  third", headers[0].second);
+        EXPECT_EQ("X-Next", headers[1].first);
+        EXPECT_EQ("value", headers[1].second);
+    }
+
+    TEST(HeaderTokenizer, AcceptsBareLineFeedsAndEmptyValues)
+    {
+        uint16_t status = 0;
+        std::string reason;
+        HEADERS headers;
+
+        ASSERT_TRUE(Tokenize("HTTP/1.1 204 No Content\nX-Empty:\nX-Also-Empty:   \r\n\n", status, reason, headers));
+
+        EXPECT_EQ(204, status);
+        EXPECT_EQ("No Content", reason);
+        ASSERT_EQ(2u, headers.size());
+        EXPECT_EQ("", headers[0].second);
+        EXPECT_EQ("", headers[1].second);
+    }
+
+    TEST(HeaderTokenizer, ColonInValueBelongsToValue)
+    {
+        uint16_t status = 0;
+        std::string reason;
+        HEADERS headers;
+
+        ASSERT_TRUE(Tokenize("HTTP/1.1 302 Found\r\nLocation: http://localhost:5000/a\r\n\r\n", status, reason, headers));
+
+        ASSERT_EQ(1u, headers.size());
+        EXPECT_EQ("Location", headers[0].first);
+        EXPECT_EQ("http://localhost:5000/a", headers[0].second);
+    }
+
+    TEST(HeaderTokenizer, MissingReasonPhraseIsEmpty)
+    {
+        uint16_t status = 0;
+        std::string reason;
+        HEADERS headers;
+
+        ASSERT_TRUE(Tokenize("HTTP/1.1 500\r\nServer: Kestrel\r\n\r\n", status, reason, headers));
+
+        EXPECT_EQ(500, status);
+        EXPECT_EQ("", reason);
+        ASSERT_EQ(1u, headers.size());
+    }
+
+    TEST(HeaderTokenizer, RejectsMalformedBlocks)
+    {
+        uint16_t status = 0;
+        std::string reason;
+
+        HEADERS headers;
+        EXPECT_FALSE(Tokenize("HTTP/1.1 200 OK", status, reason, headers));
+        EXPECT_FALSE(Tokenize("HTTP/1.1\r\n\r\n", status, reason, headers));
+        EXPECT_FALSE(Tokenize("HTTP/1.1 OK\r\n\r\n", status, reason, headers));
+        EXPECT_FALSE(Tokenize("HTTP/1.1 200 OK\r\nNoColon\r\n\r\n", status, reason, headers));
+        EXPECT_FALSE(Tokenize("HTTP/1.1 200 OK\r\n: no name\r\n\r\n", status, reason, headers));
+        EXPECT_FALSE(Tokenize("HTTP/1.1 200 OK\r\nName: unterminated", status, reason, headers));
+    }
+
+    TEST(HeaderTokenizer, FindDelimitersMatchesScalarSearchAtEveryOffset)
+    {
+        for (size_t length = 0; length < 40; length++)
+        {
+            for (size_t colonAt = 0; colonAt <= length; colonAt++)
+            {
+                for (size_t newLineAt = 0; newLineAt <= length; newLineAt++)
+                {
+                    std::string text(length, 'a');
+                    if (colonAt < length)
+                    {
+                        text[colonAt] = ':';
+                    }
+                    if (newLineAt < length)
+                    {
+                        text[newLineAt] = '\n';
+                    }
+
+                    const size_t expectedColon = text.find(':');
+                    const size_t expectedEnd = text.find('\n');
+                    const bool fExpected = expectedEnd != std::string::npos && expectedColon < expectedEnd;
+
+                    size_t colon = 0;
+                    size_t endOfLine = 0;
+                    ASSERT_EQ(fExpected, HEADER_TOKENIZER::FindDelimiters(text, colon, endOfLine));
+                    if (fExpected)
+                    {
+                        EXPECT_EQ(expectedColon, colon);
+                        EXPECT_EQ(expectedEnd, endOfLine);
+                    }
+                    EXPECT_EQ(expectedEnd, HEADER_TOKENIZER::Find(text, '\n'));
+                }
+            }
+        }
+    }
+
+    TEST(HeaderTokenizer, FindDelimitersFollowsContinuationsAcrossBlocks)
+    {
+        //
+        // The continuation and the later ':' fall into the next 16 byte block.
+        //
+        const std::string text = "Name: first part\r\n second: part\r\nNext: x\r\n";
+
+        size_t colon = 0;
+        size_t endOfLine = 0;
+        ASSERT_TRUE(HEADER_TOKENIZER::FindDelimiters(text, colon, endOfLine));
+        EXPECT_EQ(4u, colon);
+        EXPECT_EQ(text.find("\r\nNext") + 1, endOfLine);
+    }
+
+    TEST(HeaderTokenizer, FindDelimitersMatchesScalarSearchOnRandomInput)
+    {
+        std::mt19937 generator(7);
+        const char alphabet[] = { 'a', ' ', '\t', ':', '\r', '\n', '\0' };
+        std::uniform_int_distribution<size_t> pickChar(0, sizeof(alphabet) - 1);
+        std::uniform_int_distribution<size_t> pickLength(0, 100);
+
+        for (int i = 0; i < 5000; i++)
+        {
+            std::string text(pickLength(generator), 'a');
+            for (char& ch : text)
+            {
+                ch = alphabet[pickChar(generator)];
+            }
+
+            //
+            // Scalar reference: the first ':' must come before the first '\n',
+            // a '\n' followed by SP or HTAB continues the line.
+            //
+            const size_t expectedColon = text.find(':');
+            size_t expectedEnd = text.find('\n');
+            while (expectedEnd != std::string::npos && expectedEnd + 1 < text.size() &&
+                (text[expectedEnd + 1] == ' ' || text[expectedEnd + 1] == '\t'))
+            {
+                expectedEnd = text.find('\n', expectedEnd + 1);
+            }
+            const bool fExpected = expectedColon < text.find('\n') && expectedEnd != std::string::npos;
+
+            size_t colon = 0;
+            size_t endOfLine = 0;
+            ASSERT_EQ(fExpected, HEADER_TOKENIZER::FindDelimiters(text, colon, endOfLine));
+            if (fExpected)
+            {
+                EXPECT_EQ(expectedColon, colon);
+                EXPECT_EQ(expectedEnd, endOfLine);
+            }
+        }
+    }
+
+    TEST(HeaderTokenizer, RandomInputStaysWithinBlock)
+    {
+        std::mt19937 generator(42);
+        const char alphabet[] = { 'a', 'Z', '0', ' ', '\t', ':', '\r', '\n', '\0', '\x80' };
+        std::uniform_int_distribution<size_t> pickChar(0, sizeof(alphabet) - 1);
+        std::uniform_int_distribution<size_t> pickLength(0, 200);
+
+        for (int i = 0; i < 2000; i++)
+        {
+            std::string block = "HTTP/1.1 200 OK\r\n";
+            const size_t length = pickLength(generator);
+            for (size_t j = 0; j < length; j++)
+            {
+                block += alphabet[pickChar(generator)];
+            }
+
+            HEADER_TOKENIZER tokenizer(block);
+            uint16_t status = 0;
+            std::string_view reason;
+            std::string_view name;
+            std::string_view value;
+
+            ASSERT_TRUE(tokenizer.ParseStatusLine(status, reason));
+            while (tokenizer.Next(name, value))
+            {
+                EXPECT_FALSE(name.empty());
+                EXPECT_GE(name.data(), block.data());
+                EXPECT_LE(value.data() + value.size(), block.data() + block.size());
+            }
+        }
+    }
+}
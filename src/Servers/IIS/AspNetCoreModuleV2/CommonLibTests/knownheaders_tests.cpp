@@ -0,0 +1,86 @@
+// Copyright (c) .NET Foundation. All rights reserved.
+// Licensed under the MIT License. See License.txt in the project root for license information.
+
+#include "stdafx.h"
+#include "knownheaders.h"
+
+namespace KnownHeadersTests
+{
+    TEST(KnownHeaders, ResponseNamesMapToHeaderIds)
+    {
+        EXPECT_EQ(static_cast<uint32_t>(HttpHeaderCacheControl), g_KnownResponseHeaders.GetIndex("Cache-Control"));
+        EXPECT_EQ(static_cast<uint32_t>(HttpHeaderTransferEncoding), g_KnownResponseHeaders.GetIndex("Transfer-Encoding"));
+        EXPECT_EQ(static_cast<uint32_t>(HttpHeaderContentLength), g_KnownResponseHeaders.GetIndex("Content-Length"));
+        EXPECT_EQ(static_cast<uint32_t>(HttpHeaderAcceptRanges), g_KnownResponseHeaders.GetIndex("Accept-Ranges"));
+        EXPECT_EQ(static_cast<uint32_t>(HttpHeaderServer), g_KnownResponseHeaders.GetIndex("Server"));
+        EXPECT_EQ(static_cast<uint32_t>(HttpHeaderVary), g_KnownResponseHeaders.GetIndex("Vary"));
+    }
+
+    TEST(KnownHeaders, ResponseLookupIgnoresCase)
+    {
+        EXPECT_EQ(static_cast<uint32_t>(HttpHeaderContentType), g_KnownResponseHeaders.GetIndex("content-type"));
+        EXPECT_EQ(static_cast<uint32_t>(HttpHeaderContentType), g_KnownResponseHeaders.GetIndex("CONTENT-TYPE"));
+        EXPECT_EQ(static_cast<uint32_t>(HttpHeaderEtag), g_KnownResponseHeaders.GetIndex("etag"));
+    }
+
+    TEST(KnownHeaders, SetCookieAndWwwAuthenticateStayUnknown)
+    {
+        EXPECT_EQ(UNKNOWN_INDEX, g_KnownResponseHeaders.GetIndex("Set-Cookie"));
+        EXPECT_EQ(UNKNOWN_INDEX, g_KnownResponseHeaders.GetIndex("WWW-Authenticate"));
+    }
+
+    TEST(KnownHeaders, UnknownNamesAreRejected)
+    {
+        EXPECT_EQ(UNKNOWN_INDEX, g_KnownResponseHeaders.GetIndex(""));
+        EXPECT_EQ(UNKNOWN_INDEX, g_KnownResponseHeaders.GetIndex("X-Powered-By"));
+        EXPECT_EQ(UNKNOWN_INDEX, g_KnownResponseHeaders.GetIndex("Content-Lengt"));
+        EXPECT_EQ(UNKNOWN_INDEX, g_KnownResponseHeaders.GetIndex("Content-Length2"));
+        EXPECT_EQ(UNKNOWN_INDEX, g_KnownResponseHeaders.GetIndex("Host"));
+        EXPECT_EQ(UNKNOWN_INDEX, g_KnownRequestHeaders.GetIndex("Server"));
+        EXPECT_EQ(UNKNOWN_INDEX, g_KnownRequestHeaders.GetIndex("X-Forwarded-For"));
+    }
+
+    TEST(KnownHeaders, EveryNameRoundTrips)
+    {
+        for (uint32_t i = 0; i < std::size(g_rgResponseHeaderNames); i++)
+        {
+            if (!g_rgResponseHeaderNames[i].empty())
+            {
+                EXPECT_EQ(i, g_KnownResponseHeaders.GetIndex(g_rgResponseHeaderNames[i]));
+            }
+        }
+        for (uint32_t i = 0; i < std::size(g_rgRequestHeaderNames); i++)
+        {
+            EXPECT_EQ(i, g_KnownRequestHeaders.GetIndex(g_rgRequestHeaderNames[i]));
+        }
+    }
+
+    TEST(KnownHeaders, TablesCoverHttpHeaderIds)
+    {
+        EXPECT_EQ(static_cast<size_t>(HttpHeaderResponseMaximum), std::size(g_rgResponseHeaderNames));
+        EXPECT_EQ(static_cast<size_t>(HttpHeaderRequestMaximum), std::size(g_rgRequestHeaderNames));
+
+        EXPECT_EQ(static_cast<uint32_t>(HttpHeaderHost), g_KnownRequestHeaders.GetIndex("host"));
+        EXPECT_EQ(static_cast<uint32_t>(HttpHeaderUserAgent), g_KnownRequestHeaders.GetIndex("User-Agent"));
+        EXPECT_EQ(static_cast<uint32_t>(HttpHeaderTe), g_KnownRequestHeaders.GetIndex("te"));
+    }
+
+    TEST(KnownHeaders, LookupIsAvailableAtCompileTime)
+    {
+        static_assert(g_KnownResponseHeaders.GetIndex("Date") == 2, "Date is HttpHeaderDate");
+        static_assert(g_KnownRequestHeaders.GetIndex("Cookie") == 25, "Cookie is HttpHeaderCookie");
+    }
+
+    TEST(KnownHeaders, SeedSearchGivesUpOnCollidingNames)
+    {
+        //
+        // Names equal but for case hash alike under every seed.
+        //
+        static constexpr std::string_view rgNames[] = { "Accept", "ACCEPT" };
+        constexpr KNOWN_HEADER_TABLE<std::size(rgNames)> table(rgNames);
+
+        static_assert(!table.HasPerfectHash(), "Colliding names have no perfect hash");
+        static_assert(g_KnownResponseHeaders.HasPerfectHash() && g_KnownRequestHeaders.HasPerfectHash(),
+            "The header tables have a perfect hash");
+    }
+}
@@ -0,0 +1,207 @@
+// Copyright (c) .NET Foundation. All rights reserved.
+// Licensed under the MIT License. See License.txt in the project root for license information.
+
+#include "stdafx.h"
+#include "loadbalancer.h"
+#include <algorithm>
+#include <deque>
+#include <random>
+#include <vector>
+
+namespace LoadBalancerTests
+{
+    //
+    // Replays a fixed arrival schedule against FIFO backends with the given
+    // service times (microseconds) and returns the 99th percentile latency.
+    //
+    uint64_t SimulateP99(LOAD_BALANCING_POLICY policy, const std::vector<uint64_t>& serviceTimes, uint64_t interArrival, uint32_t cRequests)
+    {
+        LOAD_BALANCER balancer;
+        balancer.SetPolicy(policy);
+
+        std::vector<BACKEND_LOAD> loads(serviceTimes.size());
+        std::vector<const BACKEND_LOAD*> rgLoads;
+        for (const BACKEND_LOAD& load : loads)
+        {
+            rgLoads.push_back(&load);
+        }
+
+        std::vector<std::deque<std::pair<uint64_t, uint64_t>>> inFlight(serviceTimes.size());
+        std::vector<uint64_t> latencies;
+        std::mt19937 generator(7);
+        std::uniform_int_distribution<uint64_t> jitter(0, interArrival);
+        uint64_t now = 0;
+
+        for (uint32_t i = 0; i < cRequests; i++)
+        {
+            now += interArrival / 2 + jitter(generator);
+
+            for (size_t j = 0; j < inFlight.size(); j++)
+            {
+                while (!inFlight[j].empty() && inFlight[j].front().first <= now)
+                {
+                    loads[j].OnLatencySample(inFlight[j].front().second);
+                    loads[j].OnRequestEnd();
+                    inFlight[j].pop_front();
+                }
+            }
+
+            const uint32_t selected = balancer.Select(rgLoads.data(), static_cast<uint32_t>(rgLoads.size()));
+            const uint64_t start = inFlight[selected].empty() ? now : std::max(now, inFlight[selected].back().first);
+            const uint64_t completion = start + serviceTimes[selected];
+
+            loads[selected].OnRequestStart();
+            inFlight[selected].emplace_back(completion, completion - now);
+            latencies.push_back(completion - now);
+        }
+
+        std::sort(latencies.begin(), latencies.end());
+        return latencies[latencies.size() * 99 / 100];
+    }
+
+    TEST(LoadBalancer, RoundRobinCyclesThroughAllSlots)
+    {
+        LOAD_BALANCER balancer;
+        const BACKEND_LOAD* rgLoads[3] = {};
+
+        EXPECT_EQ(1u, balancer.Select(rgLoads, 3));
+        EXPECT_EQ(2u, balancer.Select(rgLoads, 3));
+        EXPECT_EQ(0u, balancer.Select(rgLoads, 3));
+    }
+
+    TEST(LoadBalancer, LeastRequestsPicksIdleProcess)
+    {
+        LOAD_BALANCER balancer;
+        balancer.SetPolicy(LOAD_BALANCING_LEAST_REQUESTS);
+
+        BACKEND_LOAD loads[3];
+        loads[0].OnRequestStart();
+        loads[1].OnRequestStart();
+        loads[1].OnRequestStart();
+        const BACKEND_LOAD* rgLoads[3] = { &loads[0], &loads[1], &loads[2] };
+
+        for (int i = 0; i < 10; i++)
+        {
+            EXPECT_EQ(2u, balancer.Select(rgLoads, 3));
+        }
+
+        loads[2].OnRequestStart();
+        loads[2].OnRequestStart();
+        EXPECT_EQ(0u, balancer.Select(rgLoads, 3));
+    }
+
+    TEST(LoadBalancer, EmptySlotsCountAsIdle)
+    {
+        LOAD_BALANCER balancer;
+        balancer.SetPolicy(LOAD_BALANCING_LEAST_REQUESTS);
+
+        BACKEND_LOAD load;
+        load.OnRequestStart();
+        const BACKEND_LOAD* rgLoads[2] = { &load, nullptr };
+
+        EXPECT_EQ(1u, balancer.Select(rgLoads, 2));
+        EXPECT_EQ(1u, balancer.Select(rgLoads, 2));
+    }
+
+    TEST(LoadBalancer, EqualLoadsShareTraffic)
+    {
+        for (const LOAD_BALANCING_POLICY policy : { LOAD_BALANCING_LEAST_REQUESTS, LOAD_BALANCING_POWER_OF_TWO_CHOICES, LOAD_BALANCING_EWMA_LATENCY })
+        {
+            LOAD_BALANCER balancer;
+            balancer.SetPolicy(policy);
+
+            BACKEND_LOAD loads[4];
+            const BACKEND_LOAD* rgLoads[4] = { &loads[0], &loads[1], &loads[2], &loads[3] };
+            uint32_t counts[4] = {};
+
+            for (int i = 0; i < 4000; i++)
+            {
+                counts[balancer.Select(rgLoads, 4)]++;
+            }
+            for (const uint32_t count : counts)
+            {
+                EXPECT_GT(count, 800u);
+            }
+        }
+    }
+
+    TEST(LoadBalancer, PowerOfTwoChoicesNeverPicksTheBusiestOfTwo)
+    {
+        LOAD_BALANCER balancer;
+        balancer.SetPolicy(LOAD_BALANCING_POWER_OF_TWO_CHOICES);
+
+        BACKEND_LOAD loads[2];
+        loads[0].OnRequestStart();
+        const BACKEND_LOAD* rgLoads[2] = { &loads[0], &loads[1] };
+
+        for (int i = 0; i < 100; i++)
+        {
+            EXPECT_EQ(1u, balancer.Select(rgLoads, 2));
+        }
+    }
+
+    TEST(LoadBalancer, EwmaLatencyAvoidsSlowProcess)
+    {
+        LOAD_BALANCER balancer;
+        balancer.SetPolicy(LOAD_BALANCING_EWMA_LATENCY);
+
+        BACKEND_LOAD loads[2];
+        loads[0].OnLatencySample(10000);
+        loads[1].OnLatencySample(1000);
+        loads[1].OnRequestStart();
+        const BACKEND_LOAD* rgLoads[2] = { &loads[0], &loads[1] };
+
+        EXPECT_EQ(1u, balancer.Select(rgLoads, 2));
+    }
+
+    TEST(LoadBalancer, EwmaMovesTowardsSamples)
+    {
+        BACKEND_LOAD load;
+        load.OnLatencySample(800);
+        EXPECT_EQ(800u, load.QueryLatencyEwma());
+
+        load.OnLatencySample(1600);
+        EXPECT_EQ(900u, load.QueryLatencyEwma());
+
+        for (int i = 0; i < 200; i++)
+        {
+            load.OnLatencySample(100);
+        }
+        EXPECT_LT(load.QueryLatencyEwma(), 110u);
+    }
+
+    TEST(LoadBalancer, ParsesPolicyNames)
+    {
+        LOAD_BALANCING_POLICY policy = LOAD_BALANCING_EWMA_LATENCY;
+
+        EXPECT_TRUE(LOAD_BALANCER::TryParsePolicy(L"", &policy));
+        EXPECT_EQ(LOAD_BALANCING_ROUND_ROBIN, policy);
+        EXPECT_TRUE(LOAD_BALANCER::TryParsePolicy(L"LeastRequests", &policy));
+        EXPECT_EQ(LOAD_BALANCING_LEAST_REQUESTS, policy);
+        EXPECT_TRUE(LOAD_BALANCER::TryParsePolicy(L"powerOfTwoChoices", &policy));
+        EXPECT_EQ(LOAD_BALANCING_POWER_OF_TWO_CHOICES, policy);
+        EXPECT_TRUE(LOAD_BALANCER::TryParsePolicy(L"ewmalatency", &policy));
+        EXPECT_EQ(LOAD_BALANCING_EWMA_LATENCY, policy);
+        EXPECT_FALSE(LOAD_BALANCER::TryParsePolicy(L"random", &policy));
+    }
+
+    TEST(LoadBalancer, LoadAwarePoliciesCutTailLatencyWithSlowProcess)
+    {
+        // Three processes serve a request in 1ms, one is stuck at 10ms (e.g. in a long GC).
+        // Offered load is ~80% of the total capacity, more than the slow process can take
+        // as a round-robin share.
+        const std::vector<uint64_t> serviceTimes = { 1000, 1000, 1000, 10000 };
+        const uint64_t interArrival = 400;
+        const uint32_t cRequests = 20000;
+
+        const uint64_t roundRobin = SimulateP99(LOAD_BALANCING_ROUND_ROBIN, serviceTimes, interArrival, cRequests);
+        const uint64_t leastRequests = SimulateP99(LOAD_BALANCING_LEAST_REQUESTS, serviceTimes, interArrival, cRequests);
+        const uint64_t powerOfTwo = SimulateP99(LOAD_BALANCING_POWER_OF_TWO_CHOICES, serviceTimes, interArrival, cRequests);
+        const uint64_t ewma = SimulateP99(LOAD_BALANCING_EWMA_LATENCY, serviceTimes, interArrival, cRequests);
+
+        EXPECT_LT(leastRequests * 10, roundRobin);
+        EXPECT_LT(powerOfTwo * 10, roundRobin);
+        EXPECT_LT(ewma * 10, roundRobin);
+        EXPECT_LE(ewma, leastRequests);
+    }
+}
@@ -0,0 +1,185 @@
+// Copyright (c) .NET Foundation. All rights reserved.
+// Licensed under the MIT License. See License.txt in the project root for license information.
+
+#include "stdafx.h"
+#include "portallocator.h"
+#include <random>
+#include <set>
+
+namespace PortAllocatorTests
+{
+    TEST(PortAllocator, ReservesHintWhenFree)
+    {
+        PORT_ALLOCATOR allocator(10000, 48000);
+        uint32_t dwPort = 0;
+
+        EXPECT_TRUE(allocator.Reserve(12345, &dwPort));
+        EXPECT_EQ(12345u, dwPort);
+        EXPECT_TRUE(allocator.IsReserved(12345));
+    }
+
+    TEST(PortAllocator, SkipsReservedAndListeningPorts)
+    {
+        PORT_ALLOCATOR allocator(10000, 48000);
+        uint32_t dwPort = 0;
+
+        allocator.BeginSnapshot(0);
+        allocator.MarkListening(10001);
+        allocator.MarkListening(10003);
+
+        EXPECT_TRUE(allocator.Reserve(10000, &dwPort));
+        EXPECT_EQ(10000u, dwPort);
+        EXPECT_TRUE(allocator.Reserve(10000, &dwPort));
+        EXPECT_EQ(10002u, dwPort);
+        EXPECT_TRUE(allocator.Reserve(10000, &dwPort));
+        EXPECT_EQ(10004u, dwPort);
+    }
+
+    TEST(PortAllocator, ReleasedPortCanBeReservedAgain)
+    {
+        PORT_ALLOCATOR allocator(10000, 10001);
+        uint32_t dwPort = 0;
+
+        EXPECT_TRUE(allocator.Reserve(10000, &dwPort));
+        EXPECT_TRUE(allocator.Reserve(10000, &dwPort));
+        EXPECT_FALSE(allocator.Reserve(10000, &dwPort));
+
+        allocator.Release(10000);
+        EXPECT_FALSE(allocator.IsReserved(10000));
+        EXPECT_TRUE(allocator.Reserve(10001, &dwPort));
+        EXPECT_EQ(10000u, dwPort);
+    }
+
+    TEST(PortAllocator, WrapsAroundToPortsBelowHint)
+    {
+        PORT_ALLOCATOR allocator(100, 299);
+        uint32_t dwPort = 0;
+
+        allocator.BeginSnapshot(0);
+        for (uint32_t i = 102; i <= 299; i++)
+        {
+            allocator.MarkListening(i);
+        }
+
+        EXPECT_TRUE(allocator.Reserve(250, &dwPort));
+        EXPECT_EQ(100u, dwPort);
+        EXPECT_TRUE(allocator.Reserve(101, &dwPort));
+        EXPECT_EQ(101u, dwPort);
+        EXPECT_FALSE(allocator.Reserve(101, &dwPort));
+    }
+
+    TEST(PortAllocator, NeverReturnsPortsOutsideRange)
+    {
+        PORT_ALLOCATOR allocator(1000, 1069);
+        std::set<uint32_t> ports;
+        uint32_t dwPort = 0;
+
+        while (allocator.Reserve(5000, &dwPort))
+        {
+            EXPECT_GE(dwPort, 1000u);
+            EXPECT_LE(dwPort, 1069u);
+            EXPECT_TRUE(ports.insert(dwPort).second);
+        }
+        EXPECT_EQ(70u, ports.size());
+    }
+
+    TEST(PortAllocator, SnapshotGoesStale)
+    {
+        PORT_ALLOCATOR allocator(10000, 48000);
+
+        EXPECT_TRUE(allocator.IsSnapshotStale(0, 1000));
+        allocator.BeginSnapshot(5000);
+        EXPECT_FALSE(allocator.IsSnapshotStale(5999, 1000));
+        EXPECT_TRUE(allocator.IsSnapshotStale(6000, 1000));
+
+        allocator.InvalidateSnapshot();
+        EXPECT_TRUE(allocator.IsSnapshotStale(5000, 1000));
+    }
+
+    TEST(PortAllocator, SnapshotAgeCountsFromLastSnapshot)
+    {
+        PORT_ALLOCATOR allocator(10000, 48000);
+
+        EXPECT_EQ(UINT64_MAX, allocator.QuerySnapshotAge(0));
+        allocator.BeginSnapshot(5000);
+        EXPECT_EQ(0u, allocator.QuerySnapshotAge(5000));
+        EXPECT_EQ(250u, allocator.QuerySnapshotAge(5250));
+
+        allocator.InvalidateSnapshot();
+        EXPECT_EQ(UINT64_MAX, allocator.QuerySnapshotAge(5250));
+    }
+
+    TEST(PortAllocator, NewSnapshotReplacesListeningPorts)
+    {
+        PORT_ALLOCATOR allocator(10000, 48000);
+        uint32_t dwPort = 0;
+
+        allocator.BeginSnapshot(0);
+        allocator.MarkListening(20000);
+        allocator.BeginSnapshot(1);
+
+        EXPECT_TRUE(allocator.Reserve(20000, &dwPort));
+        EXPECT_EQ(20000u, dwPort);
+    }
+
+    TEST(PortAllocator, ReportsListenersOfCurrentSnapshot)
+    {
+        PORT_ALLOCATOR allocator(10000, 48000);
+        uint32_t dwPort = 0;
+
+        allocator.BeginSnapshot(0);
+        allocator.MarkListening(20000);
+        allocator.MarkListening(9000);
+        EXPECT_TRUE(allocator.Reserve(30000, &dwPort));
+
+        EXPECT_TRUE(allocator.IsListening(20000));
+        EXPECT_FALSE(allocator.IsListening(9000));
+        EXPECT_FALSE(allocator.IsListening(30000));
+
+        allocator.InvalidateSnapshot();
+        EXPECT_FALSE(allocator.IsListening(20000));
+
+        allocator.BeginSnapshot(1);
+        EXPECT_FALSE(allocator.IsListening(20000));
+    }
+
+    TEST(PortAllocator, DenselyUsedRangeStillFindsDistinctPorts)
+    {
+        // 95% of the range is taken by other listeners, the rest is handed
+        // out to processes recycling with random hints.
+        PORT_ALLOCATOR allocator(10000, 48000);
+        std::mt19937 generator(11);
+        std::uniform_int_distribution<uint32_t> ports(10000, 48000);
+        std::set<uint32_t> listening;
+        std::set<uint32_t> reserved;
+        uint32_t dwPort = 0;
+
+        allocator.BeginSnapshot(0);
+        for (uint32_t i = 10000; i <= 48000; i++)
+        {
+            if (i % 20 != 0)
+            {
+                allocator.MarkListening(i);
+                listening.insert(i);
+            }
+        }
+
+        for (int i = 0; i < 1900; i++)
+        {
+            ASSERT_TRUE(allocator.Reserve(ports(generator), &dwPort));
+            EXPECT_EQ(0u, listening.count(dwPort));
+            EXPECT_TRUE(reserved.insert(dwPort).second);
+        }
+
+        for (int i = 0; i < 10000; i++)
+        {
+            const uint32_t dwReleased = *reserved.begin();
+            reserved.erase(reserved.begin());
+            allocator.Release(dwReleased);
+
+            ASSERT_TRUE(allocator.Reserve(ports(generator), &dwPort));
+            EXPECT_EQ(0u, listening.count(dwPort));
+            EXPECT_TRUE(reserved.insert(dwPort).second);
+        }
+    }
+}
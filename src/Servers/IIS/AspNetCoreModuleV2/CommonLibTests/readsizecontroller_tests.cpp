@@ -0,0 +1,216 @@
+// Copyright (c) .NET Foundation. All rights reserved.
+// Licensed under the MIT License. See License.txt in the project root for license information.
+
+#include "stdafx.h"
+#include "readsizecontroller.h"
+
+namespace ReadSizeControllerTests
+{
+    //
+    // Replays a response whose bytes are always available faster than they are
+    // read and returns how many read completions it took to drain it.
+    //
+    uint32_t ReplayBulkTransfer(READ_SIZE_CONTROLLER& controller, uint64_t cbResponse)
+    {
+        uint32_t cCompletions = 0;
+        while (cbResponse != 0)
+        {
+            const uint32_t cbRead = static_cast<uint32_t>(
+                cbResponse < controller.QueryReadSize() ? cbResponse : controller.QueryReadSize());
+            controller.OnReadComplete(cbRead);
+            cbResponse -= cbRead;
+            cCompletions++;
+        }
+        return cCompletions;
+    }
+
+    TEST(ReadSizeController, StartsSmallForUnknownLength)
+    {
+        READ_SIZE_CONTROLLER controller;
+        controller.Initialize(READ_SIZE_CONTROLLER::UNKNOWN_CONTENT_LENGTH, 0);
+
+        EXPECT_EQ(READ_SIZE_CONTROLLER::INITIAL_READ_SIZE, controller.QueryReadSize());
+    }
+
+    TEST(ReadSizeController, NeverReadsPastContentLength)
+    {
+        READ_SIZE_CONTROLLER controller;
+        controller.Initialize(100, 0);
+
+        EXPECT_EQ(100u, controller.QueryReadSize());
+        controller.OnReadComplete(60);
+        EXPECT_EQ(40u, controller.QueryReadSize());
+    }
+
+    TEST(ReadSizeController, KnownLengthEndsAtZero)
+    {
+        READ_SIZE_CONTROLLER controller;
+        controller.Initialize(100, 0);
+
+        controller.OnReadComplete(100);
+        EXPECT_EQ(0u, controller.QueryReadSize());
+
+        //
+        // A finished body is not mistaken for a stream of unknown length.
+        //
+        controller.OnReadComplete(0);
+        EXPECT_EQ(0u, controller.QueryReadSize());
+    }
+
+    TEST(ReadSizeController, EmptyKnownLengthReadsNothing)
+    {
+        READ_SIZE_CONTROLLER controller;
+        controller.Initialize(0, 0);
+
+        EXPECT_EQ(0u, controller.QueryReadSize());
+    }
+
+    TEST(ReadSizeController, UnknownLengthKeepsReading)
+    {
+        READ_SIZE_CONTROLLER controller;
+        controller.Initialize(READ_SIZE_CONTROLLER::UNKNOWN_CONTENT_LENGTH, 0);
+
+        for (int i = 0; i < 1000; i++)
+        {
+            controller.OnReadComplete(controller.QueryReadSize() / 2);
+            EXPECT_EQ(READ_SIZE_CONTROLLER::INITIAL_READ_SIZE, controller.QueryReadSize());
+        }
+    }
+
+    TEST(ReadSizeController, LargeContentLengthStartsAtBulkSize)
+    {
+        READ_SIZE_CONTROLLER controller;
+        controller.Initialize(50 * 1024 * 1024, 0);
+
+        EXPECT_EQ(READ_SIZE_CONTROLLER::BULK_READ_SIZE, controller.QueryReadSize());
+    }
+
+    TEST(ReadSizeController, GrowsOnFullReadsUpToMaximum)
+    {
+        READ_SIZE_CONTROLLER controller;
+        controller.Initialize(READ_SIZE_CONTROLLER::UNKNOWN_CONTENT_LENGTH, 0);
+
+        for (int i = 0; i < 100; i++)
+        {
+            controller.OnReadComplete(controller.QueryReadSize());
+        }
+
+        EXPECT_EQ(READ_SIZE_CONTROLLER::MAX_READ_SIZE, controller.QueryReadSize());
+    }
+
+    TEST(ReadSizeController, DoesNotGrowOnPartialReads)
+    {
+        READ_SIZE_CONTROLLER controller;
+        controller.Initialize(READ_SIZE_CONTROLLER::UNKNOWN_CONTENT_LENGTH, 0);
+
+        for (int i = 0; i < 100; i++)
+        {
+            controller.OnReadComplete(controller.QueryReadSize() - 1);
+        }
+
+        EXPECT_EQ(READ_SIZE_CONTROLLER::INITIAL_READ_SIZE, controller.QueryReadSize());
+    }
+
+    TEST(ReadSizeController, ShrinksWhenReadsComeBackMostlyEmpty)
+    {
+        READ_SIZE_CONTROLLER controller;
+        controller.Initialize(READ_SIZE_CONTROLLER::UNKNOWN_CONTENT_LENGTH, 0);
+
+        for (int i = 0; i < 100; i++)
+        {
+            controller.OnReadComplete(controller.QueryReadSize());
+        }
+        for (int i = 0; i < 100; i++)
+        {
+            controller.OnReadComplete(16);
+        }
+
+        EXPECT_EQ(READ_SIZE_CONTROLLER::INITIAL_READ_SIZE, controller.QueryReadSize());
+    }
+
+    TEST(ReadSizeController, RespectsReadLimit)
+    {
+        READ_SIZE_CONTROLLER controller;
+        controller.Initialize(50 * 1024 * 1024, 32 * 1024);
+
+        EXPECT_EQ(32u * 1024, controller.QueryReadSize());
+        for (int i = 0; i < 100; i++)
+        {
+            controller.OnReadComplete(controller.QueryReadSize());
+        }
+        EXPECT_EQ(32u * 1024, controller.QueryReadSize());
+    }
+
+    TEST(ReadSizeController, ReadLimitBelowInitialSizeIsIgnored)
+    {
+        READ_SIZE_CONTROLLER controller;
+        controller.Initialize(READ_SIZE_CONTROLLER::UNKNOWN_CONTENT_LENGTH, 1024);
+
+        EXPECT_EQ(READ_SIZE_CONTROLLER::INITIAL_READ_SIZE, controller.QueryReadSize());
+    }
+
+    TEST(ReadSizeController, BulkTransferNeedsFewerCompletionsPerMegabyte)
+    {
+        const uint64_t cbResponse = 50 * 1024 * 1024;
+
+        READ_SIZE_CONTROLLER unknownLength;
+        unknownLength.Initialize(READ_SIZE_CONTROLLER::UNKNOWN_CONTENT_LENGTH, 0);
+
+        READ_SIZE_CONTROLLER knownLength;
+        knownLength.Initialize(cbResponse, 0);
+
+        const uint32_t cFixedSizeCompletions = static_cast<uint32_t>(cbResponse / READ_SIZE_CONTROLLER::INITIAL_READ_SIZE);
+
+        // 8 KB reads need 128 completions per MB, adaptive reads end up at 4.
+        EXPECT_LT(ReplayBulkTransfer(unknownLength, cbResponse), cFixedSizeCompletions / 16);
+        EXPECT_LT(ReplayBulkTransfer(knownLength, cbResponse), cFixedSizeCompletions / 16);
+    }
+
+    TEST(ReadSizeController, RangeMovesBetweenItsBounds)
+    {
+        READ_SIZE_CONTROLLER controller;
+        controller.InitializeRange(1024, 64 * 1024);
+
+        EXPECT_EQ(1024u, controller.QueryReadSize());
+        for (int i = 0; i < 100; i++)
+        {
+            controller.OnReadComplete(controller.QueryReadSize());
+        }
+        EXPECT_EQ(64u * 1024, controller.QueryReadSize());
+
+        for (int i = 0; i < 100; i++)
+        {
+            controller.OnReadComplete(16);
+        }
+        EXPECT_EQ(1024u, controller.QueryReadSize());
+    }
+
+    TEST(ReadSizeController, RangeRelaysSmallMessagesInOneHop)
+    {
+        READ_SIZE_CONTROLLER controller;
+        controller.InitializeRange(1024, 64 * 1024);
+
+        //
+        // Chat sized messages never grow the buffer.
+        //
+        for (int i = 0; i < 1000; i++)
+        {
+            EXPECT_GE(controller.QueryReadSize(), 200u);
+            controller.OnReadComplete(200);
+        }
+        EXPECT_EQ(1024u, controller.QueryReadSize());
+    }
+
+    TEST(ReadSizeController, RangeRelaysBulkStreamInFewerHops)
+    {
+        const uint64_t cbStream = 16 * 1024 * 1024;
+
+        READ_SIZE_CONTROLLER controller;
+        controller.InitializeRange(1024, 64 * 1024);
+
+        //
+        // 4 KB hops need 4096 completions for the stream, 64 KB hops 256.
+        //
+        EXPECT_LT(ReplayBulkTransfer(controller, cbStream), 300u);
+    }
+}
@@ -0,0 +1,197 @@
+// Copyright (c) .NET Foundation. All rights reserved.
+// Licensed under the MIT License. See License.txt in the project root for license information.
+
+#include "stdafx.h"
+#include "relaycleanupgate.h"
+#include <atomic>
+#include <thread>
+#include <vector>
+
+namespace RelayCleanupGateTests
+{
+    TEST(RelayCleanupGate, CleanupCancelsWhenNoPumpIsInside)
+    {
+        RELAY_CLEANUP_GATE gate;
+
+        EXPECT_TRUE(gate.TryEnter());
+        EXPECT_FALSE(gate.Leave());
+
+        EXPECT_TRUE(gate.BeginCleanup(3));
+        EXPECT_TRUE(gate.IsCleanupStarted());
+        EXPECT_EQ(3u, gate.QueryCleanupReason());
+        EXPECT_FALSE(gate.TryEnter());
+    }
+
+    TEST(RelayCleanupGate, LastPumpInsideCancels)
+    {
+        RELAY_CLEANUP_GATE gate;
+
+        EXPECT_TRUE(gate.TryEnter());
+        EXPECT_TRUE(gate.TryEnter());
+
+        EXPECT_FALSE(gate.BeginCleanup(4));
+        EXPECT_FALSE(gate.TryEnter());
+
+        EXPECT_FALSE(gate.Leave());
+        EXPECT_TRUE(gate.Leave());
+    }
+
+    TEST(RelayCleanupGate, FirstCleanupWins)
+    {
+        RELAY_CLEANUP_GATE gate;
+
+        EXPECT_TRUE(gate.BeginCleanup(3));
+        EXPECT_FALSE(gate.BeginCleanup(4));
+        EXPECT_EQ(3u, gate.QueryCleanupReason());
+    }
+
+    TEST(RelayCleanupGate, CancelsOnceAfterAllIo)
+    {
+        for (int iRun = 0; iRun < 50; iRun++)
+        {
+            RELAY_CLEANUP_GATE gate;
+            std::atomic<int> cIssued(0);
+            std::atomic<int> cIssuedAtCancel(-1);
+            std::atomic<int> cCancels(0);
+            std::vector<std::thread> pumps;
+
+            auto cancel = [&]()
+            {
+                cIssuedAtCancel = cIssued.load();
+                cCancels++;
+            };
+
+            //
+            // Two pumps, as for the two directions of a WebSocket, race
+            // with the cleanup.
+            //
+            for (int iPump = 0; iPump < 2; iPump++)
+            {
+                pumps.emplace_back([&]()
+                {
+                    while (gate.TryEnter())
+                    {
+                        cIssued++;
+                        if (gate.Leave())
+                        {
+                            cancel();
+                        }
+                    }
+                });
+            }
+
+            std::this_thread::yield();
+            if (gate.BeginCleanup(5))
+            {
+                cancel();
+            }
+
+            for (std::thread& pump : pumps)
+            {
+                pump.join();
+            }
+
+            EXPECT_EQ(1, cCancels.load());
+            EXPECT_EQ(cIssued.load(), cIssuedAtCancel.load());
+        }
+    }
+
+    //
+    // Replays the WebSocket relay protocol: IO completions hold an IO count
+    // while they reissue IO or clean up, and the request completes once the
+    // count drops to 0 after a cleanup. The idle timeout cleans up from a
+    // timer thread and holds an IO count the same way, so the request never
+    // completes while the timeout still cancels its IO.
+    //
+    TEST(RelayCleanupGate, TimeoutCancelsWhileRelayIoCompletes)
+    {
+        for (int iRun = 0; iRun < 200; iRun++)
+        {
+            RELAY_CLEANUP_GATE gate;
+            std::atomic<int> cOutstandingIo(2);
+            std::atomic<bool> fIndicateCompletion(false);
+            std::atomic<bool> fCompleted(false);
+            std::atomic<int> cCancelsAfterCompletion(0);
+            std::vector<std::thread> pumps;
+
+            auto decrementIo = [&]()
+            {
+                if (--cOutstandingIo == 0 && fIndicateCompletion)
+                {
+                    fCompleted = true;
+                }
+            };
+
+            auto cancel = [&]()
+            {
+                for (int i = 0; i < 3; i++)
+                {
+                    if (fCompleted)
+                    {
+                        cCancelsAfterCompletion++;
+                    }
+                    std::this_thread::yield();
+                }
+            };
+
+            auto cleanup = [&](uint32_t reason)
+            {
+                fIndicateCompletion = true;
+                if (gate.BeginCleanup(reason))
+                {
+                    cancel();
+                }
+            };
+
+            //
+            // Every other run, one direction also fails on its own while the
+            // timeout fires.
+            //
+            for (int iPump = 0; iPump < 2; iPump++)
+            {
+                pumps.emplace_back([&, iPump]()
+                {
+                    for (int iIo = 0; ; iIo++)
+                    {
+                        const bool fFailed = iPump == 0 && iRun % 2 == 1 && iIo == iRun % 16;
+                        bool fReissued = false;
+
+                        if (!fFailed && gate.TryEnter())
+                        {
+                            cOutstandingIo++;
+                            fReissued = true;
+                            if (gate.Leave())
+                            {
+                                cancel();
+                            }
+                        }
+                        if (fFailed)
+                        {
+                            cleanup(2);
+                        }
+                        decrementIo();
+
+                        if (!fReissued)
+                        {
+                            return;
+                        }
+                    }
+                });
+            }
+
+            std::this_thread::yield();
+            cOutstandingIo++;
+            cleanup(1);
+            decrementIo();
+
+            for (std::thread& pump : pumps)
+            {
+                pump.join();
+            }
+
+            EXPECT_TRUE(fCompleted.load());
+            EXPECT_EQ(0, cOutstandingIo.load());
+            EXPECT_EQ(0, cCancelsAfterCompletion.load());
+        }
+    }
+}
@@ -0,0 +1,276 @@
+// Copyright (c) .NET Foundation. All rights reserved.
+// Licensed under the MIT License. See License.txt in the project root for license information.
+
+#include "stdafx.h"
+#include "requestbodypipeline.h"
+#include <algorithm>
+#include <string>
+
+namespace RequestBodyPipelineTests
+{
+    //
+    // Plays the client and the backend of an upload. Every read and write
+    // takes one tick, reads of the client and writes to the backend run in
+    // parallel like http.sys and WinHTTP do.
+    //
+    class FAKE_UPLOAD
+    {
+    public:
+        FAKE_UPLOAD(const std::string& entity, uint32_t cbBuffer, bool fChunked)
+            : m_entity(entity),
+              m_cbBuffer(cbBuffer),
+              m_fChunked(fChunked)
+        {
+            m_pipeline.Initialize(static_cast<uint32_t>(entity.size()), fChunked);
+        }
+
+        //
+        // Runs the upload to completion and returns the number of ticks.
+        //
+        uint32_t
+        Run()
+        {
+            uint32_t cTicks = 0;
+            Pump();
+            while (!m_fSendComplete)
+            {
+                EXPECT_TRUE(m_fReadPending || m_fWritePending);
+                cTicks++;
+
+                //
+                // Both completions of a tick are delivered, the read first.
+                //
+                const bool fWriteCompletes = m_fWritePending;
+                if (m_fReadPending)
+                {
+                    CompleteRead();
+                }
+                if (fWriteCompletes)
+                {
+                    m_fWritePending = false;
+                    m_pipeline.OnWriteComplete();
+                }
+                Pump();
+            }
+            return cTicks;
+        }
+
+        //
+        // Issues every operation the pipeline asks for.
+        //
+        void
+        Pump()
+        {
+            uint32_t iBuffer = 0;
+            uint32_t cbData = 0;
+
+            for (;;)
+            {
+                switch (m_pipeline.NextAction(m_cbBuffer, &iBuffer, &cbData))
+                {
+                case REQUEST_BODY_PIPELINE::ACTION_READ:
+                    EXPECT_FALSE(m_fReadPending);
+                    EXPECT_LT(iBuffer, REQUEST_BODY_PIPELINE::BUFFER_COUNT);
+                    EXPECT_LE(cbData, m_cbBuffer);
+                    m_fReadPending = true;
+                    m_iReadBuffer = iBuffer;
+                    m_cbRead = cbData;
+                    if (m_fWritePending)
+                    {
+                        EXPECT_NE(m_iWriteBuffer, iBuffer);
+                        m_cOverlapped++;
+                    }
+                    break;
+
+                case REQUEST_BODY_PIPELINE::ACTION_WRITE:
+                    EXPECT_FALSE(m_fWritePending);
+                    m_fWritePending = true;
+                    m_iWriteBuffer = iBuffer;
+                    m_sent.append(m_buffers[iBuffer], 0, cbData);
+                    break;
+
+                case REQUEST_BODY_PIPELINE::ACTION_WRITE_LAST_CHUNK:
+                    EXPECT_TRUE(m_fChunked);
+                    EXPECT_FALSE(m_fWritePending);
+                    m_fWritePending = true;
+                    m_cLastChunks++;
+                    break;
+
+                case REQUEST_BODY_PIPELINE::ACTION_SEND_COMPLETE:
+                    EXPECT_FALSE(m_fReadPending);
+                    EXPECT_FALSE(m_fWritePending);
+                    m_fSendComplete = true;
+                    return;
+
+                case REQUEST_BODY_PIPELINE::ACTION_NONE:
+                    return;
+                }
+            }
+        }
+
+        void
+        CompleteRead()
+        {
+            m_fReadPending = false;
+            if (m_iEntity == m_entity.size())
+            {
+                m_pipeline.OnReadEof();
+                return;
+            }
+
+            const size_t cbRead = std::min<size_t>(m_cbRead, m_entity.size() - m_iEntity);
+            m_buffers[m_iReadBuffer] = m_entity.substr(m_iEntity, cbRead);
+            m_iEntity += cbRead;
+            m_pipeline.OnReadComplete(static_cast<uint32_t>(cbRead));
+        }
+
+        REQUEST_BODY_PIPELINE   m_pipeline;
+        std::string             m_entity;
+        std::string             m_sent;
+        std::string             m_buffers[REQUEST_BODY_PIPELINE::BUFFER_COUNT];
+        uint32_t                m_cbBuffer;
+        bool                    m_fChunked;
+        size_t                  m_iEntity = 0;
+        uint32_t                m_iReadBuffer = 0;
+        uint32_t                m_iWriteBuffer = 0;
+        uint32_t                m_cbRead = 0;
+        uint32_t                m_cOverlapped = 0;
+        uint32_t                m_cLastChunks = 0;
+        bool                    m_fReadPending = false;
+        bool                    m_fWritePending = false;
+        bool                    m_fSendComplete = false;
+    };
+
+    std::string
+    MakeEntity(size_t cb)
+    {
+        std::string entity;
+        for (size_t i = 0; i < cb; i++)
+        {
+            entity.push_back(static_cast<char>('a' + i % 26));
+        }
+        return entity;
+    }
+
+    TEST(RequestBodyPipeline, EmptyEntitySendsRightAway)
+    {
+        REQUEST_BODY_PIPELINE pipeline;
+        uint32_t iBuffer = 0;
+        uint32_t cbData = 0;
+        pipeline.Initialize(0, false);
+
+        EXPECT_EQ(REQUEST_BODY_PIPELINE::ACTION_SEND_COMPLETE, pipeline.NextAction(100, &iBuffer, &cbData));
+        EXPECT_EQ(REQUEST_BODY_PIPELINE::ACTION_NONE, pipeline.NextAction(100, &iBuffer, &cbData));
+    }
+
+    TEST(RequestBodyPipeline, ReadsNextChunkWhileWriting)
+    {
+        REQUEST_BODY_PIPELINE pipeline;
+        uint32_t iBuffer = 0;
+        uint32_t cbData = 0;
+        pipeline.Initialize(300, false);
+
+        EXPECT_EQ(REQUEST_BODY_PIPELINE::ACTION_READ, pipeline.NextAction(100, &iBuffer, &cbData));
+        EXPECT_EQ(0u, iBuffer);
+        EXPECT_EQ(100u, cbData);
+        EXPECT_EQ(REQUEST_BODY_PIPELINE::ACTION_NONE, pipeline.NextAction(100, &iBuffer, &cbData));
+
+        pipeline.OnReadComplete(100);
+        EXPECT_EQ(REQUEST_BODY_PIPELINE::ACTION_WRITE, pipeline.NextAction(100, &iBuffer, &cbData));
+        EXPECT_EQ(0u, iBuffer);
+        EXPECT_EQ(100u, cbData);
+        EXPECT_EQ(REQUEST_BODY_PIPELINE::ACTION_READ, pipeline.NextAction(100, &iBuffer, &cbData));
+        EXPECT_EQ(1u, iBuffer);
+        EXPECT_EQ(REQUEST_BODY_PIPELINE::ACTION_NONE, pipeline.NextAction(100, &iBuffer, &cbData));
+    }
+
+    TEST(RequestBodyPipeline, ReadyChunkWaitsForPendingWrite)
+    {
+        REQUEST_BODY_PIPELINE pipeline;
+        uint32_t iBuffer = 0;
+        uint32_t cbData = 0;
+        pipeline.Initialize(300, false);
+
+        pipeline.NextAction(100, &iBuffer, &cbData);
+        pipeline.OnReadComplete(100);
+        pipeline.NextAction(100, &iBuffer, &cbData);
+        pipeline.NextAction(100, &iBuffer, &cbData);
+
+        //
+        // Both buffers are taken until the write completes.
+        //
+        pipeline.OnReadComplete(100);
+        EXPECT_EQ(REQUEST_BODY_PIPELINE::ACTION_NONE, pipeline.NextAction(100, &iBuffer, &cbData));
+
+        pipeline.OnWriteComplete();
+        EXPECT_EQ(REQUEST_BODY_PIPELINE::ACTION_WRITE, pipeline.NextAction(100, &iBuffer, &cbData));
+        EXPECT_EQ(1u, iBuffer);
+        EXPECT_EQ(REQUEST_BODY_PIPELINE::ACTION_READ, pipeline.NextAction(100, &iBuffer, &cbData));
+        EXPECT_EQ(0u, iBuffer);
+    }
+
+    TEST(RequestBodyPipeline, NeverReadsPastContentLength)
+    {
+        FAKE_UPLOAD upload(MakeEntity(250), 100, false);
+
+        upload.Run();
+
+        EXPECT_EQ(upload.m_entity, upload.m_sent);
+        EXPECT_EQ(0u, upload.m_cLastChunks);
+    }
+
+    TEST(RequestBodyPipeline, ChunkedEntityEndsWithOneLastChunk)
+    {
+        FAKE_UPLOAD upload(MakeEntity(1000), 64, true);
+
+        upload.Run();
+
+        EXPECT_EQ(upload.m_entity, upload.m_sent);
+        EXPECT_EQ(1u, upload.m_cLastChunks);
+    }
+
+    TEST(RequestBodyPipeline, EmptyChunkedEntityOnlySendsLastChunk)
+    {
+        FAKE_UPLOAD upload("", 64, true);
+
+        upload.Run();
+
+        EXPECT_TRUE(upload.m_sent.empty());
+        EXPECT_EQ(1u, upload.m_cLastChunks);
+    }
+
+    TEST(RequestBodyPipeline, EmptyReadDoesNotEndChunkedEntity)
+    {
+        REQUEST_BODY_PIPELINE pipeline;
+        uint32_t iBuffer = 0;
+        uint32_t cbData = 0;
+        pipeline.Initialize(0, true);
+
+        pipeline.NextAction(100, &iBuffer, &cbData);
+        pipeline.OnReadComplete(0);
+        EXPECT_EQ(REQUEST_BODY_PIPELINE::ACTION_READ, pipeline.NextAction(100, &iBuffer, &cbData));
+
+        pipeline.OnReadEof();
+        EXPECT_EQ(REQUEST_BODY_PIPELINE::ACTION_WRITE_LAST_CHUNK, pipeline.NextAction(100, &iBuffer, &cbData));
+        EXPECT_EQ(REQUEST_BODY_PIPELINE::ACTION_NONE, pipeline.NextAction(100, &iBuffer, &cbData));
+        pipeline.OnWriteComplete();
+        EXPECT_EQ(REQUEST_BODY_PIPELINE::ACTION_SEND_COMPLETE, pipeline.NextAction(100, &iBuffer, &cbData));
+    }
+
+    TEST(RequestBodyPipeline, OverlapsReadsAndWritesOnLargeUploads)
+    {
+        //
+        // Uploading N buffers one read and one write at a time takes 2N
+        // ticks, overlapped it takes N + 1.
+        //
+        const uint32_t cbBuffer = 8 * 1024;
+        const uint32_t cBuffers = 128;
+        FAKE_UPLOAD upload(MakeEntity(cbBuffer * cBuffers), cbBuffer, false);
+
+        const uint32_t cTicks = upload.Run();
+
+        EXPECT_EQ(upload.m_entity, upload.m_sent);
+        EXPECT_EQ(cBuffers + 1, cTicks);
+        EXPECT_EQ(cBuffers - 1, upload.m_cOverlapped);
+    }
+}
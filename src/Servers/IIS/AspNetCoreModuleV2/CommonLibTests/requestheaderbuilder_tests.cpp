@@ -0,0 +1,185 @@
+// Copyright (c) .NET Foundation. All rights reserved.
+// Licensed under the MIT License. See License.txt in the project root for license information.
+
+#include "stdafx.h"
+#include "requestheaderbuilder.h"
+#include <string>
+#include <vector>
+
+namespace RequestHeaderBuilderTests
+{
+    struct HEADER
+    {
+        std::string_view name;
+        std::string_view value;
+    };
+
+    std::string Build(REQUEST_HEADER_BUILDER& builder, const std::vector<HEADER>& headers)
+    {
+        for (const HEADER& header : headers)
+        {
+            builder.Measure(g_KnownRequestHeaders.GetIndex(header.name), header.name, header.value);
+        }
+
+        std::wstring block(builder.EndMeasure(), L'\0');
+        builder.BeginWrite(block.data(), block.size());
+        for (const HEADER& header : headers)
+        {
+            builder.Write(g_KnownRequestHeaders.GetIndex(header.name), header.name, header.value);
+        }
+
+        const size_t cchWritten = builder.EndWrite();
+        EXPECT_FALSE(builder.HasError());
+        EXPECT_EQ(block.size(), cchWritten);
+
+        std::string result;
+        for (const wchar_t ch : block)
+        {
+            result += static_cast<char>(ch);
+        }
+        return result;
+    }
+
+    REQUEST_HEADER_RULES DefaultRules(bool fPreserveHostHeader = true)
+    {
+        REQUEST_HEADER_RULES rules;
+        rules.Initialize(fPreserveHostHeader, "X-Forwarded-For", "X-Forwarded-Proto", "MS-ASPNETCORE-CLIENTCERT");
+        return rules;
+    }
+
+    TEST(RequestHeaderBuilder, ForwardsHeadersUnchanged)
+    {
+        const REQUEST_HEADER_RULES rules;
+        REQUEST_HEADER_BUILDER builder(rules, false);
+
+        EXPECT_EQ(
+            "Host: localhost\r\nAccept: */*\r\nX-Custom: a:b\r\n",
+            Build(builder, { { "Host", "localhost" }, { "Accept", "*/*" }, { "X-Custom", "a:b" } }));
+    }
+
+    TEST(RequestHeaderBuilder, DropsModuleHeadersAndConnection)
+    {
+        const REQUEST_HEADER_RULES rules = DefaultRules();
+        REQUEST_HEADER_BUILDER builder(rules, false);
+
+        EXPECT_EQ(
+            "Host: localhost\r\nSec-WebSocket-Extensions: x\r\n",
+            Build(builder, {
+                { "Connection", "keep-alive" },
+                { "Host", "localhost" },
+                { "ms-aspnetcore-token", "spoofed" },
+                { "MS-ASPNETCORE-ANYTHING", "spoofed" },
+                { "Sec-WebSocket-Extensions", "x" } }));
+    }
+
+    TEST(RequestHeaderBuilder, WebSocketKeepsConnectionAndDropsExtensions)
+    {
+        const REQUEST_HEADER_RULES rules = DefaultRules();
+        REQUEST_HEADER_BUILDER builder(rules, true);
+
+        EXPECT_EQ(
+            "Connection: Upgrade\r\nUpgrade: websocket\r\n",
+            Build(builder, {
+                { "Connection", "Upgrade" },
+                { "Upgrade", "websocket" },
+                { "Sec-WebSocket-Extensions", "permessage-deflate" } }));
+    }
+
+    TEST(RequestHeaderBuilder, AppendsToLastInstance)
+    {
+        const REQUEST_HEADER_RULES rules = DefaultRules();
+        REQUEST_HEADER_BUILDER builder(rules, false);
+        builder.SetValue(REQUEST_HEADER_RULES::SLOT_X_FORWARDED_FOR, "127.0.0.1:5000");
+        builder.SetValue(REQUEST_HEADER_RULES::SLOT_X_FORWARDED_PROTO, "https");
+
+        EXPECT_EQ(
+            "x-forwarded-for: 10.0.0.1\r\nAccept: */*\r\nX-Forwarded-For: 10.0.0.2, 127.0.0.1:5000\r\nX-Forwarded-Proto: https\r\n",
+            Build(builder, {
+                { "x-forwarded-for", "10.0.0.1" },
+                { "Accept", "*/*" },
+                { "X-Forwarded-For", "10.0.0.2" } }));
+    }
+
+    TEST(RequestHeaderBuilder, AppendToEmptyValueHasNoSeparator)
+    {
+        const REQUEST_HEADER_RULES rules = DefaultRules();
+        REQUEST_HEADER_BUILDER builder(rules, false);
+        builder.SetValue(REQUEST_HEADER_RULES::SLOT_X_FORWARDED_PROTO, "http");
+
+        EXPECT_EQ("X-Forwarded-Proto: http\r\n", Build(builder, { { "X-Forwarded-Proto", "" } }));
+    }
+
+    TEST(RequestHeaderBuilder, ReplacesHostWhenNotPreserved)
+    {
+        const REQUEST_HEADER_RULES rules = DefaultRules(false);
+        REQUEST_HEADER_BUILDER builder(rules, false);
+        builder.SetValue(REQUEST_HEADER_RULES::SLOT_HOST, "localhost:5000");
+
+        EXPECT_EQ(
+            "Accept: */*\r\nHost: localhost:5000\r\n",
+            Build(builder, { { "Accept", "*/*" }, { "Host", "example.com" } }));
+    }
+
+    TEST(RequestHeaderBuilder, HostValueIgnoredWhenPreserved)
+    {
+        const REQUEST_HEADER_RULES rules = DefaultRules(true);
+        REQUEST_HEADER_BUILDER builder(rules, false);
+        builder.SetValue(REQUEST_HEADER_RULES::SLOT_HOST, "localhost:5000");
+
+        EXPECT_EQ("Host: example.com\r\n", Build(builder, { { "Host", "example.com" } }));
+    }
+
+    TEST(RequestHeaderBuilder, ClientCertWithoutValueIsRemoved)
+    {
+        const REQUEST_HEADER_RULES rules = DefaultRules();
+        REQUEST_HEADER_BUILDER builder(rules, false);
+
+        EXPECT_EQ("Accept: */*\r\n", Build(builder, { { "MS-ASPNETCORE-CLIENTCERT", "spoofed" }, { "Accept", "*/*" } }));
+    }
+
+    TEST(RequestHeaderBuilder, SlotValuesReplaceInPlaceOrAreAddedLast)
+    {
+        const REQUEST_HEADER_RULES rules = DefaultRules();
+        REQUEST_HEADER_BUILDER builder(rules, false);
+        builder.SetValue(REQUEST_HEADER_RULES::SLOT_CLIENT_CERT, "Y2VydA==");
+        builder.SetValue(REQUEST_HEADER_RULES::SLOT_ASPNETCORE_TOKEN, "guid");
+        builder.SetValue(REQUEST_HEADER_RULES::SLOT_WINAUTH_TOKEN, "1a4");
+
+        EXPECT_EQ(
+            "Accept: */*\r\nMS-ASPNETCORE-TOKEN: guid\r\nMS-ASPNETCORE-CLIENTCERT: Y2VydA==\r\nMS-ASPNETCORE-WINAUTHTOKEN: 1a4\r\n",
+            Build(builder, { { "Accept", "*/*" }, { "MS-ASPNETCORE-TOKEN", "spoofed" } }));
+    }
+
+    TEST(RequestHeaderBuilder, KnownHeaderCanBeConfiguredAsSlot)
+    {
+        REQUEST_HEADER_RULES rules;
+        rules.Initialize(true, "Via", "", "");
+        REQUEST_HEADER_BUILDER builder(rules, false);
+        builder.SetValue(REQUEST_HEADER_RULES::SLOT_X_FORWARDED_FOR, "127.0.0.1");
+        builder.SetValue(REQUEST_HEADER_RULES::SLOT_X_FORWARDED_PROTO, "http");
+
+        EXPECT_EQ("Via: proxy, 127.0.0.1\r\nX-Forwarded-Proto: x\r\n", Build(builder, { { "Via", "proxy" }, { "X-Forwarded-Proto", "x" } }));
+    }
+
+    TEST(RequestHeaderBuilder, NonAsciiBytesAreWidenedOneToOne)
+    {
+        const REQUEST_HEADER_RULES rules;
+        REQUEST_HEADER_BUILDER builder(rules, false);
+
+        EXPECT_EQ("X-Name: caf\xC3\xA9\r\n", Build(builder, { { "X-Name", "caf\xC3\xA9" } }));
+    }
+
+    TEST(RequestHeaderBuilder, ChangedHeadersBetweenPassesAreDetected)
+    {
+        const REQUEST_HEADER_RULES rules;
+        REQUEST_HEADER_BUILDER builder(rules, false);
+
+        builder.Measure(UNKNOWN_INDEX, "X-A", "1");
+        std::wstring block(builder.EndMeasure(), L'\0');
+        builder.BeginWrite(block.data(), block.size());
+        builder.Write(UNKNOWN_INDEX, "X-A", "12345");
+
+        EXPECT_EQ(block.size(), builder.EndWrite());
+        EXPECT_TRUE(builder.HasError());
+    }
+}
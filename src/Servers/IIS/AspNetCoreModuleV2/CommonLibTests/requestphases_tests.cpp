@@ -0,0 +1,204 @@
+// Copyright (c) .NET Foundation. All rights reserved.
+// Licensed under the MIT License. See License.txt in the project root for license information.
+
+#include "stdafx.h"
+#include "requestphases.h"
+#include <thread>
+#include <vector>
+
+namespace RequestPhasesTests
+{
+    //
+    // One tick per microsecond.
+    //
+    constexpr int64_t FREQUENCY = 1000000;
+
+    TEST(RequestPhases, DurationRunsFromPreviousPhase)
+    {
+        REQUEST_PHASE_TIMER timer;
+        uint64_t ullDuration = 0;
+
+        timer.Start(1000);
+        timer.Mark(REQUEST_PHASE_PROCESS_ACQUIRE, 1010);
+        timer.Mark(REQUEST_PHASE_CONNECT, 1100);
+        timer.Mark(REQUEST_PHASE_FIRST_BYTE, 2100);
+
+        EXPECT_TRUE(timer.TryGetDuration(REQUEST_PHASE_PROCESS_ACQUIRE, FREQUENCY, &ullDuration));
+        EXPECT_EQ(10u, ullDuration);
+        EXPECT_TRUE(timer.TryGetDuration(REQUEST_PHASE_CONNECT, FREQUENCY, &ullDuration));
+        EXPECT_EQ(90u, ullDuration);
+
+        //
+        // Phases that were not reached are skipped.
+        //
+        EXPECT_FALSE(timer.TryGetDuration(REQUEST_PHASE_SEND_HEADERS, FREQUENCY, &ullDuration));
+        EXPECT_TRUE(timer.TryGetDuration(REQUEST_PHASE_FIRST_BYTE, FREQUENCY, &ullDuration));
+        EXPECT_EQ(1000u, ullDuration);
+    }
+
+    TEST(RequestPhases, KeepsFirstMark)
+    {
+        REQUEST_PHASE_TIMER timer;
+        uint64_t ullDuration = 0;
+
+        timer.Mark(REQUEST_PHASE_CONNECT, 50);
+        EXPECT_FALSE(timer.IsMarked(REQUEST_PHASE_CONNECT));
+
+        timer.Start(100);
+        timer.Start(200);
+        timer.Mark(REQUEST_PHASE_CONNECT, 300);
+        timer.Mark(REQUEST_PHASE_CONNECT, 400);
+
+        EXPECT_TRUE(timer.TryGetDuration(REQUEST_PHASE_CONNECT, FREQUENCY, &ullDuration));
+        EXPECT_EQ(200u, ullDuration);
+    }
+
+    TEST(RequestPhases, ConvertsTicks)
+    {
+        REQUEST_PHASE_TIMER timer;
+        uint64_t ullDuration = 0;
+
+        //
+        // 30 days at 10 MHz, the product of the ticks and 10^6 would
+        // overflow.
+        //
+        timer.Start(1);
+        timer.Mark(REQUEST_PHASE_LAST_BYTE, 1 + 25920000000000LL + 5);
+
+        EXPECT_TRUE(timer.TryGetDuration(REQUEST_PHASE_LAST_BYTE, 10000000, &ullDuration));
+        EXPECT_EQ(2592000000000u, ullDuration);
+    }
+
+    TEST(RequestPhases, FormatsServerTiming)
+    {
+        REQUEST_PHASE_TIMER timer;
+
+        EXPECT_EQ("", timer.FormatServerTiming(FREQUENCY));
+
+        timer.Start(1000);
+        timer.Mark(REQUEST_PHASE_PROCESS_ACQUIRE, 1125);
+        timer.Mark(REQUEST_PHASE_FIRST_BYTE, 3625);
+
+        EXPECT_EQ("ancm-process;dur=0.125, ancm-first-byte;dur=2.500", timer.FormatServerTiming(FREQUENCY));
+    }
+
+    TEST(RequestPhases, BucketsAreLogLinear)
+    {
+        for (uint64_t ullValue = 0; ullValue < 16; ullValue++)
+        {
+            EXPECT_EQ(ullValue, LATENCY_BUCKETS::GetBucket(ullValue));
+        }
+
+        EXPECT_EQ(16u, LATENCY_BUCKETS::GetBucket(16));
+        EXPECT_EQ(16u, LATENCY_BUCKETS::GetBucket(17));
+        EXPECT_EQ(17u, LATENCY_BUCKETS::GetBucket(18));
+        EXPECT_EQ(23u, LATENCY_BUCKETS::GetBucket(31));
+        EXPECT_EQ(24u, LATENCY_BUCKETS::GetBucket(32));
+        EXPECT_EQ(LATENCY_BUCKETS::BUCKET_COUNT - 1, LATENCY_BUCKETS::GetBucket(0xFFFFFFFF));
+        EXPECT_EQ(LATENCY_BUCKETS::BUCKET_COUNT - 1, LATENCY_BUCKETS::GetBucket(UINT64_MAX));
+    }
+
+    TEST(RequestPhases, BucketBoundsContainTheirValues)
+    {
+        uint64_t ullLowerBound = 0;
+
+        for (uint32_t iBucket = 0; iBucket < LATENCY_BUCKETS::BUCKET_COUNT; iBucket++)
+        {
+            const uint64_t ullUpperBound = LATENCY_BUCKETS::GetBucketUpperBound(iBucket);
+
+            ASSERT_EQ(iBucket, LATENCY_BUCKETS::GetBucket(ullLowerBound));
+            ASSERT_EQ(iBucket, LATENCY_BUCKETS::GetBucket(ullUpperBound));
+
+            //
+            // No bucket is wider than an eighth of its values.
+            //
+            EXPECT_LE((ullUpperBound - ullLowerBound) * LATENCY_BUCKETS::SUB_BUCKET_COUNT, ullUpperBound);
+
+            ullLowerBound = ullUpperBound + 1;
+        }
+
+        EXPECT_EQ(1ULL << LATENCY_BUCKETS::MAX_VALUE_BITS, ullLowerBound);
+    }
+
+    TEST(RequestPhases, SummarizesPercentiles)
+    {
+        REQUEST_PHASE_STATISTICS statistics;
+        statistics.Initialize(4);
+
+        for (uint64_t ullValue = 1; ullValue <= 1000; ullValue++)
+        {
+            statistics.RecordPhase(REQUEST_PHASE_FIRST_BYTE, ullValue);
+        }
+
+        const REQUEST_PHASE_SUMMARY summary = statistics.QuerySummary(REQUEST_PHASE_FIRST_BYTE);
+        EXPECT_EQ(1000u, summary.cSamples);
+        EXPECT_EQ(500u, summary.ullMeanUs);
+        EXPECT_EQ(1000u, summary.ullMaxUs);
+
+        //
+        // Within the bucket precision of the exact percentiles.
+        //
+        EXPECT_GE(summary.ullP50Us, 500u);
+        EXPECT_LE(summary.ullP50Us, 500u + 500u / 8);
+        EXPECT_GE(summary.ullP90Us, 900u);
+        EXPECT_LE(summary.ullP90Us, 900u + 900u / 8);
+        EXPECT_GE(summary.ullP99Us, 990u);
+        EXPECT_LE(summary.ullP99Us, 1000u);
+
+        EXPECT_EQ(0u, statistics.QuerySummary(REQUEST_PHASE_CONNECT).cSamples);
+    }
+
+    TEST(RequestPhases, RecordsReachedPhases)
+    {
+        REQUEST_PHASE_STATISTICS statistics;
+        REQUEST_PHASE_TIMER timer;
+        statistics.Initialize(1);
+
+        timer.Start(100);
+        timer.Mark(REQUEST_PHASE_PROCESS_ACQUIRE, 110);
+        timer.Mark(REQUEST_PHASE_CLIENT_FLUSH, 150);
+        statistics.Record(timer, FREQUENCY);
+
+        EXPECT_EQ(1u, statistics.QuerySummary(REQUEST_PHASE_PROCESS_ACQUIRE).cSamples);
+        EXPECT_EQ(10u, statistics.QuerySummary(REQUEST_PHASE_PROCESS_ACQUIRE).ullP99Us);
+        EXPECT_EQ(0u, statistics.QuerySummary(REQUEST_PHASE_LAST_BYTE).cSamples);
+        EXPECT_EQ(40u, statistics.QuerySummary(REQUEST_PHASE_CLIENT_FLUSH).ullMaxUs);
+    }
+
+    TEST(RequestPhases, IgnoresRecordsBeforeInitialize)
+    {
+        REQUEST_PHASE_STATISTICS statistics;
+
+        statistics.RecordPhase(REQUEST_PHASE_CONNECT, 10);
+
+        EXPECT_FALSE(statistics.IsEnabled());
+        EXPECT_EQ(0u, statistics.QuerySummary(REQUEST_PHASE_CONNECT).cSamples);
+    }
+
+    TEST(RequestPhases, ConcurrentRecordsAreCounted)
+    {
+        REQUEST_PHASE_STATISTICS statistics;
+        std::vector<std::thread> threads;
+        statistics.Initialize(std::thread::hardware_concurrency());
+
+        for (int iThread = 0; iThread < 8; iThread++)
+        {
+            threads.emplace_back([&statistics, iThread]()
+            {
+                for (uint64_t i = 0; i < 10000; i++)
+                {
+                    statistics.RecordPhase(REQUEST_PHASE_SEND_BODY, i + iThread);
+                }
+            });
+        }
+
+        for (std::thread& thread : threads)
+        {
+            thread.join();
+        }
+
+        const REQUEST_PHASE_SUMMARY summary = statistics.QuerySummary(REQUEST_PHASE_SEND_BODY);
+        EXPECT_EQ(80000u, summary.cSamples);
+        EXPECT_EQ(9999u + 7u, summary.ullMaxUs);
+    }
+}
@@ -0,0 +1,259 @@
+// Copyright (c) .NET Foundation. All rights reserved.
+// Licensed under the MIT License. See License.txt in the project root for license information.
+
+#include "stdafx.h"
+#include "responsecache.h"
+#include <atomic>
+#include <map>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace ResponseCacheTests
+{
+    const std::map<std::string, std::string> NO_HEADERS;
+
+    RESPONSE_CACHE::REQUEST_HEADER_READER
+    Reader(const std::map<std::string, std::string>& headers)
+    {
+        return [&headers](const std::string& strName) -> std::string_view
+        {
+            const auto iter = headers.find(strName);
+            return iter == headers.end() ? std::string_view() : std::string_view(iter->second);
+        };
+    }
+
+    std::unique_ptr<CACHED_RESPONSE>
+    MakeResponse(const std::string& extraHeaders, const std::string& entity)
+    {
+        std::unique_ptr<CACHED_RESPONSE> pResponse(new CACHED_RESPONSE());
+        pResponse->strHeaders = "HTTP/1.1 200 OK\r\n" + extraHeaders + "Content-Length: " +
+            std::to_string(entity.size()) + "\r\n\r\n";
+        pResponse->strEntity = entity;
+        return pResponse;
+    }
+
+    bool
+    IsCacheable(const std::string& headers, uint32_t* pdwMaxAge = nullptr, std::vector<std::string>* pVary = nullptr)
+    {
+        uint32_t dwMaxAge = 0;
+        std::vector<std::string> vary;
+        return RESPONSE_CACHE::TryGetResponsePolicy(
+            headers, pdwMaxAge ? pdwMaxAge : &dwMaxAge, pVary ? pVary : &vary);
+    }
+
+    TEST(ResponseCache, PolicyRequiresPublicWithLifetime)
+    {
+        uint32_t dwMaxAge = 0;
+
+        EXPECT_TRUE(IsCacheable("HTTP/1.1 200 OK\r\nCache-Control: public, max-age=60\r\n\r\n", &dwMaxAge));
+        EXPECT_EQ(60u, dwMaxAge);
+        EXPECT_TRUE(IsCacheable("HTTP/1.1 200 OK\r\ncache-control: max-age=60,PUBLIC , s-maxage=5\r\n\r\n", &dwMaxAge));
+        EXPECT_EQ(5u, dwMaxAge);
+
+        EXPECT_FALSE(IsCacheable("HTTP/1.1 200 OK\r\nCache-Control: max-age=60\r\n\r\n"));
+        EXPECT_FALSE(IsCacheable("HTTP/1.1 200 OK\r\nCache-Control: public\r\n\r\n"));
+        EXPECT_FALSE(IsCacheable("HTTP/1.1 200 OK\r\nCache-Control: public, max-age=0\r\n\r\n"));
+        EXPECT_FALSE(IsCacheable("HTTP/1.1 200 OK\r\nCache-Control: public, max-age=abc\r\n\r\n"));
+    }
+
+    TEST(ResponseCache, PolicyRejectsPrivateResponses)
+    {
+        EXPECT_FALSE(IsCacheable("HTTP/1.1 200 OK\r\nCache-Control: public, max-age=60, private\r\n\r\n"));
+        EXPECT_FALSE(IsCacheable("HTTP/1.1 200 OK\r\nCache-Control: public, max-age=60\r\nCache-Control: no-store\r\n\r\n"));
+        EXPECT_FALSE(IsCacheable("HTTP/1.1 200 OK\r\nCache-Control: public, max-age=60, no-cache\r\n\r\n"));
+        EXPECT_FALSE(IsCacheable("HTTP/1.1 200 OK\r\nCache-Control: public, max-age=60\r\nSet-Cookie: a=b\r\n\r\n"));
+        EXPECT_FALSE(IsCacheable("HTTP/1.1 200 OK\r\nCache-Control: public, max-age=60\r\nVary: *\r\n\r\n"));
+        EXPECT_FALSE(IsCacheable("HTTP/1.1 404 Not Found\r\nCache-Control: public, max-age=60\r\n\r\n"));
+    }
+
+    TEST(ResponseCache, PolicyNormalizesVaryHeaders)
+    {
+        std::vector<std::string> vary;
+
+        EXPECT_TRUE(IsCacheable(
+            "HTTP/1.1 200 OK\r\nCache-Control: public, max-age=60\r\nVary: Accept-Encoding, Accept\r\nVary: accept-encoding\r\n\r\n",
+            nullptr,
+            &vary));
+
+        ASSERT_EQ(2u, vary.size());
+        EXPECT_EQ("accept", vary[0]);
+        EXPECT_EQ("accept-encoding", vary[1]);
+    }
+
+    TEST(ResponseCache, CountsHitsAndMisses)
+    {
+        RESPONSE_CACHE cache;
+        cache.Initialize(64 * 1024, 8 * 1024);
+
+        EXPECT_EQ(nullptr, cache.Lookup("host/a", Reader(NO_HEADERS), 0));
+        EXPECT_TRUE(cache.Insert("host/a", Reader(NO_HEADERS), MakeResponse("Cache-Control: public, max-age=60\r\n", "hello"), 0));
+
+        const auto pResponse = cache.Lookup("host/a", Reader(NO_HEADERS), 1000);
+        ASSERT_TRUE(pResponse != nullptr);
+        EXPECT_EQ("hello", pResponse->strEntity);
+        EXPECT_EQ(nullptr, cache.Lookup("host/b", Reader(NO_HEADERS), 1000));
+
+        const RESPONSE_CACHE_STATISTICS statistics = cache.QueryStatistics();
+        EXPECT_EQ(1u, statistics.cHits);
+        EXPECT_EQ(2u, statistics.cMisses);
+        EXPECT_EQ(1u, statistics.cInserts);
+        EXPECT_GT(statistics.cbSize, 0u);
+    }
+
+    TEST(ResponseCache, ExpiresEntriesAfterMaxAge)
+    {
+        RESPONSE_CACHE cache;
+        cache.Initialize(64 * 1024, 8 * 1024);
+
+        cache.Insert("host/a", Reader(NO_HEADERS), MakeResponse("Cache-Control: public, max-age=2\r\n", "hello"), 10000);
+
+        EXPECT_TRUE(cache.Lookup("host/a", Reader(NO_HEADERS), 11999) != nullptr);
+        EXPECT_EQ(nullptr, cache.Lookup("host/a", Reader(NO_HEADERS), 12000));
+        EXPECT_EQ(0u, cache.QueryStatistics().cbSize);
+    }
+
+    TEST(ResponseCache, AgeCountsFromInsertion)
+    {
+        RESPONSE_CACHE cache;
+        cache.Initialize(1024 * 1024, 64 * 1024);
+
+        cache.Insert("host/a", Reader(NO_HEADERS), MakeResponse("Cache-Control: public, max-age=60\r\n", "hello"), 10000);
+        const auto pResponse = cache.Lookup("host/a", Reader(NO_HEADERS), 10000);
+        ASSERT_TRUE(pResponse != nullptr);
+
+        EXPECT_EQ(0u, RESPONSE_CACHE::QueryAgeSeconds(*pResponse, 10000));
+        EXPECT_EQ(0u, RESPONSE_CACHE::QueryAgeSeconds(*pResponse, 10999));
+        EXPECT_EQ(1u, RESPONSE_CACHE::QueryAgeSeconds(*pResponse, 11000));
+        EXPECT_EQ(59u, RESPONSE_CACHE::QueryAgeSeconds(*pResponse, 69999));
+    }
+
+    TEST(ResponseCache, AgeIncludesBackendAge)
+    {
+        RESPONSE_CACHE cache;
+        cache.Initialize(1024 * 1024, 64 * 1024);
+
+        cache.Insert("host/a", Reader(NO_HEADERS), MakeResponse("Cache-Control: public, max-age=60\r\nAge: 50\r\n", "hello"), 0);
+        const auto pResponse = cache.Lookup("host/a", Reader(NO_HEADERS), 0);
+        ASSERT_TRUE(pResponse != nullptr);
+        EXPECT_EQ(55u, RESPONSE_CACHE::QueryAgeSeconds(*pResponse, 5000));
+
+        //
+        // Only the rest of the lifetime is left, a response that arrives
+        // already stale is not cached.
+        //
+        EXPECT_TRUE(cache.Lookup("host/a", Reader(NO_HEADERS), 9999) != nullptr);
+        EXPECT_EQ(nullptr, cache.Lookup("host/a", Reader(NO_HEADERS), 10000));
+        EXPECT_FALSE(cache.Insert("host/b", Reader(NO_HEADERS), MakeResponse("Cache-Control: public, max-age=60\r\nAge: 60\r\n", "hello"), 0));
+    }
+
+    TEST(ResponseCache, EvictsLeastRecentlyUsed)
+    {
+        const std::string entity(1000, 'x');
+        const std::string cacheControl = "Cache-Control: public, max-age=60\r\n";
+        RESPONSE_CACHE cache;
+        cache.Initialize(3 * (entity.size() + RESPONSE_CACHE::ENTRY_OVERHEAD + 100), entity.size());
+
+        cache.Insert("host/a", Reader(NO_HEADERS), MakeResponse(cacheControl, entity), 0);
+        cache.Insert("host/b", Reader(NO_HEADERS), MakeResponse(cacheControl, entity), 0);
+        cache.Insert("host/c", Reader(NO_HEADERS), MakeResponse(cacheControl, entity), 0);
+
+        //
+        // Touching a makes b the least recently used entry.
+        //
+        EXPECT_TRUE(cache.Lookup("host/a", Reader(NO_HEADERS), 0) != nullptr);
+        cache.Insert("host/d", Reader(NO_HEADERS), MakeResponse(cacheControl, entity), 0);
+
+        EXPECT_EQ(nullptr, cache.Lookup("host/b", Reader(NO_HEADERS), 0));
+        EXPECT_TRUE(cache.Lookup("host/a", Reader(NO_HEADERS), 0) != nullptr);
+        EXPECT_TRUE(cache.Lookup("host/c", Reader(NO_HEADERS), 0) != nullptr);
+        EXPECT_TRUE(cache.Lookup("host/d", Reader(NO_HEADERS), 0) != nullptr);
+        EXPECT_EQ(1u, cache.QueryStatistics().cEvictions);
+    }
+
+    TEST(ResponseCache, KeysEntriesOnVaryHeaders)
+    {
+        RESPONSE_CACHE cache;
+        cache.Initialize(64 * 1024, 8 * 1024);
+        const std::map<std::string, std::string> gzip = { { "accept-encoding", "gzip" } };
+        const std::map<std::string, std::string> br = { { "accept-encoding", "br" } };
+        const std::string headers = "Cache-Control: public, max-age=60\r\nVary: Accept-Encoding\r\n";
+
+        cache.Insert("host/a", Reader(gzip), MakeResponse(headers, "gzip"), 0);
+        EXPECT_EQ(nullptr, cache.Lookup("host/a", Reader(br), 0));
+        EXPECT_EQ(nullptr, cache.Lookup("host/a", Reader(NO_HEADERS), 0));
+
+        cache.Insert("host/a", Reader(br), MakeResponse(headers, "br"), 0);
+        EXPECT_EQ("gzip", cache.Lookup("host/a", Reader(gzip), 0)->strEntity);
+        EXPECT_EQ("br", cache.Lookup("host/a", Reader(br), 0)->strEntity);
+    }
+
+    TEST(ResponseCache, RejectsUncacheableAndOversizedResponses)
+    {
+        RESPONSE_CACHE cache;
+        cache.Initialize(64 * 1024, 4);
+
+        EXPECT_FALSE(cache.Insert("host/a", Reader(NO_HEADERS), MakeResponse("Cache-Control: public, max-age=60\r\n", "hello"), 0));
+        EXPECT_FALSE(cache.Insert("host/a", Reader(NO_HEADERS), MakeResponse("Cache-Control: private, max-age=60\r\n", "hi"), 0));
+        EXPECT_EQ(0u, cache.QueryStatistics().cInserts);
+    }
+
+    TEST(ResponseCache, DisabledCacheStoresNothing)
+    {
+        RESPONSE_CACHE cache;
+        cache.Initialize(0, 8 * 1024);
+
+        EXPECT_FALSE(cache.IsEnabled());
+        EXPECT_FALSE(cache.Insert("host/a", Reader(NO_HEADERS), MakeResponse("Cache-Control: public, max-age=60\r\n", "hello"), 0));
+    }
+
+    TEST(ResponseCache, ServesEvictedResponseToHolders)
+    {
+        const std::string cacheControl = "Cache-Control: public, max-age=60\r\n";
+        RESPONSE_CACHE cache;
+        cache.Initialize(2 * RESPONSE_CACHE::ENTRY_OVERHEAD, 100);
+
+        cache.Insert("host/a", Reader(NO_HEADERS), MakeResponse(cacheControl, "first"), 0);
+        const auto pResponse = cache.Lookup("host/a", Reader(NO_HEADERS), 0);
+        cache.Insert("host/b", Reader(NO_HEADERS), MakeResponse(cacheControl, "second"), 0);
+
+        EXPECT_EQ(nullptr, cache.Lookup("host/a", Reader(NO_HEADERS), 0));
+        ASSERT_TRUE(pResponse != nullptr);
+        EXPECT_EQ("first", pResponse->strEntity);
+    }
+
+    TEST(ResponseCache, ServesConcurrentLookups)
+    {
+        RESPONSE_CACHE cache;
+        cache.Initialize(1024 * 1024, 8 * 1024);
+        std::atomic<uint32_t> cHits(0);
+        std::vector<std::thread> threads;
+
+        for (int i = 0; i < 16; i++)
+        {
+            cache.Insert("host/" + std::to_string(i), Reader(NO_HEADERS), MakeResponse("Cache-Control: public, max-age=60\r\n", "hello"), 0);
+        }
+
+        for (int iThread = 0; iThread < 4; iThread++)
+        {
+            threads.emplace_back([&]()
+            {
+                for (int i = 0; i < 1000; i++)
+                {
+                    if (cache.Lookup("host/" + std::to_string(i % 16), Reader(NO_HEADERS), 0) != nullptr)
+                    {
+                        cHits++;
+                    }
+                }
+            });
+        }
+
+        for (std::thread& thread : threads)
+        {
+            thread.join();
+        }
+
+        EXPECT_EQ(4000u, cHits.load());
+        EXPECT_EQ(4000u, cache.QueryStatistics().cHits);
+    }
+}
@@ -0,0 +1,136 @@
+// Copyright (c) .NET Foundation. All rights reserved.
+// Licensed under the MIT License. See License.txt in the project root for license information.
+
+#include "stdafx.h"
+#include "sendfile.h"
+#include <string>
+
+namespace SendFileTests
+{
+    std::string
+    Normalize(std::string_view path)
+    {
+        std::string normalized;
+        return SEND_FILE::TryNormalizeRelativePath(path, &normalized) ? normalized : "<rejected>";
+    }
+
+    SEND_FILE::RANGE_RESULT
+    ParseRange(std::string_view range, uint64_t cbFile, uint64_t* pullOffset = nullptr, uint64_t* pcbLength = nullptr)
+    {
+        uint64_t ullOffset = 0;
+        uint64_t cbLength = 0;
+        return SEND_FILE::ParseRange(range,
+            cbFile,
+            pullOffset ? pullOffset : &ullOffset,
+            pcbLength ? pcbLength : &cbLength);
+    }
+
+    TEST(SendFile, NormalizesRelativePaths)
+    {
+        EXPECT_EQ("a.txt", Normalize("a.txt"));
+        EXPECT_EQ("files\\a.txt", Normalize("/files/a.txt"));
+        EXPECT_EQ("files\\2024\\report.pdf", Normalize("\\files\\2024/report.pdf"));
+        EXPECT_EQ(".well-known\\x", Normalize(".well-known/x"));
+
+        //
+        // Leading separators never make the path absolute.
+        //
+        EXPECT_EQ("server\\share\\a.txt", Normalize("\\\\server\\share\\a.txt"));
+    }
+
+    TEST(SendFile, RejectsTraversal)
+    {
+        EXPECT_EQ("<rejected>", Normalize("../secret.txt"));
+        EXPECT_EQ("<rejected>", Normalize("files/../../secret.txt"));
+        EXPECT_EQ("<rejected>", Normalize("files\\..\\secret.txt"));
+        EXPECT_EQ("<rejected>", Normalize("files/./a.txt"));
+        EXPECT_EQ("<rejected>", Normalize("files/.../a.txt"));
+        EXPECT_EQ("<rejected>", Normalize("files//a.txt"));
+    }
+
+    TEST(SendFile, RejectsWindowsAliases)
+    {
+        EXPECT_EQ("<rejected>", Normalize("C:/Windows/win.ini"));
+        EXPECT_EQ("<rejected>", Normalize("a.txt::$DATA"));
+        EXPECT_EQ("<rejected>", Normalize("a.txt."));
+        EXPECT_EQ("<rejected>", Normalize("a.txt "));
+        EXPECT_EQ("<rejected>", Normalize("files/NUL"));
+        EXPECT_EQ("<rejected>", Normalize("con.txt"));
+        EXPECT_EQ("<rejected>", Normalize("files/COM1.log"));
+        EXPECT_EQ("<rejected>", Normalize("a*.txt"));
+        EXPECT_EQ("<rejected>", Normalize(std::string_view("a\0b", 3)));
+        EXPECT_EQ("console.txt", Normalize("console.txt"));
+        EXPECT_EQ("COM10", Normalize("COM10"));
+    }
+
+    TEST(SendFile, RejectsDirectories)
+    {
+        EXPECT_EQ("<rejected>", Normalize(""));
+        EXPECT_EQ("<rejected>", Normalize("/"));
+        EXPECT_EQ("<rejected>", Normalize("files/"));
+    }
+
+    TEST(SendFile, ChecksResolvedPathAgainstRoot)
+    {
+        EXPECT_TRUE(SEND_FILE::IsPathUnderRoot(L"\\\\?\\C:\\files", L"\\\\?\\C:\\files\\a.txt"));
+        EXPECT_TRUE(SEND_FILE::IsPathUnderRoot(L"\\\\?\\C:\\Files\\", L"\\\\?\\c:\\files\\sub\\a.txt"));
+        EXPECT_FALSE(SEND_FILE::IsPathUnderRoot(L"\\\\?\\C:\\files", L"\\\\?\\C:\\files2\\a.txt"));
+        EXPECT_FALSE(SEND_FILE::IsPathUnderRoot(L"\\\\?\\C:\\files", L"\\\\?\\C:\\a.txt"));
+        EXPECT_FALSE(SEND_FILE::IsPathUnderRoot(L"", L"\\\\?\\C:\\a.txt"));
+    }
+
+    TEST(SendFile, ParsesSingleRanges)
+    {
+        uint64_t ullOffset = 0;
+        uint64_t cbLength = 0;
+
+        EXPECT_EQ(SEND_FILE::RANGE_SATISFIABLE, ParseRange("bytes=0-99", 1000, &ullOffset, &cbLength));
+        EXPECT_EQ(0u, ullOffset);
+        EXPECT_EQ(100u, cbLength);
+
+        EXPECT_EQ(SEND_FILE::RANGE_SATISFIABLE, ParseRange("bytes=900-", 1000, &ullOffset, &cbLength));
+        EXPECT_EQ(900u, ullOffset);
+        EXPECT_EQ(100u, cbLength);
+
+        EXPECT_EQ(SEND_FILE::RANGE_SATISFIABLE, ParseRange("Bytes=-10", 1000, &ullOffset, &cbLength));
+        EXPECT_EQ(990u, ullOffset);
+        EXPECT_EQ(10u, cbLength);
+
+        EXPECT_EQ(SEND_FILE::RANGE_SATISFIABLE, ParseRange("bytes=990-5000", 1000, &ullOffset, &cbLength));
+        EXPECT_EQ(990u, ullOffset);
+        EXPECT_EQ(10u, cbLength);
+
+        EXPECT_EQ(SEND_FILE::RANGE_SATISFIABLE, ParseRange("bytes=-5000", 1000, &ullOffset, &cbLength));
+        EXPECT_EQ(0u, ullOffset);
+        EXPECT_EQ(1000u, cbLength);
+
+        EXPECT_EQ(SEND_FILE::RANGE_SATISFIABLE, ParseRange("bytes=0-99999999999999999999999", 1000, &ullOffset, &cbLength));
+        EXPECT_EQ(1000u, cbLength);
+    }
+
+    TEST(SendFile, RejectsUnsatisfiableRanges)
+    {
+        EXPECT_EQ(SEND_FILE::RANGE_NOT_SATISFIABLE, ParseRange("bytes=1000-", 1000));
+        EXPECT_EQ(SEND_FILE::RANGE_NOT_SATISFIABLE, ParseRange("bytes=-0", 1000));
+        EXPECT_EQ(SEND_FILE::RANGE_NOT_SATISFIABLE, ParseRange("bytes=0-", 0));
+        EXPECT_EQ(SEND_FILE::RANGE_NOT_SATISFIABLE, ParseRange("bytes=-1", 0));
+    }
+
+    TEST(SendFile, IgnoresUnsupportedRanges)
+    {
+        EXPECT_EQ(SEND_FILE::RANGE_NONE, ParseRange("", 1000));
+        EXPECT_EQ(SEND_FILE::RANGE_NONE, ParseRange("items=0-1", 1000));
+        EXPECT_EQ(SEND_FILE::RANGE_NONE, ParseRange("bytes=0-1,5-6", 1000));
+        EXPECT_EQ(SEND_FILE::RANGE_NONE, ParseRange("bytes=5-1", 1000));
+        EXPECT_EQ(SEND_FILE::RANGE_NONE, ParseRange("bytes=a-b", 1000));
+        EXPECT_EQ(SEND_FILE::RANGE_NONE, ParseRange("bytes=-", 1000));
+        EXPECT_EQ(SEND_FILE::RANGE_NONE, ParseRange("bytes=10", 1000));
+    }
+
+    TEST(SendFile, FormatsContentRange)
+    {
+        EXPECT_EQ("bytes 0-99/1000", SEND_FILE::FormatContentRange(0, 100, 1000));
+        EXPECT_EQ("bytes 990-999/1000", SEND_FILE::FormatContentRange(990, 10, 1000));
+        EXPECT_EQ("bytes */1000", SEND_FILE::FormatUnsatisfiedContentRange(1000));
+    }
+}
@@ -0,0 +1,201 @@
+// Copyright (c) .NET Foundation. All rights reserved.
+// Licensed under the MIT License. See License.txt in the project root for license information.
+
+#include "stdafx.h"
+#include "timerwheel.h"
+#include <map>
+#include <random>
+#include <vector>
+
+namespace TimerWheelTests
+{
+    //
+    // Advances the wheel and returns the entries that expired with the tick
+    // they expired at.
+    //
+    std::vector<std::pair<TIMER_WHEEL_ENTRY*, uint64_t>>
+    Advance(TIMER_WHEEL& wheel, uint64_t ullNow)
+    {
+        std::vector<std::pair<TIMER_WHEEL_ENTRY*, uint64_t>> expired;
+        wheel.Advance(ullNow, [&](TIMER_WHEEL_ENTRY* pEntry)
+        {
+            expired.emplace_back(pEntry, wheel.QueryNow());
+        });
+        return expired;
+    }
+
+    TEST(TimerWheel, ExpiresAtDeadline)
+    {
+        TIMER_WHEEL wheel(1000);
+        TIMER_WHEEL_ENTRY entry;
+
+        wheel.Schedule(&entry, 1010);
+        EXPECT_TRUE(TIMER_WHEEL::IsScheduled(&entry));
+        EXPECT_EQ(1u, wheel.QueryCount());
+
+        EXPECT_TRUE(Advance(wheel, 1009).empty());
+
+        const auto expired = Advance(wheel, 2000);
+        ASSERT_EQ(1u, expired.size());
+        EXPECT_EQ(&entry, expired[0].first);
+        EXPECT_EQ(1010u, expired[0].second);
+        EXPECT_FALSE(TIMER_WHEEL::IsScheduled(&entry));
+        EXPECT_EQ(0u, wheel.QueryCount());
+    }
+
+    TEST(TimerWheel, PastDeadlineExpiresOnNextTick)
+    {
+        TIMER_WHEEL wheel(500);
+        TIMER_WHEEL_ENTRY entry;
+
+        wheel.Schedule(&entry, 100);
+
+        const auto expired = Advance(wheel, 501);
+        ASSERT_EQ(1u, expired.size());
+        EXPECT_EQ(501u, expired[0].second);
+    }
+
+    TEST(TimerWheel, CancelAndReschedule)
+    {
+        TIMER_WHEEL wheel;
+        TIMER_WHEEL_ENTRY first;
+        TIMER_WHEEL_ENTRY second;
+
+        wheel.Schedule(&first, 10);
+        wheel.Schedule(&second, 10);
+        wheel.Cancel(&first);
+        wheel.Cancel(&first);
+        wheel.Schedule(&second, 5000);
+
+        EXPECT_TRUE(Advance(wheel, 4999).empty());
+
+        const auto expired = Advance(wheel, 5000);
+        ASSERT_EQ(1u, expired.size());
+        EXPECT_EQ(&second, expired[0].first);
+    }
+
+    TEST(TimerWheel, CallbackMayRescheduleAndCancel)
+    {
+        TIMER_WHEEL wheel;
+        TIMER_WHEEL_ENTRY periodic;
+        TIMER_WHEEL_ENTRY sameTick;
+        int cFired = 0;
+
+        wheel.Schedule(&periodic, 30);
+        wheel.Schedule(&sameTick, 30);
+
+        wheel.Advance(300, [&](TIMER_WHEEL_ENTRY* pEntry)
+        {
+            EXPECT_EQ(&periodic, pEntry);
+            cFired++;
+            wheel.Cancel(&sameTick);
+            wheel.Schedule(&periodic, wheel.QueryNow() + 30);
+        });
+
+        EXPECT_EQ(10, cFired);
+        EXPECT_TRUE(TIMER_WHEEL::IsScheduled(&periodic));
+        EXPECT_FALSE(TIMER_WHEEL::IsScheduled(&sameTick));
+    }
+
+    TEST(TimerWheel, FarDeadlinesCascadeExactly)
+    {
+        TIMER_WHEEL wheel(7);
+        std::vector<TIMER_WHEEL_ENTRY> entries(2000);
+        std::map<TIMER_WHEEL_ENTRY*, uint64_t> due;
+        std::mt19937_64 random(42);
+
+        //
+        // Spread over every wheel and past the highest one.
+        //
+        for (size_t i = 0; i < entries.size(); i++)
+        {
+            const uint64_t ullDelay = i % 2 == 0
+                ? random() % (1ULL << (TIMER_WHEEL::SLOT_BITS * TIMER_WHEEL::LEVEL_COUNT))
+                : random() % (1ULL << 25);
+            due[&entries[i]] = 7 + ullDelay;
+            wheel.Schedule(&entries[i], 7 + ullDelay);
+        }
+
+        uint64_t ullLastExpired = 0;
+        size_t cExpired = 0;
+        wheel.Advance(7 + (1ULL << 25), [&](TIMER_WHEEL_ENTRY* pEntry)
+        {
+            const uint64_t ullExpected = due[pEntry] > 7 ? due[pEntry] : 8;
+            EXPECT_EQ(ullExpected, wheel.QueryNow());
+            EXPECT_GE(wheel.QueryNow(), ullLastExpired);
+            ullLastExpired = wheel.QueryNow();
+            cExpired++;
+        });
+
+        EXPECT_EQ(entries.size(), cExpired);
+        EXPECT_EQ(0u, wheel.QueryCount());
+    }
+
+    TEST(TimerWheel, IdleDeadlineIsPushedOutByActivity)
+    {
+        IDLE_DEADLINE deadline;
+        uint64_t ullNextDue = 0;
+
+        EXPECT_FALSE(deadline.IsEnabled());
+
+        deadline.Initialize(60, 1000);
+        EXPECT_TRUE(deadline.IsEnabled());
+        EXPECT_EQ(1060u, deadline.QueryDue());
+
+        deadline.OnActivity(1030);
+        EXPECT_FALSE(deadline.IsExpired(1060, &ullNextDue));
+        EXPECT_EQ(1090u, ullNextDue);
+
+        EXPECT_TRUE(deadline.IsExpired(1090, &ullNextDue));
+    }
+
+    TEST(TimerWheel, IdleConnectionsTimeOutOnOneWheel)
+    {
+        constexpr uint64_t TIMEOUT = 120;
+        TIMER_WHEEL wheel(0);
+        std::vector<IDLE_DEADLINE> deadlines(1000);
+        std::vector<TIMER_WHEEL_ENTRY> entries(deadlines.size());
+        std::vector<uint64_t> timedOutAt(deadlines.size(), 0);
+
+        for (size_t i = 0; i < deadlines.size(); i++)
+        {
+            deadlines[i].Initialize(TIMEOUT, 0);
+            wheel.Schedule(&entries[i], deadlines[i].QueryDue());
+        }
+
+        //
+        // Odd connections see a message every 100 ticks until tick 1000,
+        // even ones stay idle.
+        //
+        for (uint64_t ullNow = 1; ullNow <= 2000; ullNow++)
+        {
+            if (ullNow <= 1000 && ullNow % 100 == 0)
+            {
+                for (size_t i = 1; i < deadlines.size(); i += 2)
+                {
+                    deadlines[i].OnActivity(ullNow);
+                }
+            }
+
+            wheel.Advance(ullNow, [&](TIMER_WHEEL_ENTRY* pEntry)
+            {
+                const size_t i = pEntry - entries.data();
+                uint64_t ullNextDue = 0;
+                if (deadlines[i].IsExpired(wheel.QueryNow(), &ullNextDue))
+                {
+                    timedOutAt[i] = wheel.QueryNow();
+                }
+                else
+                {
+                    wheel.Schedule(pEntry, ullNextDue);
+                }
+            });
+        }
+
+        for (size_t i = 0; i < deadlines.size(); i++)
+        {
+            EXPECT_EQ(i % 2 == 0 ? TIMEOUT : 1000 + TIMEOUT, timedOutAt[i]);
+        }
+        EXPECT_EQ(0u, wheel.QueryCount());
+    }
+}
@@ -11,12 +11,10 @@
 #include "StringHelpers.h"
 
 // Just to be aware of the FORWARDING_HANDLER object size.
-C_ASSERT(sizeof(FORWARDING_HANDLER) <= 632);
+C_ASSERT(sizeof(FORWARDING_HANDLER) <= 1016);
 
 #define DEF_MAX_FORWARDS        32
-#define HEX_TO_ASCII(c) ((CHAR)(((c) < 10) ? ((c) + '0') : ((c) + 'a' - 10)))
 #define BUFFER_SIZE         (8192UL)
-#define ENTITY_BUFFER_SIZE  (6 + BUFFER_SIZE + 2)
 
 #define FORWARDING_HANDLER_SIGNATURE        ((DWORD)'FHLR')
 #define FORWARDING_HANDLER_SIGNATURE_FREE   ((DWORD)'fhlr')
@@ -24,7 +22,7 @@ C_ASSERT(sizeof(FORWARDING_HANDLER) <= 632);
 ALLOC_CACHE_HANDLER *       FORWARDING_HANDLER::sm_pAlloc = nullptr;
 TRACE_LOG *                 FORWARDING_HANDLER::sm_pTraceLog = nullptr;
 PROTOCOL_CONFIG             FORWARDING_HANDLER::sm_ProtocolConfig;
-RESPONSE_HEADER_HASH *      FORWARDING_HANDLER::sm_pResponseHeaderHash = nullptr;
+LARGE_INTEGER               FORWARDING_HANDLER::sm_liPerfFrequency;
 
 FORWARDING_HANDLER::FORWARDING_HANDLER(
     _In_ IHttpContext                  *pW3Context,
@@ -39,10 +37,19 @@ FORWARDING_HANDLER::FORWARDING_HANDLER(
     m_fHasError(FALSE),
     m_pszHeaders(nullptr),
     m_cchHeaders(0),
+    m_pServerProcess(nullptr),
+    m_llSendRequestCounter(0),
+    m_hrAdmission(S_FALSE),
     m_BytesToReceive(0),
     m_BytesToSend(0),
     m_fWebSocketEnabled(FALSE),
     m_pWebSocket(nullptr),
+    m_pRequestEntityBuffers{},
+    m_cWriteSegments(0),
+    m_iWriteSegment(0),
+    m_fCaptureResponse(FALSE),
+    m_fCollapsedFollower(FALSE),
+    m_hSendFile(INVALID_HANDLE_VALUE),
     m_dwHandlers (1), // default http handler
     m_fDoneAsyncCompletion(FALSE),
     m_fHttpHandleInClose(FALSE),
@@ -85,6 +92,22 @@ FORWARDING_HANDLER::~FORWARDING_HANDLER(
 
     FreeResponseBuffers();
 
+    ReleaseCollapsedRequest();
+
+    if (m_hSendFile != INVALID_HANDLE_VALUE)
+    {
+        CloseHandle(m_hSendFile);
+        m_hSendFile = INVALID_HANDLE_VALUE;
+    }
+
+    if (m_pszHeaders != nullptr)
+    {
+        ENTITY_BUFFER_POOL::Free(reinterpret_cast<BYTE *>(m_pszHeaders));
+        m_pszHeaders = nullptr;
+    }
+
+    ReleaseServerProcess();
+
     if (m_pWebSocket)
     {
         m_pWebSocket->Terminate();
@@ -120,6 +143,13 @@ FORWARDING_HANDLER::ExecuteRequestHandler()
     //
     ReferenceRequestHandler();
 
+    if (m_RequestStatus == FORWARDER_START)
+    {
+        LARGE_INTEGER liNow;
+        QueryPerformanceCounter(&liNow);
+        m_PhaseTimer.Start(liNow.QuadPart);
+    }
+
     // override Protocol related config from aspNetCore config
     pProtocol->OverrideConfig(m_pApplication->QueryConfig());
 
@@ -136,10 +166,84 @@ FORWARDING_HANDLER::ExecuteRequestHandler()
         FAILURE(E_INVALIDARG);
     }
 
-    hr = m_pApplication->GetProcess(&pServerProcess);
+    m_pszOriginalHostHeader = pRequest->GetHeader(HttpHeaderHost, &cchHostName);
+    m_fDoReverseRewriteHeaders = pProtocol->QueryReverseRewriteHeaders();
+
+    if (m_hrAdmission == S_FALSE)
+    {
+        //
+        // A cached response is served without a backend process.
+        //
+        LookupCachedResponse();
+        if (m_pCachedResponse != nullptr)
+        {
+            FAILURE_IF_FAILED(SendCachedResponse());
+
+            m_RequestStatus = FORWARDER_DONE;
+            retVal = RQ_NOTIFICATION_FINISH_REQUEST;
+            goto Finished;
+        }
+
+        if (m_fCaptureResponse &&
+            !m_fCollapsedFollower &&
+            m_pApplication->QueryConfig()->QueryEnableRequestCollapsing())
+        {
+            //
+            // Only the first of concurrent misses for a URL goes to the
+            // backend, the others wait for its response to be cached.
+            //
+            m_RequestStatus = FORWARDER_WAITING_FOR_LEADER;
+            ReferenceRequestHandler();
+
+            if (!JoinCollapsedRequest())
+            {
+                //
+                // OnCollapsedRequestComplete resumes the request.
+                //
+                retVal = RQ_NOTIFICATION_PENDING;
+                goto Finished;
+            }
+
+            m_RequestStatus = FORWARDER_START;
+            DereferenceRequestHandler();
+        }
+    }
+
+    if (FAILED(m_hrAdmission))
+    {
+        hr = m_hrAdmission;
+    }
+    else
+    {
+        //
+        // The state and the reference must be in place before the request
+        // is queued, the completion may be posted before GetProcess returns.
+        // An admitted request whose process went away meanwhile is queued
+        // again rather than blocking this thread on a new one.
+        //
+        m_RequestStatus = FORWARDER_WAITING_FOR_PROCESS;
+        ReferenceRequestHandler();
+
+        hr = m_pApplication->GetProcess(this, &pServerProcess);
+        if (hr == S_FALSE)
+        {
+            //
+            // Queued until a process is ready, OnAdmissionComplete resumes
+            // the request.
+            //
+            retVal = RQ_NOTIFICATION_PENDING;
+            goto Finished;
+        }
+
+        m_RequestStatus = FORWARDER_START;
+        DereferenceRequestHandler();
+    }
+
     if (FAILED_LOG(hr))
     {
-        fFailedToStartKestrel = TRUE;
+        fFailedToStartKestrel = hr != E_ADMISSION_QUEUE_FULL &&
+            hr != E_ADMISSION_QUEUE_TIMEOUT &&
+            hr != E_APPLICATION_EXITING;
         FAILURE(hr);
     }
 
@@ -149,6 +253,13 @@ FORWARDING_HANDLER::ExecuteRequestHandler()
         FAILURE(HRESULT_FROM_WIN32(ERROR_CREATE_FAILED));
     }
 
+    //
+    // Keep the process alive and counted as busy until the request completes.
+    //
+    m_pServerProcess = pServerProcess;
+    m_pServerProcess->QueryLoad()->OnRequestStart();
+    MarkPhase(REQUEST_PHASE_PROCESS_ACQUIRE);
+
     if (pServerProcess->QueryWinHttpConnection() == nullptr)
     {
         FAILURE(HRESULT_FROM_WIN32(ERROR_INVALID_HANDLE));
@@ -156,7 +267,6 @@ FORWARDING_HANDLER::ExecuteRequestHandler()
 
     hConnect = pServerProcess->QueryWinHttpConnection()->QueryHandle();
 
-    m_pszOriginalHostHeader = pRequest->GetHeader(HttpHeaderHost, &cchHostName);
     //
     // parse original url
     //
@@ -167,8 +277,6 @@ FORWARDING_HANDLER::ExecuteRequestHandler()
 
     FAILURE_IF_FAILED(URL_UTILITY::EscapeAbsPath(pRequest, &struEscapedUrl));
 
-    m_fDoReverseRewriteHeaders = pProtocol->QueryReverseRewriteHeaders();
-
     m_cMinBufferLimit = pProtocol->QueryMinResponseBuffer();
 
     //
@@ -181,10 +289,6 @@ FORWARDING_HANDLER::ExecuteRequestHandler()
         if (cchHeader == 9 && _stricmp(pszWebSocketHeader, "websocket") == 0)
         {
             m_fWebSocketEnabled = TRUE;
-
-            // WinHttp does not support any extensions being returned by the server, so we remove the request header to avoid the server
-            // responding with any accepted extensions.
-            pRequest->DeleteHeader("Sec-WebSocket-Extensions");
         }
     }
 
@@ -237,6 +341,10 @@ FORWARDING_HANDLER::ExecuteRequestHandler()
         m_BytesToReceive = INFINITE;
     }
 
+    m_RequestBodyPipeline.Initialize(m_BytesToReceive == INFINITE ? 0 : m_BytesToReceive,
+        m_BytesToReceive == INFINITE);
+    m_ChunkEncoder.Reset();
+
     if (m_fWebSocketEnabled)
     {
         //
@@ -253,6 +361,10 @@ FORWARDING_HANDLER::ExecuteRequestHandler()
 
     m_cchLastSend = m_cchHeaders;
 
+    LARGE_INTEGER liSendRequest;
+    QueryPerformanceCounter(&liSendRequest);
+    m_llSendRequestCounter = liSendRequest.QuadPart;
+
     //FREB log
     if (ANCMEvents::ANCM_REQUEST_FORWARD_START::IsEnabled(m_pW3Context->GetTraceContext()))
     {
@@ -308,6 +420,10 @@ Failure:
     {
         pResponse->SetStatus(503, "Service Unavailable", 0, S_OK, nullptr, TRUE);
     }
+    else if (hr == E_ADMISSION_QUEUE_FULL || hr == E_ADMISSION_QUEUE_TIMEOUT)
+    {
+        pResponse->SetStatus(503, "Service Unavailable", 0, hr);
+    }
     else if (fFailedToStartKestrel && !m_pApplication->QueryConfig()->QueryDisableStartUpErrorPage())
     {
         static std::string htmlResponse = FILE_UTILITY::GetHtml(g_hOutOfProcessRHModule,
@@ -390,6 +506,18 @@ REQUEST_NOTIFICATION_STATUS
     DBG_ASSERT(m_pW3Context != nullptr);
     __analysis_assume(m_pW3Context != nullptr);
 
+    if (m_RequestStatus == FORWARDER_WAITING_FOR_PROCESS ||
+        m_RequestStatus == FORWARDER_WAITING_FOR_LEADER)
+    {
+        //
+        // Posted by OnAdmissionComplete or OnCollapsedRequestComplete, no
+        // WinHTTP request exists yet. Start over, ExecuteRequestHandler
+        // picks up the admission result or the cached response.
+        //
+        m_RequestStatus = FORWARDER_START;
+        return ExecuteRequestHandler();
+    }
+
     //
     // Take a reference so that object does not go away as a result of
     // async completion.
@@ -416,6 +544,22 @@ REQUEST_NOTIFICATION_STATUS
         fLocked = TRUE;
     }
 
+    if (m_RequestBodyPipeline.IsReadPending())
+    {
+        //
+        // This is the completion of a request entity read. It also stands
+        // in for a PostCompletion skipped while the read was outstanding.
+        //
+        if (hrCompletionStatus == HRESULT_FROM_WIN32(ERROR_HANDLE_EOF) || FAILED(hrCompletionStatus))
+        {
+            m_RequestBodyPipeline.OnReadEof();
+        }
+        else
+        {
+            m_RequestBodyPipeline.OnReadComplete(cbCompletion);
+        }
+    }
+
     if (m_fClientDisconnected && (m_RequestStatus != FORWARDER_DONE))
     {
         FAILURE(ERROR_CONNECTION_ABORTED);
@@ -434,7 +578,12 @@ REQUEST_NOTIFICATION_STATUS
             FAILURE(E_OUTOFMEMORY);
         }
 
-        hr = m_pWebSocket->ProcessRequest(this, m_pW3Context, m_hRequest, &fWebSocketUpgraded);
+        hr = m_pWebSocket->ProcessRequest(this,
+            m_pW3Context,
+            m_hRequest,
+            m_pApplication->QueryConfig()->QueryWebSocketIdleTimeout(),
+            m_pApplication->QueryConfig()->QueryEnableWebSocketCoalescing(),
+            &fWebSocketUpgraded);
         if (fWebSocketUpgraded)
         {
             // WinHttp WebSocket handle has been created, bump the counter so that remember to close it
@@ -458,6 +607,13 @@ REQUEST_NOTIFICATION_STATUS
         {
             FAILURE(HRESULT_FROM_WIN32(GetLastError()));
         }
+
+        //
+        // A websocket stays open for the lifetime of the connection,
+        // it no longer counts as an outstanding request for load balancing.
+        //
+        ReleaseServerProcess();
+
         retVal = RQ_NOTIFICATION_PENDING;
         goto Finished;
     }
@@ -509,6 +665,8 @@ REQUEST_NOTIFICATION_STATUS
             }
             else
             {
+                MarkPhase(REQUEST_PHASE_CLIENT_FLUSH);
+                RecordPhaseTiming();
                 retVal = RQ_NOTIFICATION_CONTINUE;
             }
         }
@@ -675,9 +833,9 @@ HRESULT
     FINISHED_IF_NULL_ALLOC(sm_pAlloc = new ALLOC_CACHE_HANDLER);
     FINISHED_IF_FAILED(sm_pAlloc->Initialize(sizeof(FORWARDING_HANDLER), 64)); // nThreshold
 
-    FINISHED_IF_NULL_ALLOC(sm_pResponseHeaderHash = new RESPONSE_HEADER_HASH);
+    FINISHED_IF_FAILED(ENTITY_BUFFER_POOL::StaticInitialize());
 
-    FINISHED_IF_FAILED(sm_pResponseHeaderHash->Initialize());
+    QueryPerformanceFrequency(&sm_liPerfFrequency);
 
     // Initialize PROTOCOL_CONFIG
     FINISHED_IF_FAILED(sm_ProtocolConfig.Initialize());
@@ -699,19 +857,14 @@ Finished:
 VOID
 FORWARDING_HANDLER::StaticTerminate()
 {
-    if (sm_pResponseHeaderHash != nullptr)
-    {
-        sm_pResponseHeaderHash->Clear();
-        delete sm_pResponseHeaderHash;
-        sm_pResponseHeaderHash = nullptr;
-    }
-
     if (sm_pTraceLog != nullptr)
     {
         DestroyRefTraceLog(sm_pTraceLog);
         sm_pTraceLog = nullptr;
     }
 
+    ENTITY_BUFFER_POOL::StaticTerminate();
+
     if (sm_pAlloc != nullptr)
     {
         delete sm_pAlloc;
@@ -745,23 +898,34 @@ FORWARDING_HANDLER::GetHeaders(
     _In_ const PROTOCOL_CONFIG *    pProtocol,
     _In_    BOOL                    fForwardWindowsAuthToken,
     _In_    SERVER_PROCESS*         pServerProcess,
-    _Out_   PCWSTR *                ppszHeaders,
-    _Inout_ DWORD *                 pcchHeaders
+    _Out_   PWSTR *                 ppszHeaders,
+    _Out_   DWORD *                 pcchHeaders
 )
 {
-    PCSTR pszCurrentHeader = nullptr;
-    PCSTR ppHeadersToBeRemoved = nullptr;
     PCSTR pszFinalHeader = nullptr;
-    USHORT cchCurrentHeader = 0;
     DWORD cchFinalHeader = 0;
     BOOL  fSecure = FALSE;  // dummy. Used in SplitUrl. Value will not be used
                             // as ANCM always use http protocol to communicate with backend
     STRU  struDestination;
     STRU  struUrl;
-    STACK_STRA(strTemp, 64);
-    HTTP_REQUEST_HEADERS *pHeaders = nullptr;
+    STACK_STRA(strHost, 64);
+    STACK_STRA(strForwardedFor, 64);
+    STRA  strClientCert;
+    CHAR  pszHandleStr[16] = { 0 };
     IHttpRequest *pRequest = m_pW3Context->GetRequest();
-    MULTISZA mszMsAspNetCoreHeaders;
+    const HTTP_REQUEST_HEADERS *pHeaders = &pRequest->GetRawHttpRequest()->Headers;
+    REQUEST_HEADER_BUILDER builder(*pProtocol->QueryRequestHeaderRules(), !!m_fWebSocketEnabled);
+
+    *ppszHeaders = nullptr;
+    *pcchHeaders = 0;
+
+    //
+    // The request headers are left untouched, the header block sent to the
+    // backend is built from them and the values below in a single buffer.
+    // Headers starting with MS-ASPNETCORE, the connection header for
+    // non-websocket requests and the websocket extensions header are not
+    // forwarded.
+    //
 
     //
     // We historically set the host section in request url to the new host header
@@ -775,45 +939,14 @@ FORWARDING_HANDLER::GetHeaders(
             &struDestination,
             &struUrl));
 
-        RETURN_IF_FAILED(strTemp.CopyW(struDestination.QueryStr()));
-        RETURN_IF_FAILED(pRequest->SetHeader(HttpHeaderHost,
-            strTemp.QueryStr(),
-            static_cast<USHORT>(strTemp.QueryCCH()),
-            TRUE)); // fReplace
-    }
-    //
-    // Strip all headers starting with MS-ASPNETCORE.
-    // These headers are generated by the asp.net core module and
-    // passed to the process it creates.
-    //
-
-    pHeaders = &m_pW3Context->GetRequest()->GetRawHttpRequest()->Headers;
-    for (DWORD i = 0; i<pHeaders->UnknownHeaderCount; i++)
-    {
-        if (_strnicmp(pHeaders->pUnknownHeaders[i].pName, "MS-ASPNETCORE", 13) == 0)
-        {
-            mszMsAspNetCoreHeaders.Append(pHeaders->pUnknownHeaders[i].pName, (DWORD)pHeaders->pUnknownHeaders[i].NameLength);
-        }
-    }
-
-    ppHeadersToBeRemoved = mszMsAspNetCoreHeaders.First();
-
-    //
-    // iterate the list of headers to be removed and delete them from the request.
-    //
-
-    while (ppHeadersToBeRemoved != nullptr)
-    {
-        m_pW3Context->GetRequest()->DeleteHeader(ppHeadersToBeRemoved);
-        ppHeadersToBeRemoved = mszMsAspNetCoreHeaders.Next(ppHeadersToBeRemoved);
+        RETURN_IF_FAILED(strHost.CopyW(struDestination.QueryStr()));
+        builder.SetValue(REQUEST_HEADER_RULES::SLOT_HOST,
+            std::string_view(strHost.QueryStr(), strHost.QueryCCH()));
     }
 
     if (pServerProcess->QueryGuid() != nullptr)
     {
-        RETURN_IF_FAILED(m_pW3Context->GetRequest()->SetHeader("MS-ASPNETCORE-TOKEN",
-            pServerProcess->QueryGuid(),
-            (USHORT)strlen(pServerProcess->QueryGuid()),
-            TRUE));
+        builder.SetValue(REQUEST_HEADER_RULES::SLOT_ASPNETCORE_TOKEN, pServerProcess->QueryGuid());
     }
 
     if (fForwardWindowsAuthToken &&
@@ -839,43 +972,30 @@ FORWARDING_HANDLER::GetHeaders(
             //
             // set request header with target token value
             //
-            CHAR pszHandleStr[16] = { 0 };
             if (_ui64toa_s((UINT64)hTargetTokenHandle, pszHandleStr, 16, 16) != 0)
             {
                 RETURN_HR(HRESULT_FROM_WIN32(ERROR_INVALID_DATA));
             }
 
-            RETURN_IF_FAILED(m_pW3Context->GetRequest()->SetHeader("MS-ASPNETCORE-WINAUTHTOKEN",
-                pszHandleStr,
-                (USHORT)strlen(pszHandleStr),
-                TRUE));
+            builder.SetValue(REQUEST_HEADER_RULES::SLOT_WINAUTH_TOKEN, pszHandleStr);
         }
     }
 
     if (!pProtocol->QueryXForwardedForName()->IsEmpty())
     {
-        strTemp.Reset();
-
-        pszCurrentHeader = pRequest->GetHeader(pProtocol->QueryXForwardedForName()->QueryStr(), &cchCurrentHeader);
-        if (pszCurrentHeader != nullptr)
-        {
-            RETURN_IF_FAILED(strTemp.Copy(pszCurrentHeader, cchCurrentHeader));
-            RETURN_IF_FAILED(strTemp.Append(", ", 2));
-        }
-
         RETURN_IF_FAILED(m_pW3Context->GetServerVariable("REMOTE_ADDR",
             &pszFinalHeader,
             &cchFinalHeader));
 
         if (pRequest->GetRawHttpRequest()->Address.pRemoteAddress->sa_family == AF_INET6)
         {
-            RETURN_IF_FAILED(strTemp.Append("[", 1));
-            RETURN_IF_FAILED(strTemp.Append(pszFinalHeader, cchFinalHeader));
-            RETURN_IF_FAILED(strTemp.Append("]", 1));
+            RETURN_IF_FAILED(strForwardedFor.Append("[", 1));
+            RETURN_IF_FAILED(strForwardedFor.Append(pszFinalHeader, cchFinalHeader));
+            RETURN_IF_FAILED(strForwardedFor.Append("]", 1));
         }
         else
         {
-            RETURN_IF_FAILED(strTemp.Append(pszFinalHeader, cchFinalHeader));
+            RETURN_IF_FAILED(strForwardedFor.Append(pszFinalHeader, cchFinalHeader));
         }
 
         if (pProtocol->QueryIncludePortInXForwardedFor())
@@ -884,86 +1004,94 @@ FORWARDING_HANDLER::GetHeaders(
                 &pszFinalHeader,
                 &cchFinalHeader));
 
-            RETURN_IF_FAILED(strTemp.Append(":", 1));
-            RETURN_IF_FAILED(strTemp.Append(pszFinalHeader, cchFinalHeader));
+            RETURN_IF_FAILED(strForwardedFor.Append(":", 1));
+            RETURN_IF_FAILED(strForwardedFor.Append(pszFinalHeader, cchFinalHeader));
         }
 
-        RETURN_IF_FAILED(pRequest->SetHeader(pProtocol->QueryXForwardedForName()->QueryStr(),
-            strTemp.QueryStr(),
-            static_cast<USHORT>(strTemp.QueryCCH()),
-            TRUE)); // fReplace
+        builder.SetValue(REQUEST_HEADER_RULES::SLOT_X_FORWARDED_FOR,
+            std::string_view(strForwardedFor.QueryStr(), strForwardedFor.QueryCCH()));
     }
 
-    if (!pProtocol->QuerySslHeaderName()->IsEmpty())
-    {
-        const HTTP_SSL_INFO *pSslInfo = pRequest->GetRawHttpRequest()->pSslInfo;
-        LPSTR pszScheme = "http";
-        if (pSslInfo != nullptr)
-        {
-            pszScheme = "https";
-        }
+    builder.SetValue(REQUEST_HEADER_RULES::SLOT_X_FORWARDED_PROTO,
+        pRequest->GetRawHttpRequest()->pSslInfo != nullptr ? "https" : "http");
 
-        strTemp.Reset();
+    if (pRequest->GetRawHttpRequest()->pSslInfo != nullptr &&
+        pRequest->GetRawHttpRequest()->pSslInfo->pClientCertInfo != nullptr &&
+        !pProtocol->QueryClientCertName()->IsEmpty())
+    {
+        const HTTP_SSL_CLIENT_CERT_INFO *pClientCertInfo = pRequest->GetRawHttpRequest()->pSslInfo->pClientCertInfo;
 
-        pszCurrentHeader = pRequest->GetHeader(pProtocol->QuerySslHeaderName()->QueryStr(), &cchCurrentHeader);
-        if (pszCurrentHeader != nullptr)
-        {
-            RETURN_IF_FAILED(strTemp.Copy(pszCurrentHeader, cchCurrentHeader));
-            RETURN_IF_FAILED(strTemp.Append(", ", 2));
-        }
+        // Resize the buffer large enough to hold the encoded certificate info
+        RETURN_IF_FAILED(strClientCert.Resize(
+            1 + (pClientCertInfo->CertEncodedSize + 2) / 3 * 4));
 
-        RETURN_IF_FAILED(strTemp.Append(pszScheme));
+        Base64Encode(
+            pClientCertInfo->pCertEncoded,
+            pClientCertInfo->CertEncodedSize,
+            strClientCert.QueryStr(),
+            strClientCert.QuerySize(),
+            nullptr);
+        strClientCert.SyncWithBuffer();
 
-        RETURN_IF_FAILED(pRequest->SetHeader(pProtocol->QuerySslHeaderName()->QueryStr(),
-            strTemp.QueryStr(),
-            (USHORT)strTemp.QueryCCH(),
-            TRUE));
+        builder.SetValue(REQUEST_HEADER_RULES::SLOT_CLIENT_CERT,
+            std::string_view(strClientCert.QueryStr(), strClientCert.QueryCCH()));
     }
 
-    if (!pProtocol->QueryClientCertName()->IsEmpty())
+    //
+    // Feed the headers to the builder twice, once to size the block and once
+    // to write it.
+    //
+    const auto visitHeaders = [&](decltype(&REQUEST_HEADER_BUILDER::Measure) pfnVisit)
     {
-        if (pRequest->GetRawHttpRequest()->pSslInfo == nullptr ||
-            pRequest->GetRawHttpRequest()->pSslInfo->pClientCertInfo == nullptr)
+        for (DWORD i = 0; i < HttpHeaderRequestMaximum; i++)
         {
-            pRequest->DeleteHeader(pProtocol->QueryClientCertName()->QueryStr());
+            const HTTP_KNOWN_HEADER &header = pHeaders->KnownHeaders[i];
+            if (header.pRawValue != nullptr)
+            {
+                (builder.*pfnVisit)(i,
+                    g_rgRequestHeaderNames[i],
+                    std::string_view(header.pRawValue, header.RawValueLength));
+            }
         }
-        else
-        {
-            // Resize the buffer large enough to hold the encoded certificate info
-            RETURN_IF_FAILED(strTemp.Resize(
-                1 + (pRequest->GetRawHttpRequest()->pSslInfo->pClientCertInfo->CertEncodedSize + 2) / 3 * 4));
-
-            Base64Encode(
-                pRequest->GetRawHttpRequest()->pSslInfo->pClientCertInfo->pCertEncoded,
-                pRequest->GetRawHttpRequest()->pSslInfo->pClientCertInfo->CertEncodedSize,
-                strTemp.QueryStr(),
-                strTemp.QuerySize(),
-                nullptr);
-            strTemp.SyncWithBuffer();
 
-            RETURN_IF_FAILED(pRequest->SetHeader(
-                pProtocol->QueryClientCertName()->QueryStr(),
-                strTemp.QueryStr(),
-                static_cast<USHORT>(strTemp.QueryCCH()),
-                TRUE)); // fReplace
+        for (DWORD i = 0; i < pHeaders->UnknownHeaderCount; i++)
+        {
+            const HTTP_UNKNOWN_HEADER &header = pHeaders->pUnknownHeaders[i];
+            (builder.*pfnVisit)(UNKNOWN_INDEX,
+                std::string_view(header.pName, header.NameLength),
+                std::string_view(header.pRawValue, header.RawValueLength));
         }
+    };
+
+    visitHeaders(&REQUEST_HEADER_BUILDER::Measure);
+    const size_t cchHeaders = builder.EndMeasure();
+    if (cchHeaders == 0)
+    {
+        return S_OK;
+    }
+    if (cchHeaders > MAXDWORD / sizeof(WCHAR))
+    {
+        RETURN_HR(HRESULT_FROM_WIN32(ERROR_ARITHMETIC_OVERFLOW));
     }
 
-    //
-    // Remove the connection header
-    //
-    if (!m_fWebSocketEnabled)
+    PWSTR pszHeaders = reinterpret_cast<PWSTR>(ENTITY_BUFFER_POOL::Alloc(static_cast<DWORD>(cchHeaders * sizeof(WCHAR))));
+    if (pszHeaders == nullptr)
     {
-        pRequest->DeleteHeader(HttpHeaderConnection);
+        RETURN_HR(E_OUTOFMEMORY);
     }
 
-    //
-    // Get all the headers to send to the client
-    //
-    RETURN_IF_FAILED(m_pW3Context->GetServerVariable("ALL_RAW",
-        ppszHeaders,
-        pcchHeaders));
+    builder.BeginWrite(pszHeaders, cchHeaders);
+    visitHeaders(&REQUEST_HEADER_BUILDER::Write);
+    builder.EndWrite();
+
+    if (builder.HasError())
+    {
+        ENTITY_BUFFER_POOL::Free(reinterpret_cast<BYTE *>(pszHeaders));
+        RETURN_HR(HRESULT_FROM_WIN32(ERROR_INVALID_DATA));
+    }
 
+    *ppszHeaders = pszHeaders;
+    *pcchHeaders = static_cast<DWORD>(cchHeaders);
     return S_OK;
 }
 
@@ -1248,6 +1376,10 @@ None
     {
     case WINHTTP_CALLBACK_STATUS_SENDREQUEST_COMPLETE:
     case WINHTTP_CALLBACK_STATUS_WRITE_COMPLETE:
+        if (dwInternetStatus == WINHTTP_CALLBACK_STATUS_SENDREQUEST_COMPLETE)
+        {
+            MarkPhase(REQUEST_PHASE_SEND_HEADERS);
+        }
         hr = LOG_IF_FAILED(OnWinHttpCompletionSendRequestOrWriteComplete(hRequest,
             dwInternetStatus,
             &fClientError,
@@ -1255,6 +1387,7 @@ None
         break;
 
     case WINHTTP_CALLBACK_STATUS_HEADERS_AVAILABLE:
+        MarkPhase(REQUEST_PHASE_FIRST_BYTE);
         hr = LOG_IF_FAILED(OnWinHttpCompletionStatusHeadersAvailable(hRequest,
             &fAnotherCompletionExpected));
         break;
@@ -1280,6 +1413,7 @@ None
         // This is a notification, not a completion.  This notification happens
         // during the Send Request operation.
         //
+        MarkPhase(REQUEST_PHASE_CONNECT);
         fAnotherCompletionExpected = TRUE;
         break;
 
@@ -1477,6 +1611,15 @@ Finished:
         fDoPostCompletion = !m_fFinishRequest;
     }
 
+    if (fDoPostCompletion && m_RequestBodyPipeline.IsReadPending())
+    {
+        //
+        // IIS must not see two completions at once, the outstanding request
+        // entity read resumes the request instead.
+        //
+        fDoPostCompletion = FALSE;
+    }
+
     //
     // No code should access IIS m_pW3Context after posting the completion.
     //
@@ -1503,105 +1646,39 @@ Finished:
 
 HRESULT
 FORWARDING_HANDLER::OnWinHttpCompletionSendRequestOrWriteComplete(
-    HINTERNET                   hRequest,
+    HINTERNET,
     DWORD,
     __out BOOL *                pfClientError,
     __out BOOL *                pfAnotherCompletionExpected
 )
 {
-    HRESULT hr = S_OK;
-    IHttpRequest *      pRequest = m_pW3Context->GetRequest();
-
-    *pfClientError = FALSE;
-
     //
     // completion for sending the initial request or request entity to
     // winhttp, get more request entity if available, else start receiving
     // the response
     //
-    if (m_BytesToReceive > 0)
-    {
-        if (m_pEntityBuffer == nullptr)
-        {
-            FINISHED_IF_NULL_ALLOC(m_pEntityBuffer = GetNewResponseBuffer(
-                ENTITY_BUFFER_SIZE));
-        }
-
-        if (sm_pTraceLog != nullptr)
-        {
-            WriteRefTraceLogEx(sm_pTraceLog,
-                m_cRefs,
-                this,
-                "Calling ReadEntityBody",
-                nullptr,
-                nullptr);
-        }
-        hr = pRequest->ReadEntityBody(
-            m_pEntityBuffer + 6,
-            min(m_BytesToReceive, BUFFER_SIZE),
-            TRUE,       // fAsync
-            nullptr,       // pcbBytesReceived
-            nullptr);      // pfCompletionPending
-        if (hr == HRESULT_FROM_WIN32(ERROR_HANDLE_EOF))
-        {
-            DBG_ASSERT(m_BytesToReceive == 0 ||
-                m_BytesToReceive == INFINITE);
-
-            //
-            // ERROR_HANDLE_EOF is not an error.
-            //
-            hr = S_OK;
-
-            if (m_BytesToReceive == INFINITE)
-            {
-                m_BytesToReceive = 0;
-                m_cchLastSend = 5;
-
-                //
-                // WinHttpWriteData can operate asynchronously.
-                //
-                // Take reference so that object does not go away as a result of
-                // async completion.
-                //
-                //ReferenceForwardingHandler();
-                if (!WinHttpWriteData(m_hRequest,
-                    "0\r\n\r\n",
-                    5,
-                    nullptr))
-                {
-                    FINISHED(HRESULT_FROM_WIN32(GetLastError()));
-                    //DereferenceForwardingHandler();
-                    goto Finished;
-                }
-                *pfAnotherCompletionExpected = TRUE;
-
-                goto Finished;
-            }
-        }
-        else if (FAILED_LOG(hr))
-        {
-            *pfClientError = TRUE;
-            goto Finished;
-        }
-        else
-        {
-            //
-            // ReadEntityBody will post a completion to IIS.
-            //
-            *pfAnotherCompletionExpected = TRUE;
+    *pfClientError = FALSE;
 
-            goto Finished;
-        }
+    if (m_iWriteSegment < m_cWriteSegments)
+    {
+        //
+        // The rest of a framed chunk.
+        //
+        RETURN_IF_FAILED(WriteRequestEntitySegment());
+        *pfAnotherCompletionExpected = TRUE;
+        return S_OK;
     }
 
-    m_RequestStatus = FORWARDER_RECEIVING_RESPONSE;
-
-    FINISHED_LAST_ERROR_IF(!WinHttpReceiveResponse(hRequest, nullptr));
-    *pfAnotherCompletionExpected = TRUE;
+    m_RequestBodyPipeline.OnWriteComplete();
 
-Finished:
+    RETURN_IF_FAILED(PumpRequestEntity(pfClientError));
 
-    return hr;
+    //
+    // Either a WinHTTP operation or a client read is outstanding, a read
+    // completes through AsyncCompletion.
+    //
+    *pfAnotherCompletionExpected = TRUE;
+    return S_OK;
 }
 
 HRESULT
@@ -1617,6 +1694,14 @@ FORWARDING_HANDLER::OnWinHttpCompletionStatusHeadersAvailable(
 
     *pfAnotherCompletionExpected = FALSE;
 
+    if (m_pServerProcess != nullptr && m_llSendRequestCounter != 0)
+    {
+        LARGE_INTEGER liNow;
+        QueryPerformanceCounter(&liNow);
+        m_pServerProcess->QueryLoad()->OnLatencySample(
+            (liNow.QuadPart - m_llSendRequestCounter) * 1000000 / sm_liPerfFrequency.QuadPart);
+    }
+
     //
     // Headers are available, read the status line and headers and pass
     // them on to the client
@@ -1667,12 +1752,60 @@ FORWARDING_HANDLER::OnWinHttpCompletionStatusHeadersAvailable(
         FINISHED_IF_FAILED(strHeaders.Append("\r\n"));
     }
 
+    if (m_fCaptureResponse)
+    {
+        //
+        // SetStatusAndHeaders modifies the block, copy it first.
+        //
+        StartResponseCapture(std::string_view(strHeaders.QueryStr(), strHeaders.QueryCCH()));
+    }
+
     FINISHED_IF_FAILED(SetStatusAndHeaders(
         strHeaders.QueryStr(),
         strHeaders.QueryCCH()));
 
+    MarkPhase(REQUEST_PHASE_HEADERS_SET);
+
+    if (m_pApplication->ShouldSendServerTiming())
+    {
+        try
+        {
+            const std::string strServerTiming = m_PhaseTimer.FormatServerTiming(sm_liPerfFrequency.QuadPart);
+            FINISHED_IF_FAILED(m_pW3Context->GetResponse()->SetHeader("Server-Timing",
+                strServerTiming.c_str(),
+                static_cast<USHORT>(strServerTiming.size()),
+                FALSE)); // fReplace
+        }
+        catch (...)
+        {
+            hr = OBSERVE_CAUGHT_EXCEPTION();
+            goto Finished;
+        }
+    }
+
+    if (!m_strSendFilePath.empty())
+    {
+        //
+        // The backend body is not read, closing the request below drops it.
+        //
+        m_pResponseCapture.reset();
+        ReleaseCollapsedRequest();
+
+        FINISHED_IF_FAILED(SendFileResponse());
+        MarkPhase(REQUEST_PHASE_LAST_BYTE);
+        m_RequestStatus = FORWARDER_DONE;
+        goto Finished;
+    }
+
     FreeResponseBuffers();
 
+    //
+    // m_cContentLength is 0 without a Content-Length. A response announcing
+    // an empty entity has nothing to read either way.
+    //
+    m_ReadSizeController.Initialize(m_cContentLength != 0 ? m_cContentLength : READ_SIZE_CONTROLLER::UNKNOWN_CONTENT_LENGTH,
+        sm_ProtocolConfig.QueryResponseBufferLimit());
+
     //
     // If the request was websocket, and response was 101,
     // trigger a flush, so that IIS's websocket module
@@ -1712,6 +1845,7 @@ FORWARDING_HANDLER::OnWinHttpCompletionStatusDataAvailable(
 )
 {
     HRESULT hr = S_OK;
+    DWORD   cbRead = 0;
 
     *pfAnotherCompletionExpected = FALSE;
 
@@ -1726,6 +1860,8 @@ FORWARDING_HANDLER::OnWinHttpCompletionStatusDataAvailable(
         }
 
         m_RequestStatus = FORWARDER_DONE;
+        MarkPhase(REQUEST_PHASE_LAST_BYTE);
+        CompleteResponseCapture();
 
         goto Finished;
     }
@@ -1736,8 +1872,16 @@ FORWARDING_HANDLER::OnWinHttpCompletionStatusDataAvailable(
         m_cContentLength -= dwBytes;
     }
 
-    m_pEntityBuffer = GetNewResponseBuffer(
-        min(m_BytesToSend, BUFFER_SIZE));
+    cbRead = min(m_BytesToSend, static_cast<DWORD>(m_ReadSizeController.QueryReadSize()));
+    if (cbRead == 0)
+    {
+        //
+        // More entity than the Content-Length announced.
+        //
+        FINISHED(HRESULT_FROM_WIN32(ERROR_WINHTTP_INVALID_SERVER_RESPONSE));
+    }
+
+    m_pEntityBuffer = GetNewResponseBuffer(cbRead);
     FINISHED_IF_NULL_ALLOC(m_pEntityBuffer);
 
     //
@@ -1749,7 +1893,7 @@ FORWARDING_HANDLER::OnWinHttpCompletionStatusDataAvailable(
     //ReferenceForwardingHandler();
     FINISHED_LAST_ERROR_IF(!WinHttpReadData(hRequest,
         m_pEntityBuffer,
-        min(m_BytesToSend, BUFFER_SIZE),
+        cbRead,
         nullptr));
 
     *pfAnotherCompletionExpected = TRUE;
@@ -1775,6 +1919,13 @@ FORWARDING_HANDLER::OnWinHttpCompletionStatusReadComplete(
     //
     m_BytesToSend -= dwStatusInformationLength;
 
+    m_ReadSizeController.OnReadComplete(dwStatusInformationLength);
+
+    if (m_pResponseCapture != nullptr && dwStatusInformationLength != 0)
+    {
+        AppendResponseCapture(m_pEntityBuffer, dwStatusInformationLength);
+    }
+
     if (m_cMinBufferLimit >= BUFFER_SIZE / 2)
     {
         if (m_cContentLength != 0)
@@ -1796,6 +1947,8 @@ FORWARDING_HANDLER::OnWinHttpCompletionStatusReadComplete(
             }
 
             m_RequestStatus = FORWARDER_DONE;
+            MarkPhase(REQUEST_PHASE_LAST_BYTE);
+            CompleteResponseCapture();
         }
     }
     else
@@ -1841,7 +1994,7 @@ Finished:
 
 HRESULT
 FORWARDING_HANDLER::OnSendingRequest(
-    DWORD                       cbCompletion,
+    DWORD,
     HRESULT                     hrCompletionStatus,
     __out BOOL *                pfClientError
 )
@@ -1849,96 +2002,144 @@ FORWARDING_HANDLER::OnSendingRequest(
     *pfClientError = FALSE;
 
     //
-    // This is a completion for a read from http.sys, abort in case
-    // of failure, if we read anything write it out over WinHTTP,
-    // but we have already reached EOF, now read the response
+    // This is a completion for a read from http.sys, already recorded in
+    // m_RequestBodyPipeline, abort in case of failure. Write out what was
+    // read unless a write is still in progress and read ahead into the
+    // other buffer.
     //
-    if (hrCompletionStatus == HRESULT_FROM_WIN32(ERROR_HANDLE_EOF))
+    if (FAILED(hrCompletionStatus) &&
+        hrCompletionStatus != HRESULT_FROM_WIN32(ERROR_HANDLE_EOF))
     {
-        DBG_ASSERT(m_BytesToReceive == 0 || m_BytesToReceive == INFINITE);
-        if (m_BytesToReceive == INFINITE)
-        {
-            m_BytesToReceive = 0;
-            m_cchLastSend = 5; // "0\r\n\r\n"
+        *pfClientError = TRUE;
+        RETURN_HR(hrCompletionStatus);
+    }
 
-            RETURN_LAST_ERROR_IF(!WinHttpWriteData(m_hRequest,
-                "0\r\n\r\n",
-                5,
-                nullptr));
-        }
-        else
-        {
-            m_RequestStatus = FORWARDER_RECEIVING_RESPONSE;
+    return PumpRequestEntity(pfClientError);
+}
 
-            RETURN_LAST_ERROR_IF(!WinHttpReceiveResponse(m_hRequest, nullptr));
-        }
-    }
-    else if (SUCCEEDED(hrCompletionStatus))
-    {
-        DWORD cbOffset = 0;
+HRESULT
+FORWARDING_HANDLER::PumpRequestEntity(
+    __out BOOL *                pfClientError
+)
+{
+    IHttpRequest   *pRequest = m_pW3Context->GetRequest();
+    uint32_t        iBuffer = 0;
+    uint32_t        cbData = 0;
+    HRESULT         hr = S_OK;
 
-        if (m_BytesToReceive != INFINITE)
-        {
-            m_BytesToReceive -= cbCompletion;
-            cbOffset = 6;
-        }
-        else
+    *pfClientError = FALSE;
+
+    //
+    // The pipeline marks every operation outstanding before it is issued,
+    // so a WinHTTP completion delivered on this stack sees a consistent
+    // state and may pump as well.
+    //
+    for (;;)
+    {
+        switch (m_RequestBodyPipeline.NextAction(BUFFER_SIZE, &iBuffer, &cbData))
         {
-            //
-            // For chunk-encoded requests, need to re-chunk the entity body
-            // Add the CRLF just before and after the chunk data
-            //
-            m_pEntityBuffer[4] = '\r';
-            m_pEntityBuffer[5] = '\n';
+        case REQUEST_BODY_PIPELINE::ACTION_READ:
+            if (m_pRequestEntityBuffers[iBuffer] == nullptr)
+            {
+                m_pRequestEntityBuffers[iBuffer] = GetNewResponseBuffer(BUFFER_SIZE);
+                if (m_pRequestEntityBuffers[iBuffer] == nullptr)
+                {
+                    m_RequestBodyPipeline.OnReadEof();
+                    RETURN_HR(E_OUTOFMEMORY);
+                }
+            }
 
-            m_pEntityBuffer[cbCompletion + 6] = '\r';
-            m_pEntityBuffer[cbCompletion + 7] = '\n';
+            if (sm_pTraceLog != nullptr)
+            {
+                WriteRefTraceLogEx(sm_pTraceLog,
+                    m_cRefs,
+                    this,
+                    "Calling ReadEntityBody",
+                    nullptr,
+                    nullptr);
+            }
 
-            if (cbCompletion < 0x10)
+            hr = pRequest->ReadEntityBody(
+                m_pRequestEntityBuffers[iBuffer],
+                cbData,
+                TRUE,       // fAsync
+                nullptr,       // pcbBytesReceived
+                nullptr);      // pfCompletionPending
+            if (hr == HRESULT_FROM_WIN32(ERROR_HANDLE_EOF))
             {
-                cbOffset = 3;
-                m_pEntityBuffer[3] = HEX_TO_ASCII(cbCompletion);
-                cbCompletion += 5;
+                //
+                // ERROR_HANDLE_EOF is not an error.
+                //
+                m_RequestBodyPipeline.OnReadEof();
             }
-            else if (cbCompletion < 0x100)
+            else if (FAILED_LOG(hr))
             {
-                cbOffset = 2;
-                m_pEntityBuffer[2] = HEX_TO_ASCII(cbCompletion >> 4);
-                m_pEntityBuffer[3] = HEX_TO_ASCII(cbCompletion & 0xf);
-                cbCompletion += 6;
+                m_RequestBodyPipeline.OnReadEof();
+                *pfClientError = TRUE;
+                RETURN_HR(hr);
             }
-            else if (cbCompletion < 0x1000)
+            break;
+
+        case REQUEST_BODY_PIPELINE::ACTION_WRITE:
+            if (m_BytesToReceive == INFINITE)
             {
-                cbOffset = 1;
-                m_pEntityBuffer[1] = HEX_TO_ASCII(cbCompletion >> 8);
-                m_pEntityBuffer[2] = HEX_TO_ASCII((cbCompletion >> 4) & 0xf);
-                m_pEntityBuffer[3] = HEX_TO_ASCII(cbCompletion & 0xf);
-                cbCompletion += 7;
+                //
+                // For chunk-encoded requests, need to re-chunk the entity body.
+                // The size line goes out ahead of the data as its own write.
+                //
+                m_cWriteSegments = m_ChunkEncoder.EncodeChunk(m_pRequestEntityBuffers[iBuffer],
+                    cbData,
+                    m_rgWriteSegments);
             }
             else
             {
-                DBG_ASSERT(cbCompletion < 0x10000);
-
-                cbOffset = 0;
-                m_pEntityBuffer[0] = HEX_TO_ASCII(cbCompletion >> 12);
-                m_pEntityBuffer[1] = HEX_TO_ASCII((cbCompletion >> 8) & 0xf);
-                m_pEntityBuffer[2] = HEX_TO_ASCII((cbCompletion >> 4) & 0xf);
-                m_pEntityBuffer[3] = HEX_TO_ASCII(cbCompletion & 0xf);
-                cbCompletion += 8;
+                m_rgWriteSegments[0].pbData = m_pRequestEntityBuffers[iBuffer];
+                m_rgWriteSegments[0].cbData = cbData;
+                m_cWriteSegments = 1;
             }
-        }
-        m_cchLastSend = cbCompletion;
+            m_iWriteSegment = 0;
 
-        RETURN_LAST_ERROR_IF(!WinHttpWriteData(m_hRequest,
-            m_pEntityBuffer + cbOffset,
-            cbCompletion,
-            nullptr));
-    }
-    else
-    {
-        *pfClientError = TRUE;
-        RETURN_HR(hrCompletionStatus);
+            RETURN_IF_FAILED(WriteRequestEntitySegment());
+            break;
+
+        case REQUEST_BODY_PIPELINE::ACTION_WRITE_LAST_CHUNK:
+            m_rgWriteSegments[0] = m_ChunkEncoder.EncodeLastChunk();
+            m_cWriteSegments = 1;
+            m_iWriteSegment = 0;
+
+            RETURN_IF_FAILED(WriteRequestEntitySegment());
+            break;
+
+        case REQUEST_BODY_PIPELINE::ACTION_SEND_COMPLETE:
+            MarkPhase(REQUEST_PHASE_SEND_BODY);
+            m_RequestStatus = FORWARDER_RECEIVING_RESPONSE;
+
+            RETURN_LAST_ERROR_IF(!WinHttpReceiveResponse(m_hRequest, nullptr));
+            return S_OK;
+
+        default:
+            //
+            // Wait for the outstanding read or write.
+            //
+            return S_OK;
+        }
     }
+}
+
+HRESULT
+FORWARDING_HANDLER::WriteRequestEntitySegment()
+{
+    //
+    // Advance first, the completion may be delivered on this stack.
+    //
+    const CHUNK_ENCODER::SEGMENT& segment = m_rgWriteSegments[m_iWriteSegment++];
+
+    m_cchLastSend = segment.cbData;
+
+    RETURN_LAST_ERROR_IF(!WinHttpWriteData(m_hRequest,
+        segment.pbData,
+        segment.cbData,
+        nullptr));
 
     return S_OK;
 }
@@ -1949,6 +2150,10 @@ FORWARDING_HANDLER::OnReceivingResponse(
 {
     if (m_cBytesBuffered >= m_cMinBufferLimit)
     {
+        //
+        // IIS has completed the flush of everything buffered so far,
+        // return the buffers to the pool right away.
+        //
         FreeResponseBuffers();
     }
 
@@ -1959,8 +2164,8 @@ FORWARDING_HANDLER::OnReceivingResponse(
         // at a time - also treat very small buffering limit as no
         // buffering
         //
-        m_BytesToSend = min(m_cMinBufferLimit, BUFFER_SIZE);
-        if (m_BytesToSend < BUFFER_SIZE / 2)
+        m_BytesToSend = min(m_cMinBufferLimit, static_cast<DWORD>(m_ReadSizeController.QueryReadSize()));
+        if (m_cMinBufferLimit < BUFFER_SIZE / 2)
         {
             //
             // Disable buffering.
@@ -1979,26 +2184,439 @@ FORWARDING_HANDLER::OnReceivingResponse(
     else
     {
         //
-        // Buffering enabled.
+        // Buffering enabled. The previous buffer, if any, has been handed to
+        // IIS by reference, always read into a new one.
         //
+        const DWORD cbRead = min(m_BytesToSend, static_cast<DWORD>(m_ReadSizeController.QueryReadSize()));
+
+        m_pEntityBuffer = GetNewResponseBuffer(cbRead);
         if (m_pEntityBuffer == nullptr)
         {
-            m_pEntityBuffer = GetNewResponseBuffer(min(m_BytesToSend, BUFFER_SIZE));
-            if (m_pEntityBuffer == nullptr)
-            {
-                RETURN_HR(E_OUTOFMEMORY);
-            }
+            RETURN_HR(E_OUTOFMEMORY);
         }
 
         RETURN_LAST_ERROR_IF(!WinHttpReadData(m_hRequest,
             m_pEntityBuffer,
-            min(m_BytesToSend, BUFFER_SIZE),
+            cbRead,
             nullptr));
     }
 
     return S_OK;
 }
 
+//
+// Looks the request up in the response cache. On a miss a GET request
+// captures the response for the cache.
+//
+VOID
+FORWARDING_HANDLER::LookupCachedResponse()
+{
+    RESPONSE_CACHE *pCache = m_pApplication->QueryResponseCache();
+    IHttpRequest   *pRequest = m_pW3Context->GetRequest();
+    const HTTP_VERB verb = pRequest->GetRawHttpRequest()->Verb;
+
+    //
+    // Responses to authenticated requests, requests with a body or
+    // upgrades are never shared.
+    //
+    if (!pCache->IsEnabled() ||
+        (verb != HttpVerbGET && verb != HttpVerbHEAD) ||
+        pRequest->GetHeader(HttpHeaderAuthorization) != nullptr ||
+        pRequest->GetHeader(HttpHeaderContentLength) != nullptr ||
+        pRequest->GetHeader(HttpHeaderTransferEncoding) != nullptr ||
+        pRequest->GetHeader(HttpHeaderUpgrade) != nullptr ||
+        m_pApplication->QueryConfig()->QueryForwardWindowsAuthToken())
+    {
+        return;
+    }
+
+    try
+    {
+        m_pCachedResponse = pCache->Lookup(GetResponseCacheUrl(), GetRequestHeaderReader(), GetTickCount64());
+        m_fCaptureResponse = m_pCachedResponse == nullptr && verb == HttpVerbGET;
+    }
+    catch (...)
+    {
+        OBSERVE_CAUGHT_EXCEPTION();
+    }
+}
+
+HRESULT
+FORWARDING_HANDLER::SendCachedResponse()
+{
+    IHttpResponse  *pResponse = m_pW3Context->GetResponse();
+    STACK_STRA(strHeaders, 2048);
+
+    //
+    // SetStatusAndHeaders terminates the header lines in place, the cached
+    // block is shared with other requests.
+    //
+    RETURN_IF_FAILED(strHeaders.Copy(m_pCachedResponse->strHeaders.data(),
+        m_pCachedResponse->strHeaders.size()));
+    RETURN_IF_FAILED(SetStatusAndHeaders(strHeaders.QueryStr(), strHeaders.QueryCCH()));
+
+    //
+    // Tell the client how stale the response is, it counts from when the
+    // backend produced it and replaces the Age the backend sent.
+    //
+    try
+    {
+        const std::string strAge = std::to_string(RESPONSE_CACHE::QueryAgeSeconds(*m_pCachedResponse, GetTickCount64()));
+        RETURN_IF_FAILED(pResponse->SetHeader(HttpHeaderAge,
+            strAge.c_str(),
+            static_cast<USHORT>(strAge.size()),
+            TRUE));
+    }
+    CATCH_RETURN();
+
+    if (m_pW3Context->GetRequest()->GetRawHttpRequest()->Verb != HttpVerbHEAD &&
+        !m_pCachedResponse->strEntity.empty())
+    {
+        //
+        // m_pCachedResponse keeps the entity alive until the handler goes
+        // away, even if it is evicted meanwhile.
+        //
+        HTTP_DATA_CHUNK Chunk;
+        Chunk.DataChunkType = HttpDataChunkFromMemory;
+        Chunk.FromMemory.pBuffer = const_cast<char *>(m_pCachedResponse->strEntity.data());
+        Chunk.FromMemory.BufferLength = static_cast<ULONG>(m_pCachedResponse->strEntity.size());
+        RETURN_IF_FAILED(pResponse->WriteEntityChunkByReference(&Chunk));
+    }
+
+    return S_OK;
+}
+
+VOID
+FORWARDING_HANDLER::StartResponseCapture(
+    std::string_view            headers
+)
+{
+    uint32_t dwMaxAgeSeconds = 0;
+    std::vector<std::string> rgVaryHeaders;
+
+    m_fCaptureResponse = FALSE;
+
+    try
+    {
+        if (RESPONSE_CACHE::TryGetResponsePolicy(headers, &dwMaxAgeSeconds, &rgVaryHeaders))
+        {
+            m_pResponseCapture = std::make_unique<CACHED_RESPONSE>();
+            m_pResponseCapture->strHeaders.assign(headers);
+        }
+    }
+    catch (...)
+    {
+        OBSERVE_CAUGHT_EXCEPTION();
+        m_pResponseCapture.reset();
+    }
+
+    if (m_pResponseCapture == nullptr)
+    {
+        //
+        // Nothing will be cached, let the collapsed requests go to the
+        // backend on their own.
+        //
+        ReleaseCollapsedRequest();
+    }
+}
+
+VOID
+FORWARDING_HANDLER::AppendResponseCapture(
+    _In_reads_bytes_(cbData) const BYTE *   pbData,
+    DWORD                                   cbData
+)
+{
+    if (m_pResponseCapture->strEntity.size() + cbData > m_pApplication->QueryResponseCache()->QueryMaxEntitySize())
+    {
+        m_pResponseCapture.reset();
+        ReleaseCollapsedRequest();
+        return;
+    }
+
+    try
+    {
+        m_pResponseCapture->strEntity.append(reinterpret_cast<const char *>(pbData), cbData);
+    }
+    catch (...)
+    {
+        OBSERVE_CAUGHT_EXCEPTION();
+        m_pResponseCapture.reset();
+        ReleaseCollapsedRequest();
+    }
+}
+
+//
+// Called once the whole response was received from the backend.
+//
+VOID
+FORWARDING_HANDLER::CompleteResponseCapture()
+{
+    if (m_pResponseCapture != nullptr)
+    {
+        try
+        {
+            m_pApplication->QueryResponseCache()->Insert(GetResponseCacheUrl(),
+                GetRequestHeaderReader(),
+                std::move(m_pResponseCapture),
+                GetTickCount64());
+        }
+        catch (...)
+        {
+            OBSERVE_CAUGHT_EXCEPTION();
+        }
+
+        m_pResponseCapture.reset();
+    }
+
+    //
+    // The collapsed requests find the response in the cache.
+    //
+    ReleaseCollapsedRequest();
+}
+
+//
+// Returns TRUE if the request goes to the backend, FALSE if it waits for
+// an identical request already on its way there.
+//
+BOOL
+FORWARDING_HANDLER::JoinCollapsedRequest()
+{
+    try
+    {
+        std::string strKey = GetResponseCacheUrl();
+        if (!m_pApplication->QueryCollapsedRequests()->Join(strKey, this, GetTickCount64()))
+        {
+            return FALSE;
+        }
+
+        m_strCollapsedKey = std::move(strKey);
+    }
+    catch (...)
+    {
+        OBSERVE_CAUGHT_EXCEPTION();
+    }
+
+    return TRUE;
+}
+
+VOID
+FORWARDING_HANDLER::ReleaseCollapsedRequest()
+{
+    if (!m_strCollapsedKey.empty())
+    {
+        m_pApplication->QueryCollapsedRequests()->Release(m_strCollapsedKey);
+        m_strCollapsedKey.clear();
+    }
+}
+
+//
+// Sends the file the backend named with X-Sendfile as the response entity,
+// honoring a single byte Range of the client request.
+//
+HRESULT
+FORWARDING_HANDLER::SendFileResponse()
+{
+    IHttpRequest   *pRequest = m_pW3Context->GetRequest();
+    IHttpResponse  *pResponse = m_pW3Context->GetResponse();
+    const STRU     *pstruRoot = m_pApplication->QuerySendFileRoot();
+    const HTTP_VERB verb = pRequest->GetRawHttpRequest()->Verb;
+    std::string     strRelativePath;
+    std::string     strValue;
+    STRU            struPath;
+    STRU            struFinalPath;
+    LARGE_INTEGER   liFileSize = {};
+    uint64_t        ullOffset = 0;
+    uint64_t        cbLength = 0;
+
+    try
+    {
+        if (!SEND_FILE::TryNormalizeRelativePath(m_strSendFilePath, &strRelativePath))
+        {
+            LOG_WARNF(L"Rejected X-Sendfile path '%S'", m_strSendFilePath.c_str());
+            RETURN_HR(HRESULT_FROM_WIN32(ERROR_INVALID_NAME));
+        }
+    }
+    CATCH_RETURN();
+
+    RETURN_IF_FAILED(struPath.Copy(*pstruRoot));
+    RETURN_IF_FAILED(struPath.Append(L"\\"));
+    RETURN_IF_FAILED(struPath.AppendA(strRelativePath.c_str(), strRelativePath.size()));
+
+    m_hSendFile = CreateFile(struPath.QueryStr(),
+        GENERIC_READ,
+        FILE_SHARE_READ | FILE_SHARE_DELETE,
+        nullptr,
+        OPEN_EXISTING,
+        FILE_FLAG_OVERLAPPED | FILE_FLAG_SEQUENTIAL_SCAN,
+        nullptr);
+
+    if (m_hSendFile == INVALID_HANDLE_VALUE)
+    {
+        const DWORD dwError = GetLastError();
+        if (dwError != ERROR_FILE_NOT_FOUND && dwError != ERROR_PATH_NOT_FOUND)
+        {
+            RETURN_HR(HRESULT_FROM_WIN32(dwError));
+        }
+
+        RETURN_IF_FAILED(pResponse->SetStatus(404, "Not Found"));
+        return pResponse->SetHeader(HttpHeaderContentLength, "0", 1, TRUE);
+    }
+
+    //
+    // Links and junctions below the root may point anywhere, check where
+    // the file actually is.
+    //
+    RETURN_IF_FAILED(FILE_UTILITY::GetFinalPath(m_hSendFile, &struFinalPath));
+    if (!SEND_FILE::IsPathUnderRoot(std::wstring_view(pstruRoot->QueryStr(), pstruRoot->QueryCCH()),
+            std::wstring_view(struFinalPath.QueryStr(), struFinalPath.QueryCCH())))
+    {
+        LOG_WARNF(L"Rejected X-Sendfile path '%ls' outside of the root", struFinalPath.QueryStr());
+        RETURN_HR(HRESULT_FROM_WIN32(ERROR_ACCESS_DENIED));
+    }
+
+    RETURN_LAST_ERROR_IF(!GetFileSizeEx(m_hSendFile, &liFileSize));
+
+    const uint64_t cbFile = static_cast<uint64_t>(liFileSize.QuadPart);
+    SEND_FILE::RANGE_RESULT range = SEND_FILE::RANGE_NONE;
+    PCSTR pszRange = pRequest->GetHeader(HttpHeaderRange);
+
+    //
+    // If-Range would need the validators of the file, send it whole.
+    //
+    if ((verb == HttpVerbGET || verb == HttpVerbHEAD) &&
+        pszRange != nullptr &&
+        pRequest->GetHeader(HttpHeaderIfRange) == nullptr)
+    {
+        range = SEND_FILE::ParseRange(pszRange, cbFile, &ullOffset, &cbLength);
+    }
+
+    try
+    {
+        switch (range)
+        {
+        case SEND_FILE::RANGE_NOT_SATISFIABLE:
+            strValue = SEND_FILE::FormatUnsatisfiedContentRange(cbFile);
+            RETURN_IF_FAILED(pResponse->SetStatus(416, "Range Not Satisfiable"));
+            RETURN_IF_FAILED(pResponse->SetHeader(HttpHeaderContentRange,
+                strValue.c_str(),
+                static_cast<USHORT>(strValue.size()),
+                TRUE));
+            return pResponse->SetHeader(HttpHeaderContentLength, "0", 1, TRUE);
+
+        case SEND_FILE::RANGE_SATISFIABLE:
+            strValue = SEND_FILE::FormatContentRange(ullOffset, cbLength, cbFile);
+            RETURN_IF_FAILED(pResponse->SetStatus(206, "Partial Content"));
+            RETURN_IF_FAILED(pResponse->SetHeader(HttpHeaderContentRange,
+                strValue.c_str(),
+                static_cast<USHORT>(strValue.size()),
+                TRUE));
+            break;
+
+        default:
+            ullOffset = 0;
+            cbLength = cbFile;
+            break;
+        }
+
+        strValue = std::to_string(cbLength);
+    }
+    CATCH_RETURN();
+
+    RETURN_IF_FAILED(pResponse->SetHeader(HttpHeaderContentLength,
+        strValue.c_str(),
+        static_cast<USHORT>(strValue.size()),
+        TRUE));
+    RETURN_IF_FAILED(pResponse->SetHeader(HttpHeaderAcceptRanges, "bytes", 5, TRUE));
+
+    if (verb != HttpVerbHEAD && cbLength != 0)
+    {
+        //
+        // m_hSendFile stays open until the handler goes away, after the
+        // response is sent.
+        //
+        HTTP_DATA_CHUNK Chunk;
+        Chunk.DataChunkType = HttpDataChunkFromFileHandle;
+        Chunk.FromFileHandle.ByteRange.StartingOffset.QuadPart = ullOffset;
+        Chunk.FromFileHandle.ByteRange.Length.QuadPart = cbLength;
+        Chunk.FromFileHandle.FileHandle = m_hSendFile;
+        RETURN_IF_FAILED(pResponse->WriteEntityChunkByReference(&Chunk));
+    }
+
+    return S_OK;
+}
+
+VOID
+FORWARDING_HANDLER::MarkPhase(
+    REQUEST_PHASE               phase
+)
+{
+    LARGE_INTEGER liNow;
+    QueryPerformanceCounter(&liNow);
+    m_PhaseTimer.Mark(phase, liNow.QuadPart);
+}
+
+//
+// Called once a forwarded request completed without error.
+//
+VOID
+FORWARDING_HANDLER::RecordPhaseTiming()
+{
+    m_pApplication->QueryPhaseStatistics()->Record(m_PhaseTimer, sm_liPerfFrequency.QuadPart);
+
+    if (ANCMEvents::ANCM_REQUEST_FORWARD_PHASES::IsEnabled(m_pW3Context->GetTraceContext()))
+    {
+        ULONG rgulDurations[REQUEST_PHASE_COUNT] = {};
+        for (uint32_t iPhase = 0; iPhase < REQUEST_PHASE_COUNT; iPhase++)
+        {
+            uint64_t ullMicroseconds = 0;
+            if (m_PhaseTimer.TryGetDuration(static_cast<REQUEST_PHASE>(iPhase), sm_liPerfFrequency.QuadPart, &ullMicroseconds))
+            {
+                rgulDurations[iPhase] = ullMicroseconds < ULONG_MAX ? static_cast<ULONG>(ullMicroseconds) : ULONG_MAX;
+            }
+        }
+
+        ANCMEvents::ANCM_REQUEST_FORWARD_PHASES::RaiseEvent(
+            m_pW3Context->GetTraceContext(),
+            nullptr,
+            rgulDurations[REQUEST_PHASE_PROCESS_ACQUIRE],
+            rgulDurations[REQUEST_PHASE_CONNECT],
+            rgulDurations[REQUEST_PHASE_SEND_HEADERS],
+            rgulDurations[REQUEST_PHASE_SEND_BODY],
+            rgulDurations[REQUEST_PHASE_FIRST_BYTE],
+            rgulDurations[REQUEST_PHASE_HEADERS_SET],
+            rgulDurations[REQUEST_PHASE_LAST_BYTE],
+            rgulDurations[REQUEST_PHASE_CLIENT_FLUSH]);
+    }
+}
+
+std::string
+FORWARDING_HANDLER::GetResponseCacheUrl()
+{
+    const HTTP_REQUEST *pRawRequest = m_pW3Context->GetRequest()->GetRawHttpRequest();
+    std::string strUrl(pRawRequest->pSslInfo != nullptr ? "https://" : "http://");
+
+    if (m_pszOriginalHostHeader != nullptr)
+    {
+        strUrl.append(m_pszOriginalHostHeader);
+    }
+    strUrl.append(pRawRequest->pRawUrl, pRawRequest->RawUrlLength);
+
+    return strUrl;
+}
+
+RESPONSE_CACHE::REQUEST_HEADER_READER
+FORWARDING_HANDLER::GetRequestHeaderReader()
+{
+    IHttpRequest *pRequest = m_pW3Context->GetRequest();
+
+    return [pRequest](const std::string& strName)
+    {
+        USHORT cchValue = 0;
+        PCSTR pszValue = pRequest->GetHeader(strName.c_str(), &cchValue);
+        return pszValue == nullptr ? std::string_view() : std::string_view(pszValue, cchValue);
+    };
+}
+
 BYTE *
 FORWARDING_HANDLER::GetNewResponseBuffer(
     DWORD   dwBufferSize
@@ -2012,9 +2630,7 @@ FORWARDING_HANDLER::GetNewResponseBuffer(
         return nullptr;
     }
 
-    BYTE *pBuffer = (BYTE *)HeapAlloc(GetProcessHeap(),
-        0, // dwFlags
-        dwBufferSize);
+    BYTE *pBuffer = ENTITY_BUFFER_POOL::Alloc(dwBufferSize);
     if (pBuffer == nullptr)
     {
         return nullptr;
@@ -2032,45 +2648,39 @@ FORWARDING_HANDLER::FreeResponseBuffers()
     BYTE **pBuffers = m_buffEntityBuffers.QueryPtr();
     for (DWORD i = 0; i<m_cEntityBuffers; i++)
     {
-        HeapFree(GetProcessHeap(),
-            0, // dwFlags
-            pBuffers[i]);
+        ENTITY_BUFFER_POOL::Free(pBuffers[i]);
     }
     m_cEntityBuffers = 0;
     m_pEntityBuffer = nullptr;
+    ZeroMemory(m_pRequestEntityBuffers, sizeof(m_pRequestEntityBuffers));
     m_cBytesBuffered = 0;
 }
 
 HRESULT
 FORWARDING_HANDLER::SetStatusAndHeaders(
-    PCSTR           pszHeaders,
-    DWORD
+    PSTR            pszHeaders,
+    DWORD           cchHeaders
 )
 {
     IHttpResponse * pResponse = m_pW3Context->GetResponse();
     IHttpRequest *  pRequest = m_pW3Context->GetRequest();
-    STACK_STRA(strHeaderName, 128);
-    STACK_STRA(strHeaderValue, 2048);
-    DWORD           index = 0;
-    PSTR            pchNewline = nullptr;
-    PCSTR           pchEndofHeaderValue = nullptr;
+    USHORT          uStatus = 0;
     BOOL            fServerHeaderPresent = FALSE;
+    std::string_view reason;
+    std::string_view name;
+    std::string_view value;
 
     _ASSERT(pszHeaders != nullptr);
 
+    HEADER_TOKENIZER tokenizer(std::string_view(pszHeaders, cchHeaders));
+
     //
     // The first line is the status line
     //
-    PSTR pchStatus = const_cast<PSTR>(strchr(pszHeaders, ' '));
-    if (pchStatus == nullptr)
+    if (!tokenizer.ParseStatusLine(uStatus, reason))
     {
         return HRESULT_FROM_WIN32(ERROR_INVALID_PARAMETER);
     }
-    while (*pchStatus == ' ')
-    {
-        pchStatus++;
-    }
-    USHORT uStatus = static_cast<USHORT>(atoi(pchStatus));
 
     if (m_fWebSocketEnabled && uStatus != 101)
     {
@@ -2081,154 +2691,56 @@ FORWARDING_HANDLER::SetStatusAndHeaders(
         m_fWebSocketEnabled = FALSE;
     }
 
-    pchStatus = strchr(pchStatus, ' ');
-    if (pchStatus == nullptr)
-    {
-        return HRESULT_FROM_WIN32(ERROR_INVALID_PARAMETER);
-    }
-    while (*pchStatus == ' ')
-    {
-        pchStatus++;
-    }
-    if (*pchStatus == '\r' || *pchStatus == '\n')
-    {
-        pchStatus--;
-    }
-
-    pchNewline = strchr(pchStatus, '\n');
-    if (pchNewline == nullptr)
-    {
-        return HRESULT_FROM_WIN32(ERROR_INVALID_PARAMETER);
-    }
-
     if (uStatus != 200)
     {
         //
-        // Skip over any spaces before the '\n'
+        // The tokenizer has moved past the status line, terminate the
+        // status description in place.
         //
-        for (pchEndofHeaderValue = pchNewline - 1;
-            (pchEndofHeaderValue > pchStatus) &&
-            ((*pchEndofHeaderValue == ' ') ||
-            (*pchEndofHeaderValue == '\r'));
-            pchEndofHeaderValue--)
-        {
-        }
+        PSTR pszReason = const_cast<PSTR>(reason.data());
+        pszReason[reason.size()] = '\0';
 
-        //
-        // Copy the status description
-        //
-        RETURN_IF_FAILED(strHeaderValue.Copy(
-            pchStatus,
-            (DWORD)(pchEndofHeaderValue - pchStatus) + 1));
         RETURN_IF_FAILED(pResponse->SetStatus(uStatus,
-                strHeaderValue.QueryStr(),
+                pszReason,
                 0,
                 S_OK,
                 nullptr,
                 TRUE));
     }
 
-    for (index = static_cast<DWORD>(pchNewline - pszHeaders) + 1;
-        pszHeaders[index] != '\r' && pszHeaders[index] != '\n' && pszHeaders[index] != '\0';
-        index = static_cast<DWORD>(pchNewline - pszHeaders) + 1)
+    while (tokenizer.Next(name, value))
     {
         //
-        // Find the ':' in Header : Value\r\n
-        //
-        PCSTR pchColon = strchr(pszHeaders + index, ':');
-
-        //
-        // Find the '\n' in Header : Value\r\n
-        //
-        pchNewline = const_cast<PSTR>(strchr(pszHeaders + index, '\n'));
-
-        if (pchNewline == nullptr)
-        {
-            return HRESULT_FROM_WIN32(ERROR_INVALID_PARAMETER);
-        }
-
-        //
-        // Take care of header continuation
-        //
-        while (pchNewline[1] == ' ' ||
-            pchNewline[1] == '\t')
-        {
-            pchNewline = strchr(pchNewline + 1, '\n');
-        }
-
-        DBG_ASSERT(
-            (pchColon != nullptr) && (pchColon < pchNewline));
-        if ((pchColon == nullptr) || (pchColon >= pchNewline))
-        {
-            return HRESULT_FROM_WIN32(ERROR_INVALID_PARAMETER);
-        }
-
-        //
-        // Skip over any spaces before the ':'
-        //
-        PCSTR pchEndofHeaderName;
-        for (pchEndofHeaderName = pchColon - 1;
-            (pchEndofHeaderName >= pszHeaders + index) &&
-            (*pchEndofHeaderName == ' ');
-            pchEndofHeaderName--)
-        {
-        }
-
-        pchEndofHeaderName++;
-
-        //
-        // Copy the header name
-        //
-        RETURN_IF_FAILED(strHeaderName.Copy(
-            pszHeaders + index,
-            (DWORD)(pchEndofHeaderName - pszHeaders) - index));
-
-        //
-        // Skip over the ':' and any trailing spaces
-        //
-        for (index = static_cast<DWORD>(pchColon - pszHeaders) + 1;
-            pszHeaders[index] == ' ';
-            index++)
-        {
-        }
-
+        // Both spans end before the '\n' of the header line the tokenizer
+        // has already moved past, terminate them in place.
         //
-        // Skip over any spaces before the '\n'
-        //
-        for (pchEndofHeaderValue = pchNewline - 1;
-            (pchEndofHeaderValue >= pszHeaders + index) &&
-            ((*pchEndofHeaderValue == ' ') ||
-            (*pchEndofHeaderValue == '\r'));
-            pchEndofHeaderValue--)
-        {
-        }
-
-        pchEndofHeaderValue++;
-
-        //
-        // Copy the header value
-        //
-        if (pchEndofHeaderValue == pszHeaders + index)
-        {
-            strHeaderValue.Reset();
-        }
-        else
-        {
-            RETURN_IF_FAILED(strHeaderValue.Copy(
-                pszHeaders + index,
-                (DWORD)(pchEndofHeaderValue - pszHeaders) - index));
-        }
+        PSTR pszHeaderName = const_cast<PSTR>(name.data());
+        PSTR pszHeaderValue = const_cast<PSTR>(value.data());
+        pszHeaderName[name.size()] = '\0';
+        pszHeaderValue[value.size()] = '\0';
 
         //
         // Do not pass the transfer-encoding:chunked, Connection, Date or
         // Server headers along
         //
-        DWORD headerIndex = sm_pResponseHeaderHash->GetIndex(strHeaderName.QueryStr());
+        DWORD headerIndex = g_KnownResponseHeaders.GetIndex(name);
         if (headerIndex == UNKNOWN_INDEX)
         {
-            RETURN_IF_FAILED(pResponse->SetHeader(strHeaderName.QueryStr(),
-                strHeaderValue.QueryStr(),
-                static_cast<USHORT>(strHeaderValue.QueryCCH()),
+            if (uStatus == 200 &&
+                _stricmp(pszHeaderName, SEND_FILE::HEADER_NAME) == 0 &&
+                !m_pApplication->QuerySendFileRoot()->IsEmpty())
+            {
+                try
+                {
+                    m_strSendFilePath.assign(value);
+                }
+                CATCH_RETURN();
+                continue;
+            }
+
+            RETURN_IF_FAILED(pResponse->SetHeader(pszHeaderName,
+                pszHeaderValue,
+                static_cast<USHORT>(value.size()),
                 FALSE)); // fReplace
         }
         else
@@ -2247,7 +2759,7 @@ FORWARDING_HANDLER::SetStatusAndHeaders(
                 // and WinHTTP applies no other transfer-coding decoding. IIS
                 // re-applies chunked framing toward the client as needed.
                 //
-                if (!isChunkedTransferEncoding(strHeaderValue.QueryStr()))
+                if (!isChunkedTransferEncoding(value))
                 {
                     break;
                 }
@@ -2267,18 +2779,23 @@ FORWARDING_HANDLER::SetStatusAndHeaders(
             case HttpHeaderContentLength:
                 if (pRequest->GetRawHttpRequest()->Verb != HttpVerbHEAD)
                 {
-                    m_cContentLength = _atoi64(strHeaderValue.QueryStr());
+                    m_cContentLength = _atoi64(pszHeaderValue);
                 }
                 break;
             }
 
             RETURN_IF_FAILED(pResponse->SetHeader(static_cast<HTTP_HEADER_ID>(headerIndex),
-                strHeaderValue.QueryStr(),
-                static_cast<USHORT>(strHeaderValue.QueryCCH()),
+                pszHeaderValue,
+                static_cast<USHORT>(value.size()),
                 TRUE)); // fReplace
         }
     }
 
+    if (tokenizer.HasError())
+    {
+        return HRESULT_FROM_WIN32(ERROR_INVALID_PARAMETER);
+    }
+
     //
     // Explicitly remove the Server header if the back-end didn't set one.
     //
@@ -2463,9 +2980,34 @@ FORWARDING_HANDLER::RemoveRequest(
     m_fReactToDisconnect = FALSE;
 }
 
+VOID
+FORWARDING_HANDLER::ReleaseServerProcess(
+    VOID
+)
+{
+    if (m_pServerProcess != nullptr)
+    {
+        m_pServerProcess->QueryLoad()->OnRequestEnd();
+        m_pServerProcess->DereferenceServerProcess();
+        m_pServerProcess = nullptr;
+    }
+}
+
 VOID
 FORWARDING_HANDLER::NotifyDisconnect()
 {
+    if (m_RequestStatus == FORWARDER_WAITING_FOR_PROCESS &&
+        m_pApplication->RemoveProcessWaiter(this))
+    {
+        //
+        // The client left while the request waited in the startup queue.
+        // Free its place and finish the request the way OnAdmissionComplete
+        // would have.
+        //
+        OnAdmissionComplete(HRESULT_FROM_WIN32(WSAECONNRESET));
+        return;
+    }
+
     if (!m_fReactToDisconnect)
     {
         return;
@@ -2499,6 +3041,38 @@ FORWARDING_HANDLER::NotifyDisconnect()
     }
 }
 
+void
+FORWARDING_HANDLER::OnAdmissionComplete(
+    HRESULT     hr
+) noexcept
+{
+    //
+    // Resume the request on an IIS thread, AsyncCompletion sees
+    // FORWARDER_WAITING_FOR_PROCESS and runs ExecuteRequestHandler again.
+    //
+    m_hrAdmission = hr;
+    m_pW3Context->PostCompletion(0);
+
+    //
+    // Release the reference taken when the request was queued.
+    //
+    DereferenceRequestHandler();
+}
+
+void
+FORWARDING_HANDLER::OnCollapsedRequestComplete() noexcept
+{
+    //
+    // Resume the request on an IIS thread, it looks up the cache again and
+    // goes to the backend itself if the leader's response was not cached,
+    // or not yet when the follower waited too long.
+    //
+    m_fCollapsedFollower = TRUE;
+    m_pW3Context->PostCompletion(0);
+
+    DereferenceRequestHandler();
+}
+
 _Acquires_exclusive_lock_(this->m_RequestLock)
 VOID
 FORWARDING_HANDLER::AcquireLockExclusive()
@@ -10,6 +10,8 @@ class OUT_OF_PROCESS_APPLICATION;
 enum FORWARDING_REQUEST_STATUS
 {
     FORWARDER_START,
+    FORWARDER_WAITING_FOR_PROCESS,
+    FORWARDER_WAITING_FOR_LEADER,
     FORWARDER_SENDING_REQUEST,
     FORWARDER_RECEIVING_RESPONSE,
     FORWARDER_RECEIVED_WEBSOCKET_RESPONSE,
@@ -18,7 +20,7 @@ enum FORWARDING_REQUEST_STATUS
 };
 
 
-class FORWARDING_HANDLER : public REQUEST_HANDLER
+class FORWARDING_HANDLER : public REQUEST_HANDLER, public ADMISSION_WAITER, public COLLAPSED_REQUEST_WAITER
 {
 public:
     FORWARDING_HANDLER(
@@ -71,6 +73,16 @@ public:
     VOID
     NotifyDisconnect() override;
 
+    __override
+    void
+    OnAdmissionComplete(
+        HRESULT     hr
+    ) noexcept override;
+
+    __override
+    void
+    OnCollapsedRequestComplete() noexcept override;
+
     static void * operator new(size_t size);
 
     static void operator delete(void * pMemory);
@@ -137,9 +149,60 @@ private:
         _Out_ BOOL *                pfClientError
     );
 
+    HRESULT
+    PumpRequestEntity(
+        _Out_ BOOL *                pfClientError
+    );
+
+    HRESULT
+    WriteRequestEntitySegment();
+
     HRESULT
     OnReceivingResponse();
 
+    VOID
+    LookupCachedResponse();
+
+    HRESULT
+    SendCachedResponse();
+
+    VOID
+    StartResponseCapture(
+        std::string_view            headers
+    );
+
+    VOID
+    AppendResponseCapture(
+        _In_reads_bytes_(cbData) const BYTE *   pbData,
+        DWORD                                   cbData
+    );
+
+    VOID
+    CompleteResponseCapture();
+
+    BOOL
+    JoinCollapsedRequest();
+
+    VOID
+    ReleaseCollapsedRequest();
+
+    std::string
+    GetResponseCacheUrl();
+
+    RESPONSE_CACHE::REQUEST_HEADER_READER
+    GetRequestHeaderReader();
+
+    HRESULT
+    SendFileResponse();
+
+    VOID
+    MarkPhase(
+        REQUEST_PHASE               phase
+    );
+
+    VOID
+    RecordPhaseTiming();
+
     BYTE *
     GetNewResponseBuffer(
         DWORD   dwBufferSize
@@ -150,7 +213,7 @@ private:
 
     HRESULT
     SetStatusAndHeaders(
-        PCSTR               pszHeaders,
+        PSTR                pszHeaders,
         DWORD               cchHeaders
     );
 
@@ -164,8 +227,8 @@ private:
         _In_ const PROTOCOL_CONFIG *    pProtocol,
         _In_    BOOL                    fForwardWindowsAuthToken,
         _In_    SERVER_PROCESS*         pServerProcess,
-        _Out_   PCWSTR *                ppszHeaders,
-        _Inout_ DWORD *                 pcchHeaders
+        _Out_   PWSTR *                 ppszHeaders,
+        _Out_   DWORD *                 pcchHeaders
     );
 
     VOID
@@ -173,6 +236,11 @@ private:
         VOID
     );
 
+    VOID
+    ReleaseServerProcess(
+        VOID
+    );
+
     DWORD                               m_Signature;
     //
     // WinHTTP request handle is protected using a read-write lock.
@@ -207,7 +275,18 @@ private:
     volatile  BOOL                      m_fWebSocketHandleInClose;
 
     PCSTR                               m_pszOriginalHostHeader;
-    PCWSTR                              m_pszHeaders;
+    PWSTR                               m_pszHeaders;
+    //
+    // Process the request is routed to, referenced until the request
+    // completes, and the time the request was sent to it.
+    //
+    SERVER_PROCESS *                    m_pServerProcess;
+    LONGLONG                            m_llSendRequestCounter;
+    //
+    // S_FALSE until the request has waited in the startup queue, then the
+    // result of the wait.
+    //
+    HRESULT                             m_hrAdmission;
     //
     // Record the number of winhttp handles in use
     // release IIS pipeline only after all handles got closed
@@ -221,15 +300,49 @@ private:
     DWORD                               m_cBytesBuffered;
     DWORD                               m_cMinBufferLimit;
     ULONGLONG                           m_cContentLength;
+    READ_SIZE_CONTROLLER                m_ReadSizeController;
+    REQUEST_BODY_PIPELINE               m_RequestBodyPipeline;
+    //
+    // Segments of the request entity write in progress, written one
+    // after the other as WinHTTP has no gather write.
+    //
+    CHUNK_ENCODER                       m_ChunkEncoder;
+    CHUNK_ENCODER::SEGMENT              m_rgWriteSegments[CHUNK_ENCODER::SEGMENTS_PER_CHUNK];
+    DWORD                               m_cWriteSegments;
+    DWORD                               m_iWriteSegment;
     WEBSOCKET_HANDLER *                 m_pWebSocket;
 
     BYTE *                              m_pEntityBuffer;
+    //
+    // Request entity is read into one buffer while the other is written.
+    //
+    BYTE *                              m_pRequestEntityBuffers[REQUEST_BODY_PIPELINE::BUFFER_COUNT];
     static const SIZE_T                 INLINE_ENTITY_BUFFERS = 8;
     BUFFER_T<BYTE*, INLINE_ENTITY_BUFFERS> m_buffEntityBuffers;
+    //
+    // Response served from the application's response cache, or a
+    // cacheable response copied while it is forwarded.
+    //
+    std::shared_ptr<const CACHED_RESPONSE>  m_pCachedResponse;
+    std::unique_ptr<CACHED_RESPONSE>        m_pResponseCapture;
+    BOOL                                    m_fCaptureResponse;
+    //
+    // Cache key this request fetches for the requests collapsed onto it,
+    // empty unless it leads them.
+    //
+    std::string                             m_strCollapsedKey;
+    BOOL                                    m_fCollapsedFollower;
+    //
+    // File the backend named with X-Sendfile, sent by the module in place
+    // of the backend body.
+    //
+    std::string                             m_strSendFilePath;
+    HANDLE                                  m_hSendFile;
+    REQUEST_PHASE_TIMER                     m_PhaseTimer;
 
     static ALLOC_CACHE_HANDLER *        sm_pAlloc;
     static PROTOCOL_CONFIG              sm_ProtocolConfig;
-    static RESPONSE_HEADER_HASH *       sm_pResponseHeaderHash;
+    static LARGE_INTEGER                sm_liPerfFrequency;
     //
     // Reference cout tracing for debugging purposes.
     //
@@ -9,6 +9,8 @@ OUT_OF_PROCESS_APPLICATION::OUT_OF_PROCESS_APPLICATION(
     IHttpApplication& pApplication,
     std::unique_ptr<REQUESTHANDLER_CONFIG> pConfig) :
     AppOfflineTrackingApplication(pApplication),
+    m_lAdmissionWorkerQueued(0),
+    m_lServerTimingCounter(0),
     m_fWebSocketSupported(WEBSOCKET_STATUS::WEBSOCKET_UNKNOWN),
     m_pConfig(std::move(pConfig))
 {
@@ -17,6 +19,37 @@ OUT_OF_PROCESS_APPLICATION::OUT_OF_PROCESS_APPLICATION(
 
 OUT_OF_PROCESS_APPLICATION::~OUT_OF_PROCESS_APPLICATION()
 {
+    m_AdmissionTimer.CancelTimer();
+    m_AdmissionQueue.Close(E_APPLICATION_EXITING);
+    m_CollapsedRequestTimer.CancelTimer();
+
+    if (m_ResponseCache.IsEnabled())
+    {
+        const RESPONSE_CACHE_STATISTICS statistics = m_ResponseCache.QueryStatistics();
+        LOG_INFOF(L"Response cache: %I64u hit(s), %I64u miss(es), %I64u insert(s), %I64u eviction(s), %I64u byte(s)",
+            statistics.cHits,
+            statistics.cMisses,
+            statistics.cInserts,
+            statistics.cEvictions,
+            statistics.cbSize);
+    }
+
+    for (uint32_t iPhase = 0; iPhase < REQUEST_PHASE_COUNT; iPhase++)
+    {
+        const REQUEST_PHASE_SUMMARY summary = m_PhaseStatistics.QuerySummary(static_cast<REQUEST_PHASE>(iPhase));
+        if (summary.cSamples != 0)
+        {
+            LOG_INFOF(L"Phase %S: %I64u request(s), mean %I64u us, p50 %I64u us, p90 %I64u us, p99 %I64u us, max %I64u us",
+                REQUEST_PHASE_TIMER::GetPhaseName(static_cast<REQUEST_PHASE>(iPhase)),
+                summary.cSamples,
+                summary.ullMeanUs,
+                summary.ullP50Us,
+                summary.ullP90Us,
+                summary.ullP99Us,
+                summary.ullMaxUs);
+        }
+    }
+
     SRWExclusiveLock lock(m_stopLock);
     if (m_pProcessManager != nullptr)
     {
@@ -33,11 +66,90 @@ OUT_OF_PROCESS_APPLICATION::Initialize(
     if (m_pProcessManager == nullptr)
     {
         m_pProcessManager = new PROCESS_MANAGER();
-        RETURN_IF_FAILED(m_pProcessManager->Initialize());
+        RETURN_IF_FAILED(m_pProcessManager->Initialize(this));
+    }
+
+    if (m_pConfig->QueryStartupQueueLength() != 0 && !m_AdmissionQueue.IsEnabled())
+    {
+        m_AdmissionQueue.Initialize(m_pConfig->QueryStartupQueueLength(),
+            m_pConfig->QueryStartupQueueTimeLimitInMS());
+        RETURN_IF_FAILED(m_AdmissionTimer.InitializeTimer(AdmissionTimerCallback,
+            this,
+            ADMISSION_TIMER_PERIOD_MS,
+            ADMISSION_TIMER_PERIOD_MS));
+    }
+
+    if (m_pConfig->QueryResponseCacheSize() != 0 && !m_ResponseCache.IsEnabled())
+    {
+        m_ResponseCache.Initialize(m_pConfig->QueryResponseCacheSize(),
+            min(m_pConfig->QueryResponseCacheSize() / 8, RESPONSE_CACHE_MAX_ENTITY_SIZE));
+
+        if (m_pConfig->QueryEnableRequestCollapsing())
+        {
+            //
+            // A follower of a slow leader goes to the backend itself.
+            //
+            m_CollapsedRequests.Initialize(COLLAPSED_REQUEST_TIMEOUT_MS);
+            RETURN_IF_FAILED(m_CollapsedRequestTimer.InitializeTimer(CollapsedRequestTimerCallback,
+                this,
+                ADMISSION_TIMER_PERIOD_MS,
+                ADMISSION_TIMER_PERIOD_MS));
+        }
+    }
+
+    if (!m_PhaseStatistics.IsEnabled())
+    {
+        try
+        {
+            m_PhaseStatistics.Initialize(GetActiveProcessorCount(ALL_PROCESSOR_GROUPS));
+        }
+        CATCH_RETURN();
+    }
+
+    if (!m_pConfig->QuerySendFileRoot()->IsEmpty() && m_struSendFileRoot.IsEmpty())
+    {
+        //
+        // X-Sendfile stays disabled if the root does not exist.
+        //
+        LOG_IF_FAILED(ResolveSendFileRoot());
     }
     return S_OK;
 }
 
+BOOL
+OUT_OF_PROCESS_APPLICATION::ShouldSendServerTiming()
+{
+    const DWORD dwSampleRate = m_pConfig->QueryServerTimingSampleRate();
+
+    return dwSampleRate != 0 &&
+        static_cast<DWORD>(InterlockedIncrement(&m_lServerTimingCounter)) % dwSampleRate == 0;
+}
+
+HRESULT
+OUT_OF_PROCESS_APPLICATION::ResolveSendFileRoot()
+{
+    STRU struFullPath;
+    STRU struFinalPath;
+
+    RETURN_IF_FAILED(FILE_UTILITY::ConvertPathToFullPath(m_pConfig->QuerySendFileRoot()->QueryStr(),
+        m_pConfig->QueryApplicationPhysicalPath()->QueryStr(),
+        &struFullPath));
+
+    HandleWrapper<InvalidHandleTraits> hRoot = CreateFile(struFullPath.QueryStr(),
+        FILE_READ_ATTRIBUTES,
+        FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+        nullptr,
+        OPEN_EXISTING,
+        FILE_FLAG_BACKUP_SEMANTICS,
+        nullptr);
+    RETURN_LAST_ERROR_IF(hRoot == INVALID_HANDLE_VALUE);
+
+    RETURN_IF_FAILED(FILE_UTILITY::GetFinalPath(hRoot, &struFinalPath));
+
+    LOG_INFOF(L"X-Sendfile root '%ls'", struFinalPath.QueryStr());
+    return m_struSendFileRoot.Copy(struFinalPath);
+}
+
 HRESULT
 OUT_OF_PROCESS_APPLICATION::GetProcess(
     _Out_   SERVER_PROCESS       **ppServerProcess
@@ -46,12 +158,133 @@ OUT_OF_PROCESS_APPLICATION::GetProcess(
     return m_pProcessManager->GetProcess(m_pConfig.get(), QueryWebsocketStatus(), ppServerProcess);
 }
 
+HRESULT
+OUT_OF_PROCESS_APPLICATION::GetProcess(
+    _In_opt_ ADMISSION_WAITER     *pWaiter,
+    _Out_    SERVER_PROCESS      **ppServerProcess
+)
+{
+    HRESULT hr = S_OK;
+
+    if (pWaiter == nullptr || !m_AdmissionQueue.IsEnabled())
+    {
+        return GetProcess(ppServerProcess);
+    }
+
+    RETURN_IF_FAILED(hr = m_pProcessManager->GetReadyProcess(m_pConfig.get(), QueryWebsocketStatus(), ppServerProcess));
+    if (hr == S_OK)
+    {
+        return S_OK;
+    }
+
+    if (!m_AdmissionQueue.Enqueue(pWaiter, GetTickCount64()))
+    {
+        return E_ADMISSION_QUEUE_FULL;
+    }
+
+    QueueAdmissionWorker();
+    return S_FALSE;
+}
+
+BOOL
+OUT_OF_PROCESS_APPLICATION::RemoveProcessWaiter(
+    _In_ ADMISSION_WAITER      *pWaiter
+)
+{
+    return m_AdmissionQueue.Remove(pWaiter);
+}
+
+VOID
+OUT_OF_PROCESS_APPLICATION::QueueAdmissionWorker()
+{
+    if (InterlockedCompareExchange(&m_lAdmissionWorkerQueued, 1L, 0L) != 0L)
+    {
+        //
+        // The running worker picks up the new waiter.
+        //
+        return;
+    }
+
+    ReferenceApplication();
+    if (!QueueUserWorkItem(AdmissionWorkerCallback, this, WT_EXECUTELONGFUNCTION))
+    {
+        const HRESULT hr = LOG_IF_FAILED(HRESULT_FROM_WIN32(GetLastError()));
+        InterlockedExchange(&m_lAdmissionWorkerQueued, 0L);
+        m_AdmissionQueue.CompleteAll(hr);
+        DereferenceApplication();
+    }
+}
+
+//
+// Starts a process on a thread pool thread and admits every waiter once it
+// is ready. Waiters that arrive while the process starts are admitted by
+// the same worker.
+//
+// static
+DWORD
+WINAPI
+OUT_OF_PROCESS_APPLICATION::AdmissionWorkerCallback(
+    LPVOID      lpParam
+)
+{
+    OUT_OF_PROCESS_APPLICATION *pApplication = static_cast<OUT_OF_PROCESS_APPLICATION*>(lpParam);
+
+    do
+    {
+        SERVER_PROCESS *pServerProcess = nullptr;
+        const HRESULT hr = pApplication->GetProcess(&pServerProcess);
+
+        if (pServerProcess != nullptr)
+        {
+            pServerProcess->DereferenceServerProcess();
+        }
+
+        pApplication->m_AdmissionQueue.CompleteAll(FAILED(hr) ? hr : S_OK);
+        InterlockedExchange(&pApplication->m_lAdmissionWorkerQueued, 0L);
+    }
+    while (pApplication->m_AdmissionQueue.QueryCount() != 0 &&
+           InterlockedCompareExchange(&pApplication->m_lAdmissionWorkerQueued, 1L, 0L) == 0L);
+
+    pApplication->DereferenceApplication();
+    return 0;
+}
+
+// static
+VOID
+CALLBACK
+OUT_OF_PROCESS_APPLICATION::AdmissionTimerCallback(
+    _In_ PTP_CALLBACK_INSTANCE,
+    _In_ PVOID                  Context,
+    _In_ PTP_TIMER
+)
+{
+    OUT_OF_PROCESS_APPLICATION *pApplication = static_cast<OUT_OF_PROCESS_APPLICATION*>(Context);
+    pApplication->m_AdmissionQueue.ExpireWaiters(GetTickCount64(), E_ADMISSION_QUEUE_TIMEOUT);
+}
+
+// static
+VOID
+CALLBACK
+OUT_OF_PROCESS_APPLICATION::CollapsedRequestTimerCallback(
+    _In_ PTP_CALLBACK_INSTANCE,
+    _In_ PVOID                  Context,
+    _In_ PTP_TIMER
+)
+{
+    OUT_OF_PROCESS_APPLICATION *pApplication = static_cast<OUT_OF_PROCESS_APPLICATION*>(Context);
+    pApplication->m_CollapsedRequests.ExpireFollowers(GetTickCount64());
+}
+
 __override
 VOID
 OUT_OF_PROCESS_APPLICATION::StopInternal(bool fServerInitiated)
 {
     AppOfflineTrackingApplication::StopInternal(fServerInitiated);
 
+    m_AdmissionTimer.CancelTimer();
+    m_AdmissionQueue.Close(E_APPLICATION_EXITING);
+    m_CollapsedRequestTimer.CancelTimer();
+
     if (m_pProcessManager != nullptr)
     {
         m_pProcessManager->Shutdown();
@@ -5,6 +5,12 @@
 
 #include "AppOfflineTrackingApplication.h"
 
+#define E_ADMISSION_QUEUE_FULL          HRESULT_FROM_WIN32(ERROR_BUSY)
+#define E_ADMISSION_QUEUE_TIMEOUT       HRESULT_FROM_WIN32(ERROR_SERVICE_REQUEST_TIMEOUT)
+#define ADMISSION_TIMER_PERIOD_MS       250
+#define RESPONSE_CACHE_MAX_ENTITY_SIZE  (1024ULL * 1024)
+#define COLLAPSED_REQUEST_TIMEOUT_MS    5000
+
 class OUT_OF_PROCESS_APPLICATION : public AppOfflineTrackingApplication
 {
     enum WEBSOCKET_STATUS
@@ -30,6 +36,28 @@ public:
         _Out_   SERVER_PROCESS       **ppServerProcess
     );
 
+    //
+    // Returns S_FALSE without a process if no process is ready and the
+    // waiter was queued, OnAdmissionComplete is called once a process is
+    // ready or the wait failed. Without a waiter, or when the startup
+    // queue is disabled, blocks like GetProcess.
+    //
+    HRESULT
+    GetProcess(
+        _In_opt_ ADMISSION_WAITER     *pWaiter,
+        _Out_    SERVER_PROCESS      **ppServerProcess
+    );
+
+    //
+    // Takes a waiter queued by GetProcess out of the startup queue. Returns
+    // FALSE if it was not queued, e.g. because it has already been
+    // completed, OnAdmissionComplete is not called once TRUE is returned.
+    //
+    BOOL
+    RemoveProcessWaiter(
+        _In_ ADMISSION_WAITER      *pWaiter
+    );
+
     __override
     VOID
     StopInternal(bool fServerInitiated)
@@ -51,13 +79,89 @@ public:
         return m_pConfig.get();
     }
 
+    RESPONSE_CACHE* QueryResponseCache()
+    {
+        return &m_ResponseCache;
+    }
+
+    COLLAPSED_REQUEST_REGISTRY* QueryCollapsedRequests()
+    {
+        return &m_CollapsedRequests;
+    }
+
+    //
+    // Final path of the X-Sendfile root, empty when X-Sendfile is disabled
+    // or the root could not be resolved.
+    //
+    STRU* QuerySendFileRoot()
+    {
+        return &m_struSendFileRoot;
+    }
+
+    //
+    // Phase durations of the requests forwarded for the application.
+    //
+    REQUEST_PHASE_STATISTICS* QueryPhaseStatistics()
+    {
+        return &m_PhaseStatistics;
+    }
+
+    //
+    // Whether the response of the calling request gets a Server-Timing
+    // header, per the configured sample rate.
+    //
+    BOOL
+    ShouldSendServerTiming();
+
 private:
 
     VOID SetWebsocketStatus(IHttpContext *pHttpContext);
 
+    VOID
+    QueueAdmissionWorker();
+
+    HRESULT
+    ResolveSendFileRoot();
+
+    static
+    DWORD
+    WINAPI
+    AdmissionWorkerCallback(
+        LPVOID      lpParam
+    );
+
+    static
+    VOID
+    CALLBACK
+    AdmissionTimerCallback(
+        _In_ PTP_CALLBACK_INSTANCE  Instance,
+        _In_ PVOID                  Context,
+        _In_ PTP_TIMER              Timer
+    );
+
+    static
+    VOID
+    CALLBACK
+    CollapsedRequestTimerCallback(
+        _In_ PTP_CALLBACK_INSTANCE  Instance,
+        _In_ PVOID                  Context,
+        _In_ PTP_TIMER              Timer
+    );
+
     PROCESS_MANAGER * m_pProcessManager;
     IHttpServer      *m_pHttpServer;
 
+    ADMISSION_QUEUE               m_AdmissionQueue;
+    STTIMER                       m_AdmissionTimer;
+    volatile LONG                 m_lAdmissionWorkerQueued;
+
+    RESPONSE_CACHE                m_ResponseCache;
+    COLLAPSED_REQUEST_REGISTRY    m_CollapsedRequests;
+    STTIMER                       m_CollapsedRequestTimer;
+    STRU                          m_struSendFileRoot;
+    REQUEST_PHASE_STATISTICS      m_PhaseStatistics;
+    volatile LONG                 m_lServerTimingCounter;
+
     WEBSOCKET_STATUS              m_fWebSocketSupported;
     std::unique_ptr<REQUESTHANDLER_CONFIG> m_pConfig;
 };
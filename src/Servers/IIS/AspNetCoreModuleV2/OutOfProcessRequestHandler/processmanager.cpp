@@ -10,7 +10,7 @@ volatile BOOL               PROCESS_MANAGER::sm_fWSAStartupDone = FALSE;
 
 HRESULT
 PROCESS_MANAGER::Initialize(
-    VOID
+    _In_    IAPPLICATION               *pApplication
 )
 {
     WSADATA                              wsaData{};
@@ -30,6 +30,7 @@ PROCESS_MANAGER::Initialize(
         }
     }
 
+    m_pApplication = pApplication;
     m_dwRapidFailTickStart = GetTickCount();
 
     if( m_hNULHandle == nullptr )
@@ -54,17 +55,20 @@ PROCESS_MANAGER::Initialize(
 
 PROCESS_MANAGER::~PROCESS_MANAGER()
 {
+    delete[] m_pProcessSlots;
 }
 
 HRESULT
-PROCESS_MANAGER::GetProcess(
+PROCESS_MANAGER::GetReadyProcess(
     _In_    REQUESTHANDLER_CONFIG      *pConfig,
     _In_    BOOL                        fWebsocketSupported,
     _Out_   SERVER_PROCESS            **ppServerProcess
 )
 {
     DWORD            dwProcessIndex = 0;
-    std::unique_ptr<SERVER_PROCESS>  pSelectedServerProcess;
+    DWORD            cReady = 0;
+
+    *ppServerProcess = nullptr;
 
     if (InterlockedCompareExchange(&m_lStopping, 1L, 1L) == 1L)
     {
@@ -77,12 +81,24 @@ PROCESS_MANAGER::GetProcess(
 
         if (!m_fServerProcessListReady)
         {
-            m_dwProcessesPerApplication = pConfig->QueryProcessesPerApplication();
-            m_ppServerProcessList = new SERVER_PROCESS*[m_dwProcessesPerApplication];
+            LOAD_BALANCING_POLICY policy = LOAD_BALANCING_ROUND_ROBIN;
+            if (!LOAD_BALANCER::TryParsePolicy(pConfig->QueryLoadBalancingPolicy()->QueryStr(), &policy))
+            {
+                LOG_WARNF(L"Unknown loadBalancingPolicy '%ls', falling back to round robin.",
+                    pConfig->QueryLoadBalancingPolicy()->QueryStr());
+            }
+            m_LoadBalancer.SetPolicy(policy);
+
+            m_dwRapidFailsPerMinute = pConfig->QueryRapidFailsPerMinute();
+            m_fSpareProcessEnabled = pConfig->QueryEnableSpareProcess();
+            m_dwProcessesPerApplication = min(pConfig->QueryProcessesPerApplication(), static_cast<DWORD>(MAX_PROCESSES_PER_APPLICATION));
+            m_pProcessSlots = new PROCESS_SLOT[m_dwProcessesPerApplication];
 
             for (DWORD i = 0; i < m_dwProcessesPerApplication; ++i)
             {
-                m_ppServerProcessList[i] = nullptr;
+                InitializeSRWLock(&m_pProcessSlots[i].srwStartLock);
+                m_pProcessSlots[i].pServerProcess = nullptr;
+                m_pProcessSlots[i].lWarmUpQueued = 0;
             }
         }
         m_fServerProcessListReady = TRUE;
@@ -92,45 +108,190 @@ PROCESS_MANAGER::GetProcess(
         auto lock = SRWSharedLock(m_srwLock);
 
         //
-        // round robin through to the next available process.
+        // Only route to processes that are ready to serve requests.
         //
-        dwProcessIndex = InterlockedIncrement(&m_dwRouteToProcessIndex);
-        dwProcessIndex = dwProcessIndex % m_dwProcessesPerApplication;
+        cReady = SelectReadyProcessNoLock(&dwProcessIndex);
+        if (cReady != 0)
+        {
+            m_pProcessSlots[dwProcessIndex].pServerProcess->ReferenceServerProcess();
+            *ppServerProcess = m_pProcessSlots[dwProcessIndex].pServerProcess;
+        }
+    }
+
+    if (m_fSpareProcessEnabled && m_lSpareQueued == 0)
+    {
+        QueueSpareProcess(pConfig, fWebsocketSupported);
+    }
 
-        if (m_ppServerProcessList[dwProcessIndex] != nullptr &&
-            m_ppServerProcessList[dwProcessIndex]->IsReady())
+    if (cReady != 0)
+    {
+        //
+        // restart processes that exited in the background.
+        //
+        if (cReady < m_dwProcessesPerApplication)
         {
-            *ppServerProcess = m_ppServerProcessList[dwProcessIndex];
-            return S_OK;
+            QueueWarmUp(pConfig, fWebsocketSupported, SPARE_PROCESS_INDEX);
         }
+        return S_OK;
+    }
+
+    return S_FALSE;
+}
+
+HRESULT
+PROCESS_MANAGER::GetProcess(
+    _In_    REQUESTHANDLER_CONFIG      *pConfig,
+    _In_    BOOL                        fWebsocketSupported,
+    _Out_   SERVER_PROCESS            **ppServerProcess
+)
+{
+    HRESULT          hr = S_OK;
+    DWORD            dwProcessIndex = 0;
+
+    RETURN_IF_FAILED(hr = GetReadyProcess(pConfig, fWebsocketSupported, ppServerProcess));
+    if (hr == S_OK)
+    {
+        return S_OK;
     }
 
-    // should make the lock per process so that we can start processes simultaneously ?
-    if (m_ppServerProcessList[dwProcessIndex] == nullptr ||
-        !m_ppServerProcessList[dwProcessIndex]->IsReady())
+    {
+        auto lock = SRWSharedLock(m_srwLock);
+
+        const BACKEND_LOAD* rgLoads[MAX_PROCESSES_PER_APPLICATION] = {};
+        dwProcessIndex = m_LoadBalancer.Select(rgLoads, m_dwProcessesPerApplication);
+    }
+
+    //
+    // No process is ready. Start the selected one for this request and
+    // warm up the other slots in the background, so that processes start in
+    // parallel rather than one startupTimeLimit after the other.
+    //
+    QueueWarmUp(pConfig, fWebsocketSupported, dwProcessIndex);
+
+    return StartProcessInSlot(dwProcessIndex,
+        pConfig,
+        fWebsocketSupported,
+        FALSE,
+        ppServerProcess);
+}
+
+HRESULT
+PROCESS_MANAGER::CreateServerProcess(
+    _In_    REQUESTHANDLER_CONFIG      *pConfig,
+    _In_    BOOL                        fWebsocketSupported,
+    _Out_   std::unique_ptr<SERVER_PROCESS> &pServerProcess
+)
+{
+    pServerProcess = std::make_unique<SERVER_PROCESS>();
+    RETURN_IF_FAILED(pServerProcess->Initialize(
+            this,                                   //ProcessManager
+            pConfig->QueryProcessPath(),            //
+            pConfig->QueryArguments(),              //
+            pConfig->QueryStartupTimeLimitInMS(),
+            pConfig->QueryShutdownTimeLimitInMS(),
+            pConfig->QueryWindowsAuthEnabled(),
+            pConfig->QueryBasicAuthEnabled(),
+            pConfig->QueryAnonymousAuthEnabled(),
+            pConfig->QueryEnvironmentVariables(),
+            pConfig->QueryStdoutLogEnabled(),
+            pConfig->QueryEnableOutOfProcessConsoleRedirection(),
+            fWebsocketSupported,
+            pConfig->QueryStdoutLogFile(),
+            pConfig->QueryApplicationPhysicalPath(),   // physical path
+            pConfig->QueryApplicationPath(),           // app path
+            pConfig->QueryApplicationVirtualPath(),     // App relative virtual path,
+            pConfig->QueryBindings()
+    ));
+
+    return S_OK;
+}
+
+HRESULT
+PROCESS_MANAGER::StartProcessInSlot(
+    _In_    DWORD                       dwProcessIndex,
+    _In_    REQUESTHANDLER_CONFIG      *pConfig,
+    _In_    BOOL                        fWebsocketSupported,
+    _In_    BOOL                        fWarmUp,
+    _Out_   SERVER_PROCESS            **ppServerProcess
+)
+{
+    PROCESS_SLOT *pSlot = &m_pProcessSlots[dwProcessIndex];
+
+    //
+    // A request marks the slot it starts, so that the warm-ups other
+    // requests queue meanwhile do not start a second process for it. If a
+    // warm-up already holds the flag, the request waits for its process.
+    //
+    const BOOL fOwnsFlag = fWarmUp ||
+        InterlockedCompareExchange(&pSlot->lWarmUpQueued, 1L, 0L) == 0L;
+
+    const HRESULT hr = StartSlotProcess(pSlot, pConfig, fWebsocketSupported, ppServerProcess);
+
+    if (fOwnsFlag)
+    {
+        InterlockedExchange(&pSlot->lWarmUpQueued, 0L);
+    }
+
+    return hr;
+}
+
+HRESULT
+PROCESS_MANAGER::StartSlotProcess(
+    _In_    PROCESS_SLOT               *pSlot,
+    _In_    REQUESTHANDLER_CONFIG      *pConfig,
+    _In_    BOOL                        fWebsocketSupported,
+    _Out_   SERVER_PROCESS            **ppServerProcess
+)
+{
+    std::unique_ptr<SERVER_PROCESS> pServerProcess;
+
+    //
+    // Only one thread starts the process of a slot, others wait for it here
+    // and pick up the process it started.
+    //
+    auto startLock = SRWExclusiveLock(pSlot->srwStartLock);
+
     {
         auto lock = SRWExclusiveLock(m_srwLock);
 
-        if (m_ppServerProcessList[dwProcessIndex] != nullptr)
+        if (m_lStopping)
         {
-            if (!m_ppServerProcessList[dwProcessIndex]->IsReady())
-            {
-                //
-                // terminate existing process that is not ready
-                // before creating new one.
-                //
-                ShutdownProcessNoLock( m_ppServerProcessList[dwProcessIndex] );
-            }
-            else
+            RETURN_HR(E_APPLICATION_EXITING);
+        }
+
+        if (pSlot->pServerProcess != nullptr)
+        {
+            if (pSlot->pServerProcess->IsReady())
             {
                 // server is already up and ready to serve requests.
-                //m_ppServerProcessList[dwProcessIndex]->ReferenceServerProcess();
-                *ppServerProcess = m_ppServerProcessList[dwProcessIndex];
+                pSlot->pServerProcess->ReferenceServerProcess();
+                *ppServerProcess = pSlot->pServerProcess;
                 return S_OK;
             }
+
+            //
+            // terminate existing process that is not ready
+            // before creating new one.
+            //
+            ShutdownProcessNoLock(pSlot->pServerProcess);
         }
 
-        if (RapidFailsPerMinuteExceeded(pConfig->QueryRapidFailsPerMinute()))
+        if (m_pSpareProcess != nullptr && m_pSpareProcess->IsReady())
+        {
+            //
+            // the spare process takes over the slot, a new spare is
+            // started on the next request.
+            //
+            pSlot->pServerProcess = m_pSpareProcess;
+            m_pSpareProcess = nullptr;
+            InterlockedExchange(&m_lSpareQueued, 0L);
+
+            pSlot->pServerProcess->ReferenceServerProcess();
+            *ppServerProcess = pSlot->pServerProcess;
+            return S_OK;
+        }
+
+        if (RapidFailsPerMinuteExceeded(m_dwRapidFailsPerMinute))
         {
             //
             // rapid fails per minute exceeded, do not create new process.
@@ -138,45 +299,205 @@ PROCESS_MANAGER::GetProcess(
             EventLog::Info(
                 ASPNETCORE_EVENT_RAPID_FAIL_COUNT_EXCEEDED,
                 ASPNETCORE_EVENT_RAPID_FAIL_COUNT_EXCEEDED_MSG,
-                pConfig->QueryRapidFailsPerMinute());
+                m_dwRapidFailsPerMinute);
 
             RETURN_HR(HRESULT_FROM_WIN32(ERROR_SERVER_DISABLED));
         }
+    }
+
+    //
+    // Start the process without holding m_srwLock, requests keep being
+    // routed to the ready slots meanwhile.
+    //
+    RETURN_IF_FAILED(CreateServerProcess(pConfig, fWebsocketSupported, pServerProcess));
+    RETURN_IF_FAILED(pServerProcess->StartProcess());
+
+    if (!pServerProcess->IsReady())
+    {
+        RETURN_HR(HRESULT_FROM_WIN32(ERROR_CREATE_FAILED));
+    }
+
+    {
+        auto lock = SRWExclusiveLock(m_srwLock);
+
+        if (m_lStopping)
+        {
+            pServerProcess->StopProcess();
+            pServerProcess.release()->DereferenceServerProcess();
+            RETURN_HR(E_APPLICATION_EXITING);
+        }
+
+        pSlot->pServerProcess = pServerProcess.release();
+        pSlot->pServerProcess->ReferenceServerProcess();
+        *ppServerProcess = pSlot->pServerProcess;
+    }
+
+    return S_OK;
+}
+
+VOID
+PROCESS_MANAGER::QueueWarmUp(
+    _In_    REQUESTHANDLER_CONFIG      *pConfig,
+    _In_    BOOL                        fWebsocketSupported,
+    _In_    DWORD                       dwSkipIndex
+)
+{
+    for (DWORD i = 0; i < m_dwProcessesPerApplication; ++i)
+    {
+        if (i == dwSkipIndex ||
+            InterlockedCompareExchange(&m_pProcessSlots[i].lWarmUpQueued, 1L, 0L) != 0L)
+        {
+            continue;
+        }
 
-        if (m_ppServerProcessList[dwProcessIndex] == nullptr)
         {
+            auto lock = SRWSharedLock(m_srwLock);
 
-            pSelectedServerProcess = std::make_unique<SERVER_PROCESS>();
-            RETURN_IF_FAILED(pSelectedServerProcess->Initialize(
-                    this,                                   //ProcessManager
-                    pConfig->QueryProcessPath(),            //
-                    pConfig->QueryArguments(),              //
-                    pConfig->QueryStartupTimeLimitInMS(),
-                    pConfig->QueryShutdownTimeLimitInMS(),
-                    pConfig->QueryWindowsAuthEnabled(),
-                    pConfig->QueryBasicAuthEnabled(),
-                    pConfig->QueryAnonymousAuthEnabled(),
-                    pConfig->QueryEnvironmentVariables(),
-                    pConfig->QueryStdoutLogEnabled(),
-                    pConfig->QueryEnableOutOfProcessConsoleRedirection(),
-                    fWebsocketSupported,
-                    pConfig->QueryStdoutLogFile(),
-                    pConfig->QueryApplicationPhysicalPath(),   // physical path
-                    pConfig->QueryApplicationPath(),           // app path
-                    pConfig->QueryApplicationVirtualPath(),     // App relative virtual path,
-                    pConfig->QueryBindings()
-            ));
-            RETURN_IF_FAILED(pSelectedServerProcess->StartProcess());
+            if (m_pProcessSlots[i].pServerProcess != nullptr &&
+                m_pProcessSlots[i].pServerProcess->IsReady())
+            {
+                InterlockedExchange(&m_pProcessSlots[i].lWarmUpQueued, 0L);
+                continue;
+            }
         }
 
-        if (!pSelectedServerProcess->IsReady())
+        if (FAILED_LOG(QueueWarmUpCallback(pConfig, fWebsocketSupported, i)))
         {
-            RETURN_HR(HRESULT_FROM_WIN32(ERROR_CREATE_FAILED));
+            InterlockedExchange(&m_pProcessSlots[i].lWarmUpQueued, 0L);
         }
+    }
+}
+
+VOID
+PROCESS_MANAGER::QueueSpareProcess(
+    _In_    REQUESTHANDLER_CONFIG      *pConfig,
+    _In_    BOOL                        fWebsocketSupported
+)
+{
+    if (InterlockedCompareExchange(&m_lSpareQueued, 1L, 0L) != 0L)
+    {
+        return;
+    }
+
+    if (FAILED_LOG(QueueWarmUpCallback(pConfig, fWebsocketSupported, SPARE_PROCESS_INDEX)))
+    {
+        InterlockedExchange(&m_lSpareQueued, 0L);
+    }
+}
 
-        m_ppServerProcessList[dwProcessIndex] = pSelectedServerProcess.release();
+//
+// The process is created and started on the work item, request threads
+// only queue it.
+//
+HRESULT
+PROCESS_MANAGER::QueueWarmUpCallback(
+    _In_    REQUESTHANDLER_CONFIG      *pConfig,
+    _In_    BOOL                        fWebsocketSupported,
+    _In_    DWORD                       dwProcessIndex
+)
+{
+    auto pContext = std::make_unique<WARM_UP_CONTEXT>();
+    pContext->pProcessManager = this;
+    pContext->pConfig = pConfig;
+    pContext->fWebsocketSupported = fWebsocketSupported;
+    pContext->dwProcessIndex = dwProcessIndex;
+
+    m_pApplication->ReferenceApplication();
+    ReferenceProcessManager();
+    if (!QueueUserWorkItem(WarmUpCallback, pContext.get(), WT_EXECUTELONGFUNCTION))
+    {
+        const HRESULT hr = HRESULT_FROM_WIN32(GetLastError());
+        DereferenceProcessManager();
+        m_pApplication->DereferenceApplication();
+        RETURN_HR(hr);
     }
-    *ppServerProcess = m_ppServerProcessList[dwProcessIndex];
 
+    pContext.release();
     return S_OK;
 }
+
+HRESULT
+PROCESS_MANAGER::StartSpareProcess(
+    _In_    REQUESTHANDLER_CONFIG      *pConfig,
+    _In_    BOOL                        fWebsocketSupported
+)
+{
+    std::unique_ptr<SERVER_PROCESS> pServerProcess;
+
+    {
+        auto lock = SRWExclusiveLock(m_srwLock);
+
+        if (m_lStopping)
+        {
+            RETURN_HR(E_APPLICATION_EXITING);
+        }
+
+        if (RapidFailsPerMinuteExceeded(m_dwRapidFailsPerMinute))
+        {
+            RETURN_HR(HRESULT_FROM_WIN32(ERROR_SERVER_DISABLED));
+        }
+    }
+
+    RETURN_IF_FAILED(CreateServerProcess(pConfig, fWebsocketSupported, pServerProcess));
+
+    HRESULT hr = pServerProcess->StartProcess();
+    if (FAILED(hr) || !pServerProcess->IsReady())
+    {
+        //
+        // count the failure so that the rapid fail limit stops an
+        // application that cannot start from starting a spare per request.
+        //
+        IncrementRapidFailCount();
+        RETURN_HR(FAILED(hr) ? hr : HRESULT_FROM_WIN32(ERROR_CREATE_FAILED));
+    }
+
+    {
+        auto lock = SRWExclusiveLock(m_srwLock);
+
+        if (m_lStopping)
+        {
+            pServerProcess->StopProcess();
+            pServerProcess.release()->DereferenceServerProcess();
+            RETURN_HR(E_APPLICATION_EXITING);
+        }
+
+        m_pSpareProcess = pServerProcess.release();
+    }
+
+    return S_OK;
+}
+
+// static
+DWORD
+WINAPI
+PROCESS_MANAGER::WarmUpCallback(
+    LPVOID lpParam
+)
+{
+    std::unique_ptr<WARM_UP_CONTEXT> pContext(static_cast<WARM_UP_CONTEXT*>(lpParam));
+    PROCESS_MANAGER *pProcessManager = pContext->pProcessManager;
+    IAPPLICATION *pApplication = pProcessManager->m_pApplication;
+    SERVER_PROCESS *pServerProcess = nullptr;
+
+    if (pContext->dwProcessIndex == SPARE_PROCESS_INDEX)
+    {
+        if (FAILED_LOG(pProcessManager->StartSpareProcess(pContext->pConfig,
+            pContext->fWebsocketSupported)))
+        {
+            InterlockedExchange(&pProcessManager->m_lSpareQueued, 0L);
+        }
+    }
+    else if (SUCCEEDED_LOG(pProcessManager->StartProcessInSlot(pContext->dwProcessIndex,
+        pContext->pConfig,
+        pContext->fWebsocketSupported,
+        TRUE,
+        &pServerProcess)))
+    {
+        pServerProcess->DereferenceServerProcess();
+    }
+
+    pProcessManager->DereferenceProcessManager();
+    pApplication->DereferenceApplication();
+
+    return 0;
+}
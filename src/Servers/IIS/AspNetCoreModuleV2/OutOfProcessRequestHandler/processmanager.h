@@ -4,6 +4,8 @@
 #pragma once
 
 #define ONE_MINUTE_IN_MILLISECONDS 60000
+#define MAX_PROCESSES_PER_APPLICATION 100
+#define SPARE_PROCESS_INDEX MAXDWORD
 class SERVER_PROCESS;
 
 class PROCESS_MANAGER
@@ -28,6 +30,10 @@ public:
         }
     }
 
+    //
+    // Returns a referenced process, the caller must call
+    // DereferenceServerProcess() once done with it.
+    //
     HRESULT 
     GetProcess(
         _In_    REQUESTHANDLER_CONFIG      *pConfig,
@@ -35,15 +41,30 @@ public:
         _Out_   SERVER_PROCESS            **ppServerProcess
     );
 
+    //
+    // Same as GetProcess but returns S_FALSE without a process instead of
+    // starting one on the calling thread when no process is ready.
+    //
+    HRESULT
+    GetReadyProcess(
+        _In_    REQUESTHANDLER_CONFIG      *pConfig,
+        _In_    BOOL                        fWebsocketEnabled,
+        _Out_   SERVER_PROCESS            **ppServerProcess
+    );
+
     HANDLE
     QueryNULHandle()
     {
         return m_hNULHandle;
     }
 
+    //
+    // pApplication owns the process manager and the configuration passed
+    // to it, warm-ups reference it while they run.
+    //
     HRESULT
     Initialize(
-        VOID
+        _In_    IAPPLICATION               *pApplication
     );
 
     VOID
@@ -53,15 +74,22 @@ public:
 
         for(DWORD i = 0; i < m_dwProcessesPerApplication; ++i )
         {
-            if( m_ppServerProcessList != nullptr && 
-                m_ppServerProcessList[i] != nullptr )
+            if( m_pProcessSlots != nullptr && 
+                m_pProcessSlots[i].pServerProcess != nullptr )
             {
-                m_ppServerProcessList[i]->SendSignal();
-                m_ppServerProcessList[i]->DereferenceServerProcess();
-                m_ppServerProcessList[i] = nullptr;
+                m_pProcessSlots[i].pServerProcess->SendSignal();
+                m_pProcessSlots[i].pServerProcess->DereferenceServerProcess();
+                m_pProcessSlots[i].pServerProcess = nullptr;
             }
         }
 
+        if( m_pSpareProcess != nullptr )
+        {
+            m_pSpareProcess->SendSignal();
+            m_pSpareProcess->DereferenceServerProcess();
+            m_pSpareProcess = nullptr;
+        }
+
         ReleaseSRWLockExclusive( &m_srwLock );
     }
 
@@ -107,22 +135,115 @@ public:
     }
 
     PROCESS_MANAGER() : 
-        m_ppServerProcessList(nullptr),
+        m_pApplication(nullptr),
+        m_pProcessSlots(nullptr),
         m_hNULHandle(nullptr),
         m_cRapidFailCount( 0 ),
         m_dwProcessesPerApplication( 1 ),
-        m_dwRouteToProcessIndex( 0 ),
+        m_dwRapidFailsPerMinute( 0 ),
+        m_pSpareProcess(nullptr),
+        m_lSpareQueued(0),
+        m_fSpareProcessEnabled(FALSE),
         m_fServerProcessListReady(FALSE),
         m_lStopping(0),
         m_cRefs( 1 )
     {
-        m_ppServerProcessList = nullptr;
+        m_pProcessSlots = nullptr;
         m_fServerProcessListReady = FALSE;
         InitializeSRWLock( &m_srwLock );
     }
 
 private:
 
+    //
+    // A slot for one backend process. The start lock serializes starting the
+    // process of this slot only, so that slots start in parallel and ready
+    // slots keep serving requests meanwhile. pServerProcess only changes
+    // with m_srwLock held exclusively. lWarmUpQueued is set while a warm-up
+    // is queued for the slot or a request starts its process, so that no
+    // other warm-up is queued for it meanwhile.
+    //
+    struct PROCESS_SLOT
+    {
+        SRWLOCK             srwStartLock;
+        SERVER_PROCESS     *pServerProcess;
+        volatile LONG       lWarmUpQueued;
+    };
+
+    //
+    // dwProcessIndex is SPARE_PROCESS_INDEX for the spare process. The
+    // process is created on the work item, m_pApplication is referenced
+    // until then so that pConfig stays valid.
+    //
+    struct WARM_UP_CONTEXT
+    {
+        PROCESS_MANAGER        *pProcessManager;
+        REQUESTHANDLER_CONFIG  *pConfig;
+        BOOL                    fWebsocketSupported;
+        DWORD                   dwProcessIndex;
+    };
+
+    HRESULT
+    CreateServerProcess(
+        _In_    REQUESTHANDLER_CONFIG      *pConfig,
+        _In_    BOOL                        fWebsocketSupported,
+        _Out_   std::unique_ptr<SERVER_PROCESS> &pServerProcess
+    );
+
+    //
+    // fWarmUp is set when called by a warm-up, which already holds the
+    // lWarmUpQueued flag of the slot.
+    //
+    HRESULT
+    StartProcessInSlot(
+        _In_    DWORD                       dwProcessIndex,
+        _In_    REQUESTHANDLER_CONFIG      *pConfig,
+        _In_    BOOL                        fWebsocketSupported,
+        _In_    BOOL                        fWarmUp,
+        _Out_   SERVER_PROCESS            **ppServerProcess
+    );
+
+    HRESULT
+    StartSlotProcess(
+        _In_    PROCESS_SLOT               *pSlot,
+        _In_    REQUESTHANDLER_CONFIG      *pConfig,
+        _In_    BOOL                        fWebsocketSupported,
+        _Out_   SERVER_PROCESS            **ppServerProcess
+    );
+
+    HRESULT
+    QueueWarmUpCallback(
+        _In_    REQUESTHANDLER_CONFIG      *pConfig,
+        _In_    BOOL                        fWebsocketSupported,
+        _In_    DWORD                       dwProcessIndex
+    );
+
+    VOID
+    QueueWarmUp(
+        _In_    REQUESTHANDLER_CONFIG      *pConfig,
+        _In_    BOOL                        fWebsocketSupported,
+        _In_    DWORD                       dwSkipIndex
+    );
+
+    VOID
+    QueueSpareProcess(
+        _In_    REQUESTHANDLER_CONFIG      *pConfig,
+        _In_    BOOL                        fWebsocketSupported
+    );
+
+    HRESULT
+    StartSpareProcess(
+        _In_    REQUESTHANDLER_CONFIG      *pConfig,
+        _In_    BOOL                        fWebsocketSupported
+    );
+
+    static
+    DWORD
+    WINAPI
+    WarmUpCallback(
+        LPVOID lpParam
+    );
+
     BOOL 
     RapidFailsPerMinuteExceeded(
         LONG dwRapidFailsPerMinute
@@ -151,16 +272,57 @@ private:
     {
         for(DWORD i = 0; i < m_dwProcessesPerApplication; ++i )
         {
-            if( m_ppServerProcessList != nullptr &&
-                m_ppServerProcessList[i] != nullptr &&
-                m_ppServerProcessList[i]->GetPort() == pServerProcess->GetPort() )
+            if( m_pProcessSlots != nullptr &&
+                m_pProcessSlots[i].pServerProcess != nullptr &&
+                m_pProcessSlots[i].pServerProcess->GetPort() == pServerProcess->GetPort() )
             {
                 // shutdown pServerProcess if not already shutdown.
-                m_ppServerProcessList[i]->StopProcess();
-                m_ppServerProcessList[i]->DereferenceServerProcess();
-                m_ppServerProcessList[i] = nullptr;
+                m_pProcessSlots[i].pServerProcess->StopProcess();
+                m_pProcessSlots[i].pServerProcess->DereferenceServerProcess();
+                m_pProcessSlots[i].pServerProcess = nullptr;
+            }
+        }
+
+        if( m_pSpareProcess != nullptr &&
+            m_pSpareProcess->GetPort() == pServerProcess->GetPort() )
+        {
+            // the spare process exited, start a new one on the next request.
+            m_pSpareProcess->StopProcess();
+            m_pSpareProcess->DereferenceServerProcess();
+            m_pSpareProcess = nullptr;
+            InterlockedExchange(&m_lSpareQueued, 0L);
+        }
+    }
+
+    //
+    // Picks one of the ready processes according to the load balancing
+    // policy, returns the number of ready processes.
+    //
+    DWORD
+    SelectReadyProcessNoLock(
+        DWORD *pdwProcessIndex
+    )
+    {
+        const BACKEND_LOAD* rgLoads[MAX_PROCESSES_PER_APPLICATION];
+        DWORD               rgProcessIndexes[MAX_PROCESSES_PER_APPLICATION];
+        DWORD               cReady = 0;
+
+        for (DWORD i = 0; i < m_dwProcessesPerApplication; ++i)
+        {
+            SERVER_PROCESS* pServerProcess = m_pProcessSlots[i].pServerProcess;
+            if (pServerProcess != nullptr && pServerProcess->IsReady())
+            {
+                rgLoads[cReady] = pServerProcess->QueryLoad();
+                rgProcessIndexes[cReady] = i;
+                cReady++;
             }
         }
+
+        if (cReady != 0)
+        {
+            *pdwProcessIndex = rgProcessIndexes[m_LoadBalancer.Select(rgLoads, cReady)];
+        }
+        return cReady;
     }
 
     VOID 
@@ -170,24 +332,41 @@ private:
     {
         for(DWORD i = 0; i < m_dwProcessesPerApplication; ++i )
         {
-            if( m_ppServerProcessList != nullptr &&
-                m_ppServerProcessList[i] != nullptr)
+            if( m_pProcessSlots != nullptr &&
+                m_pProcessSlots[i].pServerProcess != nullptr)
             {
                 // shutdown pServerProcess if not already shutdown.
-                m_ppServerProcessList[i]->SendSignal();
-                m_ppServerProcessList[i]->DereferenceServerProcess();
-                m_ppServerProcessList[i] = nullptr;
+                m_pProcessSlots[i].pServerProcess->SendSignal();
+                m_pProcessSlots[i].pServerProcess->DereferenceServerProcess();
+                m_pProcessSlots[i].pServerProcess = nullptr;
             }
         }
+
+        if (m_pSpareProcess != nullptr)
+        {
+            m_pSpareProcess->SendSignal();
+            m_pSpareProcess->DereferenceServerProcess();
+            m_pSpareProcess = nullptr;
+        }
     }
 
     volatile LONG                     m_cRapidFailCount;
     DWORD                             m_dwRapidFailTickStart;
     DWORD                             m_dwProcessesPerApplication;
-    volatile DWORD                    m_dwRouteToProcessIndex;
+    DWORD                             m_dwRapidFailsPerMinute;
+    LOAD_BALANCER                     m_LoadBalancer;
 
     SRWLOCK                           m_srwLock;
-    SERVER_PROCESS                  **m_ppServerProcessList;
+    IAPPLICATION                     *m_pApplication;
+    PROCESS_SLOT                     *m_pProcessSlots;
+
+    //
+    // Started and ready process that takes over the next slot whose
+    // process exited. m_lSpareQueued is set while it is starting or ready.
+    //
+    SERVER_PROCESS                   *m_pSpareProcess;
+    volatile LONG                     m_lSpareQueued;
+    BOOL                              m_fSpareProcessEnabled;
 
     //
     // m_hNULHandle is used to redirect stdout/stderr to NUL.
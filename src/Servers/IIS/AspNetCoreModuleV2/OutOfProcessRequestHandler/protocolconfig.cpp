@@ -20,6 +20,12 @@ PROTOCOL_CONFIG::Initialize()
     m_dwMinResponseBuffer = 0; // no response buffering
     m_dwResponseBufferLimit = 4096*1024;
     m_dwMaxResponseHeaderSize = 65536;
+
+    m_RequestHeaderRules.Initialize(
+        m_fPreserveHostHeader,
+        std::string_view(m_strXForwardedForName.QueryStr(), m_strXForwardedForName.QueryCCH()),
+        std::string_view(m_strSslHeaderName.QueryStr(), m_strSslHeaderName.QueryCCH()),
+        std::string_view(m_strClientCertName.QueryStr(), m_strClientCertName.QueryCCH()));
     return S_OK;
 }
 
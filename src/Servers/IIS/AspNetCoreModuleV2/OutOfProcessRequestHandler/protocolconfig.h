@@ -85,6 +85,15 @@ class PROTOCOL_CONFIG
         return &m_strClientCertName;
     }
 
+    //
+    // Header rewrite rules compiled from the settings above.
+    //
+    const REQUEST_HEADER_RULES *
+    QueryRequestHeaderRules() const
+    {
+        return &m_RequestHeaderRules;
+    }
+
  private:
     
     BOOL            m_fKeepAlive;
@@ -100,4 +109,6 @@ class PROTOCOL_CONFIG
     STRA            m_strXForwardedForName;
     STRA            m_strSslHeaderName;
     STRA            m_strClientCertName;
+
+    REQUEST_HEADER_RULES    m_RequestHeaderRules;
 };
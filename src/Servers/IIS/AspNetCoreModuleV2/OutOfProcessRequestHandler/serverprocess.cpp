@@ -7,6 +7,63 @@
 #include "EventLog.h"
 #include "file_utility.h"
 #include "exceptions.h"
+#include "SRWExclusiveLock.h"
+#include "SRWSharedLock.h"
+
+PORT_ALLOCATOR              SERVER_PROCESS::sm_PortAllocator(MIN_PORT_RANDOM, MAX_PORT);
+SRWLOCK                     SERVER_PROCESS::sm_srwPortLock = SRWLOCK_INIT;
+
+namespace
+{
+    //
+    // Snapshot of the IPv4 TCP listeners, the caller frees it with HeapFree.
+    //
+    HRESULT
+    GetTcpListenerTable(
+        _Out_ MIB_TCPTABLE_OWNER_PID  **ppTCPInfo
+    )
+    {
+        DWORD                   dwResult = ERROR_INSUFFICIENT_BUFFER;
+        MIB_TCPTABLE_OWNER_PID *pTCPInfo = nullptr;
+        DWORD                   dwSize = 1000; // Initial size for pTCPInfo buffer
+
+        *ppTCPInfo = nullptr;
+
+        while (dwResult == ERROR_INSUFFICIENT_BUFFER)
+        {
+            // Increase the buffer size with additional space, MIB_TCPROW 20 bytes
+            // New entries may be added by other processes before calling GetExtendedTcpTable
+            dwSize += 200;
+
+            if (pTCPInfo != nullptr)
+            {
+                HeapFree(GetProcessHeap(), 0, pTCPInfo);
+            }
+
+            pTCPInfo = (MIB_TCPTABLE_OWNER_PID*)HeapAlloc(GetProcessHeap(), 0, dwSize);
+            if (pTCPInfo == nullptr)
+            {
+                return E_OUTOFMEMORY;
+            }
+
+            dwResult = GetExtendedTcpTable(pTCPInfo,
+                &dwSize,
+                FALSE,
+                AF_INET,
+                TCP_TABLE_OWNER_PID_LISTENER,
+                0);
+
+            if (dwResult != NO_ERROR && dwResult != ERROR_INSUFFICIENT_BUFFER)
+            {
+                HeapFree(GetProcessHeap(), 0, pTCPInfo);
+                return HRESULT_FROM_WIN32(dwResult);
+            }
+        }
+
+        *ppTCPInfo = pTCPInfo;
+        return S_OK;
+    }
+}
 
 HRESULT
 SERVER_PROCESS::Initialize(
@@ -94,38 +151,101 @@ SERVER_PROCESS::SetupJobObject(VOID)
 HRESULT
 SERVER_PROCESS::GetRandomPort
 (
-    DWORD* pdwPickedPort,
-    DWORD  dwExcludedPort = 0
+    DWORD* pdwPickedPort
 )
 {
     DBG_ASSERT(pdwPickedPort);
 
     std::uniform_int_distribution<> dist(MIN_PORT_RANDOM, MAX_PORT);
+    uint32_t dwPort = 0;
 
-    BOOL fPortInUse = FALSE;
-    DWORD dwActualProcessId = 0; // Ignored, but required for the function call.
-    constexpr int maxRetries = 10;
-    for (int retry = 0; retry < maxRetries; ++retry)
+    //
+    // Start the search at a random port so that a recycled application does
+    // not get the port its previous process may still hold.
+    //
+    const uint32_t dwHint = dist(m_randomGenerator);
+
+    auto lock = SRWExclusiveLock(sm_srwPortLock);
+
+    if (sm_PortAllocator.IsSnapshotStale(GetTickCount64(), PORT_SNAPSHOT_MAX_AGE_MS))
     {
-        do
-        {
-            *pdwPickedPort = dist(m_randomGenerator);
-        } while (*pdwPickedPort == dwExcludedPort); // Keep generating until a valid port is found.
+        RETURN_IF_FAILED(RefreshPortSnapshotNoLock());
+    }
 
-        HRESULT hr = CheckIfServerIsUp(*pdwPickedPort, &dwActualProcessId, &fPortInUse);
-        if (FAILED(hr))
-        {
-            return hr;
-        }
+    if (!sm_PortAllocator.Reserve(dwHint, &dwPort))
+    {
+        RETURN_HR(HRESULT_FROM_WIN32(ERROR_PORT_NOT_SET));
+    }
+
+    *pdwPickedPort = dwPort;
+    m_fPortReserved = TRUE;
+    return S_OK;
+}
+
+// static
+HRESULT
+SERVER_PROCESS::RefreshPortSnapshotNoLock(
+    VOID
+)
+{
+    MIB_TCPTABLE_OWNER_PID *pTCPInfo = nullptr;
+
+    RETURN_IF_FAILED(GetTcpListenerTable(&pTCPInfo));
+
+    UpdatePortSnapshotNoLock(pTCPInfo);
+
+    HeapFree(GetProcessHeap(), 0, pTCPInfo);
+    return S_OK;
+}
+
+// static
+VOID
+SERVER_PROCESS::UpdatePortSnapshotNoLock(
+    _In_ const MIB_TCPTABLE_OWNER_PID * pTCPInfo
+)
+{
+    sm_PortAllocator.BeginSnapshot(GetTickCount64());
+    for (DWORD dwLoop = 0; dwLoop < pTCPInfo->dwNumEntries; dwLoop++)
+    {
+        sm_PortAllocator.MarkListening(ntohs((USHORT)pTCPInfo->table[dwLoop].dwLocalPort));
+    }
+}
+
+// static
+VOID
+SERVER_PROCESS::QueryPortSnapshot(
+    _In_  DWORD       dwPort,
+    _Out_ BOOL      * pfListening,
+    _Out_ ULONGLONG * pullAgeMs
+)
+{
+    auto lock = SRWSharedLock(sm_srwPortLock);
+
+    *pfListening = sm_PortAllocator.IsListening(dwPort);
+    *pullAgeMs = sm_PortAllocator.QuerySnapshotAge(GetTickCount64());
+}
 
-        if (!fPortInUse)
+VOID
+SERVER_PROCESS::ReleasePort(
+    BOOL fPortUnusable
+)
+{
+    if (m_fPortReserved)
+    {
+        auto lock = SRWExclusiveLock(sm_srwPortLock);
+
+        sm_PortAllocator.Release(m_dwPort);
+
+        //
+        // the process could not listen on the port, something else may have
+        // taken it since the last snapshot.
+        //
+        if (fPortUnusable)
         {
-            return S_OK; // Port found and is not in use, success!
+            sm_PortAllocator.InvalidateSnapshot();
         }
+        m_fPortReserved = FALSE;
     }
-
-    // All retries failed, return error.
-    return HRESULT_FROM_WIN32(ERROR_PORT_NOT_SET);
 }
 
 HRESULT
@@ -484,12 +604,19 @@ SERVER_PROCESS::PostStartCheck(
     HRESULT hr = S_OK;
 
     BOOL    fReady = FALSE;
+    BOOL    fListening = FALSE;
     BOOL    fProcessMatch = FALSE;
+    ULONGLONG ullSnapshotAgeMs = 0;
     BOOL    fDebuggerAttached = FALSE;
     DWORD   dwTickCount = 0;
     DWORD   dwTimeDifference = 0;
     DWORD   dwActualProcessId = 0;
+    DWORD   dwProbeDelay = sm_PortAllocator.InRange(m_dwPort) ? STARTUP_PROBE_INITIAL_DELAY_MS : STARTUP_PROBE_MAX_DELAY_MS;
+    DWORD   cProbes = 0;
     INT     iChildProcessIndex = -1;
+    LARGE_INTEGER liStart{};
+    LARGE_INTEGER liReady{};
+    LARGE_INTEGER liFrequency{};
     STACK_STRU(strEventMsg, 256);
 
     if (CheckRemoteDebuggerPresent(m_hProcessHandle, &fDebuggerAttached) == 0)
@@ -499,6 +626,7 @@ SERVER_PROCESS::PostStartCheck(
     }
 
     dwTickCount = GetTickCount();
+    QueryPerformanceCounter(&liStart);
 
     do
     {
@@ -516,15 +644,44 @@ SERVER_PROCESS::PostStartCheck(
                 }
             }
         }
+        //
+        // Probes read the listener snapshot shared with the port allocation.
+        // The TCP table is only fetched, which also refreshes the snapshot,
+        // once the port shows up in it or the snapshot is as old as the
+        // longest probe interval. Starts running in parallel share these
+        // fetches. A port configured outside the allocation range is not in
+        // the snapshot, it is fetched for on every probe.
+        //
+        if (sm_PortAllocator.InRange(m_dwPort))
+        {
+            QueryPortSnapshot(m_dwPort, &fListening, &ullSnapshotAgeMs);
+        }
+        else
+        {
+            fListening = TRUE;
+        }
+
         //
         // dwActualProcessId will be set only when NsiAPI(GetExtendedTcpTable) is supported
         //
-        hr = CheckIfServerIsUp(m_dwPort, &dwActualProcessId, &fReady);
+        if (fListening || ullSnapshotAgeMs >= STARTUP_PROBE_MAX_DELAY_MS)
+        {
+            hr = CheckIfServerIsUp(m_dwPort, &dwActualProcessId, &fReady);
+            ullSnapshotAgeMs = 0;
+        }
         fDebuggerAttached = IsDebuggerIsAttached();
+        cProbes++;
 
         if (!fReady)
         {
-            Sleep(250);
+            //
+            // Back off exponentially up to 250ms, but wake up when the
+            // snapshot goes stale. The wait ends early when the process
+            // exits.
+            //
+            WaitForSingleObject(m_hProcessHandle,
+                static_cast<DWORD>(min(static_cast<ULONGLONG>(dwProbeDelay), STARTUP_PROBE_MAX_DELAY_MS - ullSnapshotAgeMs)));
+            dwProbeDelay = min(dwProbeDelay * 2, static_cast<DWORD>(STARTUP_PROBE_MAX_DELAY_MS));
         }
 
         dwTimeDifference = (GetTickCount() - dwTickCount);
@@ -537,6 +694,14 @@ SERVER_PROCESS::PostStartCheck(
         goto Finished;
     }
 
+    QueryPerformanceCounter(&liReady);
+    QueryPerformanceFrequency(&liFrequency);
+    LOG_INFOF(L"Process '%d' listening on port '%d' after %I64d ms, %d probe(s)",
+        m_dwProcessId,
+        m_dwPort,
+        (liReady.QuadPart - liStart.QuadPart) * 1000 / liFrequency.QuadPart,
+        cProbes);
+
     // register call back with the created process
     if (FAILED_LOG(hr = RegisterProcessWait(&m_hProcessWaitHandle, m_hProcessHandle)))
     {
@@ -913,6 +1078,7 @@ SERVER_PROCESS::StartProcess(
             pHashTable = nullptr;
         }
 
+        ReleasePort(m_hProcessHandle != nullptr);
         CleanUp();
     }
 
@@ -1163,13 +1329,8 @@ SERVER_PROCESS::CheckIfServerIsUp(
     _Out_ BOOL      * pfReady
 )
 {
-    HRESULT                 hr = S_OK;
-    DWORD                   dwResult = ERROR_INSUFFICIENT_BUFFER;
     MIB_TCPTABLE_OWNER_PID *pTCPInfo = nullptr;
     MIB_TCPROW_OWNER_PID   *pOwner = nullptr;
-    DWORD                   dwSize = 1000; // Initial size for pTCPInfo buffer
-    int                     iResult = 0;
-    SOCKET                  socketCheck = INVALID_SOCKET;
 
     DBG_ASSERT(pfReady);
     DBG_ASSERT(pdwProcessId);
@@ -1180,36 +1341,14 @@ SERVER_PROCESS::CheckIfServerIsUp(
     //
     *pdwProcessId = 0;
 
-    while (dwResult == ERROR_INSUFFICIENT_BUFFER)
-    {
-        // Increase the buffer size with additional space, MIB_TCPROW 20 bytes
-        // New entries may be added by other processes before calling GetExtendedTcpTable
-        dwSize += 200;
-
-        if (pTCPInfo != nullptr)
-        {
-            HeapFree(GetProcessHeap(), 0, pTCPInfo);
-        }
+    RETURN_IF_FAILED(GetTcpListenerTable(&pTCPInfo));
 
-        pTCPInfo = (MIB_TCPTABLE_OWNER_PID*)HeapAlloc(GetProcessHeap(), 0, dwSize);
-        if (pTCPInfo == nullptr)
-        {
-            hr = E_OUTOFMEMORY;
-            goto Finished;
-        }
-
-        dwResult = GetExtendedTcpTable(pTCPInfo,
-            &dwSize,
-            FALSE,
-            AF_INET,
-            TCP_TABLE_OWNER_PID_LISTENER,
-            0);
-
-        if (dwResult != NO_ERROR && dwResult != ERROR_INSUFFICIENT_BUFFER)
-        {
-            hr = HRESULT_FROM_WIN32(dwResult);
-            goto Finished;
-        }
+    //
+    // The table is fresh, let the start probes and port allocations use it.
+    //
+    {
+        auto lock = SRWExclusiveLock(sm_srwPortLock);
+        UpdatePortSnapshotNoLock(pTCPInfo);
     }
 
     // iterate pTcpInfo struct to find PID/PORT entry
@@ -1224,25 +1363,8 @@ SERVER_PROCESS::CheckIfServerIsUp(
         }
     }
 
-Finished:
-
-    if (socketCheck != INVALID_SOCKET)
-    {
-        iResult = closesocket(socketCheck);
-        if (iResult == SOCKET_ERROR)
-        {
-            hr = HRESULT_FROM_WIN32(WSAGetLastError());
-        }
-        socketCheck = INVALID_SOCKET;
-    }
-
-    if (pTCPInfo != nullptr)
-    {
-        HeapFree(GetProcessHeap(), 0, pTCPInfo);
-        pTCPInfo = nullptr;
-    }
-
-    return hr;
+    HeapFree(GetProcessHeap(), 0, pTCPInfo);
+    return S_OK;
 }
 
 // send signal to the process to let it gracefully shutdown
@@ -1707,6 +1829,8 @@ SERVER_PROCESS::SERVER_PROCESS() :
     m_hShutdownHandle(nullptr),
     m_hStdErrWritePipe(nullptr),
     m_hReadThread(nullptr),
+    m_dwPort(0),
+    m_fPortReserved(FALSE),
     m_randomGenerator(std::random_device()())
 {
     //InterlockedIncrement(&g_dwActiveServerProcesses);
@@ -1792,6 +1916,7 @@ SERVER_PROCESS::~SERVER_PROCESS()
     DWORD    dwThreadStatus = 0;
 
     CleanUp();
+    ReleasePort(FALSE);
 
     // no need to free m_pEnvironmentVarTable, as it references
     // the same hash table held by configuration.
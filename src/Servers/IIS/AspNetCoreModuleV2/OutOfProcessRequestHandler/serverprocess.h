@@ -23,6 +23,9 @@
 #define ASPNETCORE_PORT_ENV_STR                     L"ASPNETCORE_PORT="
 #define ASPNETCORE_APP_PATH_ENV_STR                 L"ASPNETCORE_APPL_PATH="
 #define ASPNETCORE_APP_TOKEN_ENV_STR                L"ASPNETCORE_TOKEN="
+#define STARTUP_PROBE_INITIAL_DELAY_MS              5
+#define STARTUP_PROBE_MAX_DELAY_MS                  250
+#define PORT_SNAPSHOT_MAX_AGE_MS                    1000
 
 class PROCESS_MANAGER;
 
@@ -138,6 +141,16 @@ public:
         return m_straGuid.QueryStr();
     };
 
+    //
+    // Outstanding requests and latency, updated by the forwarding handlers
+    // routed to this process and read by the load balancer.
+    //
+    BACKEND_LOAD*
+    QueryLoad()
+    {
+        return &m_Load;
+    }
+
     VOID
     SendSignal(
         VOID
@@ -183,6 +196,31 @@ private:
         _Out_ BOOL      * pfReady
     );
 
+    static
+    HRESULT
+    RefreshPortSnapshotNoLock(
+        VOID
+    );
+
+    static
+    VOID
+    UpdatePortSnapshotNoLock(
+        _In_ const MIB_TCPTABLE_OWNER_PID * pTCPInfo
+    );
+
+    static
+    VOID
+    QueryPortSnapshot(
+        _In_  DWORD       dwPort,
+        _Out_ BOOL      * pfListening,
+        _Out_ ULONGLONG * pullAgeMs
+    );
+
+    VOID
+    ReleasePort(
+        BOOL fPortUnusable
+    );
+
     HRESULT
     RegisterProcessWait(
         _In_ PHANDLE phWaitHandle,
@@ -228,8 +266,7 @@ private:
 
     HRESULT
     GetRandomPort(
-        DWORD*    pdwPickedPort,
-        DWORD     dwExcludedPort
+        DWORD*    pdwPickedPort
     );
 
     static
@@ -283,6 +320,7 @@ private:
     std::mt19937            m_randomGenerator;
 
     DWORD                   m_dwPort;
+    BOOL                    m_fPortReserved;
     DWORD                   m_dwStartupTimeLimitInMS;
     DWORD                   m_dwShutdownTimeLimitInMS;
     DWORD                   m_cChildProcess;
@@ -312,5 +350,13 @@ private:
     HANDLE                  m_hChildProcessWaitHandles[MAX_ACTIVE_CHILD_PROCESSES];
 
     PROCESS_MANAGER         *m_pProcessManager;
+    BACKEND_LOAD            m_Load;
+
+    //
+    // Ports handed out to the processes of all applications in this
+    // worker process, and the listeners seen at the last TCP table snapshot.
+    //
+    static PORT_ALLOCATOR   sm_PortAllocator;
+    static SRWLOCK          sm_srwPortLock;
     std::map<std::wstring, std::wstring, ignore_case_comparer> m_pEnvironmentVarTable;
 };
@@ -60,10 +60,26 @@
 #include "EventTracing.h"
 #include "aspnetcore_msg.h"
 #include "requesthandler_config.h"
+#include "readsizecontroller.h"
+#include "relaycleanupgate.h"
+#include "fragmentcoalescer.h"
+#include "timerwheel.h"
+#include "requestbodypipeline.h"
+#include "chunkencoder.h"
+#include "headertokenizer.h"
+#include "knownheaders.h"
+#include "requestheaderbuilder.h"
+#include "loadbalancer.h"
+#include "portallocator.h"
+#include "admissionqueue.h"
+#include "responsecache.h"
+#include "collapsedrequests.h"
+#include "sendfile.h"
+#include "requestphases.h"
 
 #include "sttimer.h"
+#include "entitybufferpool.h"
 #include "websockethandler.h"
-#include "responseheaderhash.h"
 #include "protocolconfig.h"
 #include "forwarderconnection.h"
 #include "serverprocess.h"
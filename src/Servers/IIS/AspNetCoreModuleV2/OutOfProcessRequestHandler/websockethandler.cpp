@@ -36,20 +36,32 @@ LIST_ENTRY WEBSOCKET_HANDLER::sm_RequestsListHead;
 
 TRACE_LOG * WEBSOCKET_HANDLER::sm_pTraceLog;
 
+SRWLOCK WEBSOCKET_HANDLER::sm_IdleTimerLock;
+
+TIMER_WHEEL * WEBSOCKET_HANDLER::sm_pIdleTimerWheel;
+
+STTIMER * WEBSOCKET_HANDLER::sm_pIdleTimer;
+
 WEBSOCKET_HANDLER::WEBSOCKET_HANDLER() :
     _pHttpContext(nullptr),
     _pWebSocketContext(nullptr),
     _hWebSocketRequest(nullptr),
     _pHandler(nullptr),
+    _pWinHttpReceiveBuffer(nullptr),
+    _pIisReceiveBuffer(nullptr),
+    _cbWinHttpReceiveBuffer(0),
+    _cbIisReceiveBuffer(0),
     _dwOutstandingIo(0),
-    _fCleanupInProgress(FALSE),
+    _cRefs(1),
     _fIndicateCompletionToIis(FALSE),
     _fHandleClosed(FALSE),
     _fReceivedCloseMsg(FALSE)
 {
     LOG_TRACE(L"WEBSOCKET_HANDLER::WEBSOCKET_HANDLER");
 
-    InitializeCriticalSectionAndSpinCount(&_RequestLock, 1000);
+    _WinHttpReceiveSize.InitializeRange(MIN_RECEIVE_BUFFER_SIZE, MAX_RECEIVE_BUFFER_SIZE);
+    _IisReceiveSize.InitializeRange(MIN_RECEIVE_BUFFER_SIZE, MAX_RECEIVE_BUFFER_SIZE);
+
     InsertRequest();
 }
 
@@ -59,10 +71,21 @@ WEBSOCKET_HANDLER::Terminate(
     )
 {
     LOG_TRACE(L"WEBSOCKET_HANDLER::Terminate");
+
+    //
+    // The wheel must not keep an entry of a handler that is going away,
+    // whether or not its handle was closed already.
+    //
+    StopIdleTimer();
+
     if (!_fHandleClosed)
     {
     RemoveRequest();
-    _fCleanupInProgress = TRUE;
+
+    //
+    // The IO is cancelled below.
+    //
+    _CleanupGate.BeginCleanup(ServerStateUnavailable);
 
     if (_pHttpContext != nullptr)
     {
@@ -76,9 +99,21 @@ WEBSOCKET_HANDLER::Terminate(
     }
 
     _pWebSocketContext = nullptr;
-    DeleteCriticalSection(&_RequestLock);
+    ReleaseReceiveBuffer(&_pWinHttpReceiveBuffer);
+    ReleaseReceiveBuffer(&_pIisReceiveBuffer);
 
-    delete this;
+    DereferenceHandler();
+    }
+}
+
+VOID
+WEBSOCKET_HANDLER::DereferenceHandler(
+    VOID
+    )
+{
+    if (InterlockedDecrement(&_cRefs) == 0)
+    {
+        delete this;
     }
 }
 
@@ -111,6 +146,7 @@ WEBSOCKET_HANDLER::StaticInitialize(
     }
 
     InitializeSRWLock(&sm_RequestsListLock);
+    InitializeSRWLock(&sm_IdleTimerLock);
 
     return S_OK;
 }
@@ -131,6 +167,18 @@ WEBSOCKET_HANDLER::StaticTerminate(
         DestroyRefTraceLog(sm_pTraceLog);
         sm_pTraceLog = nullptr;
     }
+
+    if (sm_pIdleTimer != nullptr)
+    {
+        //
+        // Waits for a running callback.
+        //
+        delete sm_pIdleTimer;
+        sm_pIdleTimer = nullptr;
+    }
+
+    delete sm_pIdleTimerWheel;
+    sm_pIdleTimerWheel = nullptr;
 }
 
 VOID
@@ -224,10 +272,33 @@ WEBSOCKET_HANDLER::IndicateCompletionToIIS(
     {
         LOG_TRACE(L"WEBSOCKET_HANDLER::IndicateCompletionToIIS");
 
+        //
+        // No IO is issued on the closed handle, nor cancelled by a late
+        // idle timeout.
+        //
+        _CleanupGate.BeginCleanup(CleanupReasonUnknown);
+        StopIdleTimer();
+
         _pHandler->SetStatus(FORWARDER_DONE);
         _fHandleClosed = TRUE;
         WinHttpCloseHandle(_hWebSocketRequest);
         _hWebSocketRequest = nullptr;
+
+        ReleaseReceiveBuffer(&_pWinHttpReceiveBuffer);
+        ReleaseReceiveBuffer(&_pIisReceiveBuffer);
+    }
+}
+
+//static
+VOID
+WEBSOCKET_HANDLER::ReleaseReceiveBuffer(
+    BYTE **     ppBuffer
+    )
+{
+    if (*ppBuffer != nullptr)
+    {
+        ENTITY_BUFFER_POOL::Free(*ppBuffer);
+        *ppBuffer = nullptr;
     }
 }
 
@@ -236,6 +307,8 @@ WEBSOCKET_HANDLER::ProcessRequest(
     FORWARDING_HANDLER *pHandler,
     IHttpContext *pHttpContext,
     HINTERNET     hRequest,
+    DWORD         dwIdleTimeout,
+    BOOL          fCoalesceFragments,
     BOOL*         pfHandleCreated
 )
 /*++
@@ -254,14 +327,28 @@ Routine Description:
 --*/
 {
     HRESULT hr = S_OK;
-    //DWORD dwBuffSize = RECEIVE_BUFFER_SIZE;
+    BOOL    fEntered = FALSE;
 
     *pfHandleCreated = FALSE;
     _pHandler = pHandler;
 
-    EnterCriticalSection(&_RequestLock);
+    _WinHttpCoalescer.Initialize(!!fCoalesceFragments, MIN_COALESCE_RECEIVE_SIZE);
+    _IisCoalescer.Initialize(!!fCoalesceFragments, MIN_COALESCE_RECEIVE_SIZE);
+
     LOG_TRACEF(L"WEBSOCKET_HANDLER::ProcessRequest");
 
+    //
+    // The initial receives are issued like the relay directions issue
+    // theirs, a cleanup racing the setup cancels them once they are.
+    //
+    if (!_CleanupGate.TryEnter())
+    {
+        hr = HRESULT_FROM_WIN32(ERROR_OPERATION_ABORTED);
+        goto Finished;
+    }
+
+    fEntered = TRUE;
+
     //
     // Cache the points to IHttpContext3
     //
@@ -300,6 +387,15 @@ Routine Description:
 
     *pfHandleCreated = TRUE;
 
+    if (dwIdleTimeout != 0)
+    {
+        //
+        // The WebSocket stays open without an idle timeout if the timer
+        // cannot be started.
+        //
+        LOG_IF_FAILED(StartIdleTimer(dwIdleTimeout));
+    }
+
     //
     // Resize the send & receive buffers to be more conservative (and avoid DoS attacks).
     // NOTE: The two WinHTTP options below were added for WinBlue, so we can't
@@ -352,7 +448,10 @@ Routine Description:
     }
 
 Finished:
-    LeaveCriticalSection(&_RequestLock);
+    if (fEntered)
+    {
+        LeavePump();
+    }
 
     if (FAILED_LOG(hr))
     {
@@ -376,17 +475,34 @@ Routine Description:
 --*/
 {
     HRESULT hr = S_OK;
-    DWORD   dwBufferSize = RECEIVE_BUFFER_SIZE;
+    DWORD   dwBufferSize;
     BOOL    fUtf8Encoded;
     BOOL    fFinalFragment;
     BOOL    fClose;
 
     LOG_TRACE(L"WEBSOCKET_HANDLER::DoIisWebSocketReceive");
 
+    //
+    // A buffer that holds the first parts of a message is filled further.
+    //
+    if (_pIisReceiveBuffer == nullptr)
+    {
+        _cbIisReceiveBuffer = _IisReceiveSize.QueryReadSize();
+        _pIisReceiveBuffer = ENTITY_BUFFER_POOL::Alloc(_cbIisReceiveBuffer);
+        if (_pIisReceiveBuffer == nullptr)
+        {
+            hr = E_OUTOFMEMORY;
+            LOG_ERRORF(L"WEBSOCKET_HANDLER::DoIisWebSocketReceive failed with %08x", hr);
+            return hr;
+        }
+    }
+
+    dwBufferSize = _cbIisReceiveBuffer - _IisCoalescer.QueryBuffered();
+
     IncrementOutstandingIo();
 
     hr = _pWebSocketContext->ReadFragment(
-            &_IisReceiveBuffer,
+            _pIisReceiveBuffer + _IisCoalescer.QueryBuffered(),
             &dwBufferSize,
             TRUE,
             &fUtf8Encoded,
@@ -397,6 +513,7 @@ Routine Description:
             nullptr);
     if (FAILED_LOG(hr))
     {
+        ReleaseReceiveBuffer(&_pIisReceiveBuffer);
         DecrementOutstandingIo();
         LOG_ERRORF(L"WEBSOCKET_HANDLER::DoIisWebSocketSend failed with %08x", hr);
     }
@@ -422,17 +539,33 @@ Routine Description:
 
     LOG_TRACE(L"WEBSOCKET_HANDLER::DoWinHttpWebSocketReceive");
 
+    //
+    // A buffer that holds the first parts of a message is filled further.
+    //
+    if (_pWinHttpReceiveBuffer == nullptr)
+    {
+        _cbWinHttpReceiveBuffer = _WinHttpReceiveSize.QueryReadSize();
+        _pWinHttpReceiveBuffer = ENTITY_BUFFER_POOL::Alloc(_cbWinHttpReceiveBuffer);
+        if (_pWinHttpReceiveBuffer == nullptr)
+        {
+            hr = E_OUTOFMEMORY;
+            LOG_ERRORF(L"WEBSOCKET_HANDLER::DoWinHttpWebSocketReceive failed with %08x", hr);
+            return hr;
+        }
+    }
+
     IncrementOutstandingIo();
 
     dwError = WINHTTP_HELPER::sm_pfnWinHttpWebSocketReceive(
                 _hWebSocketRequest,
-                &_WinHttpReceiveBuffer,
-                RECEIVE_BUFFER_SIZE,
+                _pWinHttpReceiveBuffer + _WinHttpCoalescer.QueryBuffered(),
+                _cbWinHttpReceiveBuffer - _WinHttpCoalescer.QueryBuffered(),
                 nullptr,
                 nullptr);
 
     if (dwError != NO_ERROR)
     {
+        ReleaseReceiveBuffer(&_pWinHttpReceiveBuffer);
         DecrementOutstandingIo();
         hr = HRESULT_FROM_WIN32(dwError);
         LOG_ERRORF(L"WEBSOCKET_HANDLER::DoWinHttpWebSocketReceive failed with %08x", hr);
@@ -470,13 +603,14 @@ Routine Description:
         DWORD dwError = NO_ERROR;
         USHORT uStatus = 0;
         DWORD  dwReceived = 0;
+        BYTE   rgbCloseReason[WINHTTP_WEB_SOCKET_MAX_CLOSE_REASON_LENGTH];
         STACK_STRU(strCloseReason, 128);
 
         dwError = WINHTTP_HELPER::sm_pfnWinHttpWebSocketQueryCloseStatus(
                     _hWebSocketRequest,
                     &uStatus,
-                    &_WinHttpReceiveBuffer,
-                    RECEIVE_BUFFER_SIZE,
+                    rgbCloseReason,
+                    sizeof(rgbCloseReason),
                     &dwReceived);
 
         if (dwError != NO_ERROR)
@@ -488,7 +622,7 @@ Routine Description:
         //
         // Convert close reason to WCHAR
         //
-        hr = strCloseReason.CopyA((PCSTR)&_WinHttpReceiveBuffer,
+        hr = strCloseReason.CopyA((PCSTR)rgbCloseReason,
             dwReceived);
         if (FAILED_LOG(hr))
         {
@@ -531,7 +665,7 @@ Routine Description:
         // Do the Send.
         //
         hr = _pWebSocketContext->WriteFragment(
-                &_WinHttpReceiveBuffer,
+                _pWinHttpReceiveBuffer,
                 &cbData,
                 TRUE,
                 fUtf8Encoded,
@@ -638,7 +772,7 @@ Routine Description:
         dwError = WINHTTP_HELPER::sm_pfnWinHttpWebSocketSend(
                         _hWebSocketRequest,
                         eBufferType,
-                        cbData == 0 ? nullptr : &_IisReceiveBuffer,
+                        cbData == 0 ? nullptr : _pIisReceiveBuffer,
                         cbData
                         );
     }
@@ -738,29 +872,26 @@ Routine Description:
 ++*/
 {
     HRESULT                 hr = S_OK;
-    BOOL                    fLocked = FALSE;
+    BOOL                    fEntered = FALSE;
     CleanupReason           cleanupReason = CleanupReasonUnknown;
 
     LOG_TRACE(L"WEBSOCKET_HANDLER::OnWinHttpSendComplete");
 
-    if (_fCleanupInProgress)
+    if (!_CleanupGate.TryEnter())
     {
         goto Finished;
     }
 
-    EnterCriticalSection (&_RequestLock);
-
-    fLocked = TRUE;
+    fEntered = TRUE;
 
-    if (_fCleanupInProgress)
-    {
-        goto Finished;
-    }
     //
     // Data was successfully sent to backend.
     // Initiate next receive from IIS.
     //
 
+    ReleaseReceiveBuffer(&_pIisReceiveBuffer);
+    _IisCoalescer.OnSent();
+
     hr = DoIisWebSocketReceive();
     if (FAILED_LOG(hr))
     {
@@ -768,9 +899,9 @@ Routine Description:
     }
 
 Finished:
-    if (fLocked)
+    if (fEntered)
     {
-        LeaveCriticalSection(&_RequestLock);
+        LeavePump();
     }
 
     if (FAILED_LOG(hr))
@@ -837,25 +968,46 @@ Routine Description:
 --*/
 {
     HRESULT  hr = S_OK;
-    BOOL     fLocked = FALSE;
+    BOOL     fEntered = FALSE;
     CleanupReason cleanupReason = CleanupReasonUnknown;
 
     LOG_TRACEF(L"WEBSOCKET_HANDLER::OnWinHttpReceiveComplete --%p", _pHandler);
 
-    if (_fCleanupInProgress)
+    if (!_CleanupGate.TryEnter())
     {
         goto Finished;
     }
 
-    EnterCriticalSection(&_RequestLock);
+    fEntered = TRUE;
 
-    fLocked = TRUE;
-    if (_fCleanupInProgress)
+    if (_IdleDeadline.IsEnabled())
     {
-        goto Finished;
+        _IdleDeadline.OnActivity(QueryIdleTimerTick());
+    }
+
+    if (pCompletionStatus->eBufferType != WINHTTP_WEB_SOCKET_CLOSE_BUFFER_TYPE)
+    {
+        if (!_WinHttpCoalescer.OnReceive(pCompletionStatus->dwBytesTransferred,
+                pCompletionStatus->eBufferType == WINHTTP_WEB_SOCKET_BINARY_MESSAGE_BUFFER_TYPE ||
+                pCompletionStatus->eBufferType == WINHTTP_WEB_SOCKET_UTF8_MESSAGE_BUFFER_TYPE,
+                _cbWinHttpReceiveBuffer))
+        {
+            //
+            // Receive the rest of the message behind its first parts.
+            //
+            hr = DoWinHttpWebSocketReceive();
+            if (FAILED_LOG(hr))
+            {
+                cleanupReason = ServerDisconnect;
+            }
+            goto Finished;
+        }
+
+        _WinHttpReceiveSize.OnReadComplete(_WinHttpCoalescer.QueryBuffered());
     }
+
     hr = DoIisWebSocketSend(
-            pCompletionStatus->dwBytesTransferred,
+            _WinHttpCoalescer.QueryBuffered(),
             pCompletionStatus->eBufferType
             );
 
@@ -866,9 +1018,9 @@ Routine Description:
     }
 
 Finished:
-    if (fLocked)
+    if (fEntered)
     {
-        LeaveCriticalSection(&_RequestLock);
+        LeavePump();
     }
     if (FAILED_LOG(hr))
     {
@@ -904,7 +1056,7 @@ Routine Description:
 --*/
 {
     HRESULT         hr = S_OK;
-    BOOL            fLocked = FALSE;
+    BOOL            fEntered = FALSE;
     CleanupReason   cleanupReason = CleanupReasonUnknown;
 
     UNREFERENCED_PARAMETER(cbIo);
@@ -918,17 +1070,16 @@ Routine Description:
         goto Finished;
     }
 
-    if (_fCleanupInProgress)
-    {
-        goto Finished;
-    }
-    EnterCriticalSection(&_RequestLock);
-    fLocked = TRUE;
-    if (_fCleanupInProgress)
+    if (!_CleanupGate.TryEnter())
     {
         goto Finished;
     }
 
+    fEntered = TRUE;
+
+    ReleaseReceiveBuffer(&_pWinHttpReceiveBuffer);
+    _WinHttpCoalescer.OnSent();
+
     //
     // Only call read if no close hand shake was received from backend
     //
@@ -946,9 +1097,9 @@ Routine Description:
     }
 
 Finished:
-    if (fLocked)
+    if (fEntered)
     {
-        LeaveCriticalSection(&_RequestLock);
+        LeavePump();
     }
     if (FAILED_LOG(hr))
     {
@@ -989,7 +1140,7 @@ Routine Description:
 --*/
 {
     HRESULT    hr = S_OK;
-    BOOL       fLocked = FALSE;
+    BOOL       fEntered = FALSE;
     CleanupReason cleanupReason = CleanupReasonUnknown;
     WINHTTP_WEB_SOCKET_BUFFER_TYPE  BufferType{};
 
@@ -1002,18 +1153,18 @@ Routine Description:
         goto Finished;
     }
 
-    if (_fCleanupInProgress)
+    if (!_CleanupGate.TryEnter())
     {
         goto Finished;
     }
 
-    EnterCriticalSection(&_RequestLock);
+    fEntered = TRUE;
 
-    fLocked = TRUE;
-    if (_fCleanupInProgress)
+    if (_IdleDeadline.IsEnabled())
     {
-        goto Finished;
+        _IdleDeadline.OnActivity(QueryIdleTimerTick());
     }
+
     //
     // Get Buffer Type from flags.
     //
@@ -1023,6 +1174,25 @@ Routine Description:
         fClose,
         &BufferType);
 
+    if (!fClose)
+    {
+        if (!_IisCoalescer.OnReceive(cbIO, !!fFinalFragment, _cbIisReceiveBuffer))
+        {
+            //
+            // Receive the rest of the message behind its first parts.
+            //
+            hr = DoIisWebSocketReceive();
+            if (FAILED_LOG(hr))
+            {
+                cleanupReason = ClientDisconnect;
+            }
+            goto Finished;
+        }
+
+        _IisReceiveSize.OnReadComplete(_IisCoalescer.QueryBuffered());
+        cbIO = _IisCoalescer.QueryBuffered();
+    }
+
     //
     // Initiate Send.
     //
@@ -1035,9 +1205,9 @@ Routine Description:
     }
 
 Finished:
-    if (fLocked)
+    if (fEntered)
     {
-        LeaveCriticalSection(&_RequestLock);
+        LeavePump();
     }
     if (FAILED_LOG(hr))
     {
@@ -1066,37 +1236,59 @@ Routine Description:
 
     Cleanup function for the websocket handler.
 
-    Initiates cancelIo on the two IO endpoints:
-    IIS, WinHttp client.
+    Stops both relay directions from issuing further IO and
+    cancels the IO on the two endpoints: IIS, WinHttp client.
+    If a direction is issuing IO right now, the cancellation
+    is left to it, see LeavePump.
 
 Arguments:
     CleanupReason
 --*/
 {
-    BOOL    fLocked = FALSE;
     LOG_TRACEF(L"WEBSOCKET_HANDLER::Cleanup Initiated with reason %d", reason);
 
-    if (_fCleanupInProgress)
+    _fIndicateCompletionToIis = TRUE;
+
+    if (_CleanupGate.BeginCleanup(reason))
     {
-        goto Finished;
+        CancelRelay(reason);
     }
+}
 
-    EnterCriticalSection(&_RequestLock);
+VOID
+WEBSOCKET_HANDLER::LeavePump(
+    VOID
+)
+/*++
+
+Routine Description:
 
-    fLocked = TRUE;
-    if (_fCleanupInProgress)
+    Called by a relay direction once the IO it issued after
+    entering the cleanup gate is started.
+
+    The last direction to leave after a cleanup began runs
+    the cancellation, so it also reaches that IO.
+
+--*/
+{
+    if (_CleanupGate.Leave())
     {
-        goto Finished;
+        CancelRelay(static_cast<CleanupReason>(_CleanupGate.QueryCleanupReason()));
     }
+}
 
-    _fCleanupInProgress = TRUE;
-
-    _fIndicateCompletionToIis = TRUE;
+VOID
+WEBSOCKET_HANDLER::CancelRelay(
+    CleanupReason reason
+)
+{
+    LOG_TRACEF(L"WEBSOCKET_HANDLER::CancelRelay with reason %d", reason);
 
     //
     // TODO:: Raise FREB event with cleanup reason.
     //
-    if (reason == ClientDisconnect || reason == ServerStateUnavailable)
+    if ((reason == ClientDisconnect || reason == ServerStateUnavailable || reason == IdleTimeout) &&
+        _hWebSocketRequest != nullptr)
     {
         //
         // Calling shutdown to notify the backend about disconnect
@@ -1110,7 +1302,8 @@ Arguments:
 
     }
 
-    if (reason == ServerDisconnect || reason == ServerStateUnavailable)
+    if ((reason == ServerDisconnect || reason == ServerStateUnavailable || reason == IdleTimeout) &&
+        _pHttpContext != nullptr)
     {
         _pHttpContext->CancelIo();
 
@@ -1120,10 +1313,147 @@ Arguments:
         //
         _pHttpContext->GetResponse()->ResetConnection();
     }
+}
+
+HRESULT
+WEBSOCKET_HANDLER::StartIdleTimer(
+    DWORD   dwIdleTimeout
+)
+/*++
+
+Routine Description:
+
+    Puts the WebSocket on the idle timer wheel. Messages only
+    record when they were seen, the deadline is pushed out when
+    it fires early.
+
+--*/
+{
+    SRWExclusiveLock lock(sm_IdleTimerLock);
+
+    if (sm_pIdleTimerWheel == nullptr)
+    {
+        sm_pIdleTimerWheel = new TIMER_WHEEL(QueryIdleTimerTick());
+        if (sm_pIdleTimerWheel == nullptr)
+        {
+            RETURN_HR(E_OUTOFMEMORY);
+        }
+    }
+
+    if (sm_pIdleTimer == nullptr)
+    {
+        sm_pIdleTimer = new STTIMER();
+        if (sm_pIdleTimer == nullptr)
+        {
+            RETURN_HR(E_OUTOFMEMORY);
+        }
+
+        const HRESULT hr = sm_pIdleTimer->InitializeTimer(OnIdleTimer, nullptr, 1000, 1000);
+        if (FAILED(hr))
+        {
+            delete sm_pIdleTimer;
+            sm_pIdleTimer = nullptr;
+            RETURN_HR(hr);
+        }
+    }
+
+    _IdleDeadline.Initialize(dwIdleTimeout, QueryIdleTimerTick());
+    sm_pIdleTimerWheel->Schedule(&_idleTimerEntry, _IdleDeadline.QueryDue());
+
+    return S_OK;
+}
+
+VOID
+WEBSOCKET_HANDLER::StopIdleTimer(
+    VOID
+)
+{
+    if (!_IdleDeadline.IsEnabled())
+    {
+        return;
+    }
+
+    SRWExclusiveLock lock(sm_IdleTimerLock);
+
+    if (sm_pIdleTimerWheel != nullptr)
+    {
+        sm_pIdleTimerWheel->Cancel(&_idleTimerEntry);
+    }
+}
+
+//static
+VOID
+CALLBACK
+WEBSOCKET_HANDLER::OnIdleTimer(
+    _In_ PTP_CALLBACK_INSTANCE,
+    _In_ PVOID,
+    _In_ PTP_TIMER
+)
+/*++
+
+Routine Description:
+
+    Advances the idle timer wheel and cleans up the WebSockets
+    that saw no message for their idle timeout.
+
+    The cleanup runs outside of the wheel lock with a reference
+    held on the handler, so it can neither deadlock with nor race
+    a concurrent Terminate. Like an IO completion, it also holds
+    an outstanding IO count, so the relay IO it cancels cannot
+    complete the request while the cancellation still uses the
+    IIS context and the WinHttp handle.
+
+--*/
+{
+    WEBSOCKET_HANDLER * rgpIdleHandlers[64];
+    DWORD               cIdleHandlers = 0;
+    const ULONGLONG     ullNow = QueryIdleTimerTick();
 
-Finished:
-    if (fLocked)
     {
-        LeaveCriticalSection(&_RequestLock);
+        SRWExclusiveLock lock(sm_IdleTimerLock);
+
+        if (sm_pIdleTimerWheel == nullptr)
+        {
+            return;
+        }
+
+        sm_pIdleTimerWheel->Advance(ullNow, [&](TIMER_WHEEL_ENTRY* pEntry)
+        {
+            WEBSOCKET_HANDLER *pHandler = CONTAINING_RECORD(pEntry, WEBSOCKET_HANDLER, _idleTimerEntry);
+            uint64_t ullNextDue = 0;
+
+            if (pHandler->_CleanupGate.IsCleanupStarted())
+            {
+                return;
+            }
+
+            if (!pHandler->_IdleDeadline.IsExpired(ullNow, &ullNextDue))
+            {
+                sm_pIdleTimerWheel->Schedule(pEntry, ullNextDue);
+                return;
+            }
+
+            if (cIdleHandlers == _countof(rgpIdleHandlers))
+            {
+                //
+                // Left for the next tick.
+                //
+                sm_pIdleTimerWheel->Schedule(pEntry, ullNow + 1);
+                return;
+            }
+
+            InterlockedIncrement(&pHandler->_cRefs);
+            rgpIdleHandlers[cIdleHandlers++] = pHandler;
+        });
+    }
+
+    for (DWORD i = 0; i < cIdleHandlers; i++)
+    {
+        LOG_TRACEF(L"WEBSOCKET_HANDLER::OnIdleTimer --%p", rgpIdleHandlers[i]);
+
+        rgpIdleHandlers[i]->IncrementOutstandingIo();
+        rgpIdleHandlers[i]->Cleanup(IdleTimeout);
+        rgpIdleHandlers[i]->DecrementOutstandingIo();
+        rgpIdleHandlers[i]->DereferenceHandler();
     }
 }
@@ -41,6 +41,8 @@ public:
         FORWARDING_HANDLER *pHandler,
         IHttpContext * pHttpContext,
         HINTERNET      hRequest,
+        DWORD          dwIdleTimeout,
+        BOOL           fCoalesceFragments,
         BOOL*          pfHandleCreated
         );
 
@@ -128,6 +130,16 @@ private:
         CleanupReason  reason
         );
 
+    VOID
+    LeavePump(
+        VOID
+        );
+
+    VOID
+    CancelRelay(
+        CleanupReason  reason
+        );
+
     HRESULT
     DoIisWebSocketReceive(
         VOID
@@ -180,9 +192,66 @@ private:
         VOID
     );
 
+    static
+    VOID
+    ReleaseReceiveBuffer(
+        BYTE **     ppBuffer
+    );
+
+    VOID
+    DereferenceHandler(
+        VOID
+    );
+
+    HRESULT
+    StartIdleTimer(
+        DWORD       dwIdleTimeout
+    );
+
+    VOID
+    StopIdleTimer(
+        VOID
+    );
+
+    static
+    VOID
+    CALLBACK
+    OnIdleTimer(
+        _In_ PTP_CALLBACK_INSTANCE  Instance,
+        _In_ PVOID                  Context,
+        _In_ PTP_TIMER              Timer
+    );
+
+    //
+    // Idle deadlines are kept in seconds.
+    //
+    static
+    ULONGLONG
+    QueryIdleTimerTick(
+        VOID
+    )
+    {
+        return GetTickCount64() / 1000;
+    }
+
 private:
+    //
+    // Receive buffers come from ENTITY_BUFFER_POOL when a receive is issued
+    // and go back once the relayed send completed. They start at the
+    // smallest size class and grow for bulk streams.
+    //
     static const
-    DWORD               RECEIVE_BUFFER_SIZE = 4*1024;
+    DWORD               MIN_RECEIVE_BUFFER_SIZE = 1024;
+
+    static const
+    DWORD               MAX_RECEIVE_BUFFER_SIZE = 64*1024;
+
+    //
+    // With coalescing, the parts of a message are held while at least this
+    // much of the receive buffer is left for the next receive.
+    //
+    static const
+    DWORD               MIN_COALESCE_RECEIVE_SIZE = 256;
 
     LIST_ENTRY          _listEntry;
 
@@ -194,16 +263,39 @@ private:
 
     HINTERNET           _hWebSocketRequest;
 
-    BYTE                _WinHttpReceiveBuffer[RECEIVE_BUFFER_SIZE];
+    BYTE *              _pWinHttpReceiveBuffer;
+
+    BYTE *              _pIisReceiveBuffer;
+
+    READ_SIZE_CONTROLLER _WinHttpReceiveSize;
+
+    READ_SIZE_CONTROLLER _IisReceiveSize;
 
-    BYTE                _IisReceiveBuffer[RECEIVE_BUFFER_SIZE];
+    DWORD               _cbWinHttpReceiveBuffer;
 
-    CRITICAL_SECTION    _RequestLock;
+    DWORD               _cbIisReceiveBuffer;
+
+    FRAGMENT_COALESCER  _WinHttpCoalescer;
+
+    FRAGMENT_COALESCER  _IisCoalescer;
+
+    //
+    // The two relay directions run independently, each only has one IO
+    // outstanding at a time. Only cleanup coordinates with them.
+    //
+    RELAY_CLEANUP_GATE  _CleanupGate;
 
     LONG                _dwOutstandingIo;
 
-    volatile
-    BOOL                _fCleanupInProgress;
+    //
+    // One for the forwarding handler, one while the idle timer closes the
+    // WebSocket.
+    //
+    LONG                _cRefs;
+
+    TIMER_WHEEL_ENTRY   _idleTimerEntry;
+
+    IDLE_DEADLINE       _IdleDeadline;
 
     volatile
     BOOL                _fIndicateCompletionToIis;
@@ -222,4 +314,17 @@ private:
 
     static
     TRACE_LOG *         sm_pTraceLog;
+
+    //
+    // Idle timeouts of all WebSockets are driven by one timer wheel that
+    // is advanced every second.
+    //
+    static
+    SRWLOCK             sm_IdleTimerLock;
+
+    static
+    TIMER_WHEEL *       sm_pIdleTimerWheel;
+
+    static
+    STTIMER *           sm_pIdleTimer;
 };
@@ -0,0 +1,187 @@
+// Copyright (c) .NET Foundation. All rights reserved.
+// Licensed under the MIT License. See License.txt in the project root for license information.
+
+#include "stdafx.h"
+#include "admissionqueue.h"
+
+void
+ADMISSION_QUEUE::Initialize(
+    uint32_t    cMaxWaiters,
+    uint64_t    ullTimeoutMs
+) noexcept
+{
+    std::lock_guard<std::mutex> lock(m_lock);
+
+    m_cMaxWaiters = cMaxWaiters;
+    m_ullTimeoutMs = ullTimeoutMs;
+}
+
+bool
+ADMISSION_QUEUE::Enqueue(
+    ADMISSION_WAITER   *pWaiter,
+    uint64_t            ullNowMs
+) noexcept
+{
+    std::lock_guard<std::mutex> lock(m_lock);
+
+    if (m_fClosed || m_cWaiters >= m_cMaxWaiters)
+    {
+        return false;
+    }
+
+    pWaiter->m_ullDeadlineMs = ullNowMs + m_ullTimeoutMs;
+    pWaiter->m_pNextWaiter = nullptr;
+    pWaiter->m_pPrevWaiter = m_pTail;
+    pWaiter->m_fQueued = true;
+
+    if (m_pTail != nullptr)
+    {
+        m_pTail->m_pNextWaiter = pWaiter;
+    }
+    else
+    {
+        m_pHead = pWaiter;
+    }
+    m_pTail = pWaiter;
+    m_cWaiters++;
+
+    return true;
+}
+
+bool
+ADMISSION_QUEUE::Remove(
+    ADMISSION_WAITER   *pWaiter
+) noexcept
+{
+    std::lock_guard<std::mutex> lock(m_lock);
+
+    if (!pWaiter->m_fQueued)
+    {
+        return false;
+    }
+
+    UnlinkNoLock(pWaiter);
+    return true;
+}
+
+void
+ADMISSION_QUEUE::CompleteAll(
+    HRESULT     hr
+) noexcept
+{
+    ADMISSION_WAITER *pList = nullptr;
+
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+
+        pList = m_pHead;
+        for (ADMISSION_WAITER *pWaiter = pList; pWaiter != nullptr; pWaiter = pWaiter->m_pNextWaiter)
+        {
+            pWaiter->m_fQueued = false;
+        }
+        m_pHead = nullptr;
+        m_pTail = nullptr;
+        m_cWaiters = 0;
+    }
+
+    Complete(pList, hr);
+}
+
+void
+ADMISSION_QUEUE::ExpireWaiters(
+    uint64_t    ullNowMs,
+    HRESULT     hrTimeout
+) noexcept
+{
+    ADMISSION_WAITER *pList = nullptr;
+    ADMISSION_WAITER *pLast = nullptr;
+
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+
+        while (m_pHead != nullptr && m_pHead->m_ullDeadlineMs <= ullNowMs)
+        {
+            ADMISSION_WAITER *pWaiter = m_pHead;
+            UnlinkNoLock(pWaiter);
+
+            if (pLast != nullptr)
+            {
+                pLast->m_pNextWaiter = pWaiter;
+            }
+            else
+            {
+                pList = pWaiter;
+            }
+            pLast = pWaiter;
+        }
+    }
+
+    Complete(pList, hrTimeout);
+}
+
+void
+ADMISSION_QUEUE::Close(
+    HRESULT     hr
+) noexcept
+{
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+        m_fClosed = true;
+    }
+
+    CompleteAll(hr);
+}
+
+uint32_t
+ADMISSION_QUEUE::QueryCount() const noexcept
+{
+    std::lock_guard<std::mutex> lock(m_lock);
+    return m_cWaiters;
+}
+
+void
+ADMISSION_QUEUE::UnlinkNoLock(
+    ADMISSION_WAITER   *pWaiter
+) noexcept
+{
+    if (pWaiter->m_pPrevWaiter != nullptr)
+    {
+        pWaiter->m_pPrevWaiter->m_pNextWaiter = pWaiter->m_pNextWaiter;
+    }
+    else
+    {
+        m_pHead = pWaiter->m_pNextWaiter;
+    }
+
+    if (pWaiter->m_pNextWaiter != nullptr)
+    {
+        pWaiter->m_pNextWaiter->m_pPrevWaiter = pWaiter->m_pPrevWaiter;
+    }
+    else
+    {
+        m_pTail = pWaiter->m_pPrevWaiter;
+    }
+
+    pWaiter->m_pNextWaiter = nullptr;
+    pWaiter->m_pPrevWaiter = nullptr;
+    pWaiter->m_fQueued = false;
+    m_cWaiters--;
+}
+
+// static
+void
+ADMISSION_QUEUE::Complete(
+    ADMISSION_WAITER   *pList,
+    HRESULT             hr
+) noexcept
+{
+    while (pList != nullptr)
+    {
+        // the waiter may be gone once completed
+        ADMISSION_WAITER *pNext = pList->m_pNextWaiter;
+        pList->m_pNextWaiter = nullptr;
+        pList->m_pPrevWaiter = nullptr;
+        pList->OnAdmissionComplete(hr);
+        pList = pNext;
+    }
+}
@@ -0,0 +1,147 @@
+// Copyright (c) .NET Foundation. All rights reserved.
+// Licensed under the MIT License. See License.txt in the project root for license information.
+
+#pragma once
+
+#include <cstdint>
+#include <mutex>
+
+class ADMISSION_QUEUE;
+
+//
+// A request waiting for a backend process to become ready.
+//
+class ADMISSION_WAITER
+{
+public:
+
+    virtual
+    ~ADMISSION_WAITER() = default;
+
+    //
+    // Called exactly once for every queued waiter, outside of the queue
+    // lock, with S_OK once a process is ready or the error that ended the
+    // wait. The waiter may be destroyed from within the call.
+    //
+    virtual
+    void
+    OnAdmissionComplete(
+        HRESULT     hr
+    ) noexcept = 0;
+
+private:
+
+    friend class ADMISSION_QUEUE;
+
+    ADMISSION_WAITER   *m_pNextWaiter = nullptr;
+    ADMISSION_WAITER   *m_pPrevWaiter = nullptr;
+    uint64_t            m_ullDeadlineMs = 0;
+    bool                m_fQueued = false;
+};
+
+//
+// Bounded FIFO of requests parked while no backend process is ready.
+//
+// Every waiter gets the same time limit, so the waiters that time out are
+// always at the head of the queue. Waiters are intrusive, the queue never
+// allocates.
+//
+class ADMISSION_QUEUE
+{
+public:
+
+    ADMISSION_QUEUE() noexcept
+        : m_pHead(nullptr),
+          m_pTail(nullptr),
+          m_cWaiters(0),
+          m_cMaxWaiters(0),
+          m_ullTimeoutMs(0),
+          m_fClosed(false)
+    {
+    }
+
+    ADMISSION_QUEUE(const ADMISSION_QUEUE&) = delete;
+    ADMISSION_QUEUE& operator=(const ADMISSION_QUEUE&) = delete;
+
+    //
+    // A queue length of 0 disables queuing.
+    //
+    void
+    Initialize(
+        uint32_t    cMaxWaiters,
+        uint64_t    ullTimeoutMs
+    ) noexcept;
+
+    bool
+    IsEnabled() const noexcept
+    {
+        return m_cMaxWaiters != 0;
+    }
+
+    //
+    // Returns false if the queue is full, disabled or closed, the caller
+    // fails the request right away.
+    //
+    bool
+    Enqueue(
+        ADMISSION_WAITER   *pWaiter,
+        uint64_t            ullNowMs
+    ) noexcept;
+
+    //
+    // Returns false if the waiter was not queued, e.g. because it has
+    // already been completed.
+    //
+    bool
+    Remove(
+        ADMISSION_WAITER   *pWaiter
+    ) noexcept;
+
+    void
+    CompleteAll(
+        HRESULT     hr
+    ) noexcept;
+
+    //
+    // Completes the waiters queued for longer than the time limit with
+    // hrTimeout.
+    //
+    void
+    ExpireWaiters(
+        uint64_t    ullNowMs,
+        HRESULT     hrTimeout
+    ) noexcept;
+
+    //
+    // Completes all waiters with hr and rejects new ones.
+    //
+    void
+    Close(
+        HRESULT     hr
+    ) noexcept;
+
+    uint32_t
+    QueryCount() const noexcept;
+
+private:
+
+    void
+    UnlinkNoLock(
+        ADMISSION_WAITER   *pWaiter
+    ) noexcept;
+
+    static
+    void
+    Complete(
+        ADMISSION_WAITER   *pList,
+        HRESULT             hr
+    ) noexcept;
+
+    mutable std::mutex  m_lock;
+    ADMISSION_WAITER   *m_pHead;
+    ADMISSION_WAITER   *m_pTail;
+    uint32_t            m_cWaiters;
+    uint32_t            m_cMaxWaiters;
+    uint64_t            m_ullTimeoutMs;
+    bool                m_fClosed;
+};
@@ -0,0 +1,103 @@
+// Copyright (c) .NET Foundation. All rights reserved.
+// Licensed under the MIT License. See License.txt in the project root for license information.
+
+#pragma once
+
+#include <cstdint>
+
+//
+// Frames a request entity with the chunked transfer coding without touching
+// the payload buffers.
+//
+// Every chunk is described as a size line segment followed by the payload
+// segment. The CRLF that ends a chunk's data is carried at the front of the
+// next size line, or of the last chunk, so a chunk takes two writes instead
+// of three.
+//
+class CHUNK_ENCODER
+{
+public:
+
+    struct SEGMENT
+    {
+        const uint8_t  *pbData;
+        uint32_t        cbData;
+    };
+
+    //
+    // CRLF ending the previous chunk, up to 8 hex digits and CRLF.
+    //
+    static constexpr uint32_t   MAX_SIZE_LINE = 2 + 8 + 2;
+
+    static constexpr uint32_t   SEGMENTS_PER_CHUNK = 2;
+
+    void
+    Reset() noexcept
+    {
+        m_fChunkOpen = false;
+    }
+
+    //
+    // Fills rgSegments with the size line and the payload, the size line
+    // stays valid until the next call. cbPayload must not be 0, an empty
+    // chunk would end the entity.
+    //
+    uint32_t
+    EncodeChunk(
+        const uint8_t  *pbPayload,
+        uint32_t        cbPayload,
+        SEGMENT        *rgSegments
+    ) noexcept
+    {
+        static constexpr char HEX_DIGITS[] = "0123456789abcdef";
+
+        uint32_t cchSizeLine = 0;
+        if (m_fChunkOpen)
+        {
+            m_rgSizeLine[cchSizeLine++] = '\r';
+            m_rgSizeLine[cchSizeLine++] = '\n';
+        }
+
+        uint32_t cDigits = 1;
+        while (cDigits < 8 && (cbPayload >> (cDigits * 4)) != 0)
+        {
+            cDigits++;
+        }
+
+        for (uint32_t i = cDigits; i > 0; i--)
+        {
+            m_rgSizeLine[cchSizeLine++] = static_cast<uint8_t>(HEX_DIGITS[(cbPayload >> ((i - 1) * 4)) & 0xf]);
+        }
+        m_rgSizeLine[cchSizeLine++] = '\r';
+        m_rgSizeLine[cchSizeLine++] = '\n';
+
+        rgSegments[0].pbData = m_rgSizeLine;
+        rgSegments[0].cbData = cchSizeLine;
+        rgSegments[1].pbData = pbPayload;
+        rgSegments[1].cbData = cbPayload;
+
+        m_fChunkOpen = true;
+        return SEGMENTS_PER_CHUNK;
+    }
+
+    //
+    // The last chunk, closing the open chunk if there is one.
+    //
+    SEGMENT
+    EncodeLastChunk() noexcept
+    {
+        static constexpr uint8_t LAST_CHUNK[] = "\r\n0\r\n\r\n";
+
+        SEGMENT segment;
+        segment.pbData = m_fChunkOpen ? LAST_CHUNK : LAST_CHUNK + 2;
+        segment.cbData = m_fChunkOpen ? sizeof(LAST_CHUNK) - 1 : sizeof(LAST_CHUNK) - 3;
+
+        m_fChunkOpen = false;
+        return segment;
+    }
+
+private:
+
+    uint8_t     m_rgSizeLine[MAX_SIZE_LINE] = {};
+    bool        m_fChunkOpen = false;
+};
@@ -0,0 +1,122 @@
+// Copyright (c) .NET Foundation. All rights reserved.
+// Licensed under the MIT License. See License.txt in the project root for license information.
+
+#include "stdafx.h"
+#include "collapsedrequests.h"
+
+bool
+COLLAPSED_REQUEST_REGISTRY::Join(
+    const std::string&          strKey,
+    COLLAPSED_REQUEST_WAITER   *pWaiter,
+    uint64_t                    ullNowMs
+)
+{
+    SHARD& shard = GetShard(strKey);
+    std::lock_guard<std::mutex> lock(shard.lock);
+
+    const auto result = shard.followers.emplace(strKey, nullptr);
+    if (result.second)
+    {
+        return true;
+    }
+
+    pWaiter->m_ullCollapsedDeadlineMs = ullNowMs + (std::min)(m_ullTimeoutMs, UINT64_MAX - ullNowMs);
+    pWaiter->m_pNextCollapsedWaiter = result.first->second;
+    result.first->second = pWaiter;
+    return false;
+}
+
+uint32_t
+COLLAPSED_REQUEST_REGISTRY::Release(
+    const std::string&  strKey
+) noexcept
+{
+    SHARD& shard = GetShard(strKey);
+    COLLAPSED_REQUEST_WAITER *pList = nullptr;
+
+    {
+        std::lock_guard<std::mutex> lock(shard.lock);
+
+        const auto iter = shard.followers.find(strKey);
+        if (iter == shard.followers.end())
+        {
+            return 0;
+        }
+
+        pList = iter->second;
+        shard.followers.erase(iter);
+    }
+
+    return Complete(pList);
+}
+
+uint32_t
+COLLAPSED_REQUEST_REGISTRY::ExpireFollowers(
+    uint64_t    ullNowMs
+) noexcept
+{
+    COLLAPSED_REQUEST_WAITER *pList = nullptr;
+
+    for (SHARD& shard : m_rgShards)
+    {
+        std::lock_guard<std::mutex> lock(shard.lock);
+
+        for (auto& entry : shard.followers)
+        {
+            COLLAPSED_REQUEST_WAITER **ppWaiter = &entry.second;
+            while (*ppWaiter != nullptr)
+            {
+                COLLAPSED_REQUEST_WAITER *pWaiter = *ppWaiter;
+                if (pWaiter->m_ullCollapsedDeadlineMs <= ullNowMs)
+                {
+                    *ppWaiter = pWaiter->m_pNextCollapsedWaiter;
+                    pWaiter->m_pNextCollapsedWaiter = pList;
+                    pList = pWaiter;
+                }
+                else
+                {
+                    ppWaiter = &pWaiter->m_pNextCollapsedWaiter;
+                }
+            }
+        }
+    }
+
+    return Complete(pList);
+}
+
+uint32_t
+COLLAPSED_REQUEST_REGISTRY::Complete(
+    COLLAPSED_REQUEST_WAITER   *pList
+) noexcept
+{
+    uint32_t cCompleted = 0;
+
+    while (pList != nullptr)
+    {
+        //
+        // The waiter may be gone once it is completed.
+        //
+        COLLAPSED_REQUEST_WAITER *pWaiter = pList;
+        pList = pList->m_pNextCollapsedWaiter;
+        pWaiter->m_pNextCollapsedWaiter = nullptr;
+
+        pWaiter->OnCollapsedRequestComplete();
+        cCompleted++;
+    }
+
+    return cCompleted;
+}
+
+uint32_t
+COLLAPSED_REQUEST_REGISTRY::QueryCount() const noexcept
+{
+    uint32_t cKeys = 0;
+
+    for (const SHARD& shard : m_rgShards)
+    {
+        std::lock_guard<std::mutex> lock(shard.lock);
+        cKeys += static_cast<uint32_t>(shard.followers.size());
+    }
+
+    return cKeys;
+}
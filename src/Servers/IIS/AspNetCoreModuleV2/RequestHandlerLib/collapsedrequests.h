@@ -0,0 +1,136 @@
+// Copyright (c) .NET Foundation. All rights reserved.
+// Licensed under the MIT License. See License.txt in the project root for license information.
+
+#pragma once
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+class COLLAPSED_REQUEST_REGISTRY;
+
+//
+// A request waiting for an identical request to fetch the response it
+// needs.
+//
+class COLLAPSED_REQUEST_WAITER
+{
+public:
+
+    virtual
+    ~COLLAPSED_REQUEST_WAITER() = default;
+
+    //
+    // Called exactly once for every follower, outside of the registry
+    // lock, once the leader is done or the follower waited too long. The
+    // leader may have failed or its response may not have been cacheable.
+    // The waiter may be destroyed from within the call.
+    //
+    virtual
+    void
+    OnCollapsedRequestComplete() noexcept = 0;
+
+private:
+
+    friend class COLLAPSED_REQUEST_REGISTRY;
+
+    COLLAPSED_REQUEST_WAITER   *m_pNextCollapsedWaiter = nullptr;
+    uint64_t                    m_ullCollapsedDeadlineMs = 0;
+};
+
+//
+// Tracks the cache misses being fetched from the backend so identical
+// requests arriving meanwhile wait for the first one, the leader, instead
+// of all going to the backend.
+//
+// Keys are spread over shards with a lock each, requests for different
+// URLs rarely contend. Followers are intrusive, only the first request
+// for a key allocates. A follower waits at most the configured time, a
+// slow leader does not hold its followers back any longer than that.
+//
+class COLLAPSED_REQUEST_REGISTRY
+{
+public:
+
+    static constexpr uint32_t   SHARD_COUNT = 16;
+
+    COLLAPSED_REQUEST_REGISTRY() = default;
+
+    COLLAPSED_REQUEST_REGISTRY(const COLLAPSED_REQUEST_REGISTRY&) = delete;
+    COLLAPSED_REQUEST_REGISTRY& operator=(const COLLAPSED_REQUEST_REGISTRY&) = delete;
+
+    void
+    Initialize(
+        uint64_t    ullTimeoutMs
+    ) noexcept
+    {
+        m_ullTimeoutMs = ullTimeoutMs;
+    }
+
+    //
+    // Returns true if the caller leads the fetch of strKey and must call
+    // Release once done. Otherwise pWaiter follows the current leader and
+    // is completed by its Release, or by ExpireFollowers once it waited
+    // for longer than the time limit.
+    //
+    bool
+    Join(
+        const std::string&          strKey,
+        COLLAPSED_REQUEST_WAITER   *pWaiter,
+        uint64_t                    ullNowMs
+    );
+
+    //
+    // Ends the leader's fetch of strKey and completes its followers.
+    // Returns the number of followers completed.
+    //
+    uint32_t
+    Release(
+        const std::string&  strKey
+    ) noexcept;
+
+    //
+    // Completes the followers whose time limit passed at ullNowMs, they
+    // stop waiting and fetch the response themselves. Their leaders keep
+    // their keys. Returns the number of followers completed.
+    //
+    uint32_t
+    ExpireFollowers(
+        uint64_t    ullNowMs
+    ) noexcept;
+
+    //
+    // Number of keys being fetched.
+    //
+    uint32_t
+    QueryCount() const noexcept;
+
+private:
+
+    //
+    // In-flight keys and the followers waiting on each of them.
+    //
+    struct SHARD
+    {
+        mutable std::mutex                                                  lock;
+        std::unordered_map<std::string, COLLAPSED_REQUEST_WAITER*>          followers;
+    };
+
+    SHARD &
+    GetShard(
+        const std::string&  strKey
+    ) noexcept
+    {
+        return m_rgShards[std::hash<std::string>()(strKey) % SHARD_COUNT];
+    }
+
+    static
+    uint32_t
+    Complete(
+        COLLAPSED_REQUEST_WAITER   *pList
+    ) noexcept;
+
+    SHARD       m_rgShards[SHARD_COUNT];
+    uint64_t    m_ullTimeoutMs = UINT64_MAX;
+};
@@ -0,0 +1,178 @@
+// Copyright (c) .NET Foundation. All rights reserved.
+// Licensed under the MIT License. See License.txt in the project root for license information.
+
+#include "stdafx.h"
+#include "acache.h"
+#include "entitybufferpool.h"
+#include "exceptions.h"
+
+#define ENTITY_BUFFER_SIGNATURE         ((DWORD)'EBUF')
+#define ENTITY_BUFFER_SIGNATURE_FREE    ((DWORD)'ebuf')
+
+//
+// Number of bytes each size class may keep cached per CPU.
+//
+#define ENTITY_BUFFER_CACHE_PER_CPU     (256 * 1024)
+#define ENTITY_BUFFER_MAX_THRESHOLD     64
+
+//
+// Every buffer is preceded by a header recording the size class it came from.
+// The header is padded to MEMORY_ALLOCATION_ALIGNMENT so the entity data keeps
+// the alignment of the underlying heap allocation.
+//
+struct ENTITY_BUFFER_HEADER
+{
+    DWORD   dwSignature;
+    DWORD   dwSizeClass;
+};
+
+#define ENTITY_BUFFER_HEADER_SIZE       MEMORY_ALLOCATION_ALIGNMENT
+C_ASSERT(sizeof(ENTITY_BUFFER_HEADER) <= ENTITY_BUFFER_HEADER_SIZE);
+
+ALLOC_CACHE_HANDLER * ENTITY_BUFFER_POOL::sm_rgpAlloc[ENTITY_BUFFER_POOL::SIZE_CLASSES] = {};
+
+// static
+HRESULT
+ENTITY_BUFFER_POOL::StaticInitialize(
+    VOID
+)
+{
+    HRESULT hr = S_OK;
+
+    for (DWORD i = 0; i < SIZE_CLASSES; i++)
+    {
+        const DWORD cbClass = MIN_BUFFER_SIZE << i;
+
+        //
+        // Keep roughly the same number of bytes cached for every size class,
+        // so large classes only hold on to a handful of buffers per CPU.
+        //
+        LONG nThreshold = ENTITY_BUFFER_CACHE_PER_CPU / cbClass;
+        if (nThreshold > ENTITY_BUFFER_MAX_THRESHOLD)
+        {
+            nThreshold = ENTITY_BUFFER_MAX_THRESHOLD;
+        }
+        else if (nThreshold < 1)
+        {
+            nThreshold = 1;
+        }
+
+        FINISHED_IF_NULL_ALLOC(sm_rgpAlloc[i] = new ALLOC_CACHE_HANDLER);
+        FINISHED_IF_FAILED(sm_rgpAlloc[i]->Initialize(ENTITY_BUFFER_HEADER_SIZE + cbClass, nThreshold));
+    }
+
+Finished:
+    if (FAILED_LOG(hr))
+    {
+        StaticTerminate();
+    }
+    return hr;
+}
+
+// static
+VOID
+ENTITY_BUFFER_POOL::StaticTerminate(
+    VOID
+)
+{
+    for (DWORD i = 0; i < SIZE_CLASSES; i++)
+    {
+        if (sm_rgpAlloc[i] != nullptr)
+        {
+            delete sm_rgpAlloc[i];
+            sm_rgpAlloc[i] = nullptr;
+        }
+    }
+}
+
+// static
+DWORD
+ENTITY_BUFFER_POOL::QuerySizeClass(
+    DWORD   cbBuffer
+)
+{
+    DWORD dwSizeClass = 0;
+    DWORD cbClass = MIN_BUFFER_SIZE;
+
+    while (cbClass < cbBuffer && dwSizeClass < SIZE_CLASSES)
+    {
+        cbClass <<= 1;
+        dwSizeClass++;
+    }
+
+    //
+    // SIZE_CLASSES means the buffer is too large to be pooled.
+    //
+    return dwSizeClass;
+}
+
+// static
+BYTE *
+ENTITY_BUFFER_POOL::Alloc(
+    _In_ DWORD          cbBuffer,
+    _Out_opt_ DWORD *   pcbBuffer
+)
+{
+    ENTITY_BUFFER_HEADER *  pHeader = nullptr;
+    DWORD                   dwSizeClass = QuerySizeClass(cbBuffer);
+    DWORD                   cbUsable = 0;
+
+    if (dwSizeClass < SIZE_CLASSES && sm_rgpAlloc[dwSizeClass] != nullptr)
+    {
+        pHeader = static_cast<ENTITY_BUFFER_HEADER *>(sm_rgpAlloc[dwSizeClass]->Alloc());
+        cbUsable = MIN_BUFFER_SIZE << dwSizeClass;
+    }
+    else
+    {
+        if (cbBuffer > MAXDWORD - ENTITY_BUFFER_HEADER_SIZE)
+        {
+            return nullptr;
+        }
+
+        dwSizeClass = SIZE_CLASSES;
+        pHeader = static_cast<ENTITY_BUFFER_HEADER *>(HeapAlloc(GetProcessHeap(),
+            0, // dwFlags
+            ENTITY_BUFFER_HEADER_SIZE + cbBuffer));
+        cbUsable = cbBuffer;
+    }
+
+    if (pHeader == nullptr)
+    {
+        return nullptr;
+    }
+
+    pHeader->dwSignature = ENTITY_BUFFER_SIGNATURE;
+    pHeader->dwSizeClass = dwSizeClass;
+
+    if (pcbBuffer != nullptr)
+    {
+        *pcbBuffer = cbUsable;
+    }
+
+    return reinterpret_cast<BYTE *>(pHeader) + ENTITY_BUFFER_HEADER_SIZE;
+}
+
+// static
+VOID
+ENTITY_BUFFER_POOL::Free(
+    _In_ BYTE *     pBuffer
+)
+{
+    DBG_ASSERT(pBuffer != nullptr);
+
+    ENTITY_BUFFER_HEADER * pHeader = reinterpret_cast<ENTITY_BUFFER_HEADER *>(pBuffer - ENTITY_BUFFER_HEADER_SIZE);
+    DBG_ASSERT(pHeader->dwSignature == ENTITY_BUFFER_SIGNATURE);
+    pHeader->dwSignature = ENTITY_BUFFER_SIGNATURE_FREE;
+
+    const DWORD dwSizeClass = pHeader->dwSizeClass;
+    if (dwSizeClass < SIZE_CLASSES && sm_rgpAlloc[dwSizeClass] != nullptr)
+    {
+        sm_rgpAlloc[dwSizeClass]->Free(pHeader);
+    }
+    else
+    {
+        HeapFree(GetProcessHeap(),
+            0, // dwFlags
+            pHeader);
+    }
+}
@@ -0,0 +1,65 @@
+// Copyright (c) .NET Foundation. All rights reserved.
+// Licensed under the MIT License. See License.txt in the project root for license information.
+
+#pragma once
+
+class ALLOC_CACHE_HANDLER;
+
+//
+// ENTITY_BUFFER_POOL hands out request/response entity buffers in
+// power-of-two size classes. Every size class is backed by an
+// ALLOC_CACHE_HANDLER, so released buffers are recycled through per-CPU
+// lookaside lists instead of going back to the process heap.
+// Requests larger than the biggest size class are served from the heap.
+//
+class ENTITY_BUFFER_POOL
+{
+public:
+
+    static
+    HRESULT
+    StaticInitialize(
+        VOID
+    );
+
+    static
+    VOID
+    StaticTerminate(
+        VOID
+    );
+
+    //
+    // Returns a buffer with at least cbBuffer usable bytes, nullptr on failure.
+    // The usable size of the buffer is returned in pcbBuffer if requested.
+    //
+    static
+    BYTE *
+    Alloc(
+        _In_ DWORD              cbBuffer,
+        _Out_opt_ DWORD *       pcbBuffer = nullptr
+    );
+
+    static
+    VOID
+    Free(
+        _In_ BYTE *             pBuffer
+    );
+
+    static const DWORD          MIN_BUFFER_SIZE = 1024;
+    static const DWORD          MAX_BUFFER_SIZE = 256 * 1024;
+
+private:
+
+    static
+    DWORD
+    QuerySizeClass(
+        DWORD                   cbBuffer
+    );
+
+    //
+    // 1 KB, 2 KB, ... 256 KB
+    //
+    static const DWORD          SIZE_CLASSES = 9;
+
+    static ALLOC_CACHE_HANDLER* sm_rgpAlloc[SIZE_CLASSES];
+};
@@ -0,0 +1,87 @@
+// Copyright (c) .NET Foundation. All rights reserved.
+// Licensed under the MIT License. See License.txt in the project root for license information.
+
+#pragma once
+
+#include <cstdint>
+
+//
+// Decides when a relayed WebSocket direction sends what it received.
+//
+// IIS and WinHTTP complete a receive with whatever part of a message has
+// arrived, so a small message can take several completions, and the relay
+// forwarded each one as a frame of its own. When coalescing is enabled, the
+// parts of a message that is not finished yet stay in the receive buffer and
+// the next receive goes behind them. The message is sent in one frame once
+// its final part arrived, or earlier if too little of the buffer is left for
+// another receive.
+//
+// Separate messages are never merged, because each IIS or WinHTTP send call
+// writes exactly one frame. Message boundaries and ordering stay those of the
+// sender.
+//
+class FRAGMENT_COALESCER
+{
+public:
+
+    void
+    Initialize(
+        bool        fEnabled,
+        uint32_t    cbMinReceive
+    ) noexcept
+    {
+        m_fEnabled = fEnabled;
+        m_cbMinReceive = cbMinReceive;
+        m_cbBuffered = 0;
+    }
+
+    bool
+    IsEnabled() const noexcept
+    {
+        return m_fEnabled;
+    }
+
+    //
+    // Bytes held in the receive buffer, the next receive goes behind them.
+    //
+    uint32_t
+    QueryBuffered() const noexcept
+    {
+        return m_cbBuffered;
+    }
+
+    //
+    // Records a receive of cbReceived bytes into a buffer of cbBuffer bytes.
+    // True if everything buffered has to be sent now, false to receive more
+    // of the message into the rest of the buffer.
+    //
+    bool
+    OnReceive(
+        uint32_t    cbReceived,
+        bool        fFinalFragment,
+        uint32_t    cbBuffer
+    ) noexcept
+    {
+        m_cbBuffered += cbReceived;
+
+        return !m_fEnabled ||
+            fFinalFragment ||
+            cbReceived == 0 ||
+            cbBuffer - m_cbBuffered < m_cbMinReceive;
+    }
+
+    //
+    // The buffered bytes were sent.
+    //
+    void
+    OnSent() noexcept
+    {
+        m_cbBuffered = 0;
+    }
+
+private:
+
+    bool        m_fEnabled = false;
+    uint32_t    m_cbMinReceive = 0;
+    uint32_t    m_cbBuffered = 0;
+};
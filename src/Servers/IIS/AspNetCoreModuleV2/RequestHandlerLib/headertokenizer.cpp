@@ -0,0 +1,288 @@
+// Copyright (c) .NET Foundation. All rights reserved.
+// Licensed under the MIT License. See License.txt in the project root for license information.
+
+#include "stdafx.h"
+#include "headertokenizer.h"
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#include <emmintrin.h>
+#define HEADER_TOKENIZER_USE_SSE2
+#endif
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace
+{
+    inline
+    bool
+    IsWhitespace(
+        char ch
+    ) noexcept
+    {
+        return ch == ' ' || ch == '\t';
+    }
+
+    constexpr size_t BLOCK_SIZE = 16;
+
+    inline
+    size_t
+    LowestSetBit(
+        unsigned int mask
+    ) noexcept
+    {
+#if defined(_MSC_VER)
+        unsigned long index;
+        _BitScanForward(&index, mask);
+        return index;
+#else
+        return static_cast<size_t>(__builtin_ctz(mask));
+#endif
+    }
+
+    //
+    // Sets a bit for every '\n' and every ':' among the cch bytes at pch,
+    // cch is at most BLOCK_SIZE.
+    //
+    inline
+    void
+    MatchDelimiters(
+        const char *    pch,
+        size_t          cch,
+        unsigned int *  pNewLines,
+        unsigned int *  pColons
+    ) noexcept
+    {
+#ifdef HEADER_TOKENIZER_USE_SSE2
+        if (cch == BLOCK_SIZE)
+        {
+            const __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i *>(pch));
+            *pNewLines = static_cast<unsigned int>(_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, _mm_set1_epi8('\n'))));
+            *pColons = static_cast<unsigned int>(_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, _mm_set1_epi8(':'))));
+            return;
+        }
+#endif
+
+        unsigned int newLines = 0;
+        unsigned int colons = 0;
+        for (size_t i = 0; i < cch; i++)
+        {
+            if (pch[i] == '\n')
+            {
+                newLines |= 1u << i;
+            }
+            else if (pch[i] == ':')
+            {
+                colons |= 1u << i;
+            }
+        }
+        *pNewLines = newLines;
+        *pColons = colons;
+    }
+}
+
+// static
+bool
+HEADER_TOKENIZER::FindDelimiters(
+    std::string_view    text,
+    size_t &            colon,
+    size_t &            endOfLine
+) noexcept
+{
+    colon = std::string_view::npos;
+    endOfLine = std::string_view::npos;
+
+    //
+    // Names are short, match both delimiters a block at a time until the
+    // ':'. A '\n' before it means the line has no name.
+    //
+    size_t position = 0;
+    while (colon == std::string_view::npos)
+    {
+        if (position >= text.size())
+        {
+            return false;
+        }
+
+        const size_t cch = text.size() - position < BLOCK_SIZE ? text.size() - position : BLOCK_SIZE;
+        unsigned int newLines;
+        unsigned int colons;
+        MatchDelimiters(text.data() + position, cch, &newLines, &colons);
+
+        if (colons != 0)
+        {
+            const size_t bit = LowestSetBit(colons);
+            if ((newLines & ((1u << bit) - 1)) != 0)
+            {
+                return false;
+            }
+            colon = position + bit;
+        }
+        else if (newLines != 0)
+        {
+            return false;
+        }
+        position += cch;
+    }
+
+    //
+    // Values can be long, the rest of the line is left to memchr, which the
+    // CRT vectorizes for the processor it runs on. Later ':' belong to the
+    // value.
+    //
+    position = colon + 1;
+    for (;;)
+    {
+        const size_t offset = Find(text.substr(position), '\n');
+        if (offset == std::string_view::npos)
+        {
+            return false;
+        }
+        position += offset;
+
+        //
+        // Take care of header continuation
+        //
+        if (position + 1 < text.size() && IsWhitespace(text[position + 1]))
+        {
+            position++;
+            continue;
+        }
+
+        endOfLine = position;
+        return true;
+    }
+}
+
+bool
+HEADER_TOKENIZER::ParseStatusLine(
+    uint16_t &          status,
+    std::string_view &  reason
+) noexcept
+{
+    const size_t endOfLine = Find(m_block, '\n');
+    if (endOfLine == std::string_view::npos)
+    {
+        m_fError = true;
+        return false;
+    }
+
+    const std::string_view line = m_block.substr(0, endOfLine);
+    m_position = endOfLine + 1;
+
+    //
+    // HTTP-version SP status-code SP reason-phrase
+    //
+    size_t position = line.find(' ');
+    if (position == std::string_view::npos)
+    {
+        m_fError = true;
+        return false;
+    }
+    while (position < line.size() && line[position] == ' ')
+    {
+        position++;
+    }
+
+    uint32_t code = 0;
+    size_t cDigits = 0;
+    while (position < line.size() && line[position] >= '0' && line[position] <= '9' && cDigits < 3)
+    {
+        code = code * 10 + (line[position] - '0');
+        position++;
+        cDigits++;
+    }
+    if (cDigits == 0)
+    {
+        m_fError = true;
+        return false;
+    }
+    status = static_cast<uint16_t>(code);
+
+    position = line.find(' ', position);
+    if (position == std::string_view::npos)
+    {
+        position = line.size();
+    }
+    while (position < line.size() && line[position] == ' ')
+    {
+        position++;
+    }
+
+    size_t end = line.size();
+    while (end > position && (line[end - 1] == ' ' || line[end - 1] == '\r'))
+    {
+        end--;
+    }
+
+    reason = line.substr(position, end - position);
+    return true;
+}
+
+bool
+HEADER_TOKENIZER::Next(
+    std::string_view &  name,
+    std::string_view &  value
+) noexcept
+{
+    if (m_fError || m_position >= m_block.size())
+    {
+        return false;
+    }
+
+    const char first = m_block[m_position];
+    if (first == '\r' || first == '\n' || first == '\0')
+    {
+        return false;
+    }
+
+    //
+    // Find the ':' in Header : Value\r\n, it must come before the end of the line
+    //
+    size_t colon;
+    size_t endOfLine;
+    if (!FindDelimiters(m_block.substr(m_position), colon, endOfLine))
+    {
+        m_fError = true;
+        return false;
+    }
+    colon += m_position;
+    endOfLine += m_position;
+
+    //
+    // Skip over any spaces before the ':'
+    //
+    size_t endOfName = colon;
+    while (endOfName > m_position && m_block[endOfName - 1] == ' ')
+    {
+        endOfName--;
+    }
+    if (endOfName == m_position)
+    {
+        m_fError = true;
+        return false;
+    }
+
+    //
+    // Skip over the ':' and any leading spaces, and any spaces before the '\n'
+    //
+    size_t startOfValue = colon + 1;
+    while (startOfValue < endOfLine && IsWhitespace(m_block[startOfValue]))
+    {
+        startOfValue++;
+    }
+
+    size_t endOfValue = endOfLine;
+    while (endOfValue > startOfValue &&
+        (IsWhitespace(m_block[endOfValue - 1]) || m_block[endOfValue - 1] == '\r'))
+    {
+        endOfValue--;
+    }
+
+    name = m_block.substr(m_position, endOfName - m_position);
+    value = m_block.substr(startOfValue, endOfValue - startOfValue);
+    m_position = endOfLine + 1;
+
+    return true;
+}
@@ -0,0 +1,94 @@
+// Copyright (c) .NET Foundation. All rights reserved.
+// Licensed under the MIT License. See License.txt in the project root for license information.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+
+//
+// Splits a raw HTTP/1.1 response header block, as returned by
+// WINHTTP_QUERY_RAW_HEADERS_CRLF, into a status line and (name, value) spans.
+// The block is scanned once and every span points into the original buffer,
+// nothing is copied.
+//
+// Name spans exclude spaces before the ':'. Value spans exclude leading
+// spaces and trailing spaces/CR. Obs-fold continuation lines (lines starting
+// with SP or HTAB) are kept as part of the preceding header value.
+//
+class HEADER_TOKENIZER
+{
+public:
+
+    explicit
+    HEADER_TOKENIZER(
+        std::string_view    block
+    ) noexcept
+        : m_block(block),
+          m_position(0),
+          m_fError(false)
+    {
+    }
+
+    //
+    // Parses the status line, must be called before the first Next().
+    //
+    bool
+    ParseStatusLine(
+        uint16_t &          status,
+        std::string_view &  reason
+    ) noexcept;
+
+    //
+    // Returns the next header. Returns false once the empty line ending the
+    // block is reached, or on malformed input, in which case HasError() is set.
+    //
+    bool
+    Next(
+        std::string_view &  name,
+        std::string_view &  value
+    ) noexcept;
+
+    bool
+    HasError() const noexcept
+    {
+        return m_fError;
+    }
+
+    //
+    // Finds the ':' ending the name and the '\n' ending the header line that
+    // starts text, including any continuation lines. Every byte is looked at
+    // once: the name with SSE2 where available, the value with memchr.
+    // Returns false if the line is not terminated or has no ':' before its
+    // first '\n'.
+    //
+    static
+    bool
+    FindDelimiters(
+        std::string_view    text,
+        size_t &            colon,
+        size_t &            endOfLine
+    ) noexcept;
+
+    //
+    // Offset of the first occurrence of ch in text, npos if it does not occur.
+    //
+    static
+    size_t
+    Find(
+        std::string_view    text,
+        char                ch
+    ) noexcept
+    {
+        const void * pch = memchr(text.data(), ch, text.size());
+        return pch == nullptr ? std::string_view::npos : static_cast<size_t>(static_cast<const char *>(pch) - text.data());
+    }
+
+private:
+
+    std::string_view    m_block;
+    size_t              m_position;
+    bool                m_fError;
+};
@@ -0,0 +1,293 @@
+// Copyright (c) .NET Foundation. All rights reserved.
+// Licensed under the MIT License. See License.txt in the project root for license information.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <string_view>
+
+#define UNKNOWN_INDEX           (0xFFFFFFFF)
+
+//
+// Case-insensitive perfect hash from a header name to its HTTP_HEADER_ID.
+//
+// names[] is indexed by HTTP_HEADER_ID, an empty name keeps that id out of the
+// table so the header is treated as unknown. The hash seed and the slot table
+// are computed at compile time. A lookup hashes the name once, reads a single
+// slot and compares against the one candidate stored there; it takes no lock
+// and does not allocate.
+//
+// At most MAX_SEED_COUNT seeds are tried so a name list without a perfect
+// hash fails the build quickly instead of running into the compiler's
+// constexpr evaluation limits; see the static_asserts below the tables.
+//
+template<size_t N>
+class KNOWN_HEADER_TABLE
+{
+public:
+
+    static constexpr size_t     TABLE_SIZE = 256;
+    static constexpr uint32_t   MAX_SEED_COUNT = 256;
+
+    static_assert(N < 0xFF, "Header ids must fit in a slot");
+
+    constexpr
+    explicit
+    KNOWN_HEADER_TABLE(
+        const std::string_view (&names)[N]
+    ) : m_rgNames{},
+        m_rgSlots{},
+        m_dwSeed(0),
+        m_cchMaxName(0)
+    {
+        for (size_t i = 0; i < N; i++)
+        {
+            m_rgNames[i] = names[i];
+            if (names[i].size() > m_cchMaxName)
+            {
+                m_cchMaxName = names[i].size();
+            }
+        }
+
+        m_dwSeed = FindSeed(names);
+
+        for (size_t i = 0; i < TABLE_SIZE; i++)
+        {
+            m_rgSlots[i] = EMPTY_SLOT;
+        }
+        for (size_t i = 0; i < N; i++)
+        {
+            if (!names[i].empty())
+            {
+                m_rgSlots[Hash(names[i], m_dwSeed) & (TABLE_SIZE - 1)] = static_cast<uint8_t>(i);
+            }
+        }
+    }
+
+    //
+    // Returns the HTTP_HEADER_ID of name or UNKNOWN_INDEX.
+    //
+    constexpr
+    uint32_t
+    GetIndex(
+        std::string_view    name
+    ) const noexcept
+    {
+        if (name.empty() || name.size() > m_cchMaxName)
+        {
+            return UNKNOWN_INDEX;
+        }
+
+        const uint8_t slot = m_rgSlots[Hash(name, m_dwSeed) & (TABLE_SIZE - 1)];
+        if (slot == EMPTY_SLOT || !EqualsIgnoreCase(m_rgNames[slot], name))
+        {
+            return UNKNOWN_INDEX;
+        }
+
+        return slot;
+    }
+
+    //
+    // False if no seed below MAX_SEED_COUNT hashes the names without a
+    // collision, lookups are not reliable then.
+    //
+    constexpr
+    bool
+    HasPerfectHash() const noexcept
+    {
+        return m_dwSeed < MAX_SEED_COUNT;
+    }
+
+private:
+
+    static constexpr uint8_t    EMPTY_SLOT = 0xFF;
+
+    static
+    constexpr
+    char
+    ToLower(
+        char ch
+    ) noexcept
+    {
+        return (ch >= 'A' && ch <= 'Z') ? static_cast<char>(ch - 'A' + 'a') : ch;
+    }
+
+    static
+    constexpr
+    bool
+    EqualsIgnoreCase(
+        std::string_view    name1,
+        std::string_view    name2
+    ) noexcept
+    {
+        if (name1.size() != name2.size())
+        {
+            return false;
+        }
+        for (size_t i = 0; i < name1.size(); i++)
+        {
+            if (ToLower(name1[i]) != ToLower(name2[i]))
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    //
+    // FNV-1a over the lower-cased name, with the seed folded into the basis.
+    //
+    static
+    constexpr
+    uint32_t
+    Hash(
+        std::string_view    name,
+        uint32_t            dwSeed
+    ) noexcept
+    {
+        uint32_t hash = 2166136261u ^ (dwSeed * 0x9E3779B9u);
+        for (const char ch : name)
+        {
+            hash ^= static_cast<uint8_t>(ToLower(ch));
+            hash *= 16777619u;
+        }
+        return hash ^ (hash >> 16);
+    }
+
+    //
+    // Returns the first seed without collisions, MAX_SEED_COUNT if there is
+    // none below it.
+    //
+    static
+    constexpr
+    uint32_t
+    FindSeed(
+        const std::string_view (&names)[N]
+    )
+    {
+        for (uint32_t dwSeed = 0; dwSeed < MAX_SEED_COUNT; dwSeed++)
+        {
+            bool rgUsed[TABLE_SIZE] = {};
+            bool fCollision = false;
+
+            for (size_t i = 0; i < N && !fCollision; i++)
+            {
+                if (names[i].empty())
+                {
+                    continue;
+                }
+
+                const size_t slot = Hash(names[i], dwSeed) & (TABLE_SIZE - 1);
+                fCollision = rgUsed[slot];
+                rgUsed[slot] = true;
+            }
+
+            if (!fCollision)
+            {
+                return dwSeed;
+            }
+        }
+
+        return MAX_SEED_COUNT;
+    }
+
+    std::string_view    m_rgNames[N];
+    uint8_t             m_rgSlots[TABLE_SIZE];
+    uint32_t            m_dwSeed;
+    size_t              m_cchMaxName;
+};
+
+//
+// Names indexed by HTTP_HEADER_ID (HttpHeaderCacheControl ... HttpHeaderWwwAuthenticate).
+// Set-Cookie and WWW-Authenticate are left out so that they are treated as
+// unknown headers and every instance returned by the backend is kept.
+//
+inline constexpr std::string_view g_rgResponseHeaderNames[] =
+{
+    "Cache-Control",
+    "Connection",
+    "Date",
+    "Keep-Alive",
+    "Pragma",
+    "Trailer",
+    "Transfer-Encoding",
+    "Upgrade",
+    "Via",
+    "Warning",
+    "Allow",
+    "Content-Length",
+    "Content-Type",
+    "Content-Encoding",
+    "Content-Language",
+    "Content-Location",
+    "Content-MD5",
+    "Content-Range",
+    "Expires",
+    "Last-Modified",
+    "Accept-Ranges",
+    "Age",
+    "ETag",
+    "Location",
+    "Proxy-Authenticate",
+    "Retry-After",
+    "Server",
+    "",                     // Set-Cookie
+    "Vary",
+    "",                     // WWW-Authenticate
+};
+
+//
+// Names indexed by HTTP_HEADER_ID (HttpHeaderCacheControl ... HttpHeaderUserAgent).
+//
+inline constexpr std::string_view g_rgRequestHeaderNames[] =
+{
+    "Cache-Control",
+    "Connection",
+    "Date",
+    "Keep-Alive",
+    "Pragma",
+    "Trailer",
+    "Transfer-Encoding",
+    "Upgrade",
+    "Via",
+    "Warning",
+    "Allow",
+    "Content-Length",
+    "Content-Type",
+    "Content-Encoding",
+    "Content-Language",
+    "Content-Location",
+    "Content-MD5",
+    "Content-Range",
+    "Expires",
+    "Last-Modified",
+    "Accept",
+    "Accept-Charset",
+    "Accept-Encoding",
+    "Accept-Language",
+    "Authorization",
+    "Cookie",
+    "Expect",
+    "From",
+    "Host",
+    "If-Match",
+    "If-Modified-Since",
+    "If-None-Match",
+    "If-Range",
+    "If-Unmodified-Since",
+    "Max-Forwards",
+    "Proxy-Authorization",
+    "Referer",
+    "Range",
+    "TE",
+    "Translate",
+    "User-Agent",
+};
+
+inline constexpr KNOWN_HEADER_TABLE<std::size(g_rgResponseHeaderNames)> g_KnownResponseHeaders(g_rgResponseHeaderNames);
+inline constexpr KNOWN_HEADER_TABLE<std::size(g_rgRequestHeaderNames)> g_KnownRequestHeaders(g_rgRequestHeaderNames);
+
+static_assert(g_KnownResponseHeaders.HasPerfectHash(), "No seed hashes the response header names without a collision");
+static_assert(g_KnownRequestHeaders.HasPerfectHash(), "No seed hashes the request header names without a collision");
@@ -0,0 +1,209 @@
+// Copyright (c) .NET Foundation. All rights reserved.
+// Licensed under the MIT License. See License.txt in the project root for license information.
+
+#include "stdafx.h"
+#include "loadbalancer.h"
+
+namespace
+{
+    bool
+    EqualsIgnoreCase(
+        std::wstring_view   value,
+        std::wstring_view   expected
+    ) noexcept
+    {
+        if (value.size() != expected.size())
+        {
+            return false;
+        }
+        for (size_t i = 0; i < value.size(); i++)
+        {
+            const wchar_t ch = (value[i] >= L'A' && value[i] <= L'Z') ? value[i] - L'A' + L'a' : value[i];
+            const wchar_t chExpected = (expected[i] >= L'A' && expected[i] <= L'Z') ? expected[i] - L'A' + L'a' : expected[i];
+            if (ch != chExpected)
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    inline
+    uint32_t
+    QueryOutstanding(
+        const BACKEND_LOAD *    pLoad
+    ) noexcept
+    {
+        return pLoad == nullptr ? 0 : pLoad->QueryOutstanding();
+    }
+
+    //
+    // Expected wait on a backend, a process without latency samples yet
+    // costs as much as its outstanding request count.
+    //
+    inline
+    uint64_t
+    QueryCost(
+        const BACKEND_LOAD *    pLoad
+    ) noexcept
+    {
+        if (pLoad == nullptr)
+        {
+            return 0;
+        }
+        return (pLoad->QueryLatencyEwma() + 1) * (static_cast<uint64_t>(pLoad->QueryOutstanding()) + 1);
+    }
+}
+
+void
+BACKEND_LOAD::OnLatencySample(
+    uint64_t    ullLatencyUs
+) noexcept
+{
+    uint64_t ullCurrent = m_ullLatencyEwma.load(std::memory_order_relaxed);
+    uint64_t ullNext;
+    do
+    {
+        if (ullCurrent == 0)
+        {
+            ullNext = ullLatencyUs;
+        }
+        else if (ullLatencyUs >= ullCurrent)
+        {
+            ullNext = ullCurrent + ((ullLatencyUs - ullCurrent) >> EWMA_SHIFT);
+        }
+        else
+        {
+            ullNext = ullCurrent - ((ullCurrent - ullLatencyUs) >> EWMA_SHIFT);
+        }
+    } while (!m_ullLatencyEwma.compare_exchange_weak(ullCurrent, ullNext, std::memory_order_relaxed));
+}
+
+// static
+bool
+LOAD_BALANCER::TryParsePolicy(
+    std::wstring_view       value,
+    LOAD_BALANCING_POLICY * pPolicy
+) noexcept
+{
+    if (value.empty() || EqualsIgnoreCase(value, L"roundRobin"))
+    {
+        *pPolicy = LOAD_BALANCING_ROUND_ROBIN;
+    }
+    else if (EqualsIgnoreCase(value, L"leastRequests"))
+    {
+        *pPolicy = LOAD_BALANCING_LEAST_REQUESTS;
+    }
+    else if (EqualsIgnoreCase(value, L"powerOfTwoChoices"))
+    {
+        *pPolicy = LOAD_BALANCING_POWER_OF_TWO_CHOICES;
+    }
+    else if (EqualsIgnoreCase(value, L"ewmaLatency"))
+    {
+        *pPolicy = LOAD_BALANCING_EWMA_LATENCY;
+    }
+    else
+    {
+        return false;
+    }
+    return true;
+}
+
+uint32_t
+LOAD_BALANCER::Select(
+    const BACKEND_LOAD * const *    rgLoads,
+    uint32_t                        cLoads
+) noexcept
+{
+    if (cLoads <= 1)
+    {
+        return 0;
+    }
+
+    switch (m_policy)
+    {
+    case LOAD_BALANCING_LEAST_REQUESTS:
+        return SelectLeastRequests(rgLoads, cLoads);
+
+    case LOAD_BALANCING_POWER_OF_TWO_CHOICES:
+        return SelectPowerOfTwoChoices(rgLoads, cLoads);
+
+    case LOAD_BALANCING_EWMA_LATENCY:
+        return SelectEwmaLatency(rgLoads, cLoads);
+
+    default:
+        return (m_dwRouteIndex.fetch_add(1, std::memory_order_relaxed) + 1) % cLoads;
+    }
+}
+
+uint32_t
+LOAD_BALANCER::NextRandom() noexcept
+{
+    //
+    // splitmix64 over a shared counter, concurrent callers get distinct values.
+    //
+    uint64_t z = m_ullRandomState.fetch_add(0x9E3779B97F4A7C15ull, std::memory_order_relaxed) + 0x9E3779B97F4A7C15ull;
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return static_cast<uint32_t>(z ^ (z >> 31));
+}
+
+uint32_t
+LOAD_BALANCER::SelectLeastRequests(
+    const BACKEND_LOAD * const *    rgLoads,
+    uint32_t                        cLoads
+) noexcept
+{
+    const uint32_t dwStart = (m_dwRouteIndex.fetch_add(1, std::memory_order_relaxed) + 1) % cLoads;
+    uint32_t dwSelected = dwStart;
+    uint32_t cLeast = QueryOutstanding(rgLoads[dwStart]);
+
+    for (uint32_t i = 1; i < cLoads && cLeast != 0; i++)
+    {
+        const uint32_t dwIndex = (dwStart + i) % cLoads;
+        const uint32_t cOutstanding = QueryOutstanding(rgLoads[dwIndex]);
+        if (cOutstanding < cLeast)
+        {
+            cLeast = cOutstanding;
+            dwSelected = dwIndex;
+        }
+    }
+
+    return dwSelected;
+}
+
+uint32_t
+LOAD_BALANCER::SelectPowerOfTwoChoices(
+    const BACKEND_LOAD * const *    rgLoads,
+    uint32_t                        cLoads
+) noexcept
+{
+    const uint32_t dwFirst = NextRandom() % cLoads;
+    const uint32_t dwSecond = (dwFirst + 1 + NextRandom() % (cLoads - 1)) % cLoads;
+
+    return QueryOutstanding(rgLoads[dwSecond]) < QueryOutstanding(rgLoads[dwFirst]) ? dwSecond : dwFirst;
+}
+
+uint32_t
+LOAD_BALANCER::SelectEwmaLatency(
+    const BACKEND_LOAD * const *    rgLoads,
+    uint32_t                        cLoads
+) noexcept
+{
+    const uint32_t dwStart = (m_dwRouteIndex.fetch_add(1, std::memory_order_relaxed) + 1) % cLoads;
+    uint32_t dwSelected = dwStart;
+    uint64_t ullLeast = QueryCost(rgLoads[dwStart]);
+
+    for (uint32_t i = 1; i < cLoads && ullLeast != 0; i++)
+    {
+        const uint32_t dwIndex = (dwStart + i) % cLoads;
+        const uint64_t ullCost = QueryCost(rgLoads[dwIndex]);
+        if (ullCost < ullLeast)
+        {
+            ullLeast = ullCost;
+            dwSelected = dwIndex;
+        }
+    }
+
+    return dwSelected;
+}
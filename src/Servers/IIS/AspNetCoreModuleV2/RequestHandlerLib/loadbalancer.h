@@ -0,0 +1,149 @@
+// Copyright (c) .NET Foundation. All rights reserved.
+// Licensed under the MIT License. See License.txt in the project root for license information.
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <string_view>
+
+enum LOAD_BALANCING_POLICY
+{
+    LOAD_BALANCING_ROUND_ROBIN,
+    LOAD_BALANCING_LEAST_REQUESTS,
+    LOAD_BALANCING_POWER_OF_TWO_CHOICES,
+    LOAD_BALANCING_EWMA_LATENCY
+};
+
+//
+// Load of a single backend process: the number of requests forwarded to it
+// that have not completed yet, and an exponentially weighted moving average
+// of its time to first response byte.
+//
+class BACKEND_LOAD
+{
+public:
+
+    //
+    // Weight of a new latency sample is 1 / 2^EWMA_SHIFT.
+    //
+    static constexpr uint32_t   EWMA_SHIFT = 3;
+
+    BACKEND_LOAD() noexcept
+        : m_cOutstanding(0),
+          m_ullLatencyEwma(0)
+    {
+    }
+
+    void
+    OnRequestStart() noexcept
+    {
+        m_cOutstanding.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void
+    OnRequestEnd() noexcept
+    {
+        m_cOutstanding.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+    void
+    OnLatencySample(
+        uint64_t    ullLatencyUs
+    ) noexcept;
+
+    uint32_t
+    QueryOutstanding() const noexcept
+    {
+        return m_cOutstanding.load(std::memory_order_relaxed);
+    }
+
+    uint64_t
+    QueryLatencyEwma() const noexcept
+    {
+        return m_ullLatencyEwma.load(std::memory_order_relaxed);
+    }
+
+private:
+
+    std::atomic<uint32_t>   m_cOutstanding;
+    std::atomic<uint64_t>   m_ullLatencyEwma;
+};
+
+//
+// Picks the backend process a request is routed to.
+//
+// Slots without a process are passed as nullptr and are treated as idle, so
+// a load aware policy routes to them and the caller starts their process.
+// Ties are broken in round-robin order so that equally loaded processes share
+// the traffic.
+//
+class LOAD_BALANCER
+{
+public:
+
+    LOAD_BALANCER() noexcept
+        : m_policy(LOAD_BALANCING_ROUND_ROBIN),
+          m_dwRouteIndex(0),
+          m_ullRandomState(0)
+    {
+    }
+
+    void
+    SetPolicy(
+        LOAD_BALANCING_POLICY   policy
+    ) noexcept
+    {
+        m_policy = policy;
+    }
+
+    LOAD_BALANCING_POLICY
+    QueryPolicy() const noexcept
+    {
+        return m_policy;
+    }
+
+    //
+    // Parses the loadBalancingPolicy handler setting. An empty value selects
+    // round-robin.
+    //
+    static
+    bool
+    TryParsePolicy(
+        std::wstring_view       value,
+        LOAD_BALANCING_POLICY * pPolicy
+    ) noexcept;
+
+    uint32_t
+    Select(
+        const BACKEND_LOAD * const *    rgLoads,
+        uint32_t                        cLoads
+    ) noexcept;
+
+private:
+
+    uint32_t
+    NextRandom() noexcept;
+
+    uint32_t
+    SelectLeastRequests(
+        const BACKEND_LOAD * const *    rgLoads,
+        uint32_t                        cLoads
+    ) noexcept;
+
+    uint32_t
+    SelectPowerOfTwoChoices(
+        const BACKEND_LOAD * const *    rgLoads,
+        uint32_t                        cLoads
+    ) noexcept;
+
+    uint32_t
+    SelectEwmaLatency(
+        const BACKEND_LOAD * const *    rgLoads,
+        uint32_t                        cLoads
+    ) noexcept;
+
+    LOAD_BALANCING_POLICY   m_policy;
+    std::atomic<uint32_t>   m_dwRouteIndex;
+    std::atomic<uint64_t>   m_ullRandomState;
+};
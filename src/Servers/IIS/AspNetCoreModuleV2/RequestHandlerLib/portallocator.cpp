@@ -0,0 +1,171 @@
+// Copyright (c) .NET Foundation. All rights reserved.
+// Licensed under the MIT License. See License.txt in the project root for license information.
+
+#include "stdafx.h"
+#include "portallocator.h"
+#include <algorithm>
+
+namespace
+{
+    constexpr uint32_t  BITS_PER_WORD = 64;
+
+    inline
+    uint32_t
+    LowestSetBit(
+        uint64_t    ullWord
+    ) noexcept
+    {
+        uint32_t dwBit = 0;
+        while ((ullWord & 1) == 0)
+        {
+            ullWord >>= 1;
+            dwBit++;
+        }
+        return dwBit;
+    }
+}
+
+PORT_ALLOCATOR::PORT_ALLOCATOR(
+    uint32_t    dwMinPort,
+    uint32_t    dwMaxPort
+)
+    : m_dwMinPort(dwMinPort),
+      m_dwMaxPort(dwMaxPort),
+      m_ullSnapshotMs(0),
+      m_fSnapshotValid(false)
+{
+    const uint32_t cPorts = dwMaxPort - dwMinPort + 1;
+    const uint32_t cWords = (cPorts + BITS_PER_WORD - 1) / BITS_PER_WORD;
+
+    m_rgReserved.assign(cWords, 0);
+    m_rgListening.assign(cWords, 0);
+
+    //
+    // Bits past the end of the range are permanently reserved so that the
+    // scan never returns them.
+    //
+    if (cPorts % BITS_PER_WORD != 0)
+    {
+        m_rgReserved[cWords - 1] = ~0ull << (cPorts % BITS_PER_WORD);
+    }
+}
+
+bool
+PORT_ALLOCATOR::Reserve(
+    uint32_t    dwHint,
+    uint32_t *  pdwPort
+) noexcept
+{
+    const size_t cWords = m_rgReserved.size();
+    const uint32_t dwOffset = InRange(dwHint) ? dwHint - m_dwMinPort : 0;
+    const size_t iStartWord = dwOffset / BITS_PER_WORD;
+    const uint32_t dwStartBit = dwOffset % BITS_PER_WORD;
+
+    //
+    // Start in the hint's word at the hint's bit, then scan the following
+    // words and finally the bits of the first word below the hint.
+    //
+    for (size_t i = 0; i <= cWords; i++)
+    {
+        const size_t iWord = (iStartWord + i) % cWords;
+        uint64_t ullFree = ~(m_rgReserved[iWord] | m_rgListening[iWord]);
+
+        if (i == 0)
+        {
+            ullFree &= ~0ull << dwStartBit;
+        }
+        else if (i == cWords)
+        {
+            ullFree &= dwStartBit == 0 ? 0 : ~(~0ull << dwStartBit);
+        }
+
+        if (ullFree != 0)
+        {
+            const uint32_t dwBit = LowestSetBit(ullFree);
+            m_rgReserved[iWord] |= 1ull << dwBit;
+            *pdwPort = m_dwMinPort + static_cast<uint32_t>(iWord) * BITS_PER_WORD + dwBit;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void
+PORT_ALLOCATOR::Release(
+    uint32_t    dwPort
+) noexcept
+{
+    if (InRange(dwPort))
+    {
+        const uint32_t dwOffset = dwPort - m_dwMinPort;
+        m_rgReserved[dwOffset / BITS_PER_WORD] &= ~(1ull << (dwOffset % BITS_PER_WORD));
+    }
+}
+
+bool
+PORT_ALLOCATOR::IsReserved(
+    uint32_t    dwPort
+) const noexcept
+{
+    if (!InRange(dwPort))
+    {
+        return false;
+    }
+
+    const uint32_t dwOffset = dwPort - m_dwMinPort;
+    return (m_rgReserved[dwOffset / BITS_PER_WORD] & (1ull << (dwOffset % BITS_PER_WORD))) != 0;
+}
+
+void
+PORT_ALLOCATOR::BeginSnapshot(
+    uint64_t    ullNowMs
+) noexcept
+{
+    std::fill(m_rgListening.begin(), m_rgListening.end(), 0);
+    m_ullSnapshotMs = ullNowMs;
+    m_fSnapshotValid = true;
+}
+
+void
+PORT_ALLOCATOR::MarkListening(
+    uint32_t    dwPort
+) noexcept
+{
+    if (InRange(dwPort))
+    {
+        const uint32_t dwOffset = dwPort - m_dwMinPort;
+        m_rgListening[dwOffset / BITS_PER_WORD] |= 1ull << (dwOffset % BITS_PER_WORD);
+    }
+}
+
+bool
+PORT_ALLOCATOR::IsListening(
+    uint32_t    dwPort
+) const noexcept
+{
+    if (!m_fSnapshotValid || !InRange(dwPort))
+    {
+        return false;
+    }
+
+    const uint32_t dwOffset = dwPort - m_dwMinPort;
+    return (m_rgListening[dwOffset / BITS_PER_WORD] & (1ull << (dwOffset % BITS_PER_WORD))) != 0;
+}
+
+bool
+PORT_ALLOCATOR::IsSnapshotStale(
+    uint64_t    ullNowMs,
+    uint64_t    ullMaxAgeMs
+) const noexcept
+{
+    return QuerySnapshotAge(ullNowMs) >= ullMaxAgeMs;
+}
+
+uint64_t
+PORT_ALLOCATOR::QuerySnapshotAge(
+    uint64_t    ullNowMs
+) const noexcept
+{
+    return m_fSnapshotValid ? ullNowMs - m_ullSnapshotMs : UINT64_MAX;
+}
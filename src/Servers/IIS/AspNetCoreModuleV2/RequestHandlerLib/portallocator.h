@@ -0,0 +1,112 @@
+// Copyright (c) .NET Foundation. All rights reserved.
+// Licensed under the MIT License. See License.txt in the project root for license information.
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+//
+// Hands out listen ports for backend processes from a fixed range.
+//
+// Two bitmaps cover the range: ports reserved for live processes of this
+// module, and ports some process was listening on at the last snapshot of
+// the TCP table. A port is free when it is in neither, so picking one only
+// scans for a word that is not full instead of probing the TCP table for
+// each candidate.
+//
+// Not thread safe, the caller serializes access.
+//
+class PORT_ALLOCATOR
+{
+public:
+
+    PORT_ALLOCATOR(
+        uint32_t    dwMinPort,
+        uint32_t    dwMaxPort
+    );
+
+    //
+    // Reserves the first free port at or after dwHint, wrapping around at
+    // the end of the range. Returns false if every port is taken.
+    //
+    bool
+    Reserve(
+        uint32_t    dwHint,
+        uint32_t *  pdwPort
+    ) noexcept;
+
+    void
+    Release(
+        uint32_t    dwPort
+    ) noexcept;
+
+    bool
+    IsReserved(
+        uint32_t    dwPort
+    ) const noexcept;
+
+    //
+    // True if the current snapshot saw a listener on dwPort. Ports outside
+    // the range are not tracked.
+    //
+    bool
+    IsListening(
+        uint32_t    dwPort
+    ) const noexcept;
+
+    bool
+    InRange(
+        uint32_t    dwPort
+    ) const noexcept
+    {
+        return dwPort >= m_dwMinPort && dwPort <= m_dwMaxPort;
+    }
+
+    //
+    // Replaces the snapshot of listening ports, call MarkListening for each
+    // listener afterwards.
+    //
+    void
+    BeginSnapshot(
+        uint64_t    ullNowMs
+    ) noexcept;
+
+    void
+    MarkListening(
+        uint32_t    dwPort
+    ) noexcept;
+
+    bool
+    IsSnapshotStale(
+        uint64_t    ullNowMs,
+        uint64_t    ullMaxAgeMs
+    ) const noexcept;
+
+    //
+    // Age of the snapshot at ullNowMs, UINT64_MAX if there is none.
+    //
+    uint64_t
+    QuerySnapshotAge(
+        uint64_t    ullNowMs
+    ) const noexcept;
+
+    //
+    // Forces a new snapshot before the next reservation, e.g. after a
+    // process failed to listen on the port it was given.
+    //
+    void
+    InvalidateSnapshot() noexcept
+    {
+        m_fSnapshotValid = false;
+    }
+
+private:
+
+    uint32_t                m_dwMinPort;
+    uint32_t                m_dwMaxPort;
+    std::vector<uint64_t>   m_rgReserved;
+    std::vector<uint64_t>   m_rgListening;
+    uint64_t                m_ullSnapshotMs;
+    bool                    m_fSnapshotValid;
+};
@@ -0,0 +1,145 @@
+// Copyright (c) .NET Foundation. All rights reserved.
+// Licensed under the MIT License. See License.txt in the project root for license information.
+
+#pragma once
+
+#include <cstdint>
+
+//
+// Chooses how much response entity to read from the backend per completion.
+//
+// Every response starts with small reads so that short, latency-sensitive
+// responses are relayed as soon as their bytes arrive. Once a response proves
+// to be a bulk transfer, either through a large Content-Length or because
+// consecutive reads keep filling the whole buffer, the read size doubles up
+// to the configured maximum. Reads that come back mostly empty shrink it again.
+//
+class READ_SIZE_CONTROLLER
+{
+public:
+
+    static constexpr uint32_t   INITIAL_READ_SIZE = 8 * 1024;
+    static constexpr uint32_t   BULK_READ_SIZE = 64 * 1024;
+    static constexpr uint32_t   MAX_READ_SIZE = 256 * 1024;
+
+    //
+    // Responses announcing at least this much entity start at BULK_READ_SIZE.
+    //
+    static constexpr uint64_t   BULK_CONTENT_LENGTH = 1024 * 1024;
+
+    //
+    // Number of consecutive full reads after which the read size doubles.
+    //
+    static constexpr uint32_t   FULL_READS_TO_GROW = 2;
+
+    //
+    // Content length of a response that announced none.
+    //
+    static constexpr uint64_t   UNKNOWN_CONTENT_LENGTH = UINT64_MAX;
+
+    //
+    // cbContentLength is the announced response length or
+    // UNKNOWN_CONTENT_LENGTH. cbReadLimit caps the read size, 0 means
+    // MAX_READ_SIZE.
+    //
+    void
+    Initialize(
+        uint64_t    cbContentLength,
+        uint32_t    cbReadLimit
+    ) noexcept
+    {
+        m_cbMaxReadSize = MAX_READ_SIZE;
+        if (cbReadLimit != 0 && cbReadLimit < m_cbMaxReadSize)
+        {
+            m_cbMaxReadSize = cbReadLimit < INITIAL_READ_SIZE ? INITIAL_READ_SIZE : cbReadLimit;
+        }
+
+        m_fKnownLength = cbContentLength != UNKNOWN_CONTENT_LENGTH;
+        m_cbRemaining = m_fKnownLength ? cbContentLength : 0;
+        m_cFullReads = 0;
+        m_cbMinReadSize = INITIAL_READ_SIZE;
+        m_cbReadSize = INITIAL_READ_SIZE;
+
+        if (m_fKnownLength && cbContentLength >= BULK_CONTENT_LENGTH)
+        {
+            m_cbReadSize = BULK_READ_SIZE < m_cbMaxReadSize ? BULK_READ_SIZE : m_cbMaxReadSize;
+        }
+    }
+
+    //
+    // For streams without an announced length, such as relayed WebSocket
+    // messages: reads start at cbMinReadSize and move between it and
+    // cbMaxReadSize.
+    //
+    void
+    InitializeRange(
+        uint32_t    cbMinReadSize,
+        uint32_t    cbMaxReadSize
+    ) noexcept
+    {
+        m_cbMinReadSize = cbMinReadSize;
+        m_cbMaxReadSize = cbMaxReadSize < cbMinReadSize ? cbMinReadSize : cbMaxReadSize;
+        m_fKnownLength = false;
+        m_cbRemaining = 0;
+        m_cFullReads = 0;
+        m_cbReadSize = cbMinReadSize;
+    }
+
+    //
+    // Size of the next read, never more than the remaining announced entity.
+    // 0 once an announced entity has been read completely.
+    //
+    uint32_t
+    QueryReadSize() const noexcept
+    {
+        if (m_fKnownLength && m_cbRemaining < m_cbReadSize)
+        {
+            return static_cast<uint32_t>(m_cbRemaining);
+        }
+        return m_cbReadSize;
+    }
+
+    //
+    // Records the outcome of a read issued with the current read size.
+    //
+    void
+    OnReadComplete(
+        uint32_t    cbRead
+    ) noexcept
+    {
+        if (m_fKnownLength)
+        {
+            m_cbRemaining = cbRead < m_cbRemaining ? m_cbRemaining - cbRead : 0;
+        }
+
+        if (cbRead >= m_cbReadSize)
+        {
+            //
+            // The backend produces data faster than it is drained.
+            //
+            if (++m_cFullReads >= FULL_READS_TO_GROW && m_cbReadSize < m_cbMaxReadSize)
+            {
+                m_cbReadSize = m_cbReadSize * 2 < m_cbMaxReadSize ? m_cbReadSize * 2 : m_cbMaxReadSize;
+                m_cFullReads = 0;
+            }
+        }
+        else
+        {
+            m_cFullReads = 0;
+
+            if (cbRead < m_cbReadSize / 4 && m_cbReadSize > m_cbMinReadSize)
+            {
+                m_cbReadSize = m_cbReadSize / 2 > m_cbMinReadSize ? m_cbReadSize / 2 : m_cbMinReadSize;
+            }
+        }
+    }
+
+private:
+
+    bool        m_fKnownLength = false;
+    uint64_t    m_cbRemaining = 0;
+    uint32_t    m_cbReadSize = INITIAL_READ_SIZE;
+    uint32_t    m_cbMinReadSize = INITIAL_READ_SIZE;
+    uint32_t    m_cbMaxReadSize = MAX_READ_SIZE;
+    uint32_t    m_cFullReads = 0;
+};
@@ -0,0 +1,109 @@
+// Copyright (c) .NET Foundation. All rights reserved.
+// Licensed under the MIT License. See License.txt in the project root for license information.
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+//
+// Coordinates the independent IO pumps of a relay with its cleanup, without
+// a lock.
+//
+// A pump enters the gate before it issues IO and leaves once the call
+// returned. Cleanup closes the gate so that no pump enters anymore. The IO
+// cancellation has to run after every IO issued before that is visible to
+// it, so it is run by whoever sees the gate closed with no pump inside:
+// cleanup itself, or the last pump to leave. Exactly one of them is told to
+// cancel.
+//
+class RELAY_CLEANUP_GATE
+{
+public:
+
+    static constexpr uint32_t   MAX_REASON = 127;
+
+    RELAY_CLEANUP_GATE() noexcept
+        : m_dwState(0)
+    {
+    }
+
+    //
+    // False once cleanup began, the pump must not issue IO then.
+    //
+    bool
+    TryEnter() noexcept
+    {
+        uint32_t dwState = m_dwState.load(std::memory_order_acquire);
+        while ((dwState & CLEANUP_STARTED) == 0)
+        {
+            if (m_dwState.compare_exchange_weak(dwState,
+                    dwState + PUMP_INCREMENT,
+                    std::memory_order_acq_rel,
+                    std::memory_order_acquire))
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    //
+    // True if the caller has to cancel the relay IO now.
+    //
+    bool
+    Leave() noexcept
+    {
+        const uint32_t dwState = m_dwState.fetch_sub(PUMP_INCREMENT, std::memory_order_acq_rel) - PUMP_INCREMENT;
+        return (dwState & CLEANUP_STARTED) != 0 && dwState < PUMP_INCREMENT;
+    }
+
+    //
+    // Closes the gate, only the first call records its reason. True if the
+    // caller has to cancel the relay IO now, otherwise the last pump inside
+    // is told to when it leaves.
+    //
+    bool
+    BeginCleanup(
+        uint32_t    dwReason
+    ) noexcept
+    {
+        uint32_t dwState = m_dwState.load(std::memory_order_acquire);
+        while ((dwState & CLEANUP_STARTED) == 0)
+        {
+            const uint32_t dwCleanup = CLEANUP_STARTED | ((dwReason & MAX_REASON) << REASON_SHIFT);
+            if (m_dwState.compare_exchange_weak(dwState,
+                    dwState | dwCleanup,
+                    std::memory_order_acq_rel,
+                    std::memory_order_acquire))
+            {
+                return dwState < PUMP_INCREMENT;
+            }
+        }
+        return false;
+    }
+
+    bool
+    IsCleanupStarted() const noexcept
+    {
+        return (m_dwState.load(std::memory_order_acquire) & CLEANUP_STARTED) != 0;
+    }
+
+    uint32_t
+    QueryCleanupReason() const noexcept
+    {
+        return (m_dwState.load(std::memory_order_acquire) >> REASON_SHIFT) & MAX_REASON;
+    }
+
+private:
+
+    //
+    // Bit 0 closes the gate, bits 1-7 hold the cleanup reason and the
+    // number of pumps inside counts from bit 8.
+    //
+    static constexpr uint32_t   CLEANUP_STARTED = 1;
+    static constexpr uint32_t   REASON_SHIFT = 1;
+    static constexpr uint32_t   PUMP_INCREMENT = 1 << 8;
+
+    std::atomic<uint32_t>       m_dwState;
+};
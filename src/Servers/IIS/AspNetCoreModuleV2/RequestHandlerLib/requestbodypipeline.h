@@ -0,0 +1,171 @@
+// Copyright (c) .NET Foundation. All rights reserved.
+// Licensed under the MIT License. See License.txt in the project root for license information.
+
+#pragma once
+
+#include <cstdint>
+
+//
+// Sequences the reads of the request entity from the client and the writes
+// to the backend over two buffers, so that the next chunk is read while the
+// previous one is being written.
+//
+// At most one read and one write are outstanding. A chunk that completes
+// while the other buffer is still being written waits until that write
+// completes, the order of the entity is preserved.
+//
+class REQUEST_BODY_PIPELINE
+{
+public:
+
+    static constexpr uint32_t   BUFFER_COUNT = 2;
+
+    enum ACTION
+    {
+        //
+        // Wait for an outstanding read or write to complete.
+        //
+        ACTION_NONE,
+        ACTION_READ,
+        ACTION_WRITE,
+        //
+        // Write the terminating chunk of a chunked entity.
+        //
+        ACTION_WRITE_LAST_CHUNK,
+        //
+        // The whole entity has been written, receive the response.
+        //
+        ACTION_SEND_COMPLETE,
+    };
+
+    //
+    // cbContentLength is ignored for chunked entities.
+    //
+    void
+    Initialize(
+        uint32_t    cbContentLength,
+        bool        fChunked
+    ) noexcept
+    {
+        m_cbRemaining = cbContentLength;
+        m_fChunked = fChunked;
+        m_iReadBuffer = 0;
+        m_cbReady = 0;
+        m_fReadPending = false;
+        m_fWritePending = false;
+        m_fReady = false;
+        m_fEndOfEntity = false;
+        m_fLastChunkWritten = false;
+        m_fSendComplete = false;
+    }
+
+    //
+    // Returns the next operation to issue and marks it outstanding. Called
+    // until it returns ACTION_NONE or ACTION_SEND_COMPLETE. For ACTION_READ
+    // *pcbData is the size to read, for ACTION_WRITE the size read.
+    //
+    ACTION
+    NextAction(
+        uint32_t    cbBuffer,
+        uint32_t *  piBuffer,
+        uint32_t *  pcbData
+    ) noexcept
+    {
+        if (m_fReady && !m_fWritePending)
+        {
+            *piBuffer = m_iReadBuffer;
+            *pcbData = m_cbReady;
+            m_fReady = false;
+            m_fWritePending = true;
+            m_iReadBuffer = (m_iReadBuffer + 1) % BUFFER_COUNT;
+            return ACTION_WRITE;
+        }
+
+        if (!m_fReadPending && !m_fReady && !IsEndOfEntity())
+        {
+            *piBuffer = m_iReadBuffer;
+            *pcbData = !m_fChunked && m_cbRemaining < cbBuffer ? m_cbRemaining : cbBuffer;
+            m_fReadPending = true;
+            return ACTION_READ;
+        }
+
+        if (m_fReadPending || m_fWritePending || m_fReady || m_fSendComplete)
+        {
+            return ACTION_NONE;
+        }
+
+        if (m_fChunked && !m_fLastChunkWritten)
+        {
+            m_fLastChunkWritten = true;
+            m_fWritePending = true;
+            return ACTION_WRITE_LAST_CHUNK;
+        }
+
+        m_fSendComplete = true;
+        return ACTION_SEND_COMPLETE;
+    }
+
+    void
+    OnReadComplete(
+        uint32_t    cbRead
+    ) noexcept
+    {
+        m_fReadPending = false;
+        if (!m_fChunked)
+        {
+            m_cbRemaining = cbRead < m_cbRemaining ? m_cbRemaining - cbRead : 0;
+        }
+
+        //
+        // An empty read has nothing to forward, a chunked entity must not
+        // get an early terminating chunk.
+        //
+        if (cbRead != 0)
+        {
+            m_cbReady = cbRead;
+            m_fReady = true;
+        }
+    }
+
+    //
+    // The client has no more entity, or the read failed and no further
+    // read must be issued.
+    //
+    void
+    OnReadEof() noexcept
+    {
+        m_fReadPending = false;
+        m_fEndOfEntity = true;
+    }
+
+    void
+    OnWriteComplete() noexcept
+    {
+        m_fWritePending = false;
+    }
+
+    bool
+    IsReadPending() const noexcept
+    {
+        return m_fReadPending;
+    }
+
+private:
+
+    bool
+    IsEndOfEntity() const noexcept
+    {
+        return m_fEndOfEntity || (!m_fChunked && m_cbRemaining == 0);
+    }
+
+    uint32_t    m_cbRemaining = 0;
+    uint32_t    m_iReadBuffer = 0;
+    uint32_t    m_cbReady = 0;
+    bool        m_fChunked = false;
+    bool        m_fReadPending = false;
+    bool        m_fWritePending = false;
+    bool        m_fReady = false;
+    bool        m_fEndOfEntity = false;
+    bool        m_fLastChunkWritten = false;
+    bool        m_fSendComplete = false;
+};
@@ -421,6 +421,66 @@ REQUESTHANDLER_CONFIG::Populate(
         goto Finished;
     }
 
+    hr = ConfigUtility::FindLoadBalancingPolicy(pAspNetCoreElement, m_struLoadBalancingPolicy);
+    if (FAILED(hr))
+    {
+        goto Finished;
+    }
+
+    hr = ConfigUtility::FindEnableSpareProcess(pAspNetCoreElement, m_struEnableSpareProcess);
+    if (FAILED(hr))
+    {
+        goto Finished;
+    }
+
+    hr = ConfigUtility::FindStartupQueueLength(pAspNetCoreElement, m_struStartupQueueLength);
+    if (FAILED(hr))
+    {
+        goto Finished;
+    }
+
+    hr = ConfigUtility::FindStartupQueueTimeLimit(pAspNetCoreElement, m_struStartupQueueTimeLimit);
+    if (FAILED(hr))
+    {
+        goto Finished;
+    }
+
+    hr = ConfigUtility::FindResponseCacheSize(pAspNetCoreElement, m_struResponseCacheSize);
+    if (FAILED(hr))
+    {
+        goto Finished;
+    }
+
+    hr = ConfigUtility::FindEnableRequestCollapsing(pAspNetCoreElement, m_struEnableRequestCollapsing);
+    if (FAILED(hr))
+    {
+        goto Finished;
+    }
+
+    hr = ConfigUtility::FindSendFileRoot(pAspNetCoreElement, m_struSendFileRoot);
+    if (FAILED(hr))
+    {
+        goto Finished;
+    }
+
+    hr = ConfigUtility::FindServerTimingSampleRate(pAspNetCoreElement, m_struServerTimingSampleRate);
+    if (FAILED(hr))
+    {
+        goto Finished;
+    }
+
+    hr = ConfigUtility::FindWebSocketIdleTimeout(pAspNetCoreElement, m_struWebSocketIdleTimeout);
+    if (FAILED(hr))
+    {
+        goto Finished;
+    }
+
+    hr = ConfigUtility::FindEnableWebSocketCoalescing(pAspNetCoreElement, m_struEnableWebSocketCoalescing);
+    if (FAILED(hr))
+    {
+        goto Finished;
+    }
+
 Finished:
 
     if (pAspNetCoreElement != nullptr)
@@ -228,6 +228,98 @@ public:
         return &m_struForwardResponseConnectionHeader;
     }
 
+    STRU*
+    QueryLoadBalancingPolicy()
+    {
+        return &m_struLoadBalancingPolicy;
+    }
+
+    BOOL
+    QueryEnableSpareProcess()
+    {
+        return m_struEnableSpareProcess.Equals(L"true", 1);
+    }
+
+    //
+    // Number of requests that wait for a process to start instead of
+    // blocking a thread, 0 when not set.
+    //
+    DWORD
+    QueryStartupQueueLength()
+    {
+        return m_struStartupQueueLength.IsEmpty() ? 0 : static_cast<DWORD>(_wtoi(m_struStartupQueueLength.QueryStr()));
+    }
+
+    //
+    // Seconds in the handler setting, defaults to the startup time limit.
+    //
+    DWORD
+    QueryStartupQueueTimeLimitInMS()
+    {
+        return m_struStartupQueueTimeLimit.IsEmpty() ?
+            m_dwStartupTimeLimitInMS :
+            static_cast<DWORD>(_wtoi(m_struStartupQueueTimeLimit.QueryStr())) * 1000;
+    }
+
+    //
+    // Bytes of backend responses cached in memory, 0 disables the cache.
+    //
+    ULONGLONG
+    QueryResponseCacheSize()
+    {
+        return m_struResponseCacheSize.IsEmpty() ? 0 : static_cast<ULONGLONG>(_wtoi64(m_struResponseCacheSize.QueryStr()));
+    }
+
+    //
+    // Whether concurrent cache misses for a URL wait for the first one
+    // instead of all going to the backend.
+    //
+    BOOL
+    QueryEnableRequestCollapsing()
+    {
+        return m_struEnableRequestCollapsing.Equals(L"true", 1);
+    }
+
+    //
+    // Directory the backend may name files under with X-Sendfile, relative
+    // to the application's physical path. Empty disables X-Sendfile.
+    //
+    STRU*
+    QuerySendFileRoot()
+    {
+        return &m_struSendFileRoot;
+    }
+
+    //
+    // One in this many forwarded responses gets a Server-Timing header
+    // with the durations of its phases. 0 disables the header.
+    //
+    DWORD
+    QueryServerTimingSampleRate()
+    {
+        return m_struServerTimingSampleRate.IsEmpty() ? 0 : static_cast<DWORD>(_wtoi(m_struServerTimingSampleRate.QueryStr()));
+    }
+
+    //
+    // Seconds without a message in either direction after which a proxied
+    // WebSocket is closed. 0 keeps idle WebSockets open.
+    //
+    DWORD
+    QueryWebSocketIdleTimeout()
+    {
+        return m_struWebSocketIdleTimeout.IsEmpty() ? 0 : static_cast<DWORD>(_wtoi(m_struWebSocketIdleTimeout.QueryStr()));
+    }
+
+    //
+    // Whether proxied WebSockets send the parts of a message that arrive in
+    // separate receives as one frame.
+    //
+    BOOL
+    QueryEnableWebSocketCoalescing()
+    {
+        return m_struEnableWebSocketCoalescing.Equals(L"true", 1);
+    }
+
 protected:
 
     //
@@ -260,6 +352,16 @@ protected:
     STRU                   m_struApplicationVirtualPath;
     STRU                   m_struConfigPath;
     STRU                   m_struForwardResponseConnectionHeader;
+    STRU                   m_struLoadBalancingPolicy;
+    STRU                   m_struEnableSpareProcess;
+    STRU                   m_struStartupQueueLength;
+    STRU                   m_struStartupQueueTimeLimit;
+    STRU                   m_struResponseCacheSize;
+    STRU                   m_struEnableRequestCollapsing;
+    STRU                   m_struSendFileRoot;
+    STRU                   m_struServerTimingSampleRate;
+    STRU                   m_struWebSocketIdleTimeout;
+    STRU                   m_struEnableWebSocketCoalescing;
     BOOL                   m_fStdoutLogEnabled;
     BOOL                   m_fForwardWindowsAuthToken;
     BOOL                   m_fDisableStartUpErrorPage;
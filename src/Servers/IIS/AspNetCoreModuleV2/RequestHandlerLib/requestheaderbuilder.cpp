@@ -0,0 +1,338 @@
+// Copyright (c) .NET Foundation. All rights reserved.
+// Licensed under the MIT License. See License.txt in the project root for license information.
+
+#include "stdafx.h"
+#include "requestheaderbuilder.h"
+
+namespace
+{
+    constexpr std::string_view  ASPNETCORE_HEADER_PREFIX = "MS-ASPNETCORE";
+    constexpr std::string_view  WEBSOCKET_EXTENSIONS_HEADER = "Sec-WebSocket-Extensions";
+    constexpr uint32_t          CONNECTION_INDEX = g_KnownRequestHeaders.GetIndex("Connection");
+    constexpr uint32_t          HOST_INDEX = g_KnownRequestHeaders.GetIndex("Host");
+
+    inline
+    char
+    ToLower(
+        char ch
+    ) noexcept
+    {
+        return (ch >= 'A' && ch <= 'Z') ? static_cast<char>(ch - 'A' + 'a') : ch;
+    }
+
+    bool
+    StartsWithIgnoreCase(
+        std::string_view    text,
+        std::string_view    prefix
+    ) noexcept
+    {
+        if (text.size() < prefix.size())
+        {
+            return false;
+        }
+        for (size_t i = 0; i < prefix.size(); i++)
+        {
+            if (ToLower(text[i]) != ToLower(prefix[i]))
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    inline
+    bool
+    EqualsIgnoreCase(
+        std::string_view    name1,
+        std::string_view    name2
+    ) noexcept
+    {
+        return name1.size() == name2.size() && StartsWithIgnoreCase(name1, name2);
+    }
+}
+
+REQUEST_HEADER_RULES::REQUEST_HEADER_RULES() noexcept
+{
+    Initialize(true, {}, {}, {});
+}
+
+void
+REQUEST_HEADER_RULES::Initialize(
+    bool                fPreserveHostHeader,
+    std::string_view    xForwardedForName,
+    std::string_view    sslHeaderName,
+    std::string_view    clientCertName
+) noexcept
+{
+    m_rgSlotNames[SLOT_HOST] = fPreserveHostHeader ? std::string_view() : g_rgRequestHeaderNames[HOST_INDEX];
+    m_rgSlotNames[SLOT_X_FORWARDED_FOR] = xForwardedForName;
+    m_rgSlotNames[SLOT_X_FORWARDED_PROTO] = sslHeaderName;
+    m_rgSlotNames[SLOT_CLIENT_CERT] = clientCertName;
+    m_rgSlotNames[SLOT_ASPNETCORE_TOKEN] = "MS-ASPNETCORE-TOKEN";
+    m_rgSlotNames[SLOT_WINAUTH_TOKEN] = "MS-ASPNETCORE-WINAUTHTOKEN";
+
+    for (uint8_t& knownSlot : m_rgKnownSlots)
+    {
+        knownSlot = SLOT_FORWARD;
+    }
+
+    for (uint8_t slot = 0; slot < SLOT_COUNT; slot++)
+    {
+        m_rgSlotIndexes[slot] = UNKNOWN_INDEX;
+        if (m_rgSlotNames[slot].empty())
+        {
+            continue;
+        }
+
+        const uint32_t dwIndex = g_KnownRequestHeaders.GetIndex(m_rgSlotNames[slot]);
+        if (dwIndex != UNKNOWN_INDEX)
+        {
+            m_rgSlotIndexes[slot] = dwIndex;
+            m_rgKnownSlots[dwIndex] = slot;
+        }
+    }
+}
+
+REQUEST_HEADER_RULES::SLOT
+REQUEST_HEADER_RULES::Classify(
+    uint32_t            dwIndex,
+    std::string_view    name,
+    bool                fWebSocket
+) const noexcept
+{
+    if (dwIndex != UNKNOWN_INDEX)
+    {
+        if (dwIndex >= std::size(m_rgKnownSlots))
+        {
+            return SLOT_FORWARD;
+        }
+        if (dwIndex == CONNECTION_INDEX && !fWebSocket)
+        {
+            return SLOT_DROP;
+        }
+        return static_cast<SLOT>(m_rgKnownSlots[dwIndex]);
+    }
+
+    for (uint8_t slot = 0; slot < SLOT_COUNT; slot++)
+    {
+        if (m_rgSlotIndexes[slot] == UNKNOWN_INDEX &&
+            !m_rgSlotNames[slot].empty() &&
+            EqualsIgnoreCase(name, m_rgSlotNames[slot]))
+        {
+            return static_cast<SLOT>(slot);
+        }
+    }
+
+    //
+    // Headers starting with MS-ASPNETCORE are generated by the module for
+    // the process it creates, never pass them through from the client.
+    //
+    if (StartsWithIgnoreCase(name, ASPNETCORE_HEADER_PREFIX))
+    {
+        return SLOT_DROP;
+    }
+
+    //
+    // WinHttp does not support any extensions being returned by the server,
+    // so the server must not see any being offered.
+    //
+    if (fWebSocket && EqualsIgnoreCase(name, WEBSOCKET_EXTENSIONS_HEADER))
+    {
+        return SLOT_DROP;
+    }
+
+    return SLOT_FORWARD;
+}
+
+REQUEST_HEADER_BUILDER::REQUEST_HEADER_BUILDER(
+    const REQUEST_HEADER_RULES &    rules,
+    bool                            fWebSocket
+) noexcept
+    : m_rules(rules),
+      m_rgSlots{},
+      m_pszBlock(nullptr),
+      m_cchBlock(0),
+      m_cchWritten(0),
+      m_cchMeasured(0),
+      m_position(0),
+      m_fWebSocket(fWebSocket),
+      m_fError(false)
+{
+}
+
+void
+REQUEST_HEADER_BUILDER::SetValue(
+    REQUEST_HEADER_RULES::SLOT  slot,
+    std::string_view            value
+) noexcept
+{
+    if (slot < REQUEST_HEADER_RULES::SLOT_COUNT && !m_rules.QuerySlotName(slot).empty())
+    {
+        m_rgSlots[slot].value = value;
+        m_rgSlots[slot].fHasValue = true;
+    }
+}
+
+void
+REQUEST_HEADER_BUILDER::Measure(
+    uint32_t            dwIndex,
+    std::string_view    name,
+    std::string_view    value
+) noexcept
+{
+    const size_t position = m_position++;
+    const REQUEST_HEADER_RULES::SLOT slot = m_rules.Classify(dwIndex, name, m_fWebSocket);
+
+    if (slot == REQUEST_HEADER_RULES::SLOT_FORWARD)
+    {
+        m_cchMeasured += LineLength(name, value);
+    }
+    else if (slot < REQUEST_HEADER_RULES::SLOT_COUNT)
+    {
+        SLOT_STATE& state = m_rgSlots[slot];
+        state.fSeen = true;
+        state.lastPosition = position;
+        state.lastValue = value;
+
+        //
+        // Every instance of an append header is kept, the value is added
+        // to the last one.
+        //
+        if (REQUEST_HEADER_RULES::IsAppendSlot(slot))
+        {
+            m_cchMeasured += LineLength(name, value);
+        }
+    }
+}
+
+size_t
+REQUEST_HEADER_BUILDER::EndMeasure(
+) noexcept
+{
+    for (uint8_t slot = 0; slot < REQUEST_HEADER_RULES::SLOT_COUNT; slot++)
+    {
+        const SLOT_STATE& state = m_rgSlots[slot];
+        if (!state.fHasValue)
+        {
+            continue;
+        }
+
+        if (state.fSeen && REQUEST_HEADER_RULES::IsAppendSlot(static_cast<REQUEST_HEADER_RULES::SLOT>(slot)))
+        {
+            m_cchMeasured += (state.lastValue.empty() ? 0 : 2) + state.value.size();
+        }
+        else
+        {
+            m_cchMeasured += LineLength(m_rules.QuerySlotName(static_cast<REQUEST_HEADER_RULES::SLOT>(slot)), state.value);
+        }
+    }
+
+    return m_cchMeasured;
+}
+
+void
+REQUEST_HEADER_BUILDER::BeginWrite(
+    wchar_t *           pszBlock,
+    size_t              cchBlock
+) noexcept
+{
+    m_pszBlock = pszBlock;
+    m_cchBlock = cchBlock;
+    m_cchWritten = 0;
+    m_position = 0;
+}
+
+void
+REQUEST_HEADER_BUILDER::Write(
+    uint32_t            dwIndex,
+    std::string_view    name,
+    std::string_view    value
+) noexcept
+{
+    const size_t position = m_position++;
+    const REQUEST_HEADER_RULES::SLOT slot = m_rules.Classify(dwIndex, name, m_fWebSocket);
+
+    if (slot == REQUEST_HEADER_RULES::SLOT_FORWARD)
+    {
+        WriteLine(name, value);
+        return;
+    }
+    if (slot >= REQUEST_HEADER_RULES::SLOT_COUNT)
+    {
+        return;
+    }
+
+    const SLOT_STATE& state = m_rgSlots[slot];
+    const bool fAppend = REQUEST_HEADER_RULES::IsAppendSlot(slot);
+
+    if (position != state.lastPosition || !state.fHasValue)
+    {
+        if (fAppend)
+        {
+            WriteLine(name, value);
+        }
+        return;
+    }
+
+    WriteString(name);
+    WriteString(": ");
+    if (fAppend && !value.empty())
+    {
+        WriteString(value);
+        WriteString(", ");
+    }
+    WriteString(state.value);
+    WriteString("\r\n");
+}
+
+size_t
+REQUEST_HEADER_BUILDER::EndWrite(
+) noexcept
+{
+    for (uint8_t slot = 0; slot < REQUEST_HEADER_RULES::SLOT_COUNT; slot++)
+    {
+        const SLOT_STATE& state = m_rgSlots[slot];
+        if (state.fHasValue && !state.fSeen)
+        {
+            WriteLine(m_rules.QuerySlotName(static_cast<REQUEST_HEADER_RULES::SLOT>(slot)), state.value);
+        }
+    }
+
+    if (m_cchWritten != m_cchMeasured)
+    {
+        m_fError = true;
+    }
+
+    return m_cchWritten;
+}
+
+void
+REQUEST_HEADER_BUILDER::WriteString(
+    std::string_view    text
+) noexcept
+{
+    if (text.size() > m_cchBlock - m_cchWritten)
+    {
+        m_fError = true;
+        text = text.substr(0, m_cchBlock - m_cchWritten);
+    }
+
+    wchar_t * const pszOut = m_pszBlock + m_cchWritten;
+    for (size_t i = 0; i < text.size(); i++)
+    {
+        pszOut[i] = static_cast<unsigned char>(text[i]);
+    }
+    m_cchWritten += text.size();
+}
+
+void
+REQUEST_HEADER_BUILDER::WriteLine(
+    std::string_view    name,
+    std::string_view    value
+) noexcept
+{
+    WriteString(name);
+    WriteString(": ");
+    WriteString(value);
+    WriteString("\r\n");
+}
@@ -0,0 +1,204 @@
+// Copyright (c) .NET Foundation. All rights reserved.
+// Licensed under the MIT License. See License.txt in the project root for license information.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <string_view>
+#include "knownheaders.h"
+
+//
+// Header rewrite rules applied to every request forwarded to the backend,
+// compiled once from the protocol configuration.
+//
+// Each header the module rewrites is owned by a slot. Slots either replace
+// every instance of their header with a single module-generated value
+// (Host, client certificate, tokens) or append a value to the last instance
+// (X-Forwarded-For, X-Forwarded-Proto). Headers starting with MS-ASPNETCORE
+// are dropped, as is Connection for non-websocket requests and
+// Sec-WebSocket-Extensions for websocket requests.
+//
+class REQUEST_HEADER_RULES
+{
+public:
+
+    enum SLOT : uint8_t
+    {
+        SLOT_HOST,
+        SLOT_X_FORWARDED_FOR,
+        SLOT_X_FORWARDED_PROTO,
+        SLOT_CLIENT_CERT,
+        SLOT_ASPNETCORE_TOKEN,
+        SLOT_WINAUTH_TOKEN,
+        SLOT_COUNT,
+
+        SLOT_FORWARD = SLOT_COUNT,
+        SLOT_DROP
+    };
+
+    REQUEST_HEADER_RULES() noexcept;
+
+    //
+    // An empty name disables the corresponding slot. The names must outlive
+    // the rules.
+    //
+    void
+    Initialize(
+        bool                fPreserveHostHeader,
+        std::string_view    xForwardedForName,
+        std::string_view    sslHeaderName,
+        std::string_view    clientCertName
+    ) noexcept;
+
+    //
+    // Returns the slot owning the header, SLOT_FORWARD or SLOT_DROP.
+    // dwIndex is the HTTP_HEADER_ID of a known header or UNKNOWN_INDEX.
+    //
+    SLOT
+    Classify(
+        uint32_t            dwIndex,
+        std::string_view    name,
+        bool                fWebSocket
+    ) const noexcept;
+
+    std::string_view
+    QuerySlotName(
+        SLOT                slot
+    ) const noexcept
+    {
+        return m_rgSlotNames[slot];
+    }
+
+    static
+    bool
+    IsAppendSlot(
+        SLOT                slot
+    ) noexcept
+    {
+        return slot == SLOT_X_FORWARDED_FOR || slot == SLOT_X_FORWARDED_PROTO;
+    }
+
+private:
+
+    std::string_view    m_rgSlotNames[SLOT_COUNT];
+    uint32_t            m_rgSlotIndexes[SLOT_COUNT];
+    uint8_t             m_rgKnownSlots[std::size(g_rgRequestHeaderNames)];
+};
+
+//
+// Builds the header block sent to the backend, as "Name: value\r\n" lines,
+// straight from the request headers without modifying them.
+//
+// The headers are fed twice in the same order: once to Measure() so the
+// block can be allocated with its exact size, then to Write(). A slot value
+// is emitted at the position of the last instance of its header, or after all
+// other headers when the request does not have it.
+//
+// Header bytes are widened one to one for WinHTTP, which narrows them back
+// the same way, so non-ASCII bytes reach the backend unchanged.
+//
+class REQUEST_HEADER_BUILDER
+{
+public:
+
+    REQUEST_HEADER_BUILDER(
+        const REQUEST_HEADER_RULES &    rules,
+        bool                            fWebSocket
+    ) noexcept;
+
+    //
+    // Sets the value of a slot, must be called before the first Measure().
+    // A replace slot without a value removes its header.
+    //
+    void
+    SetValue(
+        REQUEST_HEADER_RULES::SLOT  slot,
+        std::string_view            value
+    ) noexcept;
+
+    void
+    Measure(
+        uint32_t            dwIndex,
+        std::string_view    name,
+        std::string_view    value
+    ) noexcept;
+
+    //
+    // Returns the number of characters in the header block.
+    //
+    size_t
+    EndMeasure(
+    ) noexcept;
+
+    void
+    BeginWrite(
+        wchar_t *           pszBlock,
+        size_t              cchBlock
+    ) noexcept;
+
+    void
+    Write(
+        uint32_t            dwIndex,
+        std::string_view    name,
+        std::string_view    value
+    ) noexcept;
+
+    //
+    // Returns the number of characters written, which equals the value
+    // returned by EndMeasure() unless the headers changed between the passes,
+    // in which case HasError() is set and the block is truncated.
+    //
+    size_t
+    EndWrite(
+    ) noexcept;
+
+    bool
+    HasError() const noexcept
+    {
+        return m_fError;
+    }
+
+private:
+
+    struct SLOT_STATE
+    {
+        std::string_view    value;
+        std::string_view    lastValue;
+        size_t              lastPosition;
+        bool                fHasValue;
+        bool                fSeen;
+    };
+
+    static
+    size_t
+    LineLength(
+        std::string_view    name,
+        std::string_view    value
+    ) noexcept
+    {
+        return name.size() + 2 + value.size() + 2;
+    }
+
+    void
+    WriteString(
+        std::string_view    text
+    ) noexcept;
+
+    void
+    WriteLine(
+        std::string_view    name,
+        std::string_view    value
+    ) noexcept;
+
+    const REQUEST_HEADER_RULES &    m_rules;
+    SLOT_STATE                      m_rgSlots[REQUEST_HEADER_RULES::SLOT_COUNT];
+    wchar_t *                       m_pszBlock;
+    size_t                          m_cchBlock;
+    size_t                          m_cchWritten;
+    size_t                          m_cchMeasured;
+    size_t                          m_position;
+    bool                            m_fWebSocket;
+    bool                            m_fError;
+};
@@ -0,0 +1,284 @@
+// Copyright (c) .NET Foundation. All rights reserved.
+// Licensed under the MIT License. See License.txt in the project root for license information.
+
+#include "stdafx.h"
+#include "requestphases.h"
+
+namespace
+{
+    const char * const  PHASE_NAMES[REQUEST_PHASE_COUNT] =
+    {
+        "ancm-process",
+        "ancm-connect",
+        "ancm-send-headers",
+        "ancm-send-body",
+        "ancm-first-byte",
+        "ancm-headers",
+        "ancm-last-byte",
+        "ancm-client-flush",
+    };
+
+    inline
+    uint32_t
+    HighestBit(
+        uint64_t    ullValue
+    ) noexcept
+    {
+        uint32_t iBit = 0;
+        while (ullValue >>= 1)
+        {
+            iBit++;
+        }
+        return iBit;
+    }
+
+    void
+    UpdateMax(
+        std::atomic<uint64_t>&  ullMax,
+        uint64_t                ullValue
+    ) noexcept
+    {
+        uint64_t ullCurrent = ullMax.load(std::memory_order_relaxed);
+        while (ullValue > ullCurrent &&
+            !ullMax.compare_exchange_weak(ullCurrent, ullValue, std::memory_order_relaxed))
+        {
+        }
+    }
+}
+
+bool
+REQUEST_PHASE_TIMER::TryGetDuration(
+    REQUEST_PHASE   phase,
+    int64_t         llFrequency,
+    uint64_t *      pullMicroseconds
+) const noexcept
+{
+    if (m_rgllEnd[phase] == 0 || llFrequency <= 0)
+    {
+        return false;
+    }
+
+    int64_t llBegin = m_llStart;
+    for (uint32_t iPhase = phase; iPhase-- > 0;)
+    {
+        if (m_rgllEnd[iPhase] != 0)
+        {
+            llBegin = m_rgllEnd[iPhase];
+            break;
+        }
+    }
+
+    const int64_t llTicks = m_rgllEnd[phase] > llBegin ? m_rgllEnd[phase] - llBegin : 0;
+
+    //
+    // Split to not overflow the multiplication for long phases.
+    //
+    *pullMicroseconds = static_cast<uint64_t>(llTicks / llFrequency) * 1000000 +
+        static_cast<uint64_t>(llTicks % llFrequency) * 1000000 / static_cast<uint64_t>(llFrequency);
+    return true;
+}
+
+std::string
+REQUEST_PHASE_TIMER::FormatServerTiming(
+    int64_t         llFrequency
+) const
+{
+    std::string strValue;
+    char szDuration[32];
+
+    for (uint32_t iPhase = 0; iPhase < REQUEST_PHASE_COUNT; iPhase++)
+    {
+        uint64_t ullMicroseconds = 0;
+        if (!TryGetDuration(static_cast<REQUEST_PHASE>(iPhase), llFrequency, &ullMicroseconds))
+        {
+            continue;
+        }
+
+        snprintf(szDuration,
+            sizeof(szDuration),
+            ";dur=%llu.%03llu",
+            static_cast<unsigned long long>(ullMicroseconds / 1000),
+            static_cast<unsigned long long>(ullMicroseconds % 1000));
+
+        if (!strValue.empty())
+        {
+            strValue.append(", ");
+        }
+        strValue.append(PHASE_NAMES[iPhase]);
+        strValue.append(szDuration);
+    }
+
+    return strValue;
+}
+
+// static
+const char *
+REQUEST_PHASE_TIMER::GetPhaseName(
+    REQUEST_PHASE   phase
+) noexcept
+{
+    return phase < REQUEST_PHASE_COUNT ? PHASE_NAMES[phase] : "";
+}
+
+// static
+uint32_t
+LATENCY_BUCKETS::GetBucket(
+    uint64_t    ullValue
+) noexcept
+{
+    if (ullValue < 2 * SUB_BUCKET_COUNT)
+    {
+        return static_cast<uint32_t>(ullValue);
+    }
+
+    if (ullValue >> MAX_VALUE_BITS != 0)
+    {
+        return BUCKET_COUNT - 1;
+    }
+
+    //
+    // The highest bit picks the power of two, the SUB_BUCKET_BITS below it
+    // the sub bucket.
+    //
+    const uint32_t iBit = HighestBit(ullValue);
+    const uint32_t iSubBucket = static_cast<uint32_t>(ullValue >> (iBit - SUB_BUCKET_BITS)) & (SUB_BUCKET_COUNT - 1);
+    return 2 * SUB_BUCKET_COUNT + (iBit - SUB_BUCKET_BITS - 1) * SUB_BUCKET_COUNT + iSubBucket;
+}
+
+// static
+uint64_t
+LATENCY_BUCKETS::GetBucketUpperBound(
+    uint32_t    iBucket
+) noexcept
+{
+    if (iBucket < 2 * SUB_BUCKET_COUNT)
+    {
+        return iBucket;
+    }
+
+    const uint32_t iBit = (iBucket - 2 * SUB_BUCKET_COUNT) / SUB_BUCKET_COUNT + SUB_BUCKET_BITS + 1;
+    const uint64_t ullSubBucket = (iBucket - 2 * SUB_BUCKET_COUNT) % SUB_BUCKET_COUNT;
+    const uint32_t iShift = iBit - SUB_BUCKET_BITS;
+
+    return ((SUB_BUCKET_COUNT + ullSubBucket + 1) << iShift) - 1;
+}
+
+void
+REQUEST_PHASE_STATISTICS::Initialize(
+    uint32_t        cProcessors
+)
+{
+    uint32_t cShards = 1;
+    while (cShards < cProcessors && cShards < MAX_SHARD_COUNT)
+    {
+        cShards <<= 1;
+    }
+
+    m_pShards.reset(new SHARD[cShards]());
+    m_dwShardMask = cShards - 1;
+}
+
+void
+REQUEST_PHASE_STATISTICS::Record(
+    const REQUEST_PHASE_TIMER&  timer,
+    int64_t                     llFrequency
+) noexcept
+{
+    for (uint32_t iPhase = 0; iPhase < REQUEST_PHASE_COUNT; iPhase++)
+    {
+        uint64_t ullMicroseconds = 0;
+        if (timer.TryGetDuration(static_cast<REQUEST_PHASE>(iPhase), llFrequency, &ullMicroseconds))
+        {
+            RecordPhase(static_cast<REQUEST_PHASE>(iPhase), ullMicroseconds);
+        }
+    }
+}
+
+void
+REQUEST_PHASE_STATISTICS::RecordPhase(
+    REQUEST_PHASE   phase,
+    uint64_t        ullMicroseconds
+) noexcept
+{
+    if (m_pShards == nullptr)
+    {
+        return;
+    }
+
+    //
+    // A thread may move to another processor meanwhile, the counters are
+    // atomic so that only costs a shared cache line.
+    //
+    SHARD& shard = m_pShards[GetCurrentProcessorNumber() & m_dwShardMask];
+
+    shard.rgcBuckets[phase][LATENCY_BUCKETS::GetBucket(ullMicroseconds)].fetch_add(1, std::memory_order_relaxed);
+    shard.rgullSum[phase].fetch_add(ullMicroseconds, std::memory_order_relaxed);
+    UpdateMax(shard.rgullMax[phase], ullMicroseconds);
+}
+
+REQUEST_PHASE_SUMMARY
+REQUEST_PHASE_STATISTICS::QuerySummary(
+    REQUEST_PHASE   phase
+) const noexcept
+{
+    REQUEST_PHASE_SUMMARY summary = {};
+    uint64_t rgcBuckets[LATENCY_BUCKETS::BUCKET_COUNT] = {};
+    uint64_t ullSum = 0;
+
+    if (m_pShards == nullptr)
+    {
+        return summary;
+    }
+
+    for (uint32_t iShard = 0; iShard <= m_dwShardMask; iShard++)
+    {
+        const SHARD& shard = m_pShards[iShard];
+        for (uint32_t iBucket = 0; iBucket < LATENCY_BUCKETS::BUCKET_COUNT; iBucket++)
+        {
+            const uint64_t cBucket = shard.rgcBuckets[phase][iBucket].load(std::memory_order_relaxed);
+            rgcBuckets[iBucket] += cBucket;
+            summary.cSamples += cBucket;
+        }
+        ullSum += shard.rgullSum[phase].load(std::memory_order_relaxed);
+
+        const uint64_t ullMax = shard.rgullMax[phase].load(std::memory_order_relaxed);
+        if (ullMax > summary.ullMaxUs)
+        {
+            summary.ullMaxUs = ullMax;
+        }
+    }
+
+    if (summary.cSamples == 0)
+    {
+        return summary;
+    }
+
+    summary.ullMeanUs = ullSum / summary.cSamples;
+
+    //
+    // Rank of a percentile is rounded up, the median of two samples is
+    // the first one.
+    //
+    const uint64_t rgcRanks[] =
+    {
+        (summary.cSamples * 50 + 99) / 100,
+        (summary.cSamples * 90 + 99) / 100,
+        (summary.cSamples * 99 + 99) / 100,
+    };
+    uint64_t *rgpullPercentiles[] = { &summary.ullP50Us, &summary.ullP90Us, &summary.ullP99Us };
+
+    uint64_t cSeen = 0;
+    uint32_t iPercentile = 0;
+    for (uint32_t iBucket = 0; iBucket < LATENCY_BUCKETS::BUCKET_COUNT && iPercentile < 3; iBucket++)
+    {
+        cSeen += rgcBuckets[iBucket];
+        while (iPercentile < 3 && cSeen >= rgcRanks[iPercentile])
+        {
+            const uint64_t ullBound = LATENCY_BUCKETS::GetBucketUpperBound(iBucket);
+            *rgpullPercentiles[iPercentile] = ullBound < summary.ullMaxUs ? ullBound : summary.ullMaxUs;
+            iPercentile++;
+        }
+    }
+
+    return summary;
+}
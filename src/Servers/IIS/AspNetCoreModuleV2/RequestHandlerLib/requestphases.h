@@ -0,0 +1,228 @@
+// Copyright (c) .NET Foundation. All rights reserved.
+// Licensed under the MIT License. See License.txt in the project root for license information.
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+//
+// Phases of a forwarded request, in the order they end. The duration of a
+// phase runs from the end of the latest earlier phase that was reached, or
+// from the start of the request.
+//
+enum REQUEST_PHASE : uint32_t
+{
+    //
+    // A backend process is picked, including the wait for admission.
+    //
+    REQUEST_PHASE_PROCESS_ACQUIRE,
+    //
+    // WinHTTP has a connection to the backend and starts sending.
+    //
+    REQUEST_PHASE_CONNECT,
+    REQUEST_PHASE_SEND_HEADERS,
+    REQUEST_PHASE_SEND_BODY,
+    //
+    // The backend's response headers are received.
+    //
+    REQUEST_PHASE_FIRST_BYTE,
+    REQUEST_PHASE_HEADERS_SET,
+    REQUEST_PHASE_LAST_BYTE,
+    //
+    // The last of the response is handed to the client connection.
+    //
+    REQUEST_PHASE_CLIENT_FLUSH,
+    REQUEST_PHASE_COUNT
+};
+
+//
+// Timestamps of the phases of one request, in QueryPerformanceCounter ticks.
+// Only the first time a phase ends is kept.
+//
+class REQUEST_PHASE_TIMER
+{
+public:
+
+    REQUEST_PHASE_TIMER() noexcept
+        : m_llStart(0),
+          m_rgllEnd{}
+    {
+    }
+
+    void
+    Start(
+        int64_t         llNow
+    ) noexcept
+    {
+        if (m_llStart == 0)
+        {
+            m_llStart = llNow;
+        }
+    }
+
+    void
+    Mark(
+        REQUEST_PHASE   phase,
+        int64_t         llNow
+    ) noexcept
+    {
+        if (m_llStart != 0 && m_rgllEnd[phase] == 0)
+        {
+            m_rgllEnd[phase] = llNow;
+        }
+    }
+
+    bool
+    IsMarked(
+        REQUEST_PHASE   phase
+    ) const noexcept
+    {
+        return m_rgllEnd[phase] != 0;
+    }
+
+    //
+    // Duration of a phase in microseconds, false if it was not reached.
+    //
+    bool
+    TryGetDuration(
+        REQUEST_PHASE   phase,
+        int64_t         llFrequency,
+        uint64_t *      pullMicroseconds
+    ) const noexcept;
+
+    //
+    // Server-Timing header value with the phases reached so far, in
+    // milliseconds: "ancm-process;dur=0.125, ancm-connect;dur=1.500".
+    //
+    std::string
+    FormatServerTiming(
+        int64_t         llFrequency
+    ) const;
+
+    static
+    const char *
+    GetPhaseName(
+        REQUEST_PHASE   phase
+    ) noexcept;
+
+private:
+
+    int64_t     m_llStart;
+    int64_t     m_rgllEnd[REQUEST_PHASE_COUNT];
+};
+
+//
+// Log-linear histogram bucketing of microsecond durations, in the manner
+// of HDR histograms: values below 2 * SUB_BUCKET_COUNT have a bucket each,
+// above that every power of two is split in SUB_BUCKET_COUNT buckets, so a
+// bucket is never wider than 1 / SUB_BUCKET_COUNT of its values.
+//
+class LATENCY_BUCKETS
+{
+public:
+
+    static constexpr uint32_t   SUB_BUCKET_BITS = 3;
+    static constexpr uint32_t   SUB_BUCKET_COUNT = 1 << SUB_BUCKET_BITS;
+    //
+    // Durations of 2^MAX_VALUE_BITS microseconds (about 71 minutes) or
+    // more share the last bucket.
+    //
+    static constexpr uint32_t   MAX_VALUE_BITS = 32;
+    static constexpr uint32_t   BUCKET_COUNT = 2 * SUB_BUCKET_COUNT +
+        (MAX_VALUE_BITS - SUB_BUCKET_BITS - 1) * SUB_BUCKET_COUNT;
+
+    static
+    uint32_t
+    GetBucket(
+        uint64_t    ullValue
+    ) noexcept;
+
+    //
+    // Largest value counted in a bucket.
+    //
+    static
+    uint64_t
+    GetBucketUpperBound(
+        uint32_t    iBucket
+    ) noexcept;
+};
+
+struct REQUEST_PHASE_SUMMARY
+{
+    uint64_t    cSamples;
+    uint64_t    ullMeanUs;
+    uint64_t    ullP50Us;
+    uint64_t    ullP90Us;
+    uint64_t    ullP99Us;
+    uint64_t    ullMaxUs;
+};
+
+//
+// Per application histograms of the phase durations of forwarded requests.
+// Recording is lock-free, each processor counts into its own shard and the
+// shards are only summed when a summary is queried.
+//
+class REQUEST_PHASE_STATISTICS
+{
+public:
+
+    static constexpr uint32_t   MAX_SHARD_COUNT = 16;
+
+    REQUEST_PHASE_STATISTICS() noexcept
+        : m_dwShardMask(0)
+    {
+    }
+
+    //
+    // Allocates a shard per processor, up to MAX_SHARD_COUNT. Nothing is
+    // recorded before.
+    //
+    void
+    Initialize(
+        uint32_t        cProcessors
+    );
+
+    bool
+    IsEnabled() const noexcept
+    {
+        return m_pShards != nullptr;
+    }
+
+    //
+    // Records the phases the request reached.
+    //
+    void
+    Record(
+        const REQUEST_PHASE_TIMER&  timer,
+        int64_t                     llFrequency
+    ) noexcept;
+
+    void
+    RecordPhase(
+        REQUEST_PHASE   phase,
+        uint64_t        ullMicroseconds
+    ) noexcept;
+
+    //
+    // Percentiles are reported as the upper bound of their bucket.
+    //
+    REQUEST_PHASE_SUMMARY
+    QuerySummary(
+        REQUEST_PHASE   phase
+    ) const noexcept;
+
+private:
+
+    struct alignas(64) SHARD
+    {
+        std::atomic<uint64_t>   rgcBuckets[REQUEST_PHASE_COUNT][LATENCY_BUCKETS::BUCKET_COUNT];
+        std::atomic<uint64_t>   rgullSum[REQUEST_PHASE_COUNT];
+        std::atomic<uint64_t>   rgullMax[REQUEST_PHASE_COUNT];
+    };
+
+    uint32_t                    m_dwShardMask;
+    std::unique_ptr<SHARD[]>    m_pShards;
+};
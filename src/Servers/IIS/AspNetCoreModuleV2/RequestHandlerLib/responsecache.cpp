@@ -0,0 +1,430 @@
+// Copyright (c) .NET Foundation. All rights reserved.
+// Licensed under the MIT License. See License.txt in the project root for license information.
+
+#include "stdafx.h"
+#include "responsecache.h"
+#include "headertokenizer.h"
+#include <algorithm>
+
+namespace
+{
+    inline
+    char
+    ToLower(
+        char    ch
+    ) noexcept
+    {
+        return ch >= 'A' && ch <= 'Z' ? static_cast<char>(ch - 'A' + 'a') : ch;
+    }
+
+    bool
+    EqualsIgnoreCase(
+        std::string_view    left,
+        std::string_view    right
+    ) noexcept
+    {
+        if (left.size() != right.size())
+        {
+            return false;
+        }
+
+        for (size_t i = 0; i < left.size(); i++)
+        {
+            if (ToLower(left[i]) != ToLower(right[i]))
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    std::string_view
+    Trim(
+        std::string_view    text
+    ) noexcept
+    {
+        while (!text.empty() && (text.front() == ' ' || text.front() == '\t'))
+        {
+            text.remove_prefix(1);
+        }
+        while (!text.empty() && (text.back() == ' ' || text.back() == '\t'))
+        {
+            text.remove_suffix(1);
+        }
+        return text;
+    }
+
+    //
+    // Calls onElement for every non-empty element of a comma separated list.
+    //
+    template<typename FUNC>
+    void
+    ForEachListElement(
+        std::string_view    list,
+        FUNC                onElement
+    )
+    {
+        while (!list.empty())
+        {
+            const size_t iComma = list.find(',');
+            const std::string_view element = Trim(list.substr(0, iComma));
+            if (!element.empty())
+            {
+                onElement(element);
+            }
+            list = iComma == std::string_view::npos ? std::string_view() : list.substr(iComma + 1);
+        }
+    }
+
+    //
+    // Parses the delta-seconds argument of a directive, false if malformed.
+    //
+    bool
+    TryParseSeconds(
+        std::string_view    text,
+        uint32_t *          pdwSeconds
+    ) noexcept
+    {
+        if (!text.empty() && text.front() == '"' && text.size() >= 2 && text.back() == '"')
+        {
+            text = text.substr(1, text.size() - 2);
+        }
+
+        if (text.empty())
+        {
+            return false;
+        }
+
+        uint64_t ullSeconds = 0;
+        for (char ch : text)
+        {
+            if (ch < '0' || ch > '9')
+            {
+                return false;
+            }
+            ullSeconds = std::min<uint64_t>(ullSeconds * 10 + (ch - '0'), UINT32_MAX);
+        }
+
+        *pdwSeconds = static_cast<uint32_t>(ullSeconds);
+        return true;
+    }
+
+    //
+    // Returns the Age the response arrived with, 0 if it has none.
+    //
+    uint32_t
+    GetAgeSeconds(
+        std::string_view    headers
+    )
+    {
+        HEADER_TOKENIZER tokenizer(headers);
+        uint16_t uStatus = 0;
+        std::string_view reason;
+        std::string_view name;
+        std::string_view value;
+        uint32_t dwAge = 0;
+
+        if (tokenizer.ParseStatusLine(uStatus, reason))
+        {
+            while (tokenizer.Next(name, value))
+            {
+                if (EqualsIgnoreCase(name, "Age") && !TryParseSeconds(Trim(value), &dwAge))
+                {
+                    dwAge = 0;
+                }
+            }
+        }
+
+        return dwAge;
+    }
+}
+
+void
+RESPONSE_CACHE::Initialize(
+    uint64_t    cbMaxSize,
+    uint64_t    cbMaxEntitySize
+)
+{
+    std::lock_guard<std::mutex> lock(m_lock);
+
+    m_cbMaxSize = cbMaxSize;
+    m_cbMaxEntitySize = (std::min)(cbMaxEntitySize, cbMaxSize);
+}
+
+std::shared_ptr<const CACHED_RESPONSE>
+RESPONSE_CACHE::Lookup(
+    const std::string&              strUrl,
+    const REQUEST_HEADER_READER&    readHeader,
+    uint64_t                        ullNowMs
+)
+{
+    std::vector<std::string> rgVaryHeaders;
+
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+
+        const auto iterVary = m_vary.find(strUrl);
+        if (iterVary == m_vary.end())
+        {
+            m_cMisses++;
+            return nullptr;
+        }
+        rgVaryHeaders = iterVary->second.rgHeaders;
+    }
+
+    //
+    // Request headers are read outside of the lock.
+    //
+    const std::string strKey = BuildKey(strUrl, rgVaryHeaders, readHeader);
+
+    std::lock_guard<std::mutex> lock(m_lock);
+
+    const auto iterEntry = m_entries.find(strKey);
+    if (iterEntry == m_entries.end())
+    {
+        m_cMisses++;
+        return nullptr;
+    }
+
+    if (iterEntry->second->ullExpiresMs <= ullNowMs)
+    {
+        RemoveNoLock(iterEntry->second);
+        m_cMisses++;
+        return nullptr;
+    }
+
+    m_lru.splice(m_lru.begin(), m_lru, iterEntry->second);
+    m_cHits++;
+    return iterEntry->second->pResponse;
+}
+
+bool
+RESPONSE_CACHE::Insert(
+    const std::string&                  strUrl,
+    const REQUEST_HEADER_READER&        readHeader,
+    std::unique_ptr<CACHED_RESPONSE>    pResponse,
+    uint64_t                            ullNowMs
+)
+{
+    uint32_t dwMaxAgeSeconds = 0;
+    std::vector<std::string> rgVaryHeaders;
+
+    if (!IsEnabled() ||
+        pResponse->strEntity.size() > m_cbMaxEntitySize ||
+        !TryGetResponsePolicy(pResponse->strHeaders, &dwMaxAgeSeconds, &rgVaryHeaders))
+    {
+        return false;
+    }
+
+    //
+    // The response stays fresh for what is left of its lifetime.
+    //
+    const uint32_t dwAgeSeconds = GetAgeSeconds(pResponse->strHeaders);
+    if (dwAgeSeconds >= dwMaxAgeSeconds)
+    {
+        return false;
+    }
+
+    pResponse->ullInsertedMs = ullNowMs;
+    pResponse->dwInitialAgeSeconds = dwAgeSeconds;
+
+    ENTRY entry;
+    entry.strKey = BuildKey(strUrl, rgVaryHeaders, readHeader);
+    entry.strUrl = strUrl;
+    entry.ullExpiresMs = ullNowMs + static_cast<uint64_t>(dwMaxAgeSeconds - dwAgeSeconds) * 1000;
+    entry.cbSize = ENTRY_OVERHEAD + entry.strKey.size() + strUrl.size() +
+        pResponse->strHeaders.size() + pResponse->strEntity.size();
+    entry.pResponse = std::move(pResponse);
+
+    if (entry.cbSize > m_cbMaxSize)
+    {
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(m_lock);
+
+    const auto iterExisting = m_entries.find(entry.strKey);
+    if (iterExisting != m_entries.end())
+    {
+        RemoveNoLock(iterExisting->second);
+    }
+
+    //
+    // The latest response decides what the URL varies on, entries stored
+    // under other Vary headers are no longer found and age out.
+    //
+    VARY& vary = m_vary[strUrl];
+    vary.rgHeaders = std::move(rgVaryHeaders);
+    vary.cEntries++;
+
+    m_cbSize += entry.cbSize;
+    m_lru.push_front(std::move(entry));
+    m_entries.emplace(m_lru.front().strKey, m_lru.begin());
+    m_cInserts++;
+
+    while (m_cbSize > m_cbMaxSize)
+    {
+        RemoveNoLock(std::prev(m_lru.end()));
+        m_cEvictions++;
+    }
+
+    return true;
+}
+
+RESPONSE_CACHE_STATISTICS
+RESPONSE_CACHE::QueryStatistics() const
+{
+    std::lock_guard<std::mutex> lock(m_lock);
+
+    RESPONSE_CACHE_STATISTICS statistics;
+    statistics.cHits = m_cHits;
+    statistics.cMisses = m_cMisses;
+    statistics.cInserts = m_cInserts;
+    statistics.cEvictions = m_cEvictions;
+    statistics.cbSize = m_cbSize;
+    return statistics;
+}
+
+// static
+uint32_t
+RESPONSE_CACHE::QueryAgeSeconds(
+    const CACHED_RESPONSE&  response,
+    uint64_t                ullNowMs
+) noexcept
+{
+    const uint64_t ullResidentSeconds = ullNowMs > response.ullInsertedMs ?
+        (ullNowMs - response.ullInsertedMs) / 1000 :
+        0;
+
+    return static_cast<uint32_t>(std::min<uint64_t>(response.dwInitialAgeSeconds + ullResidentSeconds, UINT32_MAX));
+}
+
+// static
+bool
+RESPONSE_CACHE::TryGetResponsePolicy(
+    std::string_view            headers,
+    uint32_t *                  pdwMaxAgeSeconds,
+    std::vector<std::string> *  pVaryHeaders
+)
+{
+    HEADER_TOKENIZER tokenizer(headers);
+    uint16_t uStatus = 0;
+    std::string_view reason;
+    std::string_view name;
+    std::string_view value;
+    bool fPublic = false;
+    bool fNoCache = false;
+    bool fMaxAge = false;
+    bool fSharedMaxAge = false;
+    uint32_t dwMaxAge = 0;
+    uint32_t dwSharedMaxAge = 0;
+
+    pVaryHeaders->clear();
+
+    if (!tokenizer.ParseStatusLine(uStatus, reason) || uStatus != 200)
+    {
+        return false;
+    }
+
+    while (tokenizer.Next(name, value))
+    {
+        if (EqualsIgnoreCase(name, "Set-Cookie"))
+        {
+            return false;
+        }
+        else if (EqualsIgnoreCase(name, "Cache-Control"))
+        {
+            ForEachListElement(value, [&](std::string_view directive)
+            {
+                const size_t iEquals = directive.find('=');
+                const std::string_view directiveName = Trim(directive.substr(0, iEquals));
+                const std::string_view argument = iEquals == std::string_view::npos ?
+                    std::string_view() :
+                    Trim(directive.substr(iEquals + 1));
+
+                if (EqualsIgnoreCase(directiveName, "public"))
+                {
+                    fPublic = true;
+                }
+                else if (EqualsIgnoreCase(directiveName, "private") ||
+                         EqualsIgnoreCase(directiveName, "no-store") ||
+                         EqualsIgnoreCase(directiveName, "no-cache"))
+                {
+                    fNoCache = true;
+                }
+                else if (EqualsIgnoreCase(directiveName, "max-age"))
+                {
+                    fMaxAge = TryParseSeconds(argument, &dwMaxAge);
+                    fNoCache |= !fMaxAge;
+                }
+                else if (EqualsIgnoreCase(directiveName, "s-maxage"))
+                {
+                    fSharedMaxAge = TryParseSeconds(argument, &dwSharedMaxAge);
+                    fNoCache |= !fSharedMaxAge;
+                }
+            });
+        }
+        else if (EqualsIgnoreCase(name, "Vary"))
+        {
+            ForEachListElement(value, [&](std::string_view header)
+            {
+                std::string strHeader(header);
+                std::transform(strHeader.begin(), strHeader.end(), strHeader.begin(), ToLower);
+                pVaryHeaders->push_back(std::move(strHeader));
+            });
+        }
+    }
+
+    if (tokenizer.HasError() || !fPublic || fNoCache)
+    {
+        return false;
+    }
+
+    *pdwMaxAgeSeconds = fSharedMaxAge ? dwSharedMaxAge : fMaxAge ? dwMaxAge : 0;
+    if (*pdwMaxAgeSeconds == 0)
+    {
+        return false;
+    }
+
+    std::sort(pVaryHeaders->begin(), pVaryHeaders->end());
+    pVaryHeaders->erase(std::unique(pVaryHeaders->begin(), pVaryHeaders->end()), pVaryHeaders->end());
+
+    return std::find(pVaryHeaders->begin(), pVaryHeaders->end(), "*") == pVaryHeaders->end();
+}
+
+// static
+std::string
+RESPONSE_CACHE::BuildKey(
+    const std::string&                  strUrl,
+    const std::vector<std::string>&     rgVaryHeaders,
+    const REQUEST_HEADER_READER&        readHeader
+)
+{
+    std::string strKey(strUrl);
+
+    for (const std::string& strHeader : rgVaryHeaders)
+    {
+        strKey.push_back('\n');
+        strKey.append(strHeader);
+        strKey.push_back(':');
+        strKey.append(readHeader(strHeader));
+    }
+
+    return strKey;
+}
+
+void
+RESPONSE_CACHE::RemoveNoLock(
+    LRU_LIST::iterator  iterEntry
+)
+{
+    const auto iterVary = m_vary.find(iterEntry->strUrl);
+    if (iterVary != m_vary.end() && --iterVary->second.cEntries == 0)
+    {
+        m_vary.erase(iterVary);
+    }
+
+    m_cbSize -= iterEntry->cbSize;
+    m_entries.erase(iterEntry->strKey);
+    m_lru.erase(iterEntry);
+}
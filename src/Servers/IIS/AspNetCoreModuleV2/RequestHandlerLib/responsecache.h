@@ -0,0 +1,203 @@
+// Copyright (c) .NET Foundation. All rights reserved.
+// Licensed under the MIT License. See License.txt in the project root for license information.
+
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+//
+// A backend response kept by RESPONSE_CACHE, the raw status line and headers
+// as received from WinHTTP and the whole entity. Never modified once cached,
+// requests serving it keep it alive after it has been evicted.
+//
+struct CACHED_RESPONSE
+{
+    std::string     strHeaders;
+    std::string     strEntity;
+
+    //
+    // Set by RESPONSE_CACHE::Insert: when the response was cached and the
+    // Age the backend sent with it.
+    //
+    uint64_t        ullInsertedMs = 0;
+    uint32_t        dwInitialAgeSeconds = 0;
+};
+
+//
+// Counters of a RESPONSE_CACHE since it was initialized.
+//
+struct RESPONSE_CACHE_STATISTICS
+{
+    uint64_t    cHits;
+    uint64_t    cMisses;
+    uint64_t    cInserts;
+    uint64_t    cEvictions;
+    uint64_t    cbSize;
+};
+
+//
+// Size-bounded in-memory cache of GET responses the backend marked as
+// publicly cacheable.
+//
+// Entries are keyed by URL and the request values of the headers named by
+// the response's Vary header, expire after their s-maxage or max-age and
+// are evicted least recently used first once the size limit is reached.
+// HEAD requests are served from the GET entries.
+//
+class RESPONSE_CACHE
+{
+public:
+
+    //
+    // Returns the value of a request header, empty if the header is absent.
+    //
+    using REQUEST_HEADER_READER = std::function<std::string_view(const std::string& strName)>;
+
+    //
+    // Bytes charged to every entry on top of its key, headers and entity.
+    //
+    static constexpr uint64_t   ENTRY_OVERHEAD = 256;
+
+    RESPONSE_CACHE() noexcept
+        : m_cbMaxSize(0),
+          m_cbMaxEntitySize(0),
+          m_cbSize(0),
+          m_cHits(0),
+          m_cMisses(0),
+          m_cInserts(0),
+          m_cEvictions(0)
+    {
+    }
+
+    RESPONSE_CACHE(const RESPONSE_CACHE&) = delete;
+    RESPONSE_CACHE& operator=(const RESPONSE_CACHE&) = delete;
+
+    //
+    // A size of 0 disables the cache.
+    //
+    void
+    Initialize(
+        uint64_t    cbMaxSize,
+        uint64_t    cbMaxEntitySize
+    );
+
+    bool
+    IsEnabled() const noexcept
+    {
+        return m_cbMaxSize != 0;
+    }
+
+    uint64_t
+    QueryMaxEntitySize() const noexcept
+    {
+        return m_cbMaxEntitySize;
+    }
+
+    //
+    // Returns the fresh response cached for the request, nullptr on a miss.
+    // strUrl identifies the resource including the host.
+    //
+    std::shared_ptr<const CACHED_RESPONSE>
+    Lookup(
+        const std::string&              strUrl,
+        const REQUEST_HEADER_READER&    readHeader,
+        uint64_t                        ullNowMs
+    );
+
+    //
+    // Caches the response to a GET request if its headers allow it and it
+    // fits. Returns false if the response was not cached.
+    //
+    bool
+    Insert(
+        const std::string&                  strUrl,
+        const REQUEST_HEADER_READER&        readHeader,
+        std::unique_ptr<CACHED_RESPONSE>    pResponse,
+        uint64_t                            ullNowMs
+    );
+
+    RESPONSE_CACHE_STATISTICS
+    QueryStatistics() const;
+
+    //
+    // Value of the Age header of a cached response served at ullNowMs, the
+    // backend's Age plus the whole seconds the response spent in the cache.
+    //
+    static
+    uint32_t
+    QueryAgeSeconds(
+        const CACHED_RESPONSE&  response,
+        uint64_t                ullNowMs
+    ) noexcept;
+
+    //
+    // Parses a raw response header block. A response is cacheable if it is
+    // a 200 without Set-Cookie, marked "public" with a positive s-maxage or
+    // max-age and not private, no-store or no-cache, and does not Vary on
+    // "*". pVaryHeaders receives the lower-cased Vary header names, sorted.
+    // Insert also rejects a response whose Age already reaches its lifetime.
+    //
+    static
+    bool
+    TryGetResponsePolicy(
+        std::string_view            headers,
+        uint32_t *                  pdwMaxAgeSeconds,
+        std::vector<std::string> *  pVaryHeaders
+    );
+
+private:
+
+    struct ENTRY
+    {
+        std::string                             strKey;
+        std::string                             strUrl;
+        std::shared_ptr<const CACHED_RESPONSE>  pResponse;
+        uint64_t                                ullExpiresMs;
+        uint64_t                                cbSize;
+    };
+
+    //
+    // Vary header names of the latest response cached for a URL and the
+    // number of entries of the URL.
+    //
+    struct VARY
+    {
+        std::vector<std::string>    rgHeaders;
+        uint32_t                    cEntries;
+    };
+
+    using LRU_LIST = std::list<ENTRY>;
+
+    static
+    std::string
+    BuildKey(
+        const std::string&                  strUrl,
+        const std::vector<std::string>&     rgVaryHeaders,
+        const REQUEST_HEADER_READER&        readHeader
+    );
+
+    void
+    RemoveNoLock(
+        LRU_LIST::iterator  iterEntry
+    );
+
+    mutable std::mutex                                      m_lock;
+    LRU_LIST                                                m_lru;
+    std::unordered_map<std::string, LRU_LIST::iterator>     m_entries;
+    std::unordered_map<std::string, VARY>                   m_vary;
+    uint64_t                                                m_cbMaxSize;
+    uint64_t                                                m_cbMaxEntitySize;
+    uint64_t                                                m_cbSize;
+    uint64_t                                                m_cHits;
+    uint64_t                                                m_cMisses;
+    uint64_t                                                m_cInserts;
+    uint64_t                                                m_cEvictions;
+};
@@ -0,0 +1,347 @@
+// Copyright (c) .NET Foundation. All rights reserved.
+// Licensed under the MIT License. See License.txt in the project root for license information.
+
+#include "stdafx.h"
+#include "sendfile.h"
+
+namespace
+{
+    inline
+    char
+    ToUpper(
+        char    ch
+    ) noexcept
+    {
+        return ch >= 'a' && ch <= 'z' ? static_cast<char>(ch - 'a' + 'A') : ch;
+    }
+
+    inline
+    wchar_t
+    ToUpper(
+        wchar_t ch
+    ) noexcept
+    {
+        return ch >= L'a' && ch <= L'z' ? static_cast<wchar_t>(ch - L'a' + L'A') : ch;
+    }
+
+    template<typename CHAR>
+    bool
+    EqualsIgnoreCase(
+        std::basic_string_view<CHAR>    left,
+        std::basic_string_view<CHAR>    right
+    ) noexcept
+    {
+        if (left.size() != right.size())
+        {
+            return false;
+        }
+
+        for (size_t i = 0; i < left.size(); i++)
+        {
+            if (ToUpper(left[i]) != ToUpper(right[i]))
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    inline
+    bool
+    IsSeparator(
+        wchar_t ch
+    ) noexcept
+    {
+        return ch == L'\\' || ch == L'/';
+    }
+
+    std::string_view
+    Trim(
+        std::string_view    text
+    ) noexcept
+    {
+        while (!text.empty() && (text.front() == ' ' || text.front() == '\t'))
+        {
+            text.remove_prefix(1);
+        }
+        while (!text.empty() && (text.back() == ' ' || text.back() == '\t'))
+        {
+            text.remove_suffix(1);
+        }
+        return text;
+    }
+
+    //
+    // Parses a non-empty run of digits, saturating at UINT64_MAX.
+    //
+    bool
+    TryParseNumber(
+        std::string_view    text,
+        uint64_t *          pullValue
+    ) noexcept
+    {
+        if (text.empty())
+        {
+            return false;
+        }
+
+        uint64_t ullValue = 0;
+        for (char ch : text)
+        {
+            if (ch < '0' || ch > '9')
+            {
+                return false;
+            }
+
+            const uint64_t ullDigit = static_cast<uint64_t>(ch - '0');
+            ullValue = ullValue > (UINT64_MAX - ullDigit) / 10 ? UINT64_MAX : ullValue * 10 + ullDigit;
+        }
+
+        *pullValue = ullValue;
+        return true;
+    }
+
+    //
+    // CON, PRN, AUX, NUL, COM1-9 and LPT1-9 name a device in any directory
+    // and with any extension.
+    //
+    bool
+    IsDeviceName(
+        std::string_view    segment
+    ) noexcept
+    {
+        const std::string_view base = segment.substr(0, segment.find('.'));
+
+        for (std::string_view device : { "CON", "PRN", "AUX", "NUL" })
+        {
+            if (EqualsIgnoreCase(base, device))
+            {
+                return true;
+            }
+        }
+
+        return base.size() == 4 &&
+            (EqualsIgnoreCase(base.substr(0, 3), std::string_view("COM")) ||
+             EqualsIgnoreCase(base.substr(0, 3), std::string_view("LPT"))) &&
+            base[3] >= '1' && base[3] <= '9';
+    }
+
+    bool
+    IsValidSegment(
+        std::string_view    segment
+    ) noexcept
+    {
+        if (segment.empty() ||
+            segment.back() == '.' ||
+            segment.back() == ' ' ||
+            IsDeviceName(segment))
+        {
+            //
+            // Also rejects "." and "..", Windows drops trailing dots and
+            // spaces so "a.txt." would alias "a.txt".
+            //
+            return false;
+        }
+
+        for (char ch : segment)
+        {
+            if (static_cast<unsigned char>(ch) < 0x20 || ch == 0x7f)
+            {
+                return false;
+            }
+
+            switch (ch)
+            {
+            case '<':
+            case '>':
+            case ':':
+            case '"':
+            case '|':
+            case '?':
+            case '*':
+                return false;
+            }
+        }
+
+        return true;
+    }
+}
+
+// static
+bool
+SEND_FILE::TryNormalizeRelativePath(
+    std::string_view    path,
+    std::string *       pNormalized
+)
+{
+    pNormalized->clear();
+
+    //
+    // The path is relative to the root even if the backend wrote it as
+    // an absolute URL path.
+    //
+    while (!path.empty() && IsSeparator(path.front()))
+    {
+        path.remove_prefix(1);
+    }
+
+    if (path.empty())
+    {
+        return false;
+    }
+
+    while (!path.empty())
+    {
+        size_t cchSegment = 0;
+        while (cchSegment < path.size() && !IsSeparator(path[cchSegment]))
+        {
+            cchSegment++;
+        }
+
+        const std::string_view segment = path.substr(0, cchSegment);
+        if (!IsValidSegment(segment))
+        {
+            pNormalized->clear();
+            return false;
+        }
+
+        if (!pNormalized->empty())
+        {
+            pNormalized->push_back('\\');
+        }
+        pNormalized->append(segment);
+
+        //
+        // A trailing separator leaves an empty last segment, which names a
+        // directory and is rejected.
+        //
+        if (cchSegment == path.size())
+        {
+            break;
+        }
+        path.remove_prefix(cchSegment + 1);
+        if (path.empty())
+        {
+            pNormalized->clear();
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// static
+bool
+SEND_FILE::IsPathUnderRoot(
+    std::wstring_view   root,
+    std::wstring_view   path
+) noexcept
+{
+    while (!root.empty() && IsSeparator(root.back()))
+    {
+        root.remove_suffix(1);
+    }
+
+    if (root.empty() ||
+        path.size() < root.size() ||
+        !EqualsIgnoreCase(root, path.substr(0, root.size())))
+    {
+        return false;
+    }
+
+    return path.size() == root.size() || IsSeparator(path[root.size()]);
+}
+
+// static
+SEND_FILE::RANGE_RESULT
+SEND_FILE::ParseRange(
+    std::string_view    range,
+    uint64_t            cbFile,
+    uint64_t *          pullOffset,
+    uint64_t *          pcbLength
+) noexcept
+{
+    static constexpr std::string_view BYTES_UNIT = "bytes=";
+
+    range = Trim(range);
+    if (range.size() < BYTES_UNIT.size() ||
+        !EqualsIgnoreCase(range.substr(0, BYTES_UNIT.size()), BYTES_UNIT))
+    {
+        return RANGE_NONE;
+    }
+
+    const std::string_view spec = Trim(range.substr(BYTES_UNIT.size()));
+    const size_t iDash = spec.find('-');
+    if (iDash == std::string_view::npos || spec.find(',') != std::string_view::npos)
+    {
+        return RANGE_NONE;
+    }
+
+    const std::string_view first = Trim(spec.substr(0, iDash));
+    const std::string_view last = Trim(spec.substr(iDash + 1));
+
+    if (first.empty())
+    {
+        //
+        // Suffix range, the last n bytes.
+        //
+        uint64_t cbSuffix = 0;
+        if (!TryParseNumber(last, &cbSuffix))
+        {
+            return RANGE_NONE;
+        }
+
+        if (cbSuffix == 0 || cbFile == 0)
+        {
+            return RANGE_NOT_SATISFIABLE;
+        }
+
+        *pcbLength = cbSuffix < cbFile ? cbSuffix : cbFile;
+        *pullOffset = cbFile - *pcbLength;
+        return RANGE_SATISFIABLE;
+    }
+
+    uint64_t ullFirst = 0;
+    uint64_t ullLast = UINT64_MAX;
+    if (!TryParseNumber(first, &ullFirst) ||
+        (!last.empty() && !TryParseNumber(last, &ullLast)) ||
+        ullLast < ullFirst)
+    {
+        return RANGE_NONE;
+    }
+
+    if (ullFirst >= cbFile)
+    {
+        return RANGE_NOT_SATISFIABLE;
+    }
+
+    if (ullLast > cbFile - 1)
+    {
+        ullLast = cbFile - 1;
+    }
+
+    *pullOffset = ullFirst;
+    *pcbLength = ullLast - ullFirst + 1;
+    return RANGE_SATISFIABLE;
+}
+
+// static
+std::string
+SEND_FILE::FormatContentRange(
+    uint64_t    ullOffset,
+    uint64_t    cbLength,
+    uint64_t    cbFile
+)
+{
+    return "bytes " + std::to_string(ullOffset) + "-" + std::to_string(ullOffset + cbLength - 1) +
+        "/" + std::to_string(cbFile);
+}
+
+// static
+std::string
+SEND_FILE::FormatUnsatisfiedContentRange(
+    uint64_t    cbFile
+)
+{
+    return "bytes */" + std::to_string(cbFile);
+}
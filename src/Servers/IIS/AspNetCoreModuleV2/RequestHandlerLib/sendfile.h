@@ -0,0 +1,88 @@
+// Copyright (c) .NET Foundation. All rights reserved.
+// Licensed under the MIT License. See License.txt in the project root for license information.
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+//
+// Validation and Range handling for files the backend asks the module to
+// send in its place with the X-Sendfile response header.
+//
+class SEND_FILE
+{
+public:
+
+    static constexpr char HEADER_NAME[] = "X-Sendfile";
+
+    enum RANGE_RESULT
+    {
+        //
+        // No usable Range, the whole file is sent.
+        //
+        RANGE_NONE,
+        RANGE_SATISFIABLE,
+        RANGE_NOT_SATISFIABLE,
+    };
+
+    //
+    // Validates the path the backend named, relative to the send file root,
+    // and returns it with '\' separators. Rejects anything that could name
+    // a file outside of the root or a different file than it seems to:
+    // empty, "." or ".." segments, drive letters, streams, wildcards,
+    // control characters, trailing dots or spaces and device names.
+    //
+    static
+    bool
+    TryNormalizeRelativePath(
+        std::string_view    path,
+        std::string *       pNormalized
+    );
+
+    //
+    // Whether path, as resolved by the file system, is root or below it.
+    // Both are final paths, compared case-insensitively.
+    //
+    static
+    bool
+    IsPathUnderRoot(
+        std::wstring_view   root,
+        std::wstring_view   path
+    ) noexcept;
+
+    //
+    // Parses a request Range header against a file of cbFile bytes. Only a
+    // single byte range is honored, other units, multiple ranges and
+    // malformed values are ignored as RFC 7233 allows.
+    //
+    static
+    RANGE_RESULT
+    ParseRange(
+        std::string_view    range,
+        uint64_t            cbFile,
+        uint64_t *          pullOffset,
+        uint64_t *          pcbLength
+    ) noexcept;
+
+    //
+    // Content-Range value of a 206, "bytes first-last/size".
+    //
+    static
+    std::string
+    FormatContentRange(
+        uint64_t    ullOffset,
+        uint64_t    cbLength,
+        uint64_t    cbFile
+    );
+
+    //
+    // Content-Range value of a 416, "bytes */size".
+    //
+    static
+    std::string
+    FormatUnsatisfiedContentRange(
+        uint64_t    cbFile
+    );
+};
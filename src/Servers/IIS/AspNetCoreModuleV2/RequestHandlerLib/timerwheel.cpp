@@ -0,0 +1,176 @@
+// Copyright (c) .NET Foundation. All rights reserved.
+// Licensed under the MIT License. See License.txt in the project root for license information.
+
+#include "stdafx.h"
+#include "timerwheel.h"
+
+namespace
+{
+    inline
+    void
+    InsertTail(
+        TIMER_WHEEL_ENTRY * pHead,
+        TIMER_WHEEL_ENTRY * pEntry
+    ) noexcept
+    {
+        pEntry->pPrev = pHead->pPrev;
+        pEntry->pNext = pHead;
+        pHead->pPrev->pNext = pEntry;
+        pHead->pPrev = pEntry;
+    }
+
+    inline
+    void
+    RemoveEntry(
+        TIMER_WHEEL_ENTRY * pEntry
+    ) noexcept
+    {
+        pEntry->pPrev->pNext = pEntry->pNext;
+        pEntry->pNext->pPrev = pEntry->pPrev;
+    }
+
+    inline
+    uint64_t
+    LowBits(
+        uint32_t            cBits
+    ) noexcept
+    {
+        return (1ULL << cBits) - 1;
+    }
+}
+
+TIMER_WHEEL::TIMER_WHEEL(
+    uint64_t            ullNow
+) noexcept
+    : m_ullNow(ullNow),
+      m_cEntries(0)
+{
+    for (auto& rgLevel : m_rgSlots)
+    {
+        for (TIMER_WHEEL_ENTRY& slot : rgLevel)
+        {
+            InitializeList(&slot);
+        }
+    }
+    InitializeList(&m_Overflow);
+}
+
+void
+TIMER_WHEEL::Schedule(
+    TIMER_WHEEL_ENTRY * pEntry,
+    uint64_t            ullDue
+) noexcept
+{
+    Cancel(pEntry);
+
+    //
+    // The slot of the current tick was already expired.
+    //
+    pEntry->ullDue = ullDue;
+    Place(pEntry, ullDue > m_ullNow ? ullDue : m_ullNow + 1);
+    m_cEntries++;
+}
+
+void
+TIMER_WHEEL::Cancel(
+    TIMER_WHEEL_ENTRY * pEntry
+) noexcept
+{
+    if (IsScheduled(pEntry))
+    {
+        Unlink(pEntry);
+    }
+}
+
+void
+TIMER_WHEEL::Tick(
+    TIMER_WHEEL_ENTRY * pExpired
+) noexcept
+{
+    TIMER_WHEEL_ENTRY moving;
+
+    InitializeList(pExpired);
+    m_ullNow++;
+
+    //
+    // When a wheel turns over, the next slot of the wheel above is spread
+    // over the wheels below. Upper wheels go first so their entries can
+    // cascade further down in the same tick.
+    //
+    for (uint32_t iLevel = LEVEL_COUNT; iLevel > 0; iLevel--)
+    {
+        if ((m_ullNow & LowBits(SLOT_BITS * iLevel)) != 0)
+        {
+            continue;
+        }
+
+        InitializeList(&moving);
+        SpliceList(iLevel == LEVEL_COUNT
+                ? &m_Overflow
+                : &m_rgSlots[iLevel][(m_ullNow >> (SLOT_BITS * iLevel)) & (SLOT_COUNT - 1)],
+            &moving);
+
+        while (moving.pNext != &moving)
+        {
+            TIMER_WHEEL_ENTRY *pEntry = moving.pNext;
+            RemoveEntry(pEntry);
+            Place(pEntry, pEntry->ullDue);
+        }
+    }
+
+    SpliceList(&m_rgSlots[0][m_ullNow & (SLOT_COUNT - 1)], pExpired);
+}
+
+void
+TIMER_WHEEL::Place(
+    TIMER_WHEEL_ENTRY * pEntry,
+    uint64_t            ullSlotDue
+) noexcept
+{
+    //
+    // The lowest wheel on which the deadline only differs from the current
+    // time in that wheel's bits.
+    //
+    const uint64_t ullDifference = ullSlotDue ^ m_ullNow;
+
+    for (uint32_t iLevel = 0; iLevel < LEVEL_COUNT; iLevel++)
+    {
+        if ((ullDifference >> (SLOT_BITS * (iLevel + 1))) == 0)
+        {
+            InsertTail(&m_rgSlots[iLevel][(ullSlotDue >> (SLOT_BITS * iLevel)) & (SLOT_COUNT - 1)], pEntry);
+            return;
+        }
+    }
+
+    InsertTail(&m_Overflow, pEntry);
+}
+
+void
+TIMER_WHEEL::Unlink(
+    TIMER_WHEEL_ENTRY * pEntry
+) noexcept
+{
+    RemoveEntry(pEntry);
+    pEntry->pPrev = nullptr;
+    pEntry->pNext = nullptr;
+    m_cEntries--;
+}
+
+// static
+void
+TIMER_WHEEL::SpliceList(
+    TIMER_WHEEL_ENTRY * pSource,
+    TIMER_WHEEL_ENTRY * pTarget
+) noexcept
+{
+    if (pSource->pNext == pSource)
+    {
+        return;
+    }
+
+    pSource->pNext->pPrev = pTarget->pPrev;
+    pTarget->pPrev->pNext = pSource->pNext;
+    pSource->pPrev->pNext = pTarget;
+    pTarget->pPrev = pSource->pPrev;
+    InitializeList(pSource);
+}
@@ -0,0 +1,235 @@
+// Copyright (c) .NET Foundation. All rights reserved.
+// Licensed under the MIT License. See License.txt in the project root for license information.
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+//
+// Link embedded in an object with a deadline on a TIMER_WHEEL. The object
+// is found back from it with CONTAINING_RECORD.
+//
+struct TIMER_WHEEL_ENTRY
+{
+    TIMER_WHEEL_ENTRY * pPrev = nullptr;
+    TIMER_WHEEL_ENTRY * pNext = nullptr;
+    uint64_t            ullDue = 0;
+};
+
+//
+// Hierarchical timer wheel: one timer drives the deadlines of any number of
+// objects. LEVEL_COUNT wheels of SLOT_COUNT slots each, a deadline goes to
+// the lowest wheel whose range still covers it and moves down as time
+// approaches it. Scheduling and cancelling are O(1), advancing costs one
+// step per tick plus moving every entry down at most LEVEL_COUNT times.
+//
+// Time is counted in ticks of the caller's choosing. The wheel is not
+// thread safe, callers serialize access to it.
+//
+class TIMER_WHEEL
+{
+public:
+
+    static constexpr uint32_t   SLOT_BITS = 6;
+    static constexpr uint32_t   SLOT_COUNT = 1 << SLOT_BITS;
+    static constexpr uint32_t   LEVEL_COUNT = 4;
+
+    explicit
+    TIMER_WHEEL(
+        uint64_t            ullNow = 0
+    ) noexcept;
+
+    TIMER_WHEEL(const TIMER_WHEEL&) = delete;
+    TIMER_WHEEL& operator=(const TIMER_WHEEL&) = delete;
+
+    //
+    // Deadlines that already passed expire on the next tick. Scheduling an
+    // entry that is scheduled moves it.
+    //
+    void
+    Schedule(
+        TIMER_WHEEL_ENTRY * pEntry,
+        uint64_t            ullDue
+    ) noexcept;
+
+    //
+    // Entries that are not scheduled are ignored.
+    //
+    void
+    Cancel(
+        TIMER_WHEEL_ENTRY * pEntry
+    ) noexcept;
+
+    static
+    bool
+    IsScheduled(
+        const TIMER_WHEEL_ENTRY *   pEntry
+    ) noexcept
+    {
+        return pEntry->pNext != nullptr;
+    }
+
+    //
+    // Moves time forward to ullNow and calls onExpired for every entry
+    // whose deadline passed, in deadline order tick by tick. The entry is
+    // no longer scheduled when it is passed, onExpired may schedule or
+    // cancel any entry.
+    //
+    template<typename ON_EXPIRED>
+    void
+    Advance(
+        uint64_t            ullNow,
+        ON_EXPIRED          onExpired
+    )
+    {
+        while (m_ullNow < ullNow)
+        {
+            if (m_cEntries == 0)
+            {
+                m_ullNow = ullNow;
+                break;
+            }
+
+            TIMER_WHEEL_ENTRY expired;
+            Tick(&expired);
+
+            while (expired.pNext != &expired)
+            {
+                TIMER_WHEEL_ENTRY *pEntry = expired.pNext;
+                Unlink(pEntry);
+                onExpired(pEntry);
+            }
+        }
+    }
+
+    uint64_t
+    QueryNow() const noexcept
+    {
+        return m_ullNow;
+    }
+
+    size_t
+    QueryCount() const noexcept
+    {
+        return m_cEntries;
+    }
+
+private:
+
+    //
+    // Moves time one tick forward and moves the entries that expire at it
+    // to the pExpired list.
+    //
+    void
+    Tick(
+        TIMER_WHEEL_ENTRY * pExpired
+    ) noexcept;
+
+    void
+    Place(
+        TIMER_WHEEL_ENTRY * pEntry,
+        uint64_t            ullSlotDue
+    ) noexcept;
+
+    void
+    Unlink(
+        TIMER_WHEEL_ENTRY * pEntry
+    ) noexcept;
+
+    static
+    void
+    InitializeList(
+        TIMER_WHEEL_ENTRY * pHead
+    ) noexcept
+    {
+        pHead->pPrev = pHead;
+        pHead->pNext = pHead;
+    }
+
+    //
+    // Moves the entries of pSource to the end of pTarget.
+    //
+    static
+    void
+    SpliceList(
+        TIMER_WHEEL_ENTRY * pSource,
+        TIMER_WHEEL_ENTRY * pTarget
+    ) noexcept;
+
+    uint64_t            m_ullNow;
+    size_t              m_cEntries;
+    TIMER_WHEEL_ENTRY   m_rgSlots[LEVEL_COUNT][SLOT_COUNT];
+    //
+    // Deadlines beyond the range of the highest wheel, they are placed
+    // again whenever it turns.
+    //
+    TIMER_WHEEL_ENTRY   m_Overflow;
+};
+
+//
+// Deadline of a connection that times out after a period without activity.
+// Activity only records when it happened, so it costs no timer operation.
+// The deadline is checked when it fires and is pushed out by the activity
+// seen meanwhile.
+//
+class IDLE_DEADLINE
+{
+public:
+
+    IDLE_DEADLINE() noexcept
+        : m_ullTimeout(0),
+          m_ullLastActivity(0)
+    {
+    }
+
+    void
+    Initialize(
+        uint64_t            ullTimeout,
+        uint64_t            ullNow
+    ) noexcept
+    {
+        m_ullTimeout = ullTimeout;
+        m_ullLastActivity.store(ullNow, std::memory_order_relaxed);
+    }
+
+    bool
+    IsEnabled() const noexcept
+    {
+        return m_ullTimeout != 0;
+    }
+
+    void
+    OnActivity(
+        uint64_t            ullNow
+    ) noexcept
+    {
+        m_ullLastActivity.store(ullNow, std::memory_order_relaxed);
+    }
+
+    uint64_t
+    QueryDue() const noexcept
+    {
+        return m_ullLastActivity.load(std::memory_order_relaxed) + m_ullTimeout;
+    }
+
+    //
+    // True if there was no activity for the timeout at ullNow, otherwise the
+    // deadline has to be checked again at *pullNextDue.
+    //
+    bool
+    IsExpired(
+        uint64_t            ullNow,
+        uint64_t *          pullNextDue
+    ) const noexcept
+    {
+        *pullNextDue = QueryDue();
+        return ullNow >= *pullNextDue;
+    }
+
+private:
+
+    uint64_t                m_ullTimeout;
+    std::atomic<uint64_t>   m_ullLastActivity;
+};